@@ -53,6 +53,17 @@ inline XMMATRIX InverseTranspose(CXMMATRIX m)
 	return XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(tmp),tmp));
 }
 
+//Gather the sign bits of the 4 lanes, e.g. of a comparison result
+inline UINT MoveMask(FXMVECTOR V)
+{
+#if defined(_XM_SSE_INTRINSICS_) && !defined(_XM_NO_INTRINSICS_)
+	return _mm_movemask_ps(V);
+#else
+	return (XMVectorGetIntX(V) >> 31) | ((XMVectorGetIntY(V) >> 31) << 1) |
+		   ((XMVectorGetIntZ(V) >> 31) << 2) | ((XMVectorGetIntW(V) >> 31) << 3);
+#endif
+}
+
 namespace Colors
 {
 	//Most frequently used colors
@@ -0,0 +1,635 @@
+#include "BoundingVolumes.h"
+#include <ppl.h>
+#include <vector>
+#include <cmath>
+
+namespace BoundingVolumes
+{
+	static const UINT	g_blockSize = 32768;			//Points per task
+	static const UINT	g_maxMinimalPasses = 32;		//Passes of SphereMinimal before it settles for the farthest point
+	static const double	g_minimalTolerance = 1e-6;		//Relative radius error accepted by SphereMinimal
+
+	//Per block results, merged in block order so the outcome does not depend on the scheduling
+	struct BoxPartial
+	{
+		XMFLOAT3	vMin;
+		XMFLOAT3	vMax;
+	};
+
+	struct ExtremesPartial
+	{
+		XMFLOAT3	minPoint[3];						//Points with the smallest x, y and z
+		XMFLOAT3	maxPoint[3];
+	};
+
+	struct SpherePartial
+	{
+		XMFLOAT3	center;
+		float		radius;
+	};
+
+	struct FarthestPartial
+	{
+		XMFLOAT3	point;
+		float		distSq;
+	};
+
+	struct MomentsPartial
+	{
+		XMFLOAT3	mean;
+		float		xx, yy, zz, xy, xz, yz;				//Sums of the products of the offsets from the mean
+		UINT		count;
+	};
+
+	static inline XMVECTOR LoadPoint(const XMFLOAT3 *points, UINT stride, UINT i)
+	{
+		return XMLoadFloat3((const XMFLOAT3*)((const BYTE*)points + i * stride));
+	}
+
+	UINT PointArray::Read(const XMFLOAT3 **points, UINT *stride)
+	{
+		if(m_read)
+			return 0;
+
+		m_read = true;
+		*points = m_points;
+		*stride = m_stride;
+		return m_count;
+	}
+
+	//Call func(points, count, stride, partial) for blocks of every chunk in parallel, one partial per block
+	template<typename Partial, typename Func>
+	static void ForEachBlock(PointSource &source, std::vector<Partial> &partials, const Func &func)
+	{
+		partials.clear();
+		source.Reset();
+
+		const XMFLOAT3 *points;
+		UINT stride;
+		UINT count;
+		while((count = source.Read(&points,&stride)) > 0)
+		{
+			UINT first = partials.size();
+			UINT nBlocks = (count + g_blockSize - 1) / g_blockSize;
+			partials.resize(first + nBlocks);
+
+			Concurrency::parallel_for(0U,nBlocks,[&](UINT block)
+			{
+				UINT begin = block * g_blockSize;
+				const XMFLOAT3 *blockPoints = (const XMFLOAT3*)((const BYTE*)points + begin * stride);
+				func(blockPoints,min(g_blockSize,count - begin),stride,partials[first + block]);
+			});
+		}
+
+		XMASSERT(!partials.empty());
+	}
+
+	//Bounds of the points transformed by 'm', or as they are when 'm' is NULL
+	static void BlockBox(const XMFLOAT3 *points, UINT count, UINT stride, const XMMATRIX *m, BoxPartial &partial)
+	{
+		//Two accumulators so consecutive points do not wait on each other
+		XMVECTOR p = LoadPoint(points,stride,0);
+		if(m)
+			p = XMVector3TransformNormal(p,*m);
+		XMVECTOR vMin0 = p, vMax0 = p;
+		XMVECTOR vMin1 = p, vMax1 = p;
+
+		UINT i = 1;
+		for(; i+1<count; i+=2)
+		{
+			XMVECTOR p0 = LoadPoint(points,stride,i);
+			XMVECTOR p1 = LoadPoint(points,stride,i + 1);
+			if(m)
+			{
+				p0 = XMVector3TransformNormal(p0,*m);
+				p1 = XMVector3TransformNormal(p1,*m);
+			}
+			vMin0 = XMVectorMin(vMin0,p0);
+			vMax0 = XMVectorMax(vMax0,p0);
+			vMin1 = XMVectorMin(vMin1,p1);
+			vMax1 = XMVectorMax(vMax1,p1);
+		}
+		if(i < count)
+		{
+			p = LoadPoint(points,stride,i);
+			if(m)
+				p = XMVector3TransformNormal(p,*m);
+			vMin0 = XMVectorMin(vMin0,p);
+			vMax0 = XMVectorMax(vMax0,p);
+		}
+
+		XMStoreFloat3(&partial.vMin,XMVectorMin(vMin0,vMin1));
+		XMStoreFloat3(&partial.vMax,XMVectorMax(vMax0,vMax1));
+	}
+
+	static void MergeBoxes(const std::vector<BoxPartial> &partials, XMVECTOR &vMin, XMVECTOR &vMax)
+	{
+		vMin = XMLoadFloat3(&partials[0].vMin);
+		vMax = XMLoadFloat3(&partials[0].vMax);
+		for(UINT i=1; i<partials.size(); ++i)
+		{
+			vMin = XMVectorMin(vMin,XMLoadFloat3(&partials[i].vMin));
+			vMax = XMVectorMax(vMax,XMLoadFloat3(&partials[i].vMax));
+		}
+	}
+
+	void ComputeAxisAlignedBox(XNA::AxisAlignedBox *out, PointSource &source)
+	{
+		XMASSERT(out);
+
+		std::vector<BoxPartial> partials;
+		ForEachBlock(source,partials,[](const XMFLOAT3 *points, UINT count, UINT stride, BoxPartial &partial)
+		{
+			BlockBox(points,count,stride,NULL,partial);
+		});
+
+		XMVECTOR vMin, vMax;
+		MergeBoxes(partials,vMin,vMax);
+		XMStoreFloat3(&out->Center,(vMin + vMax) * 0.5f);
+		XMStoreFloat3(&out->Extents,(vMax - vMin) * 0.5f);
+	}
+
+	//First points with the smallest and largest coordinate on each axis. The lanes of the index vectors follow the axes.
+	static void BlockExtremes(const XMFLOAT3 *points, UINT count, UINT stride, ExtremesPartial &partial)
+	{
+		XMVECTOR vMin = LoadPoint(points,stride,0);
+		XMVECTOR vMax = vMin;
+		XMVECTOR minIndex = XMVectorZero();
+		XMVECTOR maxIndex = XMVectorZero();
+		for(UINT i=1; i<count; ++i)
+		{
+			XMVECTOR p = LoadPoint(points,stride,i);
+			XMVECTOR index = XMVectorReplicateInt(i);
+			XMVECTOR less = XMVectorLess(p,vMin);
+			XMVECTOR greater = XMVectorGreater(p,vMax);
+			vMin = XMVectorSelect(vMin,p,less);
+			vMax = XMVectorSelect(vMax,p,greater);
+			minIndex = XMVectorSelect(minIndex,index,less);
+			maxIndex = XMVectorSelect(maxIndex,index,greater);
+		}
+
+		UINT minIndices[4], maxIndices[4];
+		XMStoreInt4(minIndices,minIndex);
+		XMStoreInt4(maxIndices,maxIndex);
+		for(UINT a=0; a<3; ++a)
+		{
+			XMStoreFloat3(&partial.minPoint[a],LoadPoint(points,stride,minIndices[a]));
+			XMStoreFloat3(&partial.maxPoint[a],LoadPoint(points,stride,maxIndices[a]));
+		}
+	}
+
+	//Ritter's growth: move the sphere toward every point outside it, just enough to contain it
+	static void BlockGrowSphere(const XMFLOAT3 *points, UINT count, UINT stride, const SpherePartial &start, SpherePartial &partial)
+	{
+		XMVECTOR center = XMLoadFloat3(&start.center);
+		XMVECTOR radius = XMVectorReplicate(start.radius);
+		for(UINT i=0; i<count; ++i)
+		{
+			XMVECTOR delta = LoadPoint(points,stride,i) - center;
+			XMVECTOR dist = XMVector3Length(delta);
+			if(XMVector3Greater(dist,radius))
+			{
+				radius = (radius + dist) * 0.5f;
+				center += (XMVectorReplicate(1.f) - radius * XMVectorReciprocal(dist)) * delta;
+			}
+		}
+
+		XMStoreFloat3(&partial.center,center);
+		partial.radius = XMVectorGetX(radius);
+	}
+
+	//Smallest sphere containing two spheres
+	static SpherePartial MergeSpheres(const SpherePartial &a, const SpherePartial &b)
+	{
+		XMVECTOR ca = XMLoadFloat3(&a.center);
+		XMVECTOR delta = XMLoadFloat3(&b.center) - ca;
+		float dist = XMVectorGetX(XMVector3Length(delta));
+		if(dist + b.radius <= a.radius)
+			return a;
+		if(dist + a.radius <= b.radius)
+			return b;
+
+		SpherePartial merged;
+		merged.radius = (dist + a.radius + b.radius) * 0.5f;
+		XMStoreFloat3(&merged.center,ca + delta * ((merged.radius - a.radius) / dist));
+		return merged;
+	}
+
+	//Grow 'start' over every block, then merge the spheres of the blocks
+	static SpherePartial GrowSphere(PointSource &source, const SpherePartial &start)
+	{
+		std::vector<SpherePartial> partials;
+		ForEachBlock(source,partials,[&](const XMFLOAT3 *points, UINT count, UINT stride, SpherePartial &partial)
+		{
+			BlockGrowSphere(points,count,stride,start,partial);
+		});
+
+		SpherePartial sphere = partials[0];
+		for(UINT i=1; i<partials.size(); ++i)
+			sphere = MergeSpheres(sphere,partials[i]);
+		return sphere;
+	}
+
+	//Double precision point for the exact sphere, where the circumsphere equations lose accuracy in float
+	struct Point
+	{
+		double	v[3];
+
+		Point() {}
+		explicit Point(const XMFLOAT3 &p)	{ v[0] = p.x; v[1] = p.y; v[2] = p.z; }
+	};
+
+	struct Ball
+	{
+		Point	center;
+		double	radiusSq;
+	};
+
+	static inline double Dot(const double *a, const double *b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	static inline void Cross(const double *a, const double *b, double *out)
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	static inline bool Outside(const Ball &ball, const Point &p)
+	{
+		double d[3] = {p.v[0] - ball.center.v[0], p.v[1] - ball.center.v[1], p.v[2] - ball.center.v[2]};
+		return Dot(d,d) > ball.radiusSq * (1.0 + 2.0 * g_minimalTolerance);
+	}
+
+	//Smallest sphere with all the support points on its surface
+	static Ball BallFromSupport(const Point *support, UINT n)
+	{
+		Ball ball;
+		if(n == 0)
+		{
+			ball.center.v[0] = ball.center.v[1] = ball.center.v[2] = 0.0;
+			ball.radiusSq = -1.0;
+			return ball;
+		}
+
+		const double *p0 = support[0].v;
+		double offset[3] = {0.0, 0.0, 0.0};
+		double radiusSq = -1.0;				//Unless set, the distance from p0 to the center
+		double a[3], b[3], c[3], axb[3], bxc[3], cxa[3];
+		for(UINT k=0; k<3; ++k)
+		{
+			a[k] = n > 1 ? support[1].v[k] - p0[k] : 0.0;
+			b[k] = n > 2 ? support[2].v[k] - p0[k] : 0.0;
+			c[k] = n > 3 ? support[3].v[k] - p0[k] : 0.0;
+		}
+
+		if(n == 2)
+		{
+			for(UINT k=0; k<3; ++k)
+				offset[k] = 0.5 * a[k];
+		}
+		else if(n == 3)
+		{
+			//Circumcenter: (|a|^2 b - |b|^2 a) x (a x b) / (2 |a x b|^2)
+			Cross(a,b,axb);
+			double denom = 2.0 * Dot(axb,axb);
+			if(denom > 0.0)
+			{
+				double aa = Dot(a,a), bb = Dot(b,b);
+				double t[3] = {aa * b[0] - bb * a[0], aa * b[1] - bb * a[1], aa * b[2] - bb * a[2]};
+				Cross(t,axb,offset);
+				for(UINT k=0; k<3; ++k)
+					offset[k] /= denom;
+			}
+			else
+			{
+				//Collinear: the two farthest points span the sphere, and p0 may lie between the others
+				double ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+				double aa = Dot(a,a), bb = Dot(b,b), abab = Dot(ab,ab);
+				if(abab > aa && abab > bb)
+				{
+					for(UINT k=0; k<3; ++k)
+						offset[k] = 0.5 * (a[k] + b[k]);
+					radiusSq = 0.25 * abab;
+				}
+				else
+				{
+					const double *far = aa > bb ? a : b;
+					for(UINT k=0; k<3; ++k)
+						offset[k] = 0.5 * far[k];
+				}
+			}
+		}
+		else if(n == 4)
+		{
+			//Solve 2 [a b c]^T x = (|a|^2, |b|^2, |c|^2)
+			Cross(a,b,axb);
+			Cross(b,c,bxc);
+			Cross(c,a,cxa);
+			double denom = 2.0 * Dot(a,bxc);
+			if(fabs(denom) > 1e-12 * sqrt(Dot(a,a) * Dot(b,b) * Dot(c,c)))
+			{
+				double aa = Dot(a,a), bb = Dot(b,b), cc = Dot(c,c);
+				for(UINT k=0; k<3; ++k)
+					offset[k] = (aa * bxc[k] + bb * cxa[k] + cc * axb[k]) / denom;
+			}
+			else
+				return BallFromSupport(support,3);		//Coplanar, the fourth point is on the circle of the others
+		}
+
+		for(UINT k=0; k<3; ++k)
+			ball.center.v[k] = p0[k] + offset[k];
+		ball.radiusSq = radiusSq >= 0.0 ? radiusSq : Dot(offset,offset);
+		return ball;
+	}
+
+	//Welzl's algorithm on points [0, n), with 'support' on the surface of the sphere
+	static Ball Welzl(const Point *points, UINT n, Point *support, UINT nSupport)
+	{
+		Ball ball = BallFromSupport(support,nSupport);
+		if(nSupport == 4)
+			return ball;
+
+		for(UINT i=0; i<n; ++i)
+		{
+			if(Outside(ball,points[i]))
+			{
+				support[nSupport] = points[i];
+				ball = Welzl(points,i,support,nSupport + 1);
+			}
+		}
+
+		return ball;
+	}
+
+	//Farthest point of a block from 'center'
+	static void BlockFarthest(const XMFLOAT3 *points, UINT count, UINT stride, const XMFLOAT3 &center, FarthestPartial &partial)
+	{
+		XMVECTOR c = XMLoadFloat3(&center);
+		XMVECTOR maxDistSq = XMVectorReplicate(-1.f);
+		XMVECTOR maxIndex = XMVectorZero();
+		for(UINT i=0; i<count; ++i)
+		{
+			XMVECTOR d = LoadPoint(points,stride,i) - c;
+			XMVECTOR distSq = XMVector3LengthSq(d);
+			XMVECTOR greater = XMVectorGreater(distSq,maxDistSq);
+			maxDistSq = XMVectorSelect(maxDistSq,distSq,greater);
+			maxIndex = XMVectorSelect(maxIndex,XMVectorReplicateInt(i),greater);
+		}
+
+		XMStoreFloat3(&partial.point,LoadPoint(points,stride,XMVectorGetIntX(maxIndex)));
+		partial.distSq = XMVectorGetX(maxDistSq);
+	}
+
+	//Exact sphere of the candidates, then add the farthest point of every block left outside, until all points are inside
+	static void MinimalSphere(PointSource &source, std::vector<Point> &candidates, SpherePartial &sphere)
+	{
+		std::vector<FarthestPartial> farthest;
+		for(UINT pass=0; pass<g_maxMinimalPasses; ++pass)
+		{
+			Point support[4];
+			Ball ball = Welzl(&candidates[0],candidates.size(),support,0);
+			XMFLOAT3 center((float)ball.center.v[0],(float)ball.center.v[1],(float)ball.center.v[2]);
+
+			ForEachBlock(source,farthest,[&](const XMFLOAT3 *points, UINT count, UINT stride, FarthestPartial &partial)
+			{
+				BlockFarthest(points,count,stride,center,partial);
+			});
+
+			//New candidates go first, they are the most likely to support the sphere
+			std::vector<Point> added;
+			double maxDistSq = ball.radiusSq;
+			for(UINT i=0; i<farthest.size(); ++i)
+			{
+				maxDistSq = max(maxDistSq,(double)farthest[i].distSq);
+				if(Outside(ball,Point(farthest[i].point)))
+					added.push_back(Point(farthest[i].point));
+			}
+
+			//Without new points(or out of passes) the radius still covers every point, including the float rounding of the center
+			sphere.center = center;
+			sphere.radius = (float)sqrt(maxDistSq);
+			if(added.empty())
+				break;
+			candidates.insert(candidates.begin(),added.begin(),added.end());
+		}
+	}
+
+	void ComputeSphere(XNA::Sphere *out, PointSource &source, SphereMode mode)
+	{
+		XMASSERT(out);
+
+		//Extreme points of the whole set. Strict comparisons keep the first ones, as XNA.
+		std::vector<ExtremesPartial> extremes;
+		ForEachBlock(source,extremes,[](const XMFLOAT3 *points, UINT count, UINT stride, ExtremesPartial &partial)
+		{
+			BlockExtremes(points,count,stride,partial);
+		});
+
+		ExtremesPartial e = extremes[0];
+		for(UINT i=1; i<extremes.size(); ++i)
+		{
+			for(UINT a=0; a<3; ++a)
+			{
+				if((&extremes[i].minPoint[a].x)[a] < (&e.minPoint[a].x)[a])
+					e.minPoint[a] = extremes[i].minPoint[a];
+				if((&extremes[i].maxPoint[a].x)[a] > (&e.maxPoint[a].x)[a])
+					e.maxPoint[a] = extremes[i].maxPoint[a];
+			}
+		}
+
+		//Start from the pair farthest apart
+		UINT best = 0;
+		float bestDist = -1.f;
+		for(UINT a=0; a<3; ++a)
+		{
+			float dist = XMVectorGetX(XMVector3Length(XMLoadFloat3(&e.maxPoint[a]) - XMLoadFloat3(&e.minPoint[a])));
+			if(dist > bestDist)
+			{
+				bestDist = dist;
+				best = a;
+			}
+		}
+
+		SpherePartial start;
+		XMStoreFloat3(&start.center,(XMLoadFloat3(&e.maxPoint[best]) + XMLoadFloat3(&e.minPoint[best])) * 0.5f);
+		start.radius = bestDist * 0.5f;
+		SpherePartial sphere = GrowSphere(source,start);
+
+		if(mode == SphereMinimal)
+		{
+			//Start from the axis extremes: the minimal sphere is usually supported by few points near them
+			std::vector<Point> candidates;
+			for(UINT a=0; a<3; ++a)
+			{
+				candidates.push_back(Point(e.minPoint[a]));
+				candidates.push_back(Point(e.maxPoint[a]));
+			}
+			MinimalSphere(source,candidates,sphere);
+		}
+		out->Center = sphere.center;
+		out->Radius = sphere.radius;
+	}
+
+	//Mean and scatter of a block, summed around its first point then moved to the mean
+	static void BlockMoments(const XMFLOAT3 *points, UINT count, UINT stride, MomentsPartial &partial)
+	{
+		XMVECTOR origin = LoadPoint(points,stride,0);
+		XMVECTOR sum = XMVectorZero();
+		XMVECTOR xx_yy_zz = XMVectorZero();
+		XMVECTOR xy_xz_yz = XMVectorZero();
+		for(UINT i=1; i<count; ++i)
+		{
+			XMVECTOR d = LoadPoint(points,stride,i) - origin;
+			sum += d;
+			xx_yy_zz += d * d;
+			xy_xz_yz += XMVectorSwizzle(d,0,0,1,3) * XMVectorSwizzle(d,1,2,2,3);
+		}
+
+		XMVECTOR mean = sum * (1.f / count);
+		xx_yy_zz -= sum * mean;
+		xy_xz_yz -= XMVectorSwizzle(sum,0,0,1,3) * XMVectorSwizzle(mean,1,2,2,3);
+
+		XMStoreFloat3(&partial.mean,origin + mean);
+		partial.xx = XMVectorGetX(xx_yy_zz);
+		partial.yy = XMVectorGetY(xx_yy_zz);
+		partial.zz = XMVectorGetZ(xx_yy_zz);
+		partial.xy = XMVectorGetX(xy_xz_yz);
+		partial.xz = XMVectorGetY(xy_xz_yz);
+		partial.yz = XMVectorGetZ(xy_xz_yz);
+		partial.count = count;
+	}
+
+	//Eigenvectors of a symmetric matrix by Jacobi rotations, returned as the columns of 'v'
+	static void SymmetricEigenVectors(double a[3][3], double v[3][3])
+	{
+		for(UINT i=0; i<3; ++i)
+		{
+			for(UINT j=0; j<3; ++j)
+				v[i][j] = i == j ? 1.0 : 0.0;
+		}
+
+		for(UINT sweep=0; sweep<32; ++sweep)
+		{
+			double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+			double diagonal = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+			if(off <= 1e-24 * diagonal)
+				break;
+
+			for(UINT p=0; p<2; ++p)
+			{
+				for(UINT q=p+1; q<3; ++q)
+				{
+					if(a[p][q] == 0.0)
+						continue;
+
+					//Rotation zeroing a[p][q]
+					double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+					double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+					double c = 1.0 / sqrt(t * t + 1.0);
+					double s = t * c;
+
+					for(UINT k=0; k<3; ++k)
+					{
+						double akp = a[k][p], akq = a[k][q];
+						a[k][p] = c * akp - s * akq;
+						a[k][q] = s * akp + c * akq;
+					}
+					for(UINT k=0; k<3; ++k)
+					{
+						double apk = a[p][k], aqk = a[q][k];
+						a[p][k] = c * apk - s * aqk;
+						a[q][k] = s * apk + c * aqk;
+					}
+					for(UINT k=0; k<3; ++k)
+					{
+						double vkp = v[k][p], vkq = v[k][q];
+						v[k][p] = c * vkp - s * vkq;
+						v[k][q] = s * vkp + c * vkq;
+					}
+				}
+			}
+		}
+	}
+
+	void ComputeOrientedBox(XNA::OrientedBox *out, PointSource &source)
+	{
+		XMASSERT(out);
+
+		//Covariance of all the points, merging the blocks in double precision(Chan et al.)
+		std::vector<MomentsPartial> moments;
+		ForEachBlock(source,moments,[](const XMFLOAT3 *points, UINT count, UINT stride, MomentsPartial &partial)
+		{
+			BlockMoments(points,count,stride,partial);
+		});
+
+		double mean[3] = {moments[0].mean.x, moments[0].mean.y, moments[0].mean.z};
+		double c[3][3] = {
+			{moments[0].xx, moments[0].xy, moments[0].xz},
+			{moments[0].xy, moments[0].yy, moments[0].yz},
+			{moments[0].xz, moments[0].yz, moments[0].zz}};
+		double n = moments[0].count;
+		for(UINT i=1; i<moments.size(); ++i)
+		{
+			const MomentsPartial &m = moments[i];
+			double nb = m.count;
+			double total = n + nb;
+			double delta[3] = {m.mean.x - mean[0], m.mean.y - mean[1], m.mean.z - mean[2]};
+			double scatter[3][3] = {{m.xx, m.xy, m.xz}, {m.xy, m.yy, m.yz}, {m.xz, m.yz, m.zz}};
+			for(UINT r=0; r<3; ++r)
+			{
+				for(UINT k=0; k<3; ++k)
+					c[r][k] += scatter[r][k] + delta[r] * delta[k] * n * nb / total;
+			}
+			for(UINT r=0; r<3; ++r)
+				mean[r] += delta[r] * nb / total;
+			n = total;
+		}
+
+		double v[3][3];
+		SymmetricEigenVectors(c,v);
+
+		XMMATRIX R;
+		R.r[0] = XMVectorSet((float)v[0][0],(float)v[1][0],(float)v[2][0],0.f);
+		R.r[1] = XMVectorSet((float)v[0][1],(float)v[1][1],(float)v[2][1],0.f);
+		R.r[2] = XMVector3Cross(R.r[0],R.r[1]);				//Right handed, for XMQuaternionRotationMatrix
+		R.r[3] = XMVectorSet(0.f,0.f,0.f,1.f);
+
+		XMVECTOR orientation = XMQuaternionNormalize(XMQuaternionRotationMatrix(R));
+		R = XMMatrixRotationQuaternion(orientation);
+		XMMATRIX inverseR = XMMatrixTranspose(R);
+
+		//Extents along the axes
+		std::vector<BoxPartial> boxes;
+		ForEachBlock(source,boxes,[&](const XMFLOAT3 *points, UINT count, UINT stride, BoxPartial &partial)
+		{
+			BlockBox(points,count,stride,&inverseR,partial);
+		});
+
+		XMVECTOR vMin, vMax;
+		MergeBoxes(boxes,vMin,vMax);
+		XMStoreFloat3(&out->Center,XMVector3TransformNormal((vMin + vMax) * 0.5f,R));
+		XMStoreFloat3(&out->Extents,(vMax - vMin) * 0.5f);
+		XMStoreFloat4(&out->Orientation,orientation);
+	}
+
+	void ComputeAxisAlignedBox(XNA::AxisAlignedBox *out, UINT count, const XMFLOAT3 *points, UINT stride)
+	{
+		PointArray source(count,points,stride);
+		ComputeAxisAlignedBox(out,source);
+	}
+
+	void ComputeSphere(XNA::Sphere *out, UINT count, const XMFLOAT3 *points, UINT stride, SphereMode mode)
+	{
+		PointArray source(count,points,stride);
+		ComputeSphere(out,source,mode);
+	}
+
+	void ComputeOrientedBox(XNA::OrientedBox *out, UINT count, const XMFLOAT3 *points, UINT stride)
+	{
+		PointArray source(count,points,stride);
+		ComputeOrientedBox(out,source);
+	}
+}
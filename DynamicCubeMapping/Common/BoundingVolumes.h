@@ -0,0 +1,60 @@
+#ifndef _BOUNDING_VOLUMES_H_
+#define _BOUNDING_VOLUMES_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include "xnacollision.h"
+
+//Bounding volumes of large point sets, as XNA::ComputeBounding*FromPoints but split into blocks processed in parallel.
+//The points come from a PointSource one chunk at a time, so the whole set never has to be in memory:
+//each volume reads the source once or twice(and more for the minimal sphere).
+namespace BoundingVolumes
+{
+	//Points delivered in chunks. A chunk stays valid until the next call to Read.
+	class PointSource
+	{
+	public:
+		virtual ~PointSource() {}
+
+		//Go back to the first chunk
+		virtual void Reset() = 0;
+		//Return the number of points in the next chunk, 0 at the end
+		virtual UINT Read(const XMFLOAT3 **points, UINT *stride) = 0;
+	};
+
+	//Points already in memory, delivered as a single chunk
+	class PointArray: public PointSource
+	{
+	public:
+		PointArray(UINT count, const XMFLOAT3 *points, UINT stride)
+			: m_count(count), m_points(points), m_stride(stride), m_read(false) {}
+
+		void Reset()	{ m_read = false; }
+		UINT Read(const XMFLOAT3 **points, UINT *stride);
+
+	private:
+		UINT			m_count;
+		const XMFLOAT3	*m_points;
+		UINT			m_stride;
+		bool			m_read;
+	};
+
+	enum SphereMode
+	{
+		SphereFast,			//Grow from the farthest pair of axis extremes(Ritter), as XNA. Two passes over the points.
+		SphereMinimal		//Smallest enclosing sphere: exact sphere(Welzl) of a few candidate points, adding the points left
+							//outside until there are none. Usually a few more passes.
+	};
+
+	void ComputeAxisAlignedBox(XNA::AxisAlignedBox *out, PointSource &source);
+	void ComputeSphere(XNA::Sphere *out, PointSource &source, SphereMode mode = SphereFast);
+	//Box along the principal axes of the points(eigenvectors of their covariance), as XNA
+	void ComputeOrientedBox(XNA::OrientedBox *out, PointSource &source);
+
+	//Same as above for points in memory, with the arguments of the XNA functions
+	void ComputeAxisAlignedBox(XNA::AxisAlignedBox *out, UINT count, const XMFLOAT3 *points, UINT stride);
+	void ComputeSphere(XNA::Sphere *out, UINT count, const XMFLOAT3 *points, UINT stride, SphereMode mode = SphereFast);
+	void ComputeOrientedBox(XNA::OrientedBox *out, UINT count, const XMFLOAT3 *points, UINT stride);
+};
+
+#endif	//_BOUNDING_VOLUMES_H_
@@ -1,4 +1,5 @@
 #include "Camera.h"
+#include "Culling.h"
 
 Camera::Camera():m_right(1.f,0.f,0.f),
 	m_up(0.f,1.f,0.f),
@@ -7,10 +8,44 @@ Camera::Camera():m_right(1.f,0.f,0.f),
 	m_aspect(800.f/600),
 	m_fovY(XM_PI*0.25),
 	m_nearZ(1.f),
-	m_farZ(1000.f)
+	m_farZ(1000.f),
+	m_viewDirty(false)
 {
 	XMStoreFloat4x4(&m_view,XMMatrixIdentity());
-	XMStoreFloat4x4(&m_proj,XMMatrixPerspectiveFovLH(m_fovY,m_aspect,m_nearZ,m_farZ));
+	SetLens(m_fovY,m_aspect,m_nearZ,m_farZ);
+}
+
+void Camera::SetLens(float fovY, float ratioAspect, float nearZ, float farZ)
+{
+	m_fovY = fovY;
+	m_aspect = ratioAspect;
+	m_nearZ = nearZ;
+	m_farZ = farZ;
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(m_fovY,m_aspect,m_nearZ,m_farZ);
+	XMStoreFloat4x4(&m_proj,proj);
+	XNA::ComputeFrustumFromProjection(&m_frustum,&proj);
+
+	RefreshViewProjection();
+}
+
+void Camera::GetPlanes(XMVECTOR *planes) const
+{
+	for(UINT i=0; i<6; ++i)
+		planes[i] = XMLoadFloat4(&m_planes[i]);
+}
+
+void Camera::RefreshViewProjection()
+{
+	XMMATRIX viewProj = XMLoadFloat4x4(&m_view) * XMLoadFloat4x4(&m_proj);
+	XMVECTOR det;
+	XMStoreFloat4x4(&m_viewProj,viewProj);
+	XMStoreFloat4x4(&m_invViewProj,XMMatrixInverse(&det,viewProj));
+
+	XMVECTOR planes[6];
+	Culling::ComputePlanes(viewProj,planes);
+	for(UINT i=0; i<6; ++i)
+		XMStoreFloat4(&m_planes[i],planes[i]);
 }
 
 
@@ -24,6 +59,7 @@ void Camera::LookAtXM(FXMVECTOR pos, FXMVECTOR lookAt, FXMVECTOR worldUp)
 	XMStoreFloat3(&m_right,right);
 	XMStoreFloat3(&m_up,up);
 	XMStoreFloat3(&m_look,look);
+	m_viewDirty = true;
 }
 	
 void Camera::LookAt(XMFLOAT3 &pos, XMFLOAT3 &lookAt, XMFLOAT3 &worldUp)
@@ -42,6 +78,7 @@ void Camera::Walk(float dist)
 	pos += look * XMVectorReplicate(dist);
 	
 	XMStoreFloat3(&m_position,pos);
+	m_viewDirty = true;
 }
 	
 void Camera::Strafe(float dist)
@@ -51,6 +88,7 @@ void Camera::Strafe(float dist)
 	pos += right * XMVectorReplicate(dist);
 	
 	XMStoreFloat3(&m_position,pos);
+	m_viewDirty = true;
 }
 	
 void Camera::Pitch(float angle)
@@ -59,6 +97,7 @@ void Camera::Pitch(float angle)
 
 	XMStoreFloat3(&m_up,XMVector3TransformNormal(XMLoadFloat3(&m_up),rotation));
 	XMStoreFloat3(&m_look,XMVector3TransformNormal(XMLoadFloat3(&m_look),rotation));
+	m_viewDirty = true;
 }
 	
 void Camera::RotateY(float angle)
@@ -68,10 +107,15 @@ void Camera::RotateY(float angle)
 	XMStoreFloat3(&m_right,XMVector3TransformNormal(XMLoadFloat3(&m_right),rotation));
 	XMStoreFloat3(&m_up,XMVector3TransformNormal(XMLoadFloat3(&m_up),rotation));
 	XMStoreFloat3(&m_look,XMVector3TransformNormal(XMLoadFloat3(&m_look),rotation));
+	m_viewDirty = true;
 }
 
 void Camera::UpdateView()
 {
+	if(!m_viewDirty)
+		return;
+	m_viewDirty = false;
+
 	XMVECTOR r = XMLoadFloat3(&m_right);
 	XMVECTOR u = XMLoadFloat3(&m_up);
 	XMVECTOR l = XMLoadFloat3(&m_look);
@@ -94,4 +138,6 @@ void Camera::UpdateView()
 	m_view(1,0) = m_right.y;	m_view(1,1) = m_up.y;	m_view(1,2) = m_look.y;	m_view(1,3) = 0;
 	m_view(2,0) = m_right.z;	m_view(2,1) = m_up.z;	m_view(2,2) = m_look.z;	m_view(2,3) = 0;
 	m_view(3,0) = x;			m_view(3,1) = y;		m_view(3,2) =z;			m_view(3,3) = 1;
+
+	RefreshViewProjection();
 }
\ No newline at end of file
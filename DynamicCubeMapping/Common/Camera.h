@@ -4,6 +4,7 @@
 #include <Windows.h>
 #include <xnamath.h>
 #include <cmath>
+#include "xnacollision.h"
 
 class Camera
 {
@@ -11,8 +12,8 @@ public:
 	Camera();
 
 	//Camera position
-	void SetPosition(float x, float y, float z)		{ m_position = XMFLOAT3(x,y,z); }
-	void SetPositionXM(FXMVECTOR pos)				{ XMStoreFloat3(&m_position,pos); }
+	void SetPosition(float x, float y, float z)		{ m_position = XMFLOAT3(x,y,z); m_viewDirty = true; }
+	void SetPositionXM(FXMVECTOR pos)				{ XMStoreFloat3(&m_position,pos); m_viewDirty = true; }
 
 	//Gets
 	XMFLOAT3 GetPosition()	const	{ return m_position; }
@@ -32,21 +33,20 @@ public:
 	float GetFovX()		const		{ return atan(m_aspect * tan(m_fovY * 0.5f)) * 2.f; }
 	float GetAspect()	const		{ return m_aspect; }
 
-	//Get matrices
-	XMMATRIX View()				const	{ return XMLoadFloat4x4(&m_view); }
-	XMMATRIX Projection()		const	{ return XMLoadFloat4x4(&m_proj); }
-	XMMATRIX ViewProjection()	const	{ return XMLoadFloat4x4(&m_view) * XMLoadFloat4x4(&m_proj); }
+	//Get matrices. The products are cached, refreshed by UpdateView and SetLens.
+	XMMATRIX View()						const	{ return XMLoadFloat4x4(&m_view); }
+	XMMATRIX Projection()				const	{ return XMLoadFloat4x4(&m_proj); }
+	XMMATRIX ViewProjection()			const	{ return XMLoadFloat4x4(&m_viewProj); }
+	XMMATRIX InverseViewProjection()	const	{ return XMLoadFloat4x4(&m_invViewProj); }
 
-	//Configure projection
-	void SetLens(float fovY, float ratioAspect, float nearZ, float farZ)
-	{
-		m_fovY = fovY;
-		m_aspect = ratioAspect;
-		m_nearZ = nearZ;
-		m_farZ = farZ;
+	//Frustum of the projection, in view space(see XNA::ComputeFrustumFromProjection)
+	const XNA::Frustum& GetFrustum()	const	{ return m_frustum; }
+	//The six world space planes of the view-projection(far, near, right, left, top, bottom),
+	//same as Culling::ComputePlanes(ViewProjection(), planes)
+	void GetPlanes(XMVECTOR *planes) const;
 
-		XMStoreFloat4x4(&m_proj,XMMatrixPerspectiveFovLH(m_fovY,m_aspect,m_nearZ,m_farZ));
-	}
+	//Configure projection
+	void SetLens(float fovY, float ratioAspect, float nearZ, float farZ);
 
 	//Set view matrix using traditional method: pos, viewPoint, up
 	void LookAtXM(FXMVECTOR pos, FXMVECTOR lookAt, FXMVECTOR worldUp);
@@ -58,9 +58,13 @@ public:
 	void Pitch(float angle);
 	void RotateY(float angle);
 
-	//Update view matrix
+	//Update view matrix, when the camera moved since the last update
 	void UpdateView();
 
+private:
+	//Recompute the products of the view and projection matrices
+	void RefreshViewProjection();
+
 private:
 	XMFLOAT3	m_right;			//Position and 3 basic axis
 	XMFLOAT3	m_up;
@@ -74,6 +78,12 @@ private:
 
 	XMFLOAT4X4	m_view;				//View matrix
 	XMFLOAT4X4	m_proj;				//Projection matrix
+	bool		m_viewDirty;		//Position or axes changed since the last UpdateView
+
+	XMFLOAT4X4		m_viewProj;		//Cached from m_view and m_proj
+	XMFLOAT4X4		m_invViewProj;
+	XNA::Frustum	m_frustum;		//View space
+	XMFLOAT4		m_planes[6];	//World space
 };
 
 #endif
\ No newline at end of file
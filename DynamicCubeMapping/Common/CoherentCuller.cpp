@@ -0,0 +1,167 @@
+#include "CoherentCuller.h"
+#include <cstring>
+
+CoherentCuller::CoherentCuller():
+	m_planeVersion(1),
+	m_objectTests(0),
+	m_skippedObjects(0),
+	m_planeTests(0)
+{
+	memset(m_planes,0,sizeof(m_planes));
+	memset(m_absPlanes,0,sizeof(m_absPlanes));
+}
+
+void CoherentCuller::Resize(UINT count)
+{
+	Entry empty;
+	memset(&empty,0,sizeof(empty));
+	empty.type = VolumeNone;
+	m_entries.resize(count,empty);
+}
+
+void CoherentCuller::Invalidate()
+{
+	for(UINT i=0; i<m_entries.size(); ++i)
+		m_entries[i].type = VolumeNone;
+}
+
+void CoherentCuller::BeginFrame(const XMVECTOR *planes)
+{
+	XMFLOAT4 stored[6];
+	for(UINT i=0; i<6; ++i)
+		XMStoreFloat4(&stored[i],planes[i]);
+
+	if(memcmp(stored,m_planes,sizeof(stored)) == 0)
+		return;
+
+	//An entry tested under older planes, even several frames ago, must not be reused
+	if(++m_planeVersion == 0)
+		m_planeVersion = 1;
+	for(UINT i=0; i<6; ++i)
+	{
+		m_planes[i] = stored[i];
+		XMStoreFloat4(&m_absPlanes[i],XMVectorAbs(planes[i]));
+	}
+}
+
+void CoherentCuller::ResetStats()
+{
+	m_objectTests = 0;
+	m_skippedObjects = 0;
+	m_planeTests = 0;
+}
+
+bool CoherentCuller::Reuse(Entry &entry, VolumeType type, const float *bounds, UINT count)
+{
+	if(entry.planeVersion == m_planeVersion && entry.type == type && memcmp(entry.bounds,bounds,count * sizeof(float)) == 0)
+	{
+		++m_skippedObjects;
+		return true;
+	}
+
+	memcpy(entry.bounds,bounds,count * sizeof(float));
+	entry.type = (BYTE)type;
+	entry.planeVersion = m_planeVersion;
+	return false;
+}
+
+template<typename Radius>
+INT CoherentCuller::Test(Entry &entry, FXMVECTOR center, const Radius &radius)
+{
+	++m_objectTests;
+
+	//The plane that rejected the object last time first, then the others in order
+	UINT first = entry.lastPlane;
+	XMVECTOR dist = XMVector4Dot(center,XMLoadFloat4(&m_planes[first]));
+	XMVECTOR r = radius(first);
+	++m_planeTests;
+	if(XMVector4Greater(dist,r))
+	{
+		entry.result = 0;
+		return 0;
+	}
+	bool allInside = XMVector4Less(dist,-r);
+
+	for(UINT i=0; i<6; ++i)
+	{
+		if(i == first)
+			continue;
+
+		dist = XMVector4Dot(center,XMLoadFloat4(&m_planes[i]));
+		r = radius(i);
+		++m_planeTests;
+		if(XMVector4Greater(dist,r))
+		{
+			entry.lastPlane = (BYTE)i;
+			entry.result = 0;
+			return 0;
+		}
+		allInside = allInside && XMVector4Less(dist,-r);
+	}
+
+	entry.result = allInside ? 2 : 1;
+	return entry.result;
+}
+
+INT CoherentCuller::TestAABB(UINT object, const XNA::AxisAlignedBox &box)
+{
+	Entry &entry = m_entries[object];
+	if(Reuse(entry,VolumeBox,&box.Center.x,6))
+		return entry.result;
+
+	//Center with w = 1 to dot with the planes, as in the XNA test
+	XMVECTOR center = XMVectorSetW(XMLoadFloat3(&box.Center),1.f);
+	XMVECTOR extents = XMLoadFloat3(&box.Extents);
+	return Test(entry,center,[&](UINT i) -> XMVECTOR
+	{
+		return XMVector3Dot(extents,XMLoadFloat4(&m_absPlanes[i]));
+	});
+}
+
+INT CoherentCuller::TestSphere(UINT object, const XNA::Sphere &sphere)
+{
+	Entry &entry = m_entries[object];
+	if(Reuse(entry,VolumeSphere,&sphere.Center.x,4))
+		return entry.result;
+
+	XMVECTOR center = XMVectorSetW(XMLoadFloat3(&sphere.Center),1.f);
+	XMVECTOR radius = XMVectorReplicate(sphere.Radius);
+	return Test(entry,center,[&](UINT) -> XMVECTOR
+	{
+		return radius;
+	});
+}
+
+UINT CoherentCuller::CullAABBs(const XNA::AxisAlignedBox *boxes, UINT count, UINT *visibleMask)
+{
+	memset(visibleMask,0,(count + 31) / 32 * sizeof(UINT));
+
+	UINT visible = 0;
+	for(UINT i=0; i<count; ++i)
+	{
+		if(TestAABB(i,boxes[i]))
+		{
+			visibleMask[i >> 5] |= 1u << (i & 31);
+			++visible;
+		}
+	}
+
+	return visible;
+}
+
+UINT CoherentCuller::CullSpheres(const XNA::Sphere *spheres, UINT count, UINT *visibleMask)
+{
+	memset(visibleMask,0,(count + 31) / 32 * sizeof(UINT));
+
+	UINT visible = 0;
+	for(UINT i=0; i<count; ++i)
+	{
+		if(TestSphere(i,spheres[i]))
+		{
+			visibleMask[i >> 5] |= 1u << (i & 31);
+			++visible;
+		}
+	}
+
+	return visible;
+}
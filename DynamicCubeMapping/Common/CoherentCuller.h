@@ -0,0 +1,76 @@
+#ifndef _COHERENT_CULLER_H_
+#define _COHERENT_CULLER_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include <vector>
+#include "xnacollision.h"
+
+//Per object frustum tests with the results of XNA::IntersectAxisAlignedBox6Planes and XNA::IntersectSphere6Planes
+//(0 outside, 1 intersecting, 2 inside), using the coherence between frames:
+//	- each object remembers the plane that rejected it last and tests it first, since an object outside
+//	  the frustum usually stays outside the same plane while the camera moves slowly;
+//	- an object whose bounds did not change since it was last tested, under the same planes, gets its previous
+//	  result without any test.
+//Objects are identified by an index below the count passed to Resize; a single index must always be tested
+//with the same kind of volume.
+class CoherentCuller
+{
+public:
+	CoherentCuller();
+
+	//Number of objects tracked. New objects start without a cached result.
+	void Resize(UINT count);
+	//Drop the cached results, e.g. when object indices are reassigned
+	void Invalidate();
+
+	//Planes of the frame, in the XNA order and convention(Dot(plane, point) > 0 is outside).
+	//Cached results stay valid for as long as the planes stay exactly the same.
+	void BeginFrame(const XMVECTOR *planes);
+
+	INT TestAABB(UINT object, const XNA::AxisAlignedBox &box);
+	INT TestSphere(UINT object, const XNA::Sphere &sphere);
+
+	//Bit i of 'visibleMask'(Culling::MaskSize(count) UINTs) is set when object i is not outside.
+	//Return the number of visible objects.
+	UINT CullAABBs(const XNA::AxisAlignedBox *boxes, UINT count, UINT *visibleMask);
+	UINT CullSpheres(const XNA::Sphere *spheres, UINT count, UINT *visibleMask);
+
+	//Counters since the last ResetStats: objects tested, objects answered from the cache, and plane tests done
+	//(a plain 6-plane test costs 6 per object)
+	UINT GetObjectTests()	const	{ return m_objectTests; }
+	UINT GetSkippedObjects()	const	{ return m_skippedObjects; }
+	UINT GetPlaneTests()	const	{ return m_planeTests; }
+	void ResetStats();
+
+private:
+	enum VolumeType { VolumeNone, VolumeBox, VolumeSphere };
+
+	struct Entry
+	{
+		float	bounds[6];					//Box center and extents, or sphere center and radius
+		UINT	planeVersion;				//m_planeVersion when the result was computed
+		BYTE	type;						//VolumeType of the cached result, VolumeNone when there is none
+		BYTE	lastPlane;					//Plane that rejected the object last, tested first
+		BYTE	result;
+	};
+
+	//Shared by both volumes: the object projects on plane i as [dist - radius(i), dist + radius(i)]
+	template<typename Radius>
+	INT Test(Entry &entry, FXMVECTOR center, const Radius &radius);
+	//Whether the cached result still holds for these bounds, and if not store them in the entry
+	bool Reuse(Entry &entry, VolumeType type, const float *bounds, UINT count);
+
+private:
+	XMFLOAT4			m_planes[6];		//Not XMVECTOR, so the culler can live in unaligned heap memory
+	XMFLOAT4			m_absPlanes[6];		//|normal| of the planes, to project box extents
+	UINT				m_planeVersion;		//Changes with the planes; 0 is never current
+
+	std::vector<Entry>	m_entries;
+
+	UINT	m_objectTests;
+	UINT	m_skippedObjects;
+	UINT	m_planeTests;
+};
+
+#endif	//_COHERENT_CULLER_H_
@@ -0,0 +1,108 @@
+#include "CommandRecorder.h"
+#include "AppUtil.h"
+
+CommandRecorder::CommandRecorder():m_jobs(NULL),
+	m_parallel(true),
+	m_secsPerCount(0.f)
+{
+	__int64 countsPerSec(0);
+	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+	if(countsPerSec)
+		m_secsPerCount = 1.f / countsPerSec;
+	ResetStats();
+}
+
+CommandRecorder::~CommandRecorder()
+{
+	Release();
+}
+
+bool CommandRecorder::Init(ID3D11Device *device, UINT nContexts, JobSystem *jobs)
+{
+	Release();
+
+	m_jobs = jobs;
+	m_contexts.assign(nContexts,(ID3D11DeviceContext*)NULL);
+	m_lists.assign(nContexts,(ID3D11CommandList*)NULL);
+	for(UINT i=0; i<nContexts; ++i)
+	{
+		if(FAILED(device->CreateDeferredContext(0,&m_contexts[i])))
+		{
+			Release();
+			MessageBox(NULL,L"Create deferred context failed!",L"Error",MB_OK);
+			return false;
+		}
+	}
+	return true;
+}
+
+void CommandRecorder::Release()
+{
+	for(UINT i=0; i<m_contexts.size(); ++i)
+	{
+		SafeRelease(m_lists[i]);
+		SafeRelease(m_contexts[i]);
+	}
+	m_contexts.clear();
+	m_lists.clear();
+}
+
+void CommandRecorder::Record(UINT count, const RecordFunc &record)
+{
+	__int64 begin(0), end(0);
+	QueryPerformanceCounter((LARGE_INTEGER*)&begin);
+
+	//Context c records items [c * perContext, (c + 1) * perContext)
+	UINT nContexts = m_contexts.size();
+	UINT perContext = nContexts ? (count + nContexts - 1) / nContexts : 0;
+	auto recordRange = [&](UINT c)
+	{
+		UINT first = c * perContext;
+		UINT last = min(first + perContext,count);
+		if(first >= last)
+			return;
+		for(UINT i=first; i<last; ++i)
+			record(i,m_contexts[c]);
+		m_contexts[c]->FinishCommandList(FALSE,&m_lists[c]);
+	};
+	if(m_parallel && m_jobs)
+		m_jobs->ParallelFor(0,nContexts,1,recordRange);
+	else
+	{
+		for(UINT c=0; c<nContexts; ++c)
+			recordRange(c);
+	}
+
+	QueryPerformanceCounter((LARGE_INTEGER*)&end);
+	m_lastMs = (end - begin) * m_secsPerCount * 1000.f;
+	m_totalMs += m_lastMs;
+	++m_records;
+}
+
+void CommandRecorder::Execute(ID3D11DeviceContext *immediate)
+{
+	for(UINT c=0; c<m_lists.size(); ++c)
+	{
+		if(!m_lists[c])
+			continue;
+		immediate->ExecuteCommandList(m_lists[c],FALSE);
+		SafeRelease(m_lists[c]);
+	}
+}
+
+int CommandRecorder::GetContextIndex(const ID3D11DeviceContext *context) const
+{
+	for(UINT c=0; c<m_contexts.size(); ++c)
+	{
+		if(m_contexts[c] == context)
+			return c;
+	}
+	return -1;
+}
+
+void CommandRecorder::ResetStats()
+{
+	m_lastMs = 0.f;
+	m_totalMs = 0.f;
+	m_records = 0;
+}
@@ -0,0 +1,63 @@
+#ifndef _COMMAND_RECORDER_H_
+#define _COMMAND_RECORDER_H_
+
+#include <Windows.h>
+#include <D3D11.h>
+#include <vector>
+#include <functional>
+#include "JobSystem.h"
+
+//Records a sequence of items(e.g. the passes of a frame) into command lists on deferred contexts, one context per
+//worker, then executes the lists on the immediate context in item order. Each context records a contiguous range
+//of items, so the order of the commands is the order of the items whatever the scheduling.
+//
+//Anything an item writes on the CPU while recording must belong to its context: the effects keep the values of
+//their variables in the effect object, so each context needs its own copy(see Effects::Basic(copy)).
+class CommandRecorder
+{
+public:
+	typedef std::function<void(UINT item, ID3D11DeviceContext *context)> RecordFunc;
+
+	CommandRecorder();
+	~CommandRecorder();
+
+	//The contexts record on the workers of 'jobs', or on the calling thread when it is NULL
+	bool Init(ID3D11Device *device, UINT nContexts, JobSystem *jobs);
+	void Release();
+
+	//Parallel: one job per context. Otherwise the same contexts record one after another on the calling thread,
+	//as a baseline for the timings.
+	void SetParallel(bool parallel)		{ m_parallel = parallel; }
+	bool IsParallel()			const	{ return m_parallel; }
+
+	//Record 'count' items on the deferred contexts
+	void Record(UINT count, const RecordFunc &record);
+	//Execute the command lists of the last Record in order, then drop them
+	void Execute(ID3D11DeviceContext *immediate);
+
+	UINT GetContextCount()		const	{ return m_contexts.size(); }
+	//Index of a deferred context of the recorder, -1 for any other context
+	int GetContextIndex(const ID3D11DeviceContext *context) const;
+
+	//Wall time of the last Record, and the average since ResetStats(milliseconds)
+	float GetLastRecordMs()		const	{ return m_lastMs; }
+	float GetAverageRecordMs()	const	{ return m_records ? m_totalMs / m_records : 0.f; }
+	void ResetStats();
+
+private:
+	CommandRecorder(const CommandRecorder&);
+	CommandRecorder& operator=(const CommandRecorder&);
+
+private:
+	std::vector<ID3D11DeviceContext*>	m_contexts;
+	std::vector<ID3D11CommandList*>		m_lists;			//Per context, NULL when it recorded nothing
+	JobSystem							*m_jobs;
+	bool								m_parallel;
+
+	float	m_secsPerCount;
+	float	m_lastMs;
+	float	m_totalMs;
+	UINT	m_records;
+};
+
+#endif	//_COMMAND_RECORDER_H_
@@ -0,0 +1,830 @@
+#include "ConvexHull.h"
+#include "AppUtil.h"
+#include <ppl.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace ConvexHull
+{
+	static const UINT	g_blockSize = 16384;			//Points per task
+	static const UINT	g_nDirections = 13;				//Axes, face and cube diagonals: 26 extreme points for the first hull
+	static const float	g_epsilonScale = 8.f * FLT_EPSILON;	//Thickness of the faces, relative to the size of the coordinates
+	static const float	g_coplanarCos = 1.f - 1e-5f;	//Neighbor triangles merged into one plane
+
+	static const XMVECTORF32 g_directions[16] =
+	{
+		{ 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f },
+		{ 1.f, 1.f, 0.f, 0.f }, { 1.f, -1.f, 0.f, 0.f }, { 1.f, 0.f, 1.f, 0.f }, { 1.f, 0.f, -1.f, 0.f },
+		{ 0.f, 1.f, 1.f, 0.f }, { 0.f, 1.f, -1.f, 0.f },
+		{ 1.f, 1.f, 1.f, 0.f }, { 1.f, 1.f, -1.f, 0.f }, { 1.f, -1.f, 1.f, 0.f }, { 1.f, -1.f, -1.f, 0.f },
+		{ 1.f, 0.f, 0.f, 0.f }, { 1.f, 0.f, 0.f, 0.f }, { 1.f, 0.f, 0.f, 0.f }	//Padding
+	};
+
+	static inline XMVECTOR LoadPoint(const XMFLOAT3 *points, UINT stride, UINT i)
+	{
+		return XMLoadFloat3((const XMFLOAT3*)((const BYTE*)points + i * stride));
+	}
+
+	//Call func(begin, end, block) for blocks of [0, count) in parallel
+	template<typename Func>
+	static void ForEachBlock(UINT count, const Func &func)
+	{
+		UINT nBlocks = (count + g_blockSize - 1) / g_blockSize;
+		if(nBlocks <= 1)
+		{
+			func(0U,count,0U);
+			return;
+		}
+		Concurrency::parallel_for(0U,nBlocks,[&](UINT block)
+		{
+			UINT begin = block * g_blockSize;
+			func(begin,min(begin + g_blockSize,count),block);
+		});
+	}
+
+	struct ExtremesPartial
+	{
+		UINT	minIndex[16];
+		UINT	maxIndex[16];
+		float	minDot[16];
+		float	maxDot[16];
+	};
+
+	struct FarthestPartial
+	{
+		UINT	index;
+		float	dist;
+	};
+
+	class HullBuilder
+	{
+	public:
+		HullBuilder(const XMFLOAT3 *points, UINT count, UINT stride)
+			: m_points(points), m_count(count), m_stride(stride), m_epsilon(0.f), m_stamp(0) {}
+
+		bool Run(UINT maxVertices, Hull &hull);
+
+	private:
+		struct Face
+		{
+			UINT				v[3];
+			int					adj[3];			//Face across edge(v[k], v[k + 1])
+			XMFLOAT3			normal;
+			float				dist;
+			std::vector<UINT>	outside;		//Points in front of the face, assigned to no other face
+			UINT				farthest;
+			float				farthestDist;
+			UINT				stamp;			//Visit of the last horizon search
+			bool				visible;
+			bool				alive;
+		};
+
+		struct Edge
+		{
+			UINT	from;
+			UINT	to;
+			int		face;						//Hidden face across the edge
+		};
+
+		XMVECTOR Point(UINT i) const	{ return LoadPoint(m_points,m_stride,i); }
+		const XMFLOAT3& PointRef(UINT i) const	{ return *(const XMFLOAT3*)((const BYTE*)m_points + i * m_stride); }
+
+		//Unit normal of a face in double. In float, the cross product of the edges of a small face far from the origin
+		//is off by more than the thickness of the faces, which lets the hull fold over where faces are almost coplanar.
+		void Normal(const Face &face, double *n) const
+		{
+			const XMFLOAT3 &a = PointRef(face.v[0]), &b = PointRef(face.v[1]), &c = PointRef(face.v[2]);
+			double abx = (double)b.x - a.x, aby = (double)b.y - a.y, abz = (double)b.z - a.z;
+			double acx = (double)c.x - a.x, acy = (double)c.y - a.y, acz = (double)c.z - a.z;
+			n[0] = aby * acz - abz * acy;
+			n[1] = abz * acx - abx * acz;
+			n[2] = abx * acy - aby * acx;
+			double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			double invLength = length > 0. ? 1. / length : 0.;
+			n[0] *= invLength;
+			n[1] *= invLength;
+			n[2] *= invLength;
+		}
+
+		//Distance of a point in front of the face, in double for the horizon search
+		double Height(const Face &face, UINT point) const
+		{
+			double n[3];
+			Normal(face,n);
+			const XMFLOAT3 &a = PointRef(face.v[0]), &p = PointRef(point);
+			return n[0] * ((double)p.x - a.x) + n[1] * ((double)p.y - a.y) + n[2] * ((double)p.z - a.z);
+		}
+
+		bool	InitialSimplex();
+		int		AddFace(UINT a, UINT b, UINT c);
+		void	Assign(const UINT *candidates, UINT count, const std::vector<int> &faces);
+		bool	Expand(UINT maxVertices);
+		void	Enclose(const std::vector<int> &faces, std::vector<XMFLOAT3> &vertices, XMVECTOR centroid, std::vector<float> &dists);
+		void	Output(bool conservative, Hull &hull);
+
+	private:
+		const XMFLOAT3		*m_points;
+		UINT				m_count;
+		UINT				m_stride;
+		float				m_epsilon;
+		UINT				m_stamp;
+		UINT				m_nAdded;			//Points added to the hull so far, an upper bound of its vertex count
+		std::vector<Face>	m_faces;
+		std::vector<int>	m_pending;			//Faces that had outside points when they were created
+		std::vector<UINT>	m_extremes;
+	};
+
+	int HullBuilder::AddFace(UINT a, UINT b, UINT c)
+	{
+		m_faces.push_back(Face());
+		Face &face = m_faces.back();
+		face.v[0] = a;
+		face.v[1] = b;
+		face.v[2] = c;
+		face.adj[0] = face.adj[1] = face.adj[2] = -1;
+
+		//A sliver face keeps a zero normal: nothing is in front of it, so it only gets removed with its neighbors
+		double n[3];
+		Normal(face,n);
+		const XMFLOAT3 &pa = PointRef(a);
+		face.normal = XMFLOAT3((float)n[0],(float)n[1],(float)n[2]);
+		face.dist = (float)(n[0] * pa.x + n[1] * pa.y + n[2] * pa.z);
+		face.farthest = 0;
+		face.farthestDist = 0.f;
+		face.stamp = 0;
+		face.visible = false;
+		face.alive = true;
+		return (int)m_faces.size() - 1;
+	}
+
+	//Tetrahedron of the farthest pair of extreme points, the extreme point farthest from their line and
+	//the point of the whole set farthest from the plane of those three
+	bool HullBuilder::InitialSimplex()
+	{
+		std::vector<ExtremesPartial> partials((m_count + g_blockSize - 1) / g_blockSize);
+		XMMATRIX directions[4];
+		for(UINT g=0; g<4; ++g)
+			directions[g] = XMMatrixTranspose(XMMATRIX(g_directions[4 * g],g_directions[4 * g + 1],g_directions[4 * g + 2],g_directions[4 * g + 3]));
+
+		ForEachBlock(m_count,[&](UINT begin, UINT end, UINT block)
+		{
+			XMVECTOR minDot[4], maxDot[4], minIndex[4], maxIndex[4];
+			XMVECTOR p = Point(begin);
+			for(UINT g=0; g<4; ++g)
+			{
+				minDot[g] = maxDot[g] = XMVector3TransformNormal(p,directions[g]);
+				minIndex[g] = maxIndex[g] = XMVectorReplicateInt(begin);
+			}
+			for(UINT i=begin+1; i<end; ++i)
+			{
+				p = Point(i);
+				XMVECTOR index = XMVectorReplicateInt(i);
+				for(UINT g=0; g<4; ++g)
+				{
+					XMVECTOR dot = XMVector3TransformNormal(p,directions[g]);
+					XMVECTOR less = XMVectorLess(dot,minDot[g]);
+					XMVECTOR greater = XMVectorGreater(dot,maxDot[g]);
+					minDot[g] = XMVectorSelect(minDot[g],dot,less);
+					maxDot[g] = XMVectorSelect(maxDot[g],dot,greater);
+					minIndex[g] = XMVectorSelect(minIndex[g],index,less);
+					maxIndex[g] = XMVectorSelect(maxIndex[g],index,greater);
+				}
+			}
+
+			ExtremesPartial &partial = partials[block];
+			for(UINT g=0; g<4; ++g)
+			{
+				XMStoreInt4(&partial.minIndex[4 * g],minIndex[g]);
+				XMStoreInt4(&partial.maxIndex[4 * g],maxIndex[g]);
+				XMStoreFloat4((XMFLOAT4*)&partial.minDot[4 * g],minDot[g]);
+				XMStoreFloat4((XMFLOAT4*)&partial.maxDot[4 * g],maxDot[g]);
+			}
+		});
+
+		//Merged in block order so the outcome does not depend on the scheduling
+		ExtremesPartial merged = partials[0];
+		for(UINT b=1; b<partials.size(); ++b)
+		{
+			for(UINT d=0; d<g_nDirections; ++d)
+			{
+				if(partials[b].minDot[d] < merged.minDot[d])
+				{
+					merged.minDot[d] = partials[b].minDot[d];
+					merged.minIndex[d] = partials[b].minIndex[d];
+				}
+				if(partials[b].maxDot[d] > merged.maxDot[d])
+				{
+					merged.maxDot[d] = partials[b].maxDot[d];
+					merged.maxIndex[d] = partials[b].maxIndex[d];
+				}
+			}
+		}
+
+		m_extremes.clear();
+		for(UINT d=0; d<g_nDirections; ++d)
+		{
+			m_extremes.push_back(merged.minIndex[d]);
+			m_extremes.push_back(merged.maxIndex[d]);
+		}
+
+		//Tolerance from the magnitude of the coordinates(the first 3 directions are the axes)
+		float size = 0.f;
+		for(UINT a=0; a<3; ++a)
+			size += max(fabs(merged.minDot[a]),fabs(merged.maxDot[a]));
+		m_epsilon = g_epsilonScale * max(size,FLT_MIN);
+
+		UINT i0 = m_extremes[0], i1 = m_extremes[1];
+		float bestDistSq = -1.f;
+		for(UINT a=0; a<m_extremes.size(); ++a)
+		{
+			for(UINT b=a+1; b<m_extremes.size(); ++b)
+			{
+				float distSq = XMVectorGetX(XMVector3LengthSq(Point(m_extremes[b]) - Point(m_extremes[a])));
+				if(distSq > bestDistSq)
+				{
+					bestDistSq = distSq;
+					i0 = m_extremes[a];
+					i1 = m_extremes[b];
+				}
+			}
+		}
+		if(bestDistSq <= m_epsilon * m_epsilon)
+			return false;
+
+		XMVECTOR p0 = Point(i0);
+		XMVECTOR axis = XMVector3Normalize(Point(i1) - p0);
+		UINT i2 = i0;
+		bestDistSq = -1.f;
+		for(UINT a=0; a<m_extremes.size(); ++a)
+		{
+			XMVECTOR delta = Point(m_extremes[a]) - p0;
+			float distSq = XMVectorGetX(XMVector3LengthSq(delta - axis * XMVector3Dot(delta,axis)));
+			if(distSq > bestDistSq)
+			{
+				bestDistSq = distSq;
+				i2 = m_extremes[a];
+			}
+		}
+		if(bestDistSq <= m_epsilon * m_epsilon)
+			return false;
+
+		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(Point(i1) - p0,Point(i2) - p0));
+		float planeDist = XMVectorGetX(XMVector3Dot(normal,p0));
+		std::vector<FarthestPartial> farthest(partials.size());
+		ForEachBlock(m_count,[&](UINT begin, UINT end, UINT block)
+		{
+			FarthestPartial &partial = farthest[block];
+			partial.index = begin;
+			partial.dist = 0.f;
+			for(UINT i=begin; i<end; ++i)
+			{
+				float dist = XMVectorGetX(XMVector3Dot(normal,Point(i))) - planeDist;
+				if(fabs(dist) > fabs(partial.dist))
+				{
+					partial.dist = dist;
+					partial.index = i;
+				}
+			}
+		});
+		FarthestPartial apex = farthest[0];
+		for(UINT b=1; b<farthest.size(); ++b)
+		{
+			if(fabs(farthest[b].dist) > fabs(apex.dist))
+				apex = farthest[b];
+		}
+		if(fabs(apex.dist) <= m_epsilon)
+			return false;
+
+		//Base facing away from the apex
+		UINT i3 = apex.index;
+		if(apex.dist > 0.f)
+			std::swap(i1,i2);
+		m_faces.clear();
+		AddFace(i0,i1,i2);
+		AddFace(i1,i0,i3);
+		AddFace(i2,i1,i3);
+		AddFace(i0,i2,i3);
+
+		//Each edge(a, b) of a face is the edge(b, a) of its neighbor
+		for(UINT f=0; f<4; ++f)
+		{
+			for(UINT k=0; k<3; ++k)
+			{
+				UINT a = m_faces[f].v[k], b = m_faces[f].v[(k + 1) % 3];
+				for(UINT g=0; g<4; ++g)
+				{
+					for(UINT j=0; j<3; ++j)
+					{
+						if(m_faces[g].v[j] == b && m_faces[g].v[(j + 1) % 3] == a)
+							m_faces[f].adj[k] = (int)g;
+					}
+				}
+			}
+		}
+		m_nAdded = 4;
+		return true;
+	}
+
+	//Give each candidate point to the face among 'faces' it is farthest in front of, and drop the points behind all of them.
+	//'candidates' NULL means every point.
+	void HullBuilder::Assign(const UINT *candidates, UINT count, const std::vector<int> &faces)
+	{
+		if(count == 0 || faces.empty())
+			return;
+
+		//Faces as structure of arrays, padded with copies of the first face
+		UINT nGroups = (faces.size() + 3) / 4;
+		std::vector<XMFLOAT4> planes(4 * nGroups);
+		for(UINT g=0; g<nGroups; ++g)
+		{
+			float *x = &planes[4 * g].x, *y = &planes[4 * g + 1].x, *z = &planes[4 * g + 2].x, *w = &planes[4 * g + 3].x;
+			for(UINT k=0; k<4; ++k)
+			{
+				const Face &face = m_faces[faces[min(4 * g + k,(UINT)faces.size() - 1)]];
+				x[k] = face.normal.x;
+				y[k] = face.normal.y;
+				z[k] = face.normal.z;
+				w[k] = face.dist + m_epsilon;
+			}
+		}
+
+		std::vector<int> assigned(count);
+		std::vector<float> dists(count);
+		ForEachBlock(count,[&](UINT begin, UINT end, UINT)
+		{
+			//Face indices kept as floats, exact far beyond any face count
+			static const XMVECTORF32 lanes = { 0.f, 1.f, 2.f, 3.f };
+			for(UINT i=begin; i<end; ++i)
+			{
+				XMVECTOR p = Point(candidates ? candidates[i] : i);
+				XMVECTOR px = XMVectorSplatX(p), py = XMVectorSplatY(p), pz = XMVectorSplatZ(p);
+				XMVECTOR best = XMVectorZero();
+				XMVECTOR bestIndex = XMVectorReplicate(-1.f);
+				XMVECTOR index = lanes;
+				for(UINT g=0; g<nGroups; ++g)
+				{
+					XMVECTOR dist = XMVectorMultiplyAdd(px,XMLoadFloat4(&planes[4 * g]),
+						XMVectorMultiplyAdd(py,XMLoadFloat4(&planes[4 * g + 1]),
+						XMVectorMultiply(pz,XMLoadFloat4(&planes[4 * g + 2])))) - XMLoadFloat4(&planes[4 * g + 3]);
+					XMVECTOR greater = XMVectorGreater(dist,best);
+					best = XMVectorSelect(best,dist,greater);
+					bestIndex = XMVectorSelect(bestIndex,index,greater);
+					index += XMVectorReplicate(4.f);
+				}
+
+				float lane[4], laneIndex[4];
+				XMStoreFloat4((XMFLOAT4*)lane,best);
+				XMStoreFloat4((XMFLOAT4*)laneIndex,bestIndex);
+				int face = -1;
+				float dist = 0.f;
+				for(UINT k=0; k<4; ++k)
+				{
+					if(laneIndex[k] >= 0.f && (face < 0 || lane[k] > dist))
+					{
+						face = (int)laneIndex[k];
+						dist = lane[k];
+					}
+				}
+				//Padding lanes repeat the last face
+				assigned[i] = face < 0 ? -1 : min(face,(int)faces.size() - 1);
+				dists[i] = dist + m_epsilon;
+			}
+		});
+
+		//Appended in candidate order, so the outcome does not depend on the scheduling
+		for(UINT i=0; i<count; ++i)
+		{
+			if(assigned[i] < 0)
+				continue;
+			Face &face = m_faces[faces[assigned[i]]];
+			UINT point = candidates ? candidates[i] : i;
+			if(face.outside.empty() || dists[i] > face.farthestDist)
+			{
+				face.farthest = point;
+				face.farthestDist = dists[i];
+			}
+			face.outside.push_back(point);
+		}
+		for(UINT f=0; f<faces.size(); ++f)
+		{
+			if(!m_faces[faces[f]].outside.empty())
+				m_pending.push_back(faces[f]);
+		}
+	}
+
+	//Add outside points until there are none left or 'maxVertices' points were added(0 for no limit).
+	//Return true when points are left outside.
+	bool HullBuilder::Expand(UINT maxVertices)
+	{
+		std::vector<int> stack, visible, created;
+		std::vector<Edge> horizon;
+		std::vector<UINT> candidates;
+		while(true)
+		{
+			//Without a budget any face will do; with one, the farthest point of all faces goes first
+			int next = -1;
+			if(maxVertices)
+			{
+				UINT kept = 0;
+				for(UINT i=0; i<m_pending.size(); ++i)
+				{
+					int f = m_pending[i];
+					if(!m_faces[f].alive || m_faces[f].outside.empty())
+						continue;
+					m_pending[kept++] = f;
+					if(next < 0 || m_faces[f].farthestDist > m_faces[next].farthestDist)
+						next = f;
+				}
+				m_pending.resize(kept);
+			}
+			else
+			{
+				while(!m_pending.empty() && next < 0)
+				{
+					int f = m_pending.back();
+					if(m_faces[f].alive && !m_faces[f].outside.empty())
+						next = f;
+					else
+						m_pending.pop_back();
+				}
+			}
+			if(next < 0)
+				return false;
+			if(maxVertices && m_nAdded >= maxVertices)
+				return true;
+
+			//The float plane of the assignment may be slightly off: a point not in front of its face in double is dropped
+			UINT eye = m_faces[next].farthest;
+			if(Height(m_faces[next],eye) <= m_epsilon)
+			{
+				std::vector<UINT> &outside = m_faces[next].outside;
+				outside.erase(std::find(outside.begin(),outside.end(),eye));
+				m_faces[next].farthestDist = 0.f;
+				for(UINT i=0; i<outside.size(); ++i)
+				{
+					float dist = (float)Height(m_faces[next],outside[i]);
+					if(dist > m_faces[next].farthestDist)
+					{
+						m_faces[next].farthest = outside[i];
+						m_faces[next].farthestDist = dist;
+					}
+				}
+				continue;
+			}
+
+			//Faces seen from the eye, and the edges between them and the hidden faces(the horizon)
+			++m_stamp;
+			visible.clear();
+			horizon.clear();
+			stack.clear();
+			stack.push_back(next);
+			m_faces[next].stamp = m_stamp;
+			m_faces[next].visible = true;
+			while(!stack.empty())
+			{
+				int f = stack.back();
+				stack.pop_back();
+				visible.push_back(f);
+				for(UINT k=0; k<3; ++k)
+				{
+					int n = m_faces[f].adj[k];
+					Face &neighbor = m_faces[n];
+					if(neighbor.stamp != m_stamp)
+					{
+						neighbor.stamp = m_stamp;
+						neighbor.visible = Height(neighbor,eye) > 0.;
+						if(neighbor.visible)
+							stack.push_back(n);
+					}
+					if(!neighbor.visible)
+					{
+						Edge edge = { m_faces[f].v[k], m_faces[f].v[(k + 1) % 3], n };
+						horizon.push_back(edge);
+					}
+				}
+			}
+
+			//A cone of new faces from the horizon to the eye
+			created.clear();
+			for(UINT e=0; e<horizon.size(); ++e)
+			{
+				const Edge &edge = horizon[e];
+				int f = AddFace(edge.from,edge.to,eye);
+				created.push_back(f);
+				m_faces[f].adj[0] = edge.face;
+				Face &neighbor = m_faces[edge.face];
+				for(UINT k=0; k<3; ++k)
+				{
+					if(neighbor.v[k] == edge.to && neighbor.v[(k + 1) % 3] == edge.from)
+						neighbor.adj[k] = f;
+				}
+			}
+			//Face e has edges(to, eye) and(eye, from), shared with the faces starting at 'to' and ending at 'from'
+			for(UINT e=0; e<horizon.size(); ++e)
+			{
+				for(UINT o=0; o<horizon.size(); ++o)
+				{
+					if(horizon[o].from == horizon[e].to)
+						m_faces[created[e]].adj[1] = created[o];
+					if(horizon[o].to == horizon[e].from)
+						m_faces[created[e]].adj[2] = created[o];
+				}
+			}
+
+			candidates.clear();
+			for(UINT i=0; i<visible.size(); ++i)
+			{
+				Face &face = m_faces[visible[i]];
+				face.alive = false;
+				for(UINT p=0; p<face.outside.size(); ++p)
+				{
+					if(face.outside[p] != eye)
+						candidates.push_back(face.outside[p]);
+				}
+				std::vector<UINT>().swap(face.outside);
+			}
+			++m_nAdded;
+
+			Assign(candidates.empty() ? NULL : &candidates[0],candidates.size(),created);
+		}
+	}
+
+	//Scale the hull about 'centroid' until every point still outside is enclosed, and a little more to cover
+	//the points dropped within the thickness of a face. 'dists' gets the scaled face distances.
+	void HullBuilder::Enclose(const std::vector<int> &faces, std::vector<XMFLOAT3> &vertices, XMVECTOR centroid, std::vector<float> &dists)
+	{
+		//Planes relative to the centroid, divided by the distance of the centroid to the face,
+		//so Dot(gauge, (point, -1)) gives the scale at which the face passes through the point
+		std::vector<XMFLOAT4> gauges(m_faces.size());
+		float minHeight = FLT_MAX;
+		for(UINT f=0; f<faces.size(); ++f)
+		{
+			const Face &face = m_faces[faces[f]];
+			XMVECTOR n = XMLoadFloat3(&face.normal);
+			float nc = XMVectorGetX(XMVector3Dot(n,centroid));
+			float height = max(face.dist - nc,m_epsilon);
+			minHeight = min(minHeight,height);
+			XMStoreFloat4(&gauges[faces[f]],XMVectorSetW(n,nc) / XMVectorReplicate(height));
+		}
+		float tolerance = m_epsilon / minHeight;
+
+		std::vector<UINT> outside;
+		std::vector<int> starts;
+		for(UINT f=0; f<faces.size(); ++f)
+		{
+			const std::vector<UINT> &points = m_faces[faces[f]].outside;
+			outside.insert(outside.end(),points.begin(),points.end());
+			starts.insert(starts.end(),points.size(),faces[f]);
+		}
+
+		//The largest gauge is a linear maximum over the polar of the hull, whose vertices are the gauges and whose
+		//edges join adjacent faces: climbing from the face the point was assigned to reaches it without testing
+		//every face. Faces within the tolerance of the best are walked too, to get across coplanar triangles.
+		std::vector<float> partials((outside.size() + g_blockSize - 1) / g_blockSize + 1,1.f);
+		ForEachBlock(outside.size(),[&](UINT begin, UINT end, UINT block)
+		{
+			std::vector<UINT> stamps(m_faces.size(),0);
+			std::vector<int> stack;
+			float scale = 1.f;
+			for(UINT i=begin; i<end; ++i)
+			{
+				XMVECTOR p = XMVectorSetW(Point(outside[i]),-1.f);
+				UINT stamp = i - begin + 1;
+				int f = starts[i];
+				float best = XMVectorGetX(XMVector4Dot(XMLoadFloat4(&gauges[f]),p));
+				stamps[f] = stamp;
+				stack.push_back(f);
+				while(!stack.empty())
+				{
+					int g = stack.back();
+					stack.pop_back();
+					for(UINT k=0; k<3; ++k)
+					{
+						int n = m_faces[g].adj[k];
+						if(stamps[n] == stamp)
+							continue;
+						stamps[n] = stamp;
+						float s = XMVectorGetX(XMVector4Dot(XMLoadFloat4(&gauges[n]),p));
+						if(s >= best - tolerance)
+						{
+							best = max(best,s);
+							stack.push_back(n);
+						}
+					}
+				}
+				scale = max(scale,best);
+			}
+			partials[block] = scale;
+		});
+
+		float scale = 1.f;
+		for(UINT b=0; b<partials.size(); ++b)
+			scale = max(scale,partials[b]);
+		scale += 2.f * tolerance;
+
+		for(UINT v=0; v<vertices.size(); ++v)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[v]);
+			XMStoreFloat3(&vertices[v],XMVectorMultiplyAdd(p - centroid,XMVectorReplicate(scale),centroid));
+		}
+		dists.resize(faces.size());
+		for(UINT f=0; f<faces.size(); ++f)
+		{
+			const Face &face = m_faces[faces[f]];
+			float nc = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&face.normal),centroid));
+			dists[f] = nc + scale * (face.dist - nc);
+		}
+	}
+
+	void HullBuilder::Output(bool conservative, Hull &hull)
+	{
+		std::vector<int> faces;
+		std::vector<int> remap(m_count,-1);
+		hull.vertices.clear();
+		hull.indices.clear();
+		hull.planes.clear();
+		for(UINT f=0; f<m_faces.size(); ++f)
+		{
+			const Face &face = m_faces[f];
+			if(!face.alive)
+				continue;
+			faces.push_back(f);
+			for(UINT k=0; k<3; ++k)
+			{
+				UINT v = face.v[k];
+				if(remap[v] < 0)
+				{
+					remap[v] = hull.vertices.size();
+					hull.vertices.push_back(XMFLOAT3());
+					XMStoreFloat3(&hull.vertices.back(),Point(v));
+				}
+				hull.indices.push_back(remap[v]);
+			}
+		}
+
+		std::vector<float> dists(faces.size());
+		for(UINT f=0; f<faces.size(); ++f)
+			dists[f] = m_faces[faces[f]].dist;
+		if(conservative)
+		{
+			XMVECTOR centroid = XMVectorZero();
+			for(UINT v=0; v<hull.vertices.size(); ++v)
+				centroid += XMLoadFloat3(&hull.vertices[v]);
+			centroid /= (float)hull.vertices.size();
+			Enclose(faces,hull.vertices,centroid,dists);
+		}
+
+		//Merge the planes of coplanar neighbors: each face joins the group of the first neighbor found coplanar
+		std::vector<int> faceIndex(m_faces.size(),-1);
+		for(UINT f=0; f<faces.size(); ++f)
+			faceIndex[faces[f]] = f;
+		std::vector<int> group(faces.size(),-1);
+		std::vector<int> stack;
+		for(UINT f=0; f<faces.size(); ++f)
+		{
+			if(group[f] >= 0)
+				continue;
+
+			int plane = hull.planes.size();
+			const Face &first = m_faces[faces[f]];
+			XMVECTOR normal = XMLoadFloat3(&first.normal);
+			float dist = dists[f];
+			group[f] = plane;
+			stack.push_back(f);
+			while(!stack.empty())
+			{
+				//The plane is moved out to the farthest vertex of the group, so it stays behind every triangle
+				int g = stack.back();
+				stack.pop_back();
+				for(UINT k=0; k<3; ++k)
+					dist = max(dist,XMVectorGetX(XMVector3Dot(normal,XMLoadFloat3(&hull.vertices[hull.indices[3 * g + k]]))));
+				for(UINT k=0; k<3; ++k)
+				{
+					int n = faceIndex[m_faces[faces[g]].adj[k]];
+					if(n < 0 || group[n] >= 0)
+						continue;
+					const Face &neighbor = m_faces[faces[n]];
+					if(XMVectorGetX(XMVector3Dot(normal,XMLoadFloat3(&neighbor.normal))) >= g_coplanarCos &&
+					   fabs(dists[n] - dists[f]) <= 4.f * m_epsilon)
+					{
+						group[n] = plane;
+						stack.push_back(n);
+					}
+				}
+			}
+
+			XMFLOAT4 p;
+			XMStoreFloat4(&p,XMVectorSetW(normal,-dist));
+			hull.planes.push_back(p);
+		}
+	}
+
+	bool HullBuilder::Run(UINT maxVertices, Hull &hull)
+	{
+		hull.vertices.clear();
+		hull.indices.clear();
+		hull.planes.clear();
+		if(m_count < 4 || !InitialSimplex())
+			return false;
+
+		if(maxVertices)
+			maxVertices = max(maxVertices,4U);
+
+		std::vector<int> faces;
+		for(UINT f=0; f<m_faces.size(); ++f)
+			faces.push_back(f);
+
+		//Hull of the extreme points first: most of the points inside a solid are behind its faces
+		//and get dropped by the parallel pass over the whole set
+		m_pending.clear();
+		Assign(&m_extremes[0],m_extremes.size(),faces);
+		Expand(maxVertices);
+
+		faces.clear();
+		for(UINT f=0; f<m_faces.size(); ++f)
+		{
+			if(!m_faces[f].alive)
+				continue;
+			std::vector<UINT>().swap(m_faces[f].outside);
+			faces.push_back(f);
+		}
+		m_pending.clear();
+		Assign(NULL,m_count,faces);
+
+		bool left = Expand(maxVertices);
+		Output(left,hull);
+		return true;
+	}
+
+	bool Build(Hull &hull, UINT count, const XMFLOAT3 *points, UINT stride, UINT maxVertices)
+	{
+		HullBuilder builder(points,count,stride);
+		return builder.Run(maxVertices,hull);
+	}
+
+	bool Build(Hull &hull, const GeoGen::MeshData &mesh, UINT maxVertices)
+	{
+		if(mesh.vertices.empty())
+		{
+			hull = Hull();
+			return false;
+		}
+		return Build(hull,mesh.vertices.size(),&mesh.vertices[0].pos,sizeof(GeoGen::Vertex),maxVertices);
+	}
+
+	INT IntersectPlane(const Hull &hull, FXMVECTOR plane)
+	{
+		XMVECTOR minDist = XMVectorReplicate(FLT_MAX);
+		XMVECTOR maxDist = XMVectorReplicate(-FLT_MAX);
+		for(UINT v=0; v<hull.vertices.size(); ++v)
+		{
+			XMVECTOR dist = XMPlaneDotCoord(plane,XMLoadFloat3(&hull.vertices[v]));
+			minDist = XMVectorMin(minDist,dist);
+			maxDist = XMVectorMax(maxDist,dist);
+		}
+
+		if(XMVector4Greater(minDist,XMVectorZero()))
+			return 0;
+		if(XMVector4Less(maxDist,XMVectorZero()))
+			return 2;
+		return 1;
+	}
+
+	INT Intersect6Planes(const Hull &hull, const XMVECTOR *planes)
+	{
+		//Planes as matrix columns: transforming a point gives its distance to 4 planes at once
+		XMMATRIX planes0 = XMMatrixTranspose(XMMATRIX(planes[0],planes[1],planes[2],planes[3]));
+		XMMATRIX planes1 = XMMatrixTranspose(XMMATRIX(planes[4],planes[5],planes[4],planes[5]));
+		XMVECTOR min0 = XMVectorReplicate(FLT_MAX), min1 = min0;
+		XMVECTOR max0 = XMVectorReplicate(-FLT_MAX), max1 = max0;
+		for(UINT v=0; v<hull.vertices.size(); ++v)
+		{
+			XMVECTOR p = XMLoadFloat3(&hull.vertices[v]);
+			XMVECTOR dist0 = XMVector3Transform(p,planes0);
+			XMVECTOR dist1 = XMVector3Transform(p,planes1);
+			min0 = XMVectorMin(min0,dist0);
+			max0 = XMVectorMax(max0,dist0);
+			min1 = XMVectorMin(min1,dist1);
+			max1 = XMVectorMax(max1,dist1);
+		}
+
+		//Outside when fully in front of any plane, inside when behind all of them
+		XMVECTOR zero = XMVectorZero();
+		if(MoveMask(XMVectorGreater(min0,zero)) | MoveMask(XMVectorGreater(min1,zero)))
+			return 0;
+		if((MoveMask(XMVectorLess(max0,zero)) & MoveMask(XMVectorLess(max1,zero))) == 0xf)
+			return 2;
+		return 1;
+	}
+
+	bool ContainsPoint(const Hull &hull, FXMVECTOR point)
+	{
+		for(UINT i=0; i<hull.planes.size(); ++i)
+		{
+			if(XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&hull.planes[i]),point)) > 0.f)
+				return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef _CONVEX_HULL_H_
+#define _CONVEX_HULL_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include <vector>
+#include "xnacollision.h"
+#include "GeometryGens.h"
+
+//Convex hulls of point sets(e.g. mesh vertices) as cheap collision and culling proxies.
+//Built by quickhull: the points inside the hull of a few extreme points are dropped in parallel, then faces are
+//grown toward their farthest outside point, each point left outside being assigned to one face(in parallel for
+//large sets). With a vertex budget the farthest point of all faces is added first, and once the budget is spent
+//the hull is scaled about its centroid until it encloses every point again, so it stays a conservative bound.
+//The vertices can be used with GjkEpa::PointSetShape for convex collision.
+namespace ConvexHull
+{
+	struct Hull
+	{
+		std::vector<XMFLOAT3>	vertices;
+		std::vector<UINT>		indices;		//3 per triangle, cross(v1 - v0, v2 - v0) points out of the hull(clockwise
+												//seen from outside, the D3D front face winding)
+		std::vector<XMFLOAT4>	planes;			//One per face, coplanar triangles merged. Dot(plane, point) > 0 is outside,
+												//as XNA::ComputePlanesFromFrustum.
+	};
+
+	//Build the hull of 'count' points. With 'maxVertices' (at least 4) the hull has at most that many vertices,
+	//0 keeps every vertex of the exact hull. Return false, leaving the hull empty, when the points do not span a volume.
+	bool Build(Hull &hull, UINT count, const XMFLOAT3 *points, UINT stride, UINT maxVertices = 0);
+	bool Build(Hull &hull, const GeoGen::MeshData &mesh, UINT maxVertices = 0);
+
+	//Same results as the XNA plane tests: 0 in front of the plane, 1 intersecting it, 2 behind it
+	INT IntersectPlane(const Hull &hull, FXMVECTOR plane);
+	//Same results as XNA::IntersectAxisAlignedBox6Planes: 0 outside, 1 intersecting, 2 inside.
+	//'planes' are six planes in the space of the hull, e.g. from XNA::ComputePlanesFromFrustum.
+	INT Intersect6Planes(const Hull &hull, const XMVECTOR *planes);
+	bool ContainsPoint(const Hull &hull, FXMVECTOR point);
+};
+
+#endif	//_CONVEX_HULL_H_
@@ -0,0 +1,126 @@
+#include "CubeCameraRig.h"
+
+//Look and up directions of the faces, as the D3D cube map layout expects
+static const XMFLOAT3 g_faceLooks[CubeCameraRig::FaceCount] =
+{
+	XMFLOAT3( 1.f, 0.f, 0.f),
+	XMFLOAT3(-1.f, 0.f, 0.f),
+	XMFLOAT3( 0.f, 1.f, 0.f),
+	XMFLOAT3( 0.f,-1.f, 0.f),
+	XMFLOAT3( 0.f, 0.f, 1.f),
+	XMFLOAT3( 0.f, 0.f,-1.f)
+};
+
+static const XMFLOAT3 g_faceUps[CubeCameraRig::FaceCount] =
+{
+	XMFLOAT3( 0.f, 1.f, 0.f),
+	XMFLOAT3( 0.f, 1.f, 0.f),
+	XMFLOAT3( 0.f, 0.f,-1.f),
+	XMFLOAT3( 0.f, 0.f, 1.f),
+	XMFLOAT3( 0.f, 1.f, 0.f),
+	XMFLOAT3( 0.f, 1.f, 0.f)
+};
+
+CubeCameraRig::CubeCameraRig():m_center(0.f,0.f,0.f),
+	m_nearZ(1.f),
+	m_farZ(1000.f)
+{
+	SetLens(m_nearZ,m_farZ);
+}
+
+void CubeCameraRig::SetLens(float nearZ, float farZ)
+{
+	m_nearZ = nearZ;
+	m_farZ = farZ;
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PI*0.5f,1.f,m_nearZ,m_farZ);
+	XNA::Frustum frustum;
+	XNA::ComputeFrustumFromProjection(&frustum,&proj);
+
+	for(UINT f=0; f<FaceCount; ++f)
+	{
+		XMMATRIX rotation = XMMatrixLookToLH(XMVectorZero(),XMLoadFloat3(&g_faceLooks[f]),XMLoadFloat3(&g_faceUps[f]));
+		XMMATRIX rotationProj = rotation * proj;
+		XMStoreFloat4x4(&m_rotations[f],rotation);
+		XMStoreFloat4x4(&m_rotationProj[f],rotationProj);
+
+		//The frustum turns from view to world space by the inverse(transpose) of the rotation
+		m_frustums[f] = frustum;
+		XMStoreFloat4(&m_frustums[f].Orientation,XMQuaternionRotationMatrix(XMMatrixTranspose(rotation)));
+
+		XMVECTOR planes[6];
+		Culling::ComputePlanes(rotationProj,planes);
+		for(UINT p=0; p<6; ++p)
+		{
+			XMFLOAT4 plane;
+			XMStoreFloat4(&plane,planes[p]);
+			m_planeX[6 * f + p] = plane.x;
+			m_planeY[6 * f + p] = plane.y;
+			m_planeZ[6 * f + p] = plane.z;
+			m_originW[6 * f + p] = plane.w;
+		}
+	}
+
+	Refresh();
+}
+
+bool CubeCameraRig::SetCenter(FXMVECTOR center)
+{
+	XMFLOAT3 c;
+	XMStoreFloat3(&c,center);
+	if(c.x == m_center.x && c.y == m_center.y && c.z == m_center.z)
+		return false;
+
+	m_center = c;
+	Refresh();
+	return true;
+}
+
+void CubeCameraRig::Refresh()
+{
+	//View-projection of a face at c: translation(-c) * m_rotationProj, whose last row is r3 - c.x r0 - c.y r1 - c.z r2
+	XMVECTOR cx = XMVectorReplicate(m_center.x);
+	XMVECTOR cy = XMVectorReplicate(m_center.y);
+	XMVECTOR cz = XMVectorReplicate(m_center.z);
+	for(UINT f=0; f<FaceCount; ++f)
+	{
+		XMMATRIX m = XMLoadFloat4x4(&m_rotationProj[f]);
+		m.r[3] = XMVectorNegativeMultiplySubtract(cz,m.r[2],
+			XMVectorNegativeMultiplySubtract(cy,m.r[1],XMVectorNegativeMultiplySubtract(cx,m.r[0],m.r[3])));
+		XMStoreFloat4x4(&m_viewProj[f],m);
+		m_frustums[f].Origin = m_center;
+	}
+
+	//Planes at c: w - Dot(normal, c), four planes per vector
+	for(UINT i=0; i<6 * FaceCount; i+=4)
+	{
+		XMVECTOR w = XMLoadFloat4((const XMFLOAT4*)&m_originW[i]);
+		w = XMVectorNegativeMultiplySubtract(cx,XMLoadFloat4((const XMFLOAT4*)&m_planeX[i]),w);
+		w = XMVectorNegativeMultiplySubtract(cy,XMLoadFloat4((const XMFLOAT4*)&m_planeY[i]),w);
+		w = XMVectorNegativeMultiplySubtract(cz,XMLoadFloat4((const XMFLOAT4*)&m_planeZ[i]),w);
+		XMStoreFloat4((XMFLOAT4*)&m_planeW[i],w);
+	}
+}
+
+XMMATRIX CubeCameraRig::View(UINT face) const
+{
+	XMMATRIX view = XMLoadFloat4x4(&m_rotations[face]);
+	XMVECTOR c = XMLoadFloat3(&m_center);
+	view.r[3] = XMVectorSetW(-XMVector3TransformNormal(c,view),1.f);
+	return view;
+}
+
+void CubeCameraRig::GetPlanes(UINT face, XMVECTOR *planes) const
+{
+	for(UINT p=0; p<6; ++p)
+	{
+		UINT i = 6 * face + p;
+		planes[p] = XMVectorSet(m_planeX[i],m_planeY[i],m_planeZ[i],m_planeW[i]);
+	}
+}
+
+Culling::CubeViews CubeCameraRig::GetCubeViews() const
+{
+	Culling::CubeViews cube = { m_center, m_nearZ, m_farZ };
+	return cube;
+}
@@ -0,0 +1,63 @@
+#ifndef _CUBE_CAMERA_RIG_H_
+#define _CUBE_CAMERA_RIG_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include "xnacollision.h"
+#include "Culling.h"
+
+//The six 90 degree cameras of a dynamic cube map, in D3D face order(+X, -X, +Y, -Y, +Z, -Z).
+//The face rotations are constant, so their rotation * projection products and frustums are built once by SetLens.
+//Moving the center only changes the translation: the last row of each view-projection and the distance of each
+//plane, updated for the six faces together.
+class CubeCameraRig
+{
+public:
+	enum { FaceCount = 6 };
+
+	CubeCameraRig();
+
+	//Near and far distances shared by the faces
+	void SetLens(float nearZ, float farZ);
+	//Move the cameras, nothing is recomputed when the center does not change. Return true when it changed.
+	bool SetCenter(FXMVECTOR center);
+
+	XMFLOAT3	GetCenter()		const	{ return m_center; }
+	XMVECTOR	GetCenterXM()	const	{ return XMLoadFloat3(&m_center); }
+	float		GetNearZ()		const	{ return m_nearZ; }
+	float		GetFarZ()		const	{ return m_farZ; }
+
+	XMMATRIX View(UINT face)			const;
+	XMMATRIX ViewProjection(UINT face)	const	{ return XMLoadFloat4x4(&m_viewProj[face]); }
+	//Frustum of a face in world space
+	const XNA::Frustum& GetFrustum(UINT face)	const	{ return m_frustums[face]; }
+	//World space planes of a face(far, near, right, left, top, bottom), as Culling::ComputePlanes(ViewProjection(face))
+	void GetPlanes(UINT face, XMVECTOR *planes) const;
+	//For Culling::CullSpheresCube and CullAABBsCube
+	Culling::CubeViews GetCubeViews() const;
+
+private:
+	//Translate the view-projections, frustums and planes to m_center
+	void Refresh();
+
+private:
+	XMFLOAT3		m_center;
+	float			m_nearZ;
+	float			m_farZ;
+
+	XMFLOAT4X4		m_rotations[FaceCount];			//Views of the faces at the origin
+	XMFLOAT4X4		m_rotationProj[FaceCount];		//m_rotations[f] * projection
+
+	XMFLOAT4X4		m_viewProj[FaceCount];
+	XNA::Frustum	m_frustums[FaceCount];
+
+	//Planes of the faces at the origin as structure of arrays, plane p of face f at 6 * f + p.
+	//Only w depends on the center.
+	float			m_planeX[6 * FaceCount];
+	float			m_planeY[6 * FaceCount];
+	float			m_planeZ[6 * FaceCount];
+	float			m_originW[6 * FaceCount];
+	float			m_planeW[6 * FaceCount];
+};
+
+#endif	//_CUBE_CAMERA_RIG_H_
@@ -0,0 +1,92 @@
+#include "CubeFaceScheduler.h"
+#include "AppUtil.h"
+
+CubeFaceScheduler::CubeFaceScheduler():m_policy(UpdateAll),
+	m_facesPerFrame(FaceCount),
+	m_refreshInterval(0.5f),
+	m_dirty(AllFaces),
+	m_undefined(AllFaces),
+	m_cursor(0),
+	m_elapsed(0.f)
+{
+	ResetStats();
+}
+
+void CubeFaceScheduler::SetPolicy(Policy policy, UINT facesPerFrame, float refreshInterval)
+{
+	facesPerFrame = Clamp(1U,(UINT)FaceCount,facesPerFrame);
+	refreshInterval = max(refreshInterval,0.f);
+	//Called every frame while a key is held: only a real change restarts the time slice
+	if(policy == m_policy && facesPerFrame == m_facesPerFrame && refreshInterval == m_refreshInterval)
+		return;
+
+	m_policy = policy;
+	m_facesPerFrame = facesPerFrame;
+	m_refreshInterval = refreshInterval;
+	m_elapsed = 0.f;
+}
+
+UINT CubeFaceScheduler::TakeFaces(UINT candidates, UINT count)
+{
+	UINT faces = 0;
+	UINT start = m_cursor;
+	for(UINT i=0; i<FaceCount && count > 0; ++i)
+	{
+		UINT face = (start + i) % FaceCount;
+		if(candidates & (1 << face))
+		{
+			faces |= 1 << face;
+			m_cursor = (face + 1) % FaceCount;
+			--count;
+		}
+	}
+	return faces;
+}
+
+UINT CubeFaceScheduler::Schedule()
+{
+	UINT faces = 0;
+	switch(m_policy)
+	{
+	case UpdateAll:
+		faces = AllFaces;
+		break;
+	case RoundRobin:
+		faces = TakeFaces(AllFaces,m_facesPerFrame);
+		break;
+	case DirtyFaces:
+		faces = TakeFaces(m_dirty,m_facesPerFrame);
+		break;
+	case TimeSliced:
+		{
+			//One face every interval / 6 seconds. A long frame renders at most the whole cube and drops the rest of its time.
+			float faceTime = m_refreshInterval / FaceCount;
+			UINT due = FaceCount;
+			if(faceTime > 0.f)
+				due = min((UINT)(m_elapsed / faceTime),(UINT)FaceCount);
+			m_elapsed = faceTime > 0.f ? min(m_elapsed - due * faceTime,faceTime) : 0.f;
+			faces = TakeFaces(AllFaces,due);
+		}
+		break;
+	}
+	if(m_policy != TimeSliced)
+		m_elapsed = 0.f;
+
+	faces |= m_undefined;
+	m_undefined = 0;
+	m_dirty &= ~faces;
+
+	m_lastFaces = 0;
+	for(UINT f=0; f<FaceCount; ++f)
+		m_lastFaces += (faces >> f) & 1;
+	m_totalFaces += m_lastFaces;
+	++m_frames;
+	return faces;
+}
+
+void CubeFaceScheduler::ResetStats()
+{
+	m_lastFaces = 0;
+	m_totalFaces = 0;
+	m_frames = 0;
+}
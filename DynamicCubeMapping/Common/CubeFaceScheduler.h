@@ -0,0 +1,67 @@
+#ifndef _CUBE_FACE_SCHEDULER_H_
+#define _CUBE_FACE_SCHEDULER_H_
+
+#include <Windows.h>
+
+//Chooses which faces of a dynamic cube map to render each frame, so a probe does not redraw six faces
+//(and regenerate its mips) every frame when little changes around it. Faces are bits 0-5 of a mask, in D3D
+//face order. No rendering here: Schedule returns the mask and the caller draws those faces.
+class CubeFaceScheduler
+{
+public:
+	enum Policy
+	{
+		UpdateAll,			//Six faces every frame
+		RoundRobin,			//The next 'facesPerFrame' faces in turn, whatever changed
+		DirtyFaces,			//Only faces marked dirty, at most 'facesPerFrame' a frame(the others wait)
+		TimeSliced			//Full refresh every 'refreshInterval' seconds, its faces spread over the interval
+	};
+
+	enum { FaceCount = 6, AllFaces = (1 << FaceCount) - 1 };
+
+	CubeFaceScheduler();
+
+	//Does nothing when the policy and its parameters are the current ones
+	void	SetPolicy(Policy policy, UINT facesPerFrame = FaceCount, float refreshInterval = 0.5f);
+	Policy	GetPolicy()	const	{ return m_policy; }
+
+	//Faces whose content is stale, e.g. the faces an object was visible in before and after it moved.
+	//Only DirtyFaces waits for this, the other policies refresh every face in turn anyway.
+	void MarkDirty(UINT faceMask)	{ m_dirty |= faceMask & AllFaces; }
+	//Faces with undefined content(creation, resize): rendered on the next Schedule whatever the policy
+	void Reset()					{ m_dirty = m_undefined = AllFaces; }
+	//Faces returned by Schedule but not drawn(e.g. the passes drawing them were culled): forced on the next Schedule
+	void Restore(UINT faceMask)		{ m_undefined |= faceMask & AllFaces; }
+
+	//Time since the last frame, for TimeSliced
+	void Advance(float delta)		{ m_elapsed += delta; }
+	//Faces to render this frame. They count as up to date after the call. 0 means the cube map, and its mips, did not change.
+	UINT Schedule();
+
+	//Faces rendered by the last Schedule, and totals since ResetStats
+	UINT GetLastFaces()		const	{ return m_lastFaces; }
+	UINT GetTotalFaces()	const	{ return m_totalFaces; }
+	UINT GetFrames()		const	{ return m_frames; }
+	float GetFacesPerFrame()	const	{ return m_frames ? (float)m_totalFaces / m_frames : 0.f; }
+	void ResetStats();
+
+private:
+	//'count' faces in cyclic order from m_cursor among 'candidates'
+	UINT TakeFaces(UINT candidates, UINT count);
+
+private:
+	Policy	m_policy;
+	UINT	m_facesPerFrame;
+	float	m_refreshInterval;
+
+	UINT	m_dirty;
+	UINT	m_undefined;
+	UINT	m_cursor;			//Next face in cyclic order
+	float	m_elapsed;			//TimeSliced: time not yet turned into faces
+
+	UINT	m_lastFaces;
+	UINT	m_totalFaces;
+	UINT	m_frames;
+};
+
+#endif	//_CUBE_FACE_SCHEDULER_H_
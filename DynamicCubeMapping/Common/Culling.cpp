@@ -0,0 +1,452 @@
+#include "Culling.h"
+#include "AppUtil.h"
+#include <cstring>
+
+namespace Culling
+{
+	//Number of set bits in a 4 bit value
+	static const UINT g_bitCount[16] = { 0,1,1,2, 1,2,2,3, 1,2,2,3, 2,3,3,4 };
+
+	static inline XMVECTOR Load4(const float *p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	void SetPlanes(const XMVECTOR *planes, FrustumPlanes &out)
+	{
+		for(UINT i=0; i<6; ++i)
+		{
+			out.x[i] = XMVectorSplatX(planes[i]);
+			out.y[i] = XMVectorSplatY(planes[i]);
+			out.z[i] = XMVectorSplatZ(planes[i]);
+			out.w[i] = XMVectorSplatW(planes[i]);
+
+			out.absX[i] = XMVectorAbs(out.x[i]);
+			out.absY[i] = XMVectorAbs(out.y[i]);
+			out.absZ[i] = XMVectorAbs(out.z[i]);
+		}
+	}
+
+	void SetPlanes(const XNA::Frustum &frustum, FrustumPlanes &out)
+	{
+		XMVECTOR planes[6];
+		XNA::ComputePlanesFromFrustum(&frustum,&planes[0],&planes[1],&planes[2],&planes[3],&planes[4],&planes[5]);
+
+		SetPlanes(planes,out);
+	}
+
+	//Sphere tests
+	struct SphereTest
+	{
+		typedef SphereSoA Bounds;
+		enum { nArrays = 4 };
+
+		struct Lanes
+		{
+			XMVECTOR cx, cy, cz, r;
+		};
+
+		static inline void Load(const SphereSoA &s, UINT i, Lanes &l)
+		{
+			l.cx = Load4(s.centerX + i);
+			l.cy = Load4(s.centerY + i);
+			l.cz = Load4(s.centerZ + i);
+			l.r = Load4(s.radius + i);
+		}
+
+		//All bits set in the lanes of the loaded spheres outside a plane
+		static inline XMVECTOR Outside(const FrustumPlanes &planes, const Lanes &l)
+		{
+			XMVECTOR outside = XMVectorFalseInt();
+			for(UINT p=0; p<6; ++p)
+			{
+				XMVECTOR dist = XMVectorMultiplyAdd(l.cx,planes.x[p],planes.w[p]);
+				dist = XMVectorMultiplyAdd(l.cy,planes.y[p],dist);
+				dist = XMVectorMultiplyAdd(l.cz,planes.z[p],dist);
+				outside = XMVectorOrInt(outside,XMVectorGreater(dist,l.r));
+			}
+
+			return outside;
+		}
+
+		//Visibility bits of 4 loaded objects
+		static inline UINT Test(const FrustumPlanes &planes, const Lanes &l)
+		{
+			return ~MoveMask(Outside(planes,l)) & 0xF;
+		}
+
+		//Radius along a cube axis, and against an unnormalized diagonal plane such as x - y = 0
+		static inline XMVECTOR AxisRadius(const Lanes &l, UINT)	{ return l.r; }
+		static inline XMVECTOR DiagRadius(const Lanes &l, UINT, UINT)
+		{
+			static const XMVECTORF32 sqrt2 = { 1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+			return XMVectorMultiply(l.r,sqrt2);
+		}
+
+		//Visibility bits of the 4 spheres starting at 'i'
+		static inline UINT Test4(const FrustumPlanes &planes, const SphereSoA &s, UINT i)
+		{
+			Lanes l;
+			Load(s,i,l);
+			return Test(planes,l);
+		}
+
+		static void Arrays(const SphereSoA &s, const float **arrays)
+		{
+			arrays[0] = s.centerX;	arrays[1] = s.centerY;	arrays[2] = s.centerZ;	arrays[3] = s.radius;
+		}
+
+		static void FromArrays(const float **arrays, UINT count, SphereSoA &s)
+		{
+			s.centerX = arrays[0];	s.centerY = arrays[1];	s.centerZ = arrays[2];	s.radius = arrays[3];
+			s.count = count;
+		}
+	};
+
+	//Box tests
+	struct AABBTest
+	{
+		typedef AABBSoA Bounds;
+		enum { nArrays = 6 };
+
+		struct Lanes
+		{
+			XMVECTOR cx, cy, cz, ex, ey, ez;
+		};
+
+		static inline void Load(const AABBSoA &b, UINT i, Lanes &l)
+		{
+			l.cx = Load4(b.centerX + i);
+			l.cy = Load4(b.centerY + i);
+			l.cz = Load4(b.centerZ + i);
+			l.ex = Load4(b.extentX + i);
+			l.ey = Load4(b.extentY + i);
+			l.ez = Load4(b.extentZ + i);
+		}
+
+		//All bits set in the lanes of the loaded boxes outside a plane
+		static inline XMVECTOR Outside(const FrustumPlanes &planes, const Lanes &l)
+		{
+			XMVECTOR outside = XMVectorFalseInt();
+			for(UINT p=0; p<6; ++p)
+			{
+				XMVECTOR dist = XMVectorMultiplyAdd(l.cx,planes.x[p],planes.w[p]);
+				dist = XMVectorMultiplyAdd(l.cy,planes.y[p],dist);
+				dist = XMVectorMultiplyAdd(l.cz,planes.z[p],dist);
+
+				//Extents projected on the plane normal
+				XMVECTOR radius = XMVectorMultiply(l.ex,planes.absX[p]);
+				radius = XMVectorMultiplyAdd(l.ey,planes.absY[p],radius);
+				radius = XMVectorMultiplyAdd(l.ez,planes.absZ[p],radius);
+
+				outside = XMVectorOrInt(outside,XMVectorGreater(dist,radius));
+			}
+
+			return outside;
+		}
+
+		//Visibility bits of 4 loaded objects
+		static inline UINT Test(const FrustumPlanes &planes, const Lanes &l)
+		{
+			return ~MoveMask(Outside(planes,l)) & 0xF;
+		}
+
+		//Extent along a cube axis, and against an unnormalized diagonal plane such as x - y = 0
+		static inline XMVECTOR AxisRadius(const Lanes &l, UINT axis)
+		{
+			return axis == 0 ? l.ex : (axis == 1 ? l.ey : l.ez);
+		}
+		static inline XMVECTOR DiagRadius(const Lanes &l, UINT a, UINT b)
+		{
+			return XMVectorAdd(AxisRadius(l,a),AxisRadius(l,b));
+		}
+
+		//Visibility bits of the 4 boxes starting at 'i'
+		static inline UINT Test4(const FrustumPlanes &planes, const AABBSoA &b, UINT i)
+		{
+			Lanes l;
+			Load(b,i,l);
+			return Test(planes,l);
+		}
+
+		static void Arrays(const AABBSoA &b, const float **arrays)
+		{
+			arrays[0] = b.centerX;	arrays[1] = b.centerY;	arrays[2] = b.centerZ;
+			arrays[3] = b.extentX;	arrays[4] = b.extentY;	arrays[5] = b.extentZ;
+		}
+
+		static void FromArrays(const float **arrays, UINT count, AABBSoA &b)
+		{
+			b.centerX = arrays[0];	b.centerY = arrays[1];	b.centerZ = arrays[2];
+			b.extentX = arrays[3];	b.extentY = arrays[4];	b.extentZ = arrays[5];
+			b.count = count;
+		}
+	};
+
+	//Zero padded copy of the last 'count % 4' objects, so that full vectors can be loaded
+	template<typename Test>
+	struct PaddedTail
+	{
+		PaddedTail(const typename Test::Bounds &bounds, UINT first)
+		{
+			n = bounds.count - first;
+
+			const float *src[Test::nArrays];
+			const float *dst[Test::nArrays];
+			Test::Arrays(bounds,src);
+			for(UINT a=0; a<Test::nArrays; ++a)
+			{
+				padded[a][0] = padded[a][1] = padded[a][2] = padded[a][3] = 0.f;
+				for(UINT k=0; k<n; ++k)
+					padded[a][k] = src[a][first + k];
+				dst[a] = padded[a];
+			}
+			Test::FromArrays(dst,4,tail);
+		}
+
+		_DECLSPEC_ALIGN_16_ float	padded[Test::nArrays][4];
+		typename Test::Bounds		tail;
+		UINT						n;
+	};
+
+	//Test the last 'count % 4' objects
+	template<typename Test>
+	static UINT TestTail(const FrustumPlanes &planes, const typename Test::Bounds &bounds, UINT first)
+	{
+		PaddedTail<Test> tail(bounds,first);
+
+		return Test::Test4(planes,tail.tail,0) & ((1u << tail.n) - 1);
+	}
+
+	template<typename Test>
+	static UINT CullToMask(const FrustumPlanes &planes, const typename Test::Bounds &bounds, UINT *visibleMask)
+	{
+		memset(visibleMask,0,MaskSize(bounds.count) * sizeof(UINT));
+
+		UINT nVisible = 0;
+		UINT i = 0;
+		//8 objects per iteration, two independent groups of 4
+		for(; i + 8 <= bounds.count; i += 8)
+		{
+			UINT low = Test::Test4(planes,bounds,i);
+			UINT high = Test::Test4(planes,bounds,i + 4);
+
+			visibleMask[i >> 5] |= (low | (high << 4)) << (i & 31);
+			nVisible += g_bitCount[low] + g_bitCount[high];
+		}
+		for(; i + 4 <= bounds.count; i += 4)
+		{
+			UINT bits = Test::Test4(planes,bounds,i);
+			visibleMask[i >> 5] |= bits << (i & 31);
+			nVisible += g_bitCount[bits];
+		}
+		if(i < bounds.count)
+		{
+			UINT bits = TestTail<Test>(planes,bounds,i);
+			visibleMask[i >> 5] |= bits << (i & 31);
+			nVisible += g_bitCount[bits];
+		}
+
+		return nVisible;
+	}
+
+	//Append the set lanes of 'bits' to 'out' without branching on the result
+	static inline UINT Compact(UINT bits, UINT first, UINT nLanes, UINT *out, UINT nOut)
+	{
+		for(UINT lane=0; lane<nLanes; ++lane)
+		{
+			out[nOut] = first + lane;
+			nOut += (bits >> lane) & 1;
+		}
+		return nOut;
+	}
+
+	template<typename Test>
+	static UINT CullToIndices(const FrustumPlanes &planes, const typename Test::Bounds &bounds, UINT *visibleIndices)
+	{
+		UINT nVisible = 0;
+		UINT i = 0;
+		for(; i + 8 <= bounds.count; i += 8)
+		{
+			UINT low = Test::Test4(planes,bounds,i);
+			UINT high = Test::Test4(planes,bounds,i + 4);
+
+			nVisible = Compact(low | (high << 4),i,8,visibleIndices,nVisible);
+		}
+		for(; i + 4 <= bounds.count; i += 4)
+		{
+			nVisible = Compact(Test::Test4(planes,bounds,i),i,4,visibleIndices,nVisible);
+		}
+		if(i < bounds.count)
+		{
+			nVisible = Compact(TestTail<Test>(planes,bounds,i),i,bounds.count - i,visibleIndices,nVisible);
+		}
+
+		return nVisible;
+	}
+
+	//OR bit 'first + v' into the lanes of the loaded objects that are not outside views[v]
+	template<typename Test>
+	static inline XMVECTOR TestViews(const FrustumPlanes *views, UINT nViews, UINT first, const typename Test::Lanes &l, XMVECTOR masks)
+	{
+		for(UINT v=0; v<nViews; ++v)
+		{
+			masks = XMVectorOrInt(masks,XMVectorAndCInt(XMVectorReplicateInt(1u << (first + v)),Test::Outside(views[v],l)));
+		}
+		return masks;
+	}
+
+	//The six faces of a cube camera only have 6 distinct side planes: x = y, x = -y, x = z, x = -z, y = z and y = -z
+	//through the center, each one shared by two faces(on opposite sides).
+	//So 6 diagonal and 3 axis distances decide all faces, instead of 36 plane tests.
+	template<typename Test>
+	static inline XMVECTOR TestCube(const CubeViews &cube, const typename Test::Lanes &l)
+	{
+		XMVECTOR x = XMVectorSubtract(l.cx,XMVectorReplicate(cube.center.x));
+		XMVECTOR y = XMVectorSubtract(l.cy,XMVectorReplicate(cube.center.y));
+		XMVECTOR z = XMVectorSubtract(l.cz,XMVectorReplicate(cube.center.z));
+		XMVECTOR nearZ = XMVectorReplicate(cube.nearZ);
+		XMVECTOR farZ = XMVectorReplicate(cube.farZ);
+
+		//Can the object reach the positive/negative side of each diagonal plane
+		XMVECTOR dist[6], radius[6];
+		dist[0] = XMVectorSubtract(x,y);	radius[0] = Test::DiagRadius(l,0,1);
+		dist[1] = XMVectorAdd(x,y);			radius[1] = radius[0];
+		dist[2] = XMVectorSubtract(x,z);	radius[2] = Test::DiagRadius(l,0,2);
+		dist[3] = XMVectorAdd(x,z);			radius[3] = radius[2];
+		dist[4] = XMVectorSubtract(y,z);	radius[4] = Test::DiagRadius(l,1,2);
+		dist[5] = XMVectorAdd(y,z);			radius[5] = radius[4];
+
+		XMVECTOR pos[6], neg[6];
+		for(UINT k=0; k<6; ++k)
+		{
+			pos[k] = XMVectorGreaterOrEqual(XMVectorAdd(dist[k],radius[k]),XMVectorZero());
+			neg[k] = XMVectorLessOrEqual(XMVectorSubtract(dist[k],radius[k]),XMVectorZero());
+		}
+
+		//Depth range along each axis, on the positive and negative side
+		XMVECTOR axisPos[3], axisNeg[3];
+		XMVECTOR axes[3] = { x, y, z };
+		for(UINT a=0; a<3; ++a)
+		{
+			XMVECTOR r = Test::AxisRadius(l,a);
+			XMVECTOR lo = XMVectorSubtract(axes[a],r);
+			XMVECTOR hi = XMVectorAdd(axes[a],r);
+			axisPos[a] = XMVectorAndInt(XMVectorGreaterOrEqual(hi,nearZ),XMVectorLessOrEqual(lo,farZ));
+			axisNeg[a] = XMVectorAndInt(XMVectorLessOrEqual(lo,XMVectorNegate(nearZ)),XMVectorGreaterOrEqual(hi,XMVectorNegate(farZ)));
+		}
+
+		//D3D face order: +X, -X, +Y, -Y, +Z, -Z
+		XMVECTOR faces[6];
+		faces[0] = XMVectorAndInt(XMVectorAndInt(axisPos[0],pos[0]),XMVectorAndInt(XMVectorAndInt(pos[1],pos[2]),pos[3]));
+		faces[1] = XMVectorAndInt(XMVectorAndInt(axisNeg[0],neg[0]),XMVectorAndInt(XMVectorAndInt(neg[1],neg[2]),neg[3]));
+		faces[2] = XMVectorAndInt(XMVectorAndInt(axisPos[1],neg[0]),XMVectorAndInt(XMVectorAndInt(pos[1],pos[4]),pos[5]));
+		faces[3] = XMVectorAndInt(XMVectorAndInt(axisNeg[1],pos[0]),XMVectorAndInt(XMVectorAndInt(neg[1],neg[4]),neg[5]));
+		faces[4] = XMVectorAndInt(XMVectorAndInt(axisPos[2],neg[2]),XMVectorAndInt(XMVectorAndInt(pos[3],neg[4]),pos[5]));
+		faces[5] = XMVectorAndInt(XMVectorAndInt(axisNeg[2],pos[2]),XMVectorAndInt(XMVectorAndInt(neg[3],pos[4]),neg[5]));
+
+		XMVECTOR masks = XMVectorZero();
+		for(UINT f=0; f<6; ++f)
+		{
+			masks = XMVectorOrInt(masks,XMVectorAndInt(faces[f],XMVectorReplicateInt(1u << f)));
+		}
+		return masks;
+	}
+
+	//One pass over the bounds: 4 objects are loaded once, then tested against the cube(if any) and every view.
+	template<typename Test>
+	static UINT CullToViewMasks(const CubeViews *cube, const FrustumPlanes *views, UINT nViews, const typename Test::Bounds &bounds, UINT *viewMasks)
+	{
+		UINT first = cube ? 6 : 0;
+		XMASSERT(first + nViews <= 32);
+
+		typename Test::Lanes l;
+		UINT i = 0;
+		for(; i + 4 <= bounds.count; i += 4)
+		{
+			Test::Load(bounds,i,l);
+			XMVECTOR masks = cube ? TestCube<Test>(*cube,l) : XMVectorZero();
+			XMStoreInt4(viewMasks + i,TestViews<Test>(views,nViews,first,l,masks));
+		}
+		if(i < bounds.count)
+		{
+			PaddedTail<Test> tail(bounds,i);
+			Test::Load(tail.tail,0,l);
+			XMVECTOR masks = cube ? TestCube<Test>(*cube,l) : XMVectorZero();
+
+			UINT tailMasks[4];
+			XMStoreInt4(tailMasks,TestViews<Test>(views,nViews,first,l,masks));
+			for(UINT k=0; k<tail.n; ++k)
+				viewMasks[i + k] = tailMasks[k];
+		}
+
+		UINT nVisible = 0;
+		for(i=0; i<bounds.count; ++i)
+			nVisible += viewMasks[i] != 0;
+
+		return nVisible;
+	}
+
+	UINT CullSpheres(const FrustumPlanes &planes, const SphereSoA &spheres, UINT *visibleMask)
+	{
+		return CullToMask<SphereTest>(planes,spheres,visibleMask);
+	}
+
+	UINT CullAABBs(const FrustumPlanes &planes, const AABBSoA &boxes, UINT *visibleMask)
+	{
+		return CullToMask<AABBTest>(planes,boxes,visibleMask);
+	}
+
+	UINT CullSpheresCompact(const FrustumPlanes &planes, const SphereSoA &spheres, UINT *visibleIndices)
+	{
+		return CullToIndices<SphereTest>(planes,spheres,visibleIndices);
+	}
+
+	UINT CullAABBsCompact(const FrustumPlanes &planes, const AABBSoA &boxes, UINT *visibleIndices)
+	{
+		return CullToIndices<AABBTest>(planes,boxes,visibleIndices);
+	}
+
+	UINT CullSpheresMultiView(const FrustumPlanes *views, UINT nViews, const SphereSoA &spheres, UINT *viewMasks)
+	{
+		return CullToViewMasks<SphereTest>(NULL,views,nViews,spheres,viewMasks);
+	}
+
+	UINT CullAABBsMultiView(const FrustumPlanes *views, UINT nViews, const AABBSoA &boxes, UINT *viewMasks)
+	{
+		return CullToViewMasks<AABBTest>(NULL,views,nViews,boxes,viewMasks);
+	}
+
+	UINT CullSpheresCube(const CubeViews &cube, const FrustumPlanes *views, UINT nViews, const SphereSoA &spheres, UINT *viewMasks)
+	{
+		return CullToViewMasks<SphereTest>(&cube,views,nViews,spheres,viewMasks);
+	}
+
+	UINT CullAABBsCube(const CubeViews &cube, const FrustumPlanes *views, UINT nViews, const AABBSoA &boxes, UINT *viewMasks)
+	{
+		return CullToViewMasks<AABBTest>(&cube,views,nViews,boxes,viewMasks);
+	}
+
+	void ComputePlanes(CXMMATRIX viewProj, XMVECTOR *planes)
+	{
+		//Clip space planes taken from the columns of the matrix(row vectors, D3D depth range [0, 1]).
+		//Negated, so that the inside of the frustum is on the negative side as in the XNA tests.
+		XMMATRIX M = XMMatrixTranspose(viewProj);
+
+		planes[0] = XMVectorSubtract(M.r[2],M.r[3]);					//Far
+		planes[1] = XMVectorNegate(M.r[2]);								//Near
+		planes[2] = XMVectorSubtract(M.r[0],M.r[3]);					//Right
+		planes[3] = XMVectorNegate(XMVectorAdd(M.r[3],M.r[0]));			//Left
+		planes[4] = XMVectorSubtract(M.r[1],M.r[3]);					//Top
+		planes[5] = XMVectorNegate(XMVectorAdd(M.r[3],M.r[1]));			//Bottom
+		for(UINT i=0; i<6; ++i)
+			planes[i] = XMPlaneNormalize(planes[i]);
+	}
+
+	void SetPlanes(CXMMATRIX viewProj, FrustumPlanes &out)
+	{
+		XMVECTOR planes[6];
+		ComputePlanes(viewProj,planes);
+		SetPlanes(planes,out);
+	}
+};
@@ -0,0 +1,93 @@
+#ifndef _CULLING_H_
+#define _CULLING_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include "xnacollision.h"
+
+//Batch view frustum culling.
+//Bounds are passed as structure of arrays, so one XMVECTOR holds the same component of 4 objects
+//and a single instruction tests 4 objects against a plane. The loops handle 8 objects per iteration.
+namespace Culling
+{
+	//Six planes with every component splatted across a vector.
+	//Same convention as the XNA 6-plane tests: a point is outside a plane when Dot(plane, point) > 0.
+	_DECLSPEC_ALIGN_16_ struct FrustumPlanes
+	{
+		XMVECTOR	x[6];
+		XMVECTOR	y[6];
+		XMVECTOR	z[6];
+		XMVECTOR	w[6];
+
+		XMVECTOR	absX[6];		//|normal|, used to project box extents on the plane normal
+		XMVECTOR	absY[6];
+		XMVECTOR	absZ[6];
+	};
+
+	//Spheres in SoA form. All arrays hold 'count' floats.
+	struct SphereSoA
+	{
+		const float	*centerX;
+		const float	*centerY;
+		const float	*centerZ;
+		const float	*radius;
+		UINT		count;
+	};
+
+	//Axis aligned boxes in SoA form(center and half size, same as XNA::AxisAlignedBox)
+	struct AABBSoA
+	{
+		const float	*centerX;
+		const float	*centerY;
+		const float	*centerZ;
+		const float	*extentX;
+		const float	*extentY;
+		const float	*extentZ;
+		UINT		count;
+	};
+
+	//Six 90 degree cube map cameras at 'center', looking down the world axes in D3D face order(+X, -X, +Y, -Y, +Z, -Z)
+	struct CubeViews
+	{
+		XMFLOAT3	center;
+		float		nearZ;
+		float		farZ;
+	};
+
+	//Fill 'out' from six planes, e.g. the ones returned by XNA::ComputePlanesFromFrustum
+	void SetPlanes(const XMVECTOR *planes, FrustumPlanes &out);
+	//Compute the planes of a frustum placed in world space(see XNA::TransformFrustum)
+	void SetPlanes(const XNA::Frustum &frustum, FrustumPlanes &out);
+	//Extract the planes of a view-projection matrix, in world space
+	void SetPlanes(CXMMATRIX viewProj, FrustumPlanes &out);
+	//Same six planes as XMVECTORs(far, near, right, left, top, bottom), for the XNA 6-plane tests
+	void ComputePlanes(CXMMATRIX viewProj, XMVECTOR *planes);
+
+	//Number of UINTs needed by a visibility bit mask of 'count' objects
+	inline UINT MaskSize(UINT count)	{ return (count + 31) / 32; }
+	//Is object 'i' set in a visibility bit mask
+	inline bool IsVisible(const UINT *mask, UINT i)	{ return (mask[i >> 5] & (1u << (i & 31))) != 0; }
+
+	//Write one bit per object into 'visibleMask'(MaskSize(count) UINTs), set when the object is not outside any plane.
+	//Return the number of visible objects.
+	UINT CullSpheres(const FrustumPlanes &planes, const SphereSoA &spheres, UINT *visibleMask);
+	UINT CullAABBs(const FrustumPlanes &planes, const AABBSoA &boxes, UINT *visibleMask);
+
+	//Same tests, but write the indices of visible objects to 'visibleIndices'(room for 'count' entries).
+	//Return the number of visible objects.
+	UINT CullSpheresCompact(const FrustumPlanes &planes, const SphereSoA &spheres, UINT *visibleIndices);
+	UINT CullAABBsCompact(const FrustumPlanes &planes, const AABBSoA &boxes, UINT *visibleIndices);
+
+	//Test every object against up to 32 views(e.g. six cube faces and the main camera) in one pass over the bounds.
+	//Bit v of viewMasks[i] is set when object i is visible in views[v]; 'viewMasks' has room for 'count' entries.
+	//Return the number of objects visible in at least one view.
+	UINT CullSpheresMultiView(const FrustumPlanes *views, UINT nViews, const SphereSoA &spheres, UINT *viewMasks);
+	UINT CullAABBsMultiView(const FrustumPlanes *views, UINT nViews, const AABBSoA &boxes, UINT *viewMasks);
+
+	//Same, with the six faces of a cube camera in bits 0-5 and views[v] in bit 6 + v(nViews <= 26).
+	//The faces share their side planes, so this is much cheaper than passing them as six general views.
+	UINT CullSpheresCube(const CubeViews &cube, const FrustumPlanes *views, UINT nViews, const SphereSoA &spheres, UINT *viewMasks);
+	UINT CullAABBsCube(const CubeViews &cube, const FrustumPlanes *views, UINT nViews, const AABBSoA &boxes, UINT *viewMasks);
+};
+
+#endif	//_CULLING_H_
@@ -0,0 +1,319 @@
+#include "DynamicAabbTree.h"
+#include <malloc.h>
+#include <cstring>
+
+static XMVECTOR BoxMin(const XNA::AxisAlignedBox &box)
+{
+	return XMLoadFloat3(&box.Center) - XMLoadFloat3(&box.Extents);
+}
+
+static XMVECTOR BoxMax(const XNA::AxisAlignedBox &box)
+{
+	return XMLoadFloat3(&box.Center) + XMLoadFloat3(&box.Extents);
+}
+
+static void SetMinMax(FXMVECTOR vMin, FXMVECTOR vMax, XNA::AxisAlignedBox &box)
+{
+	XMStoreFloat3(&box.Center,(vMin + vMax) * 0.5f);
+	XMStoreFloat3(&box.Extents,(vMax - vMin) * 0.5f);
+}
+
+static void Union(const XNA::AxisAlignedBox &a, const XNA::AxisAlignedBox &b, XNA::AxisAlignedBox &result)
+{
+	SetMinMax(XMVectorMin(BoxMin(a),BoxMin(b)),XMVectorMax(BoxMax(a),BoxMax(b)),result);
+}
+
+//Half the surface area, in units of the extents
+static float Area(const XNA::AxisAlignedBox &box)
+{
+	const XMFLOAT3 &e = box.Extents;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+static float UnionArea(const XNA::AxisAlignedBox &a, const XNA::AxisAlignedBox &b)
+{
+	XNA::AxisAlignedBox u;
+	Union(a,b,u);
+	return Area(u);
+}
+
+static bool Contains(const XNA::AxisAlignedBox &outer, const XNA::AxisAlignedBox &inner)
+{
+	return XMVector3LessOrEqual(BoxMin(outer),BoxMin(inner)) && XMVector3LessOrEqual(BoxMax(inner),BoxMax(outer));
+}
+
+DynamicAabbTree::DynamicAabbTree(float margin, float motionScale)
+	: m_nodes(NULL), m_nodeCapacity(0), m_nodeCount(0), m_freeList(NullNode), m_root(NullNode), m_proxyCount(0),
+	  m_margin(margin), m_motionScale(motionScale)
+{
+}
+
+DynamicAabbTree::~DynamicAabbTree()
+{
+	_aligned_free(m_nodes);
+}
+
+int DynamicAabbTree::AllocateNode()
+{
+	if(m_freeList == NullNode)
+	{
+		//Grow the pool and chain the new nodes into the free list
+		int capacity = max(2 * m_nodeCapacity,16);
+		Node *nodes = (Node*)_aligned_malloc(capacity * sizeof(Node),16);
+		if(m_nodes)
+		{
+			memcpy(nodes,m_nodes,m_nodeCount * sizeof(Node));
+			_aligned_free(m_nodes);
+		}
+		m_nodes = nodes;
+		m_nodeCapacity = capacity;
+
+		for(int i=m_nodeCount; i<capacity; ++i)
+		{
+			m_nodes[i].parent = i + 1;
+			m_nodes[i].height = -1;
+		}
+		m_nodes[capacity - 1].parent = NullNode;
+		m_freeList = m_nodeCount;
+	}
+
+	int node = m_freeList;
+	Node &n = m_nodes[node];
+	m_freeList = n.parent;
+	n.userData = NULL;
+	n.parent = NullNode;
+	n.child1 = NullNode;
+	n.child2 = NullNode;
+	n.height = 0;
+	++m_nodeCount;
+	return node;
+}
+
+void DynamicAabbTree::FreeNode(int node)
+{
+	XMASSERT(0 <= node && node < m_nodeCapacity && m_nodeCount > 0);
+	m_nodes[node].parent = m_freeList;
+	m_nodes[node].height = -1;
+	m_freeList = node;
+	--m_nodeCount;
+}
+
+int DynamicAabbTree::CreateProxy(const XNA::AxisAlignedBox &box, void *userData)
+{
+	int proxy = AllocateNode();
+	Node &node = m_nodes[proxy];
+	node.box.Center = box.Center;
+	XMStoreFloat3(&node.box.Extents,XMLoadFloat3(&box.Extents) + XMVectorReplicate(m_margin));
+	node.userData = userData;
+
+	InsertLeaf(proxy);
+	++m_proxyCount;
+	return proxy;
+}
+
+void DynamicAabbTree::DestroyProxy(int proxy)
+{
+	XMASSERT(0 <= proxy && proxy < m_nodeCapacity && IsLeaf(proxy));
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--m_proxyCount;
+}
+
+bool DynamicAabbTree::MoveProxy(int proxy, const XNA::AxisAlignedBox &box, FXMVECTOR displacement)
+{
+	XMASSERT(0 <= proxy && proxy < m_nodeCapacity && IsLeaf(proxy));
+	if(Contains(m_nodes[proxy].box,box))
+		return false;
+
+	RemoveLeaf(proxy);
+
+	//Grow the box by the margin, then stretch it along the predicted motion
+	XMVECTOR margin = XMVectorReplicate(m_margin);
+	XMVECTOR d = displacement * m_motionScale;
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR vMin = BoxMin(box) - margin + XMVectorMin(d,zero);
+	XMVECTOR vMax = BoxMax(box) + margin + XMVectorMax(d,zero);
+	SetMinMax(vMin,vMax,m_nodes[proxy].box);
+
+	InsertLeaf(proxy);
+	return true;
+}
+
+void DynamicAabbTree::InsertLeaf(int leaf)
+{
+	if(m_root == NullNode)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = NullNode;
+		return;
+	}
+
+	//Walk down to the best sibling: the cost of a new parent at 'index' against the cost of pushing the leaf further down.
+	//Every ancestor of the new parent grows by the same amount, so that growth is paid on both sides.
+	//The box is copied since the node pool may move when the new parent is allocated.
+	XNA::AxisAlignedBox leafBox = m_nodes[leaf].box;
+	int index = m_root;
+	while(!IsLeaf(index))
+	{
+		const Node &node = m_nodes[index];
+		float area = Area(node.box);
+		float combinedArea = UnionArea(node.box,leafBox);
+
+		float cost = 2.f * combinedArea;
+		float inheritanceCost = 2.f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = {node.child1, node.child2};
+		for(int i=0; i<2; ++i)
+		{
+			const Node &child = m_nodes[children[i]];
+			float newArea = UnionArea(child.box,leafBox);
+			if(child.child1 == NullNode)
+				childCost[i] = newArea + inheritanceCost;
+			else
+				childCost[i] = newArea - Area(child.box) + inheritanceCost;
+		}
+
+		if(cost < childCost[0] && cost < childCost[1])
+			break;
+
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	//Replace the sibling with a new parent of both
+	int sibling = index;
+	int oldParent = m_nodes[sibling].parent;
+	int newParent = AllocateNode();
+	Node &parent = m_nodes[newParent];
+	parent.parent = oldParent;
+	Union(leafBox,m_nodes[sibling].box,parent.box);
+	parent.height = m_nodes[sibling].height + 1;
+	parent.child1 = sibling;
+	parent.child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if(oldParent != NullNode)
+	{
+		if(m_nodes[oldParent].child1 == sibling)
+			m_nodes[oldParent].child1 = newParent;
+		else
+			m_nodes[oldParent].child2 = newParent;
+	}
+	else
+		m_root = newParent;
+
+	//From the new parent up, as it may be unbalanced itself when the sibling is a tall subtree
+	Refit(newParent);
+}
+
+void DynamicAabbTree::RemoveLeaf(int leaf)
+{
+	if(leaf == m_root)
+	{
+		m_root = NullNode;
+		return;
+	}
+
+	//The sibling takes the place of the parent
+	int parent = m_nodes[leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if(grandParent != NullNode)
+	{
+		if(m_nodes[grandParent].child1 == parent)
+			m_nodes[grandParent].child1 = sibling;
+		else
+			m_nodes[grandParent].child2 = sibling;
+		m_nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		Refit(grandParent);
+	}
+	else
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = NullNode;
+		FreeNode(parent);
+	}
+}
+
+//Rebalance and refit the boxes from 'index' up to the root
+void DynamicAabbTree::Refit(int index)
+{
+	while(index != NullNode)
+	{
+		index = Balance(index);
+
+		Node &node = m_nodes[index];
+		const Node &child1 = m_nodes[node.child1];
+		const Node &child2 = m_nodes[node.child2];
+		node.height = 1 + max(child1.height,child2.height);
+		Union(child1.box,child2.box,node.box);
+
+		index = node.parent;
+	}
+}
+
+//Rotate 'a' when its children differ in height by more than one. Return the node now at the place of 'a'.
+int DynamicAabbTree::Balance(int iA)
+{
+	Node *A = &m_nodes[iA];
+	if(A->child1 == NullNode || A->height < 2)
+		return iA;
+
+	int iB = A->child1;
+	int iC = A->child2;
+	Node *B = &m_nodes[iB];
+	Node *C = &m_nodes[iC];
+	int balance = C->height - B->height;
+	if(balance >= -1 && balance <= 1)
+		return iA;
+
+	//Promote the higher child(C or B) and move the shorter of its children down to A
+	int iUp = balance > 1 ? iC : iB;
+	int iDown = balance > 1 ? iB : iC;
+	Node *up = &m_nodes[iUp];
+	Node *down = &m_nodes[iDown];
+
+	int iF = up->child1;
+	int iG = up->child2;
+	Node *F = &m_nodes[iF];
+	Node *G = &m_nodes[iG];
+
+	//Swap A and its promoted child
+	up->child1 = iA;
+	up->parent = A->parent;
+	A->parent = iUp;
+
+	if(up->parent != NullNode)
+	{
+		if(m_nodes[up->parent].child1 == iA)
+			m_nodes[up->parent].child1 = iUp;
+		else
+			m_nodes[up->parent].child2 = iUp;
+	}
+	else
+		m_root = iUp;
+
+	//Keep the higher grandchild under the promoted node
+	int iKeep = F->height > G->height ? iF : iG;
+	int iMove = F->height > G->height ? iG : iF;
+	Node *keep = &m_nodes[iKeep];
+	Node *move = &m_nodes[iMove];
+
+	up->child2 = iKeep;
+	if(balance > 1)
+		A->child2 = iMove;
+	else
+		A->child1 = iMove;
+	move->parent = iA;
+
+	Union(down->box,move->box,A->box);
+	Union(A->box,keep->box,up->box);
+	A->height = 1 + max(down->height,move->height);
+	up->height = 1 + max(A->height,keep->height);
+
+	return iUp;
+}
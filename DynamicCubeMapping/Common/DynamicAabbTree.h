@@ -0,0 +1,215 @@
+#ifndef _DYNAMIC_AABB_TREE_H_
+#define _DYNAMIC_AABB_TREE_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include "xnacollision.h"
+
+//Bounding volume tree for moving objects.
+//Each object(proxy) is a leaf holding a "fat" box: its real box grown by a margin and by the predicted motion.
+//Moving a proxy inside its fat box costs nothing; otherwise the leaf is removed and inserted again,
+//refitting its ancestors. Insertion picks the sibling with the lowest surface area cost and
+//rotations keep the tree balanced.
+class DynamicAabbTree
+{
+public:
+	enum { NullNode = -1 };
+
+	DynamicAabbTree(float margin = 0.1f, float motionScale = 2.f);
+	~DynamicAabbTree();
+
+	//Add an object and return its proxy id
+	int		CreateProxy(const XNA::AxisAlignedBox &box, void *userData);
+	void	DestroyProxy(int proxy);
+	//Update the box of a moving object. 'displacement' is the expected motion for the next frame, used to enlarge the fat box.
+	//Return true when the proxy had to be reinserted.
+	bool	MoveProxy(int proxy, const XNA::AxisAlignedBox &box, FXMVECTOR displacement);
+
+	void*						GetUserData(int proxy)	const	{ return m_nodes[proxy].userData; }
+	const XNA::AxisAlignedBox&	GetFatBox(int proxy)	const	{ return m_nodes[proxy].box; }
+	int							GetHeight()				const	{ return m_root == NullNode ? 0 : m_nodes[m_root].height; }
+	UINT						GetProxyCount()			const	{ return m_proxyCount; }
+
+	//Call callback(proxy) for every fat box overlapping 'box'. The callback returns false to stop the query.
+	template<typename Callback>
+	void QueryOverlap(const XNA::AxisAlignedBox &box, Callback &callback) const;
+
+	//Call callback(proxy) for every fat box inside or intersecting the frustum.
+	//Subtrees fully inside the frustum are reported without further tests.
+	template<typename Callback>
+	void QueryFrustum(const XNA::Frustum &frustum, Callback &callback) const;
+
+	//Call callback(proxy, maxDist) for every fat box hit by the ray(normalized direction) within 'maxDist'.
+	//The callback returns the new maximum distance, e.g. the distance to the object it hit; 0 stops the query.
+	template<typename Callback>
+	void RayCast(FXMVECTOR origin, FXMVECTOR direction, float maxDist, Callback &callback) const;
+
+private:
+	enum { StackSize = 256 };
+
+	struct Node
+	{
+		XNA::AxisAlignedBox	box;			//Fat box of a leaf, or union of the children
+		void				*userData;
+		int					parent;			//Next free node while the node is unused
+		int					child1;
+		int					child2;
+		int					height;			//0 for leaves, -1 for unused nodes
+	};
+
+	bool	IsLeaf(int node)	const	{ return m_nodes[node].child1 == NullNode; }
+
+	int		AllocateNode();
+	void	FreeNode(int node);
+	void	InsertLeaf(int leaf);
+	void	RemoveLeaf(int leaf);
+	int		Balance(int node);
+	void	Refit(int node);
+
+	template<typename Callback>
+	bool ReportSubtree(int node, Callback &callback) const;
+
+private:
+	Node	*m_nodes;						//16 byte aligned, grown by doubling
+	int		m_nodeCapacity;
+	int		m_nodeCount;
+	int		m_freeList;
+	int		m_root;
+	UINT	m_proxyCount;
+
+	float	m_margin;						//Added on every side of a proxy's box
+	float	m_motionScale;					//Multiplies the displacement passed to MoveProxy
+};
+
+template<typename Callback>
+void DynamicAabbTree::QueryOverlap(const XNA::AxisAlignedBox &box, Callback &callback) const
+{
+	if(m_root == NullNode)
+		return;
+
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = m_root;
+	while(top > 0)
+	{
+		int index = stack[--top];
+		const Node &node = m_nodes[index];
+		if(!XNA::IntersectAxisAlignedBoxAxisAlignedBox(&node.box,&box))
+			continue;
+
+		if(node.child1 == NullNode)
+		{
+			if(!callback(index))
+				return;
+		}
+		else
+		{
+			XMASSERT(top + 2 <= StackSize);
+			stack[top++] = node.child1;
+			stack[top++] = node.child2;
+		}
+	}
+}
+
+template<typename Callback>
+bool DynamicAabbTree::ReportSubtree(int root, Callback &callback) const
+{
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = root;
+	while(top > 0)
+	{
+		int index = stack[--top];
+		const Node &node = m_nodes[index];
+		if(node.child1 == NullNode)
+		{
+			if(!callback(index))
+				return false;
+		}
+		else
+		{
+			XMASSERT(top + 2 <= StackSize);
+			stack[top++] = node.child1;
+			stack[top++] = node.child2;
+		}
+	}
+
+	return true;
+}
+
+template<typename Callback>
+void DynamicAabbTree::QueryFrustum(const XNA::Frustum &frustum, Callback &callback) const
+{
+	if(m_root == NullNode)
+		return;
+
+	XMVECTOR planes[6];
+	XNA::ComputePlanesFromFrustum(&frustum,&planes[0],&planes[1],&planes[2],&planes[3],&planes[4],&planes[5]);
+
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = m_root;
+	while(top > 0)
+	{
+		int index = stack[--top];
+		const Node &node = m_nodes[index];
+		INT result = XNA::IntersectAxisAlignedBox6Planes(&node.box,planes[0],planes[1],planes[2],planes[3],planes[4],planes[5]);
+		if(result == 0)
+			continue;
+
+		if(result == 2)
+		{
+			//Fully inside: everything below is visible
+			if(!ReportSubtree(index,callback))
+				return;
+		}
+		else if(node.child1 == NullNode)
+		{
+			if(!callback(index))
+				return;
+		}
+		else
+		{
+			XMASSERT(top + 2 <= StackSize);
+			stack[top++] = node.child1;
+			stack[top++] = node.child2;
+		}
+	}
+}
+
+template<typename Callback>
+void DynamicAabbTree::RayCast(FXMVECTOR origin, FXMVECTOR direction, float maxDist, Callback &callback) const
+{
+	if(m_root == NullNode)
+		return;
+
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = m_root;
+	while(top > 0)
+	{
+		int index = stack[--top];
+		const Node &node = m_nodes[index];
+
+		//Negative when the origin is inside the box
+		float dist;
+		if(!XNA::IntersectRayAxisAlignedBox(origin,direction,&node.box,&dist) || dist > maxDist)
+			continue;
+
+		if(node.child1 == NullNode)
+		{
+			float value = callback(index,maxDist);
+			if(value == 0.f)
+				return;
+			maxDist = min(maxDist,value);
+		}
+		else
+		{
+			XMASSERT(top + 2 <= StackSize);
+			stack[top++] = node.child1;
+			stack[top++] = node.child2;
+		}
+	}
+}
+
+#endif	//_DYNAMIC_AABB_TREE_H_
@@ -0,0 +1,297 @@
+#include "FrameGraph.h"
+#include <algorithm>
+
+FrameGraph::FrameGraph():m_nPasses(0),
+	m_nResources(0),
+	m_nTransient(0)
+{
+}
+
+void FrameGraph::Reset()
+{
+	//Clear instead of shrinking, so the per pass arrays are not reallocated every frame
+	for(UINT i=0; i<m_nPasses; ++i)
+	{
+		Pass &pass = m_passes[i];
+		pass.func = PassFunc();
+		pass.reads.clear();
+		pass.writes.clear();
+		pass.inputs.clear();
+		pass.after.clear();
+	}
+	for(UINT i=0; i<m_nResources; ++i)
+		m_resources[i].readers.clear();
+	m_nPasses = 0;
+	m_nResources = 0;
+	m_order.clear();
+	m_groupStart.clear();
+	m_physical.clear();
+	m_nTransient = 0;
+}
+
+int FrameGraph::AddResource(const char *name, const RenderTargetPool::Desc &desc)
+{
+	if(m_nResources == m_resources.size())
+		m_resources.push_back(Resource());
+
+	Resource &resource = m_resources[m_nResources];
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = false;
+	resource.output = false;
+	resource.target = -1;
+	resource.physical = -1;
+	return m_nResources++;
+}
+
+int FrameGraph::ImportResource(const char *name, int target, bool output)
+{
+	RenderTargetPool::Desc desc = { 0 };
+	int resource = AddResource(name,desc);
+	m_resources[resource].imported = true;
+	m_resources[resource].output = output;
+	m_resources[resource].target = target;
+	return resource;
+}
+
+int FrameGraph::AddPass(const char *name, const PassFunc &func)
+{
+	if(m_nPasses == m_passes.size())
+		m_passes.push_back(Pass());
+
+	Pass &pass = m_passes[m_nPasses];
+	pass.name = name;
+	pass.func = func;
+	pass.sideEffect = false;
+	pass.alive = false;
+	pass.group = 0;
+	return m_nPasses++;
+}
+
+void FrameGraph::Read(int pass, int resource)
+{
+	AddUnique(m_passes[pass].reads,resource);
+}
+
+void FrameGraph::Write(int pass, int resource)
+{
+	AddUnique(m_passes[pass].writes,resource);
+}
+
+void FrameGraph::AddUnique(std::vector<int> &items, int item)
+{
+	if(std::find(items.begin(),items.end(),item) == items.end())
+		items.push_back(item);
+}
+
+int FrameGraph::GetTarget(int resource) const
+{
+	const Resource &r = m_resources[resource];
+	if(r.imported)
+		return r.target;
+	return r.physical >= 0 ? m_physical[r.physical].target : -1;
+}
+
+void FrameGraph::Compile()
+{
+	//Dependencies in declaration order. The reads of a pass come before its writes, so a pass that reads and
+	//writes a resource follows its previous writer, not itself.
+	for(UINT r=0; r<m_nResources; ++r)
+	{
+		m_resources[r].lastWriter = -1;
+		m_resources[r].readers.clear();
+		m_resources[r].first = m_resources[r].last = -1;
+		m_resources[r].physical = -1;
+	}
+	for(UINT p=0; p<m_nPasses; ++p)
+	{
+		Pass &pass = m_passes[p];
+		for(UINT i=0; i<pass.reads.size(); ++i)
+		{
+			Resource &resource = m_resources[pass.reads[i]];
+			if(resource.lastWriter >= 0)
+			{
+				AddUnique(pass.inputs,resource.lastWriter);
+				AddUnique(pass.after,resource.lastWriter);
+			}
+			resource.readers.push_back(p);
+		}
+		for(UINT i=0; i<pass.writes.size(); ++i)
+		{
+			Resource &resource = m_resources[pass.writes[i]];
+			if(resource.lastWriter >= 0)
+				AddUnique(pass.after,resource.lastWriter);
+			for(UINT j=0; j<resource.readers.size(); ++j)
+			{
+				if(resource.readers[j] != (int)p)
+					AddUnique(pass.after,resource.readers[j]);
+			}
+			resource.readers.clear();
+			resource.lastWriter = p;
+		}
+	}
+
+	//Culling: only data flows keep a pass alive. The dependencies point to earlier passes,
+	//so one walk from the last pass reaches every producer.
+	for(UINT p=0; p<m_nPasses; ++p)
+	{
+		Pass &pass = m_passes[p];
+		pass.alive = pass.sideEffect;
+		for(UINT i=0; i<pass.writes.size() && !pass.alive; ++i)
+			pass.alive = m_resources[pass.writes[i]].output;
+	}
+	for(int p=m_nPasses-1; p>=0; --p)
+	{
+		const Pass &pass = m_passes[p];
+		if(!pass.alive)
+			continue;
+		for(UINT i=0; i<pass.inputs.size(); ++i)
+			m_passes[pass.inputs[i]].alive = true;
+	}
+
+	//Groups: one after the latest group among the live passes it waits for
+	UINT nGroups = 0;
+	m_groupCount.clear();
+	for(UINT p=0; p<m_nPasses; ++p)
+	{
+		Pass &pass = m_passes[p];
+		if(!pass.alive)
+			continue;
+		UINT group = 0;
+		for(UINT i=0; i<pass.after.size(); ++i)
+		{
+			const Pass &before = m_passes[pass.after[i]];
+			if(before.alive)
+				group = max(group,before.group + 1);
+		}
+		pass.group = group;
+		nGroups = max(nGroups,group + 1);
+		if(m_groupCount.size() < nGroups)
+			m_groupCount.resize(nGroups,0);
+		++m_groupCount[group];
+	}
+
+	//Counting sort by group, stable so a group keeps the declaration order
+	m_groupStart.assign(nGroups + 1,0);
+	for(UINT g=0; g<nGroups; ++g)
+		m_groupStart[g + 1] = m_groupStart[g] + m_groupCount[g];
+	m_order.resize(m_groupStart[nGroups]);
+	for(UINT g=0; g<nGroups; ++g)
+		m_groupCount[g] = m_groupStart[g];
+	for(UINT p=0; p<m_nPasses; ++p)
+	{
+		if(m_passes[p].alive)
+			m_order[m_groupCount[m_passes[p].group]++] = p;
+	}
+
+	//Lifetimes in groups: the passes of a group may run concurrently, so a target is busy for whole groups
+	for(UINT p=0; p<m_nPasses; ++p)
+	{
+		const Pass &pass = m_passes[p];
+		if(!pass.alive)
+			continue;
+		for(UINT k=0; k<2; ++k)
+		{
+			const std::vector<int> &used = k ? pass.writes : pass.reads;
+			for(UINT i=0; i<used.size(); ++i)
+			{
+				Resource &resource = m_resources[used[i]];
+				int group = pass.group;
+				resource.first = resource.first < 0 ? group : min(resource.first,group);
+				resource.last = max(resource.last,group);
+			}
+		}
+	}
+
+	//Aliasing: by first group, each transient resource takes a target of its descriptor that is free by then
+	m_sorted.clear();
+	for(UINT r=0; r<m_nResources; ++r)
+	{
+		if(!m_resources[r].imported && m_resources[r].first >= 0)
+			m_sorted.push_back(r);
+	}
+	m_nTransient = m_sorted.size();
+	const std::vector<Resource> &resources = m_resources;
+	std::stable_sort(m_sorted.begin(),m_sorted.end(),[&](int a, int b) -> bool
+	{
+		return resources[a].first < resources[b].first;
+	});
+
+	m_physical.clear();
+	for(UINT i=0; i<m_sorted.size(); ++i)
+	{
+		Resource &resource = m_resources[m_sorted[i]];
+		int physical = -1;
+		for(UINT j=0; j<m_physical.size() && physical < 0; ++j)
+		{
+			if(m_physical[j].last < resource.first && m_physical[j].desc == resource.desc)
+				physical = j;
+		}
+		if(physical < 0)
+		{
+			Physical target = { resource.desc, resource.first, resource.last, -1 };
+			physical = m_physical.size();
+			m_physical.push_back(target);
+		}
+		else
+			m_physical[physical].last = resource.last;
+		resource.physical = physical;
+	}
+}
+
+bool FrameGraph::Execute(RenderTargetPool &pool, ID3D11DeviceContext *context)
+{
+	bool created = true;
+	for(UINT g=0; g<GetGroupCount(); ++g)
+	{
+		for(UINT i=0; i<m_physical.size(); ++i)
+		{
+			if(m_physical[i].first == (int)g)
+			{
+				m_physical[i].target = pool.Acquire(m_physical[i].desc);
+				created = created && m_physical[i].target >= 0;
+			}
+		}
+		if(!created)
+			break;
+
+		for(UINT i=m_groupStart[g]; i<m_groupStart[g + 1]; ++i)
+			ExecutePass(m_order[i],context);
+
+		for(UINT i=0; i<m_physical.size(); ++i)
+		{
+			if(m_physical[i].last == (int)g)
+			{
+				pool.Release(m_physical[i].target);
+				m_physical[i].target = -1;
+			}
+		}
+	}
+
+	//After a failure, give back what is still held
+	ReleaseTargets(pool);
+	return created;
+}
+
+bool FrameGraph::AcquireTargets(RenderTargetPool &pool)
+{
+	for(UINT i=0; i<m_physical.size(); ++i)
+	{
+		m_physical[i].target = pool.Acquire(m_physical[i].desc);
+		if(m_physical[i].target < 0)
+		{
+			ReleaseTargets(pool);
+			return false;
+		}
+	}
+	return true;
+}
+
+void FrameGraph::ReleaseTargets(RenderTargetPool &pool)
+{
+	for(UINT i=0; i<m_physical.size(); ++i)
+	{
+		pool.Release(m_physical[i].target);
+		m_physical[i].target = -1;
+	}
+}
@@ -0,0 +1,127 @@
+#ifndef _FRAME_GRAPH_H_
+#define _FRAME_GRAPH_H_
+
+#include <Windows.h>
+#include <D3D11.h>
+#include <vector>
+#include <functional>
+#include "RenderTargetPool.h"
+
+//The passes of a frame and the resources they read and write, rebuilt every frame.
+//
+//Passes are declared in submission order. Compile then, on the CPU only:
+// - orders them: a pass runs after the last writer of what it reads or writes, and after the readers of what it overwrites;
+// - culls the passes whose outputs nobody uses, walking back from the outputs and the passes with side effects;
+// - groups them in levels: the passes of a group do not depend on each other, so they may be recorded in parallel;
+// - computes the lifetime of each transient resource in groups, and lets resources with the same descriptor whose
+//   lifetimes do not overlap share one target from the pool.
+//Execute acquires the targets before the first group using them, runs the passes and releases the targets after
+//their last group.
+class FrameGraph
+{
+public:
+	typedef std::function<void(ID3D11DeviceContext*)> PassFunc;
+
+	FrameGraph();
+
+	//Drop the passes and resources of the last frame. The arrays keep their capacity.
+	void Reset();
+
+	//A target created by the graph when a live pass uses it. 'name' is a static string, for debugging.
+	int AddResource(const char *name, const RenderTargetPool::Desc &desc);
+	//A resource owned outside the graph(back buffer, a cube map held across frames), with its pool target if any.
+	//Writing an output keeps a pass alive.
+	int ImportResource(const char *name, int target = -1, bool output = false);
+
+	int		AddPass(const char *name, const PassFunc &func);
+	void	Read(int pass, int resource);
+	void	Write(int pass, int resource);
+	//Never culled(e.g. Present, queries)
+	void	SetSideEffect(int pass)		{ m_passes[pass].sideEffect = true; }
+
+	void Compile();
+	//Run the live passes group by group on 'context'. Return false when a target could not be created.
+	bool Execute(RenderTargetPool &pool, ID3D11DeviceContext *context);
+	//To record all the live passes at once instead(e.g. on deferred contexts, submitted later in execution order):
+	//acquire every target before, release them once the commands are submitted
+	bool AcquireTargets(RenderTargetPool &pool);
+	void ReleaseTargets(RenderTargetPool &pool);
+
+	//Pool target of a resource, valid while its passes run
+	int GetTarget(int resource) const;
+
+	//After Compile: passes in execution order, group g being m_order[GetGroupStart(g), GetGroupStart(g + 1))
+	bool		IsCulled(int pass)			const	{ return !m_passes[pass].alive; }
+	UINT		GetGroupCount()				const	{ return m_groupStart.empty() ? 0 : m_groupStart.size() - 1; }
+	UINT		GetGroupStart(UINT group)	const	{ return m_groupStart[group]; }
+	int			GetOrderedPass(UINT i)		const	{ return m_order[i]; }
+	const char*	GetPassName(int pass)		const	{ return m_passes[pass].name; }
+	//Group of a live pass
+	UINT		GetGroup(int pass)			const	{ return m_passes[pass].group; }
+	//Execute the live passes of one group, in any order or concurrently, once its targets are acquired
+	void		ExecutePass(int pass, ID3D11DeviceContext *context) const	{ m_passes[pass].func(context); }
+
+	UINT GetPassCount()			const	{ return m_nPasses; }
+	UINT GetLivePassCount()		const	{ return m_order.size(); }
+	UINT GetResourceCount()		const	{ return m_nResources; }
+	//Transient resources used by live passes, and the targets they need after aliasing
+	UINT GetTransientCount()	const	{ return m_nTransient; }
+	UINT GetPhysicalCount()		const	{ return m_physical.size(); }
+
+private:
+	struct Pass
+	{
+		const char			*name;
+		PassFunc			func;
+		std::vector<int>	reads;
+		std::vector<int>	writes;
+		std::vector<int>	inputs;			//Last writers of the reads: the passes whose data is used
+		std::vector<int>	after;			//Every pass that must run before, inputs included
+		bool				sideEffect;
+		bool				alive;
+		UINT				group;
+	};
+
+	struct Resource
+	{
+		const char				*name;
+		RenderTargetPool::Desc	desc;
+		bool					imported;
+		bool					output;
+		int						target;			//Imported: the pool target given, transient: unused
+		int						lastWriter;		//While compiling
+		std::vector<int>		readers;		//Since the last write, while compiling
+		int						first;			//First and last group using it, -1 when unused
+		int						last;
+		int						physical;		//Shared target of a transient resource
+	};
+
+	struct Physical
+	{
+		RenderTargetPool::Desc	desc;
+		int						first;
+		int						last;
+		int						target;			//While executing
+	};
+
+	static void AddUnique(std::vector<int> &passes, int pass);
+
+	FrameGraph(const FrameGraph&);
+	FrameGraph& operator=(const FrameGraph&);
+
+private:
+	std::vector<Pass>		m_passes;			//The first m_nPasses are used
+	UINT					m_nPasses;
+	std::vector<Resource>	m_resources;
+	UINT					m_nResources;
+
+	std::vector<int>		m_order;			//Live passes by group, in declaration order within a group
+	std::vector<UINT>		m_groupStart;
+	std::vector<Physical>	m_physical;
+	UINT					m_nTransient;
+
+	std::vector<int>		m_sorted;			//Scratch: transient resources by first group
+	std::vector<UINT>		m_groupCount;
+};
+
+#endif	//_FRAME_GRAPH_H_
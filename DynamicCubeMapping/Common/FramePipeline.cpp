@@ -0,0 +1,148 @@
+#include "FramePipeline.h"
+
+FramePipeline::FramePipeline():m_thread(NULL),
+	m_submitted(0),
+	m_drawnCount(0),
+	m_secsPerCount(0.f)
+{
+	m_filled.head = m_filled.tail = 0;
+	m_drawn.head = m_drawn.tail = 0;
+	m_filled.pushed = CreateEvent(NULL,FALSE,FALSE,NULL);
+	m_drawn.pushed = CreateEvent(NULL,FALSE,FALSE,NULL);
+
+	__int64 countsPerSec(0);
+	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+	if(countsPerSec)
+		m_secsPerCount = 1.f / countsPerSec;
+	ResetStats();
+}
+
+FramePipeline::~FramePipeline()
+{
+	Stop();
+	CloseHandle(m_filled.pushed);
+	CloseHandle(m_drawn.pushed);
+}
+
+bool FramePipeline::Start(const RenderFunc &render, const ThreadFunc &begin, const ThreadFunc &end)
+{
+	Stop();
+	if(!m_filled.pushed || !m_drawn.pushed)
+		return false;
+
+	m_render = render;
+	m_begin = begin;
+	m_end = end;
+	//Every packet starts free
+	m_filled.head = m_filled.tail = 0;
+	m_drawn.head = m_drawn.tail = 0;
+	m_submitted = 0;
+	m_drawnCount = 0;
+	for(UINT i=0; i<PacketCount; ++i)
+		Push(m_drawn,i);
+
+	m_thread = CreateThread(NULL,0,ThreadMain,this,0,NULL);
+	if(!m_thread)
+	{
+		MessageBox(NULL,L"Create render thread failed!",L"Error",MB_OK);
+		return false;
+	}
+	return true;
+}
+
+void FramePipeline::Stop()
+{
+	if(!m_thread)
+		return;
+
+	Push(m_filled,StopPacket);
+	WaitForSingleObject(m_thread,INFINITE);
+	CloseHandle(m_thread);
+	m_thread = NULL;
+}
+
+DWORD WINAPI FramePipeline::ThreadMain(LPVOID param)
+{
+	FramePipeline &pipeline = *static_cast<FramePipeline*>(param);
+	if(pipeline.m_begin)
+		pipeline.m_begin();
+
+	for(;;)
+	{
+		UINT packet = Pop(pipeline.m_filled);
+		if(packet == StopPacket)
+			break;
+
+		pipeline.m_render(packet);
+
+		pipeline.m_totalLatencyMs += (pipeline.Now() - pipeline.m_beginTimes[packet]) * pipeline.m_secsPerCount * 1000.f;
+		InterlockedIncrement(&pipeline.m_frames);
+		//Counted before the push sets the event Flush waits on
+		InterlockedIncrement(&pipeline.m_drawnCount);
+		Push(pipeline.m_drawn,packet);
+	}
+
+	if(pipeline.m_end)
+		pipeline.m_end();
+	return 0;
+}
+
+UINT FramePipeline::BeginPacket()
+{
+	__int64 begin = Now();
+	UINT packet = Pop(m_drawn);
+	m_beginTimes[packet] = Now();
+
+	m_totalWaitMs += (m_beginTimes[packet] - begin) * m_secsPerCount * 1000.f;
+	++m_begins;
+	return packet;
+}
+
+void FramePipeline::SubmitPacket(UINT packet)
+{
+	++m_submitted;
+	Push(m_filled,packet);
+}
+
+void FramePipeline::Flush()
+{
+	//Counts the frames, not the free packets: the caller may hold one from BeginPacket(e.g. in Update)
+	while(m_thread && m_drawnCount != m_submitted)
+		WaitForSingleObject(m_drawn.pushed,INFINITE);
+}
+
+void FramePipeline::Push(Ring &ring, UINT item)
+{
+	//Never full: there are fewer packets than slots
+	LONG tail = ring.tail;
+	ring.items[tail & (RingSize - 1)] = item;
+	InterlockedExchange(&ring.tail,tail + 1);
+	SetEvent(ring.pushed);
+}
+
+UINT FramePipeline::Pop(Ring &ring)
+{
+	//An item pushed after the test sets the event, so the wait cannot miss it
+	LONG head = ring.head;
+	while(ring.tail == head)
+		WaitForSingleObject(ring.pushed,INFINITE);
+
+	UINT item = ring.items[head & (RingSize - 1)];
+	InterlockedExchange(&ring.head,head + 1);
+	return item;
+}
+
+__int64 FramePipeline::Now() const
+{
+	__int64 count(0);
+	QueryPerformanceCounter((LARGE_INTEGER*)&count);
+	return count;
+}
+
+void FramePipeline::ResetStats()
+{
+	m_totalLatencyMs = 0.f;
+	m_frames = 0;
+	m_totalWaitMs = 0.f;
+	m_begins = 0;
+}
@@ -0,0 +1,87 @@
+#ifndef _FRAME_PIPELINE_H_
+#define _FRAME_PIPELINE_H_
+
+#include <Windows.h>
+#include <functional>
+
+//Two stage frame pipeline: while a render thread draws frame N from its packet, the thread that submitted it fills
+//the packet of frame N + 1. A packet holds everything the render stage reads(camera, transforms, lights...), and
+//nothing writes it while it is drawn.
+//
+//The packets go round through two single producer, single consumer rings: the filled ones to the render thread, the
+//drawn ones back. With two packets the submitting thread is at most one frame ahead.
+class FramePipeline
+{
+public:
+	enum { PacketCount = 2 };
+
+	typedef std::function<void(UINT packet)>	RenderFunc;
+	typedef std::function<void()>				ThreadFunc;
+
+	FramePipeline();
+	~FramePipeline();
+
+	//Start the render thread: begin() runs first on it, then render(packet) for each packet submitted, then end()
+	bool Start(const RenderFunc &render, const ThreadFunc &begin = ThreadFunc(), const ThreadFunc &end = ThreadFunc());
+	//Draw the packets submitted, then stop the thread
+	void Stop();
+	bool IsRunning()	const	{ return m_thread != NULL; }
+
+	//Packet to fill next, once the render thread gave one back
+	UINT BeginPacket();
+	void SubmitPacket(UINT packet);
+	//Wait until the packets submitted are drawn: the render thread is idle until the next SubmitPacket, so the
+	//device context and the swap chain may be used(e.g. to resize). May be called between BeginPacket and
+	//SubmitPacket.
+	void Flush();
+
+	//Averages since ResetStats(milliseconds): from BeginPacket to the end of the packet's render, and the time
+	//BeginPacket waited for the render thread
+	float GetAverageLatencyMs()	const	{ return m_frames ? m_totalLatencyMs / m_frames : 0.f; }
+	float GetAverageWaitMs()	const	{ return m_begins ? m_totalWaitMs / m_begins : 0.f; }
+	void ResetStats();
+
+private:
+	enum { RingSize = 4, StopPacket = 0xffffffff };
+
+	//Single producer, single consumer: each index is written by one side only
+	struct Ring
+	{
+		UINT			items[RingSize];
+		volatile LONG	head;			//Consumer
+		volatile LONG	tail;			//Producer
+		HANDLE			pushed;			//Auto reset, set on each push
+	};
+
+	static DWORD WINAPI ThreadMain(LPVOID param);
+
+	static void Push(Ring &ring, UINT item);
+	//Wait for an item
+	static UINT Pop(Ring &ring);
+	__int64 Now() const;
+
+	FramePipeline(const FramePipeline&);
+	FramePipeline& operator=(const FramePipeline&);
+
+private:
+	HANDLE		m_thread;
+	RenderFunc	m_render;
+	ThreadFunc	m_begin;
+	ThreadFunc	m_end;
+
+	Ring		m_filled;				//To the render thread
+	Ring		m_drawn;				//Back
+	LONG			m_submitted;		//Frames submitted, on the submitting thread
+	volatile LONG	m_drawnCount;		//Frames drawn
+
+	__int64		m_beginTimes[PacketCount];
+
+	//The latencies are added on the render thread, read on the other one: the averages may be a frame late
+	float			m_secsPerCount;
+	float			m_totalLatencyMs;
+	volatile LONG	m_frames;
+	float			m_totalWaitMs;
+	UINT			m_begins;
+};
+
+#endif	//_FRAME_PIPELINE_H_
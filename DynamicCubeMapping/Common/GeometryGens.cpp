@@ -1,166 +1,31 @@
 #include "GeometryGens.h"
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
 
 namespace GeoGen
 {
 	void CreateBox(float width, float height, float depth, MeshData &mesh)
 	{
-		mesh.vertices.clear();
-		mesh.indices.clear();
+		//The unit box table already holds all 24 vertices and 36 indices
+		CreateFromStatic(UnitBox(),width,height,depth,mesh);
+	}
 
-		//24 vertices
-		mesh.vertices.resize(24);
-		//36 indices
-		mesh.indices.resize(36);
-
-		float halfW = width * 0.5f;
-		float halfH = height * 0.5f;
-		float halfD = depth * 0.5f;
-
-		//front
-		mesh.vertices[0].pos = XMFLOAT3(-halfW,-halfH,-halfD);
-		mesh.vertices[0].normal = XMFLOAT3(0.f,0.f,-1.f);
-		mesh.vertices[0].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[0].tex = XMFLOAT2(0.f,1.f);
-		mesh.vertices[1].pos = XMFLOAT3(-halfW,halfH,-halfD);
-		mesh.vertices[1].normal = XMFLOAT3(0.f,0.f,-1.f);
-		mesh.vertices[1].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[1].tex = XMFLOAT2(0.f,0.f);
-		mesh.vertices[2].pos = XMFLOAT3(halfW,halfH,-halfD);
-		mesh.vertices[2].normal = XMFLOAT3(0.f,0.f,-1.f);
-		mesh.vertices[2].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[2].tex = XMFLOAT2(1.f,0.f);
-		mesh.vertices[3].pos = XMFLOAT3(halfW,-halfH,-halfD);
-		mesh.vertices[3].normal = XMFLOAT3(0.f,0.f,-1.f);
-		mesh.vertices[3].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[3].tex = XMFLOAT2(1.f,1.f);
-		//left
-		mesh.vertices[4].pos = XMFLOAT3(-halfW,-halfH,halfD);
-		mesh.vertices[4].normal = XMFLOAT3(-1.f,0.f,0.f);
-		mesh.vertices[4].tangent = XMFLOAT3(0.f,0.f,-1.f);
-		mesh.vertices[4].tex = XMFLOAT2(0.f,1.f);
-		mesh.vertices[5].pos = XMFLOAT3(-halfW,halfH,halfD);
-		mesh.vertices[5].normal = XMFLOAT3(-1.f,0.f,0.f);
-		mesh.vertices[5].tangent = XMFLOAT3(0.f,0.f,-1.f);
-		mesh.vertices[5].tex = XMFLOAT2(0.f,0.f);
-		mesh.vertices[6].pos = XMFLOAT3(-halfW,halfH,-halfD);
-		mesh.vertices[6].normal = XMFLOAT3(-1.f,0.f,0.f);
-		mesh.vertices[6].tangent = XMFLOAT3(0.f,0.f,-1.f);
-		mesh.vertices[6].tex = XMFLOAT2(1.f,0.f);
-		mesh.vertices[7].pos = XMFLOAT3(-halfW,-halfH,-halfD);
-		mesh.vertices[7].normal = XMFLOAT3(-1.f,0.f,0.f);
-		mesh.vertices[7].tangent = XMFLOAT3(0.f,0.f,-1.f);
-		mesh.vertices[7].tex = XMFLOAT2(1.f,1.f);
-		//back
-		mesh.vertices[8].pos = XMFLOAT3(halfW,-halfH,halfD);
-		mesh.vertices[8].normal = XMFLOAT3(0.f,0.f,1.f);
-		mesh.vertices[8].tangent = XMFLOAT3(-1.f,0.f,0.f);
-		mesh.vertices[8].tex = XMFLOAT2(0.f,1.f);
-		mesh.vertices[9].pos = XMFLOAT3(halfW,halfH,halfD);
-		mesh.vertices[9].normal = XMFLOAT3(0.f,0.f,1.f);
-		mesh.vertices[9].tangent = XMFLOAT3(-1.f,0.f,0.f);
-		mesh.vertices[9].tex = XMFLOAT2(0.f,0.f);
-		mesh.vertices[10].pos = XMFLOAT3(-halfW,halfH,halfD);
-		mesh.vertices[10].normal = XMFLOAT3(0.f,0.f,1.f);
-		mesh.vertices[10].tangent = XMFLOAT3(-1.f,0.f,0.f);
-		mesh.vertices[10].tex = XMFLOAT2(1.f,0.f);
-		mesh.vertices[11].pos = XMFLOAT3(-halfW,-halfH,halfD);
-		mesh.vertices[11].normal = XMFLOAT3(0.f,0.f,1.f);
-		mesh.vertices[11].tangent = XMFLOAT3(-1.f,0.f,0.f);
-		mesh.vertices[11].tex = XMFLOAT2(1.f,1.f);
-		//right
-		mesh.vertices[12].pos = XMFLOAT3(halfW,-halfH,-halfD);
-		mesh.vertices[12].normal = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[12].tangent = XMFLOAT3(0.f,0.f,1.f);
-		mesh.vertices[12].tex = XMFLOAT2(0.f,1.f);
-		mesh.vertices[13].pos = XMFLOAT3(halfW,halfH,-halfD);
-		mesh.vertices[13].normal = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[13].tangent = XMFLOAT3(0.f,0.f,1.f);
-		mesh.vertices[13].tex = XMFLOAT2(0.f,0.f);
-		mesh.vertices[14].pos = XMFLOAT3(halfW,halfH,halfD);
-		mesh.vertices[14].normal = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[14].tangent = XMFLOAT3(0.f,0.f,1.f);
-		mesh.vertices[14].tex = XMFLOAT2(1.f,0.f);
-		mesh.vertices[15].pos = XMFLOAT3(halfW,-halfH,halfD);
-		mesh.vertices[15].normal = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[15].tangent = XMFLOAT3(0.f,0.f,1.f);
-		mesh.vertices[15].tex = XMFLOAT2(1.f,1.f);
-		//top
-		mesh.vertices[16].pos = XMFLOAT3(-halfW,halfH,-halfD);
-		mesh.vertices[16].normal = XMFLOAT3(0.f,1.f,0.f);
-		mesh.vertices[16].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[16].tex = XMFLOAT2(0.f,1.f);
-		mesh.vertices[17].pos = XMFLOAT3(-halfW,halfH,halfD);
-		mesh.vertices[17].normal = XMFLOAT3(0.f,1.f,0.f);
-		mesh.vertices[17].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[17].tex = XMFLOAT2(0.f,0.f);
-		mesh.vertices[18].pos = XMFLOAT3(halfW,halfH,halfD);
-		mesh.vertices[18].normal = XMFLOAT3(0.f,1.f,0.f);
-		mesh.vertices[18].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[18].tex = XMFLOAT2(1.f,0.f);
-		mesh.vertices[19].pos = XMFLOAT3(halfW,halfH,-halfD);
-		mesh.vertices[19].normal = XMFLOAT3(0.f,1.f,0.f);
-		mesh.vertices[19].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[19].tex = XMFLOAT2(1.f,1.f);
-		//bottom
-		mesh.vertices[20].pos = XMFLOAT3(-halfW,-halfH,halfD);
-		mesh.vertices[20].normal = XMFLOAT3(0.f,-1.f,0.f);
-		mesh.vertices[20].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[20].tex = XMFLOAT2(0.f,1.f);
-		mesh.vertices[21].pos = XMFLOAT3(-halfW,-halfH,-halfD);
-		mesh.vertices[21].normal = XMFLOAT3(0.f,-1.f,0.f);
-		mesh.vertices[21].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[21].tex = XMFLOAT2(0.f,0.f);
-		mesh.vertices[22].pos = XMFLOAT3(halfW,-halfH,-halfD);
-		mesh.vertices[22].normal = XMFLOAT3(0.f,-1.f,0.f);
-		mesh.vertices[22].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[22].tex = XMFLOAT2(1.f,0.f);
-		mesh.vertices[23].pos = XMFLOAT3(halfW,-halfH,halfD);
-		mesh.vertices[23].normal = XMFLOAT3(0.f,-1.f,0.f);
-		mesh.vertices[23].tangent = XMFLOAT3(1.f,0.f,0.f);
-		mesh.vertices[23].tex = XMFLOAT2(1.f,1.f);
-		
-		//Construct index
-		mesh.indices[0] = 0;
-		mesh.indices[1] = 1;
-		mesh.indices[2] = 2;
-		mesh.indices[3] = 0;
-		mesh.indices[4] = 2;
-		mesh.indices[5] = 3;
-		
-		mesh.indices[6] = 4;
-		mesh.indices[7] = 5;
-		mesh.indices[8] = 6;
-		mesh.indices[9] = 4;
-		mesh.indices[10] = 6;
-		mesh.indices[11] = 7;
-		
-		mesh.indices[12] = 8;
-		mesh.indices[13] = 9;
-		mesh.indices[14] = 10;
-		mesh.indices[15] = 8;
-		mesh.indices[16] = 10;
-		mesh.indices[17] = 11;
-		
-		mesh.indices[18] = 12;
-		mesh.indices[19] = 13;
-		mesh.indices[20] = 14;
-		mesh.indices[21] = 12;
-		mesh.indices[22] = 14;
-		mesh.indices[23] = 15;
-		
-		mesh.indices[24] = 16;
-		mesh.indices[25] = 17;
-		mesh.indices[26] = 18;
-		mesh.indices[27] = 16;
-		mesh.indices[28] = 18;
-		mesh.indices[29] = 19;
-		
-		mesh.indices[30] = 20;
-		mesh.indices[31] = 21;
-		mesh.indices[32] = 22;
-		mesh.indices[33] = 20;
-		mesh.indices[34] = 22;
-		mesh.indices[35] = 23;
+	void CreateFromStatic(const StaticMesh &src, float sx, float sy, float sz, MeshData &mesh)
+	{
+		mesh.vertices.resize(src.nVertices);
+		mesh.indices.assign(src.indices,src.indices + src.nIndices);
+
+		memcpy(&mesh.vertices[0],src.vertices,sizeof(StaticVertex) * src.nVertices);
+		if(sx == 1.f && sy == 1.f && sz == 1.f)
+			return;
+
+		for(UINT i=0; i<src.nVertices; ++i)
+		{
+			mesh.vertices[i].pos.x *= sx;
+			mesh.vertices[i].pos.y *= sy;
+			mesh.vertices[i].pos.z *= sz;
+		}
 	}
 
 	void CreateGrid(float width, float height, UINT m, UINT n, MeshData &mesh)
@@ -437,4 +302,217 @@ namespace GeoGen
 			}
 		}
 	}
+
+	//Unit geodesic sphere of one subdivision level
+	struct GeoSphereLevel
+	{
+		std::vector<XMFLOAT3>	positions;		//Shared vertices, used to build the next level
+		std::vector<UINT>		indices;
+		MeshData				unitMesh;		//Final vertices with uv seams split, built on first request
+	};
+
+	//Cached levels, level i is the icosahedron subdivided i times. Built before main, so the lock exists before any
+	//thread may call CreateGeoSphere.
+	static struct GeoSphereCache
+	{
+		CRITICAL_SECTION				lock;
+		std::vector<GeoSphereLevel>		levels;
+
+		GeoSphereCache()	{ InitializeCriticalSection(&lock); }
+		~GeoSphereCache()	{ DeleteCriticalSection(&lock); }
+	} g_geoSphereCache;
+
+	static void BuildIcosahedron(GeoSphereLevel &level)
+	{
+		//One vertex on each pole, two rings of 5 vertices at latitude +-atan(1/2)
+		const float ringY = 1.f / sqrtf(5.f);
+		const float ringR = 2.f / sqrtf(5.f);
+
+		level.positions.resize(12);
+		level.positions[0] = XMFLOAT3(0.f,1.f,0.f);
+		for(UINT i=0; i<5; ++i)
+		{
+			float upper = XM_2PI * i / 5.f;
+			float lower = upper + XM_PI / 5.f;
+			level.positions[1+i] = XMFLOAT3(ringR*cosf(upper),ringY,ringR*sinf(upper));
+			level.positions[6+i] = XMFLOAT3(ringR*cosf(lower),-ringY,ringR*sinf(lower));
+		}
+		level.positions[11] = XMFLOAT3(0.f,-1.f,0.f);
+
+		level.indices.clear();
+		for(UINT i=0; i<5; ++i)
+		{
+			UINT u0 = 1 + i, u1 = 1 + (i + 1) % 5;
+			UINT l0 = 6 + i, l1 = 6 + (i + 1) % 5;
+
+			UINT tris[12] = { 0,u1,u0,  u0,u1,l0,  l0,u1,l1,  11,l0,l1 };
+			level.indices.insert(level.indices.end(),tris,tris + 12);
+		}
+
+		//Same winding as CreateSphere: (v1-v0)x(v2-v0) points outwards
+		for(UINT i=0; i<level.indices.size(); i+=3)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&level.positions[level.indices[i]]);
+			XMVECTOR v1 = XMLoadFloat3(&level.positions[level.indices[i+1]]);
+			XMVECTOR v2 = XMLoadFloat3(&level.positions[level.indices[i+2]]);
+			XMVECTOR N = XMVector3Cross(v1 - v0,v2 - v0);
+			if(XMVectorGetX(XMVector3Dot(N,v0 + v1 + v2)) < 0.f)
+				std::swap(level.indices[i+1],level.indices[i+2]);
+		}
+	}
+
+	//Split every triangle of 'src' into 4, midpoints are shared through an edge hash
+	static void SubdivideGeoSphere(const GeoSphereLevel &src, GeoSphereLevel &dst)
+	{
+		UINT nTris = src.indices.size() / 3;
+		//Euler: each level has V + E vertices, E = 3F/2
+		dst.positions.reserve(src.positions.size() + nTris * 3 / 2);
+		dst.positions = src.positions;
+		dst.indices.resize(nTris * 12);
+
+		std::unordered_map<unsigned __int64,UINT> midpoints;
+		midpoints.rehash(nTris * 2);
+
+		for(UINT i=0; i<nTris; ++i)
+		{
+			UINT v[3] = { src.indices[i*3], src.indices[i*3+1], src.indices[i*3+2] };
+			UINT m[3];
+			for(UINT e=0; e<3; ++e)
+			{
+				UINT a = v[e], b = v[(e + 1) % 3];
+				unsigned __int64 key = a < b ? (static_cast<unsigned __int64>(a) << 32) | b : (static_cast<unsigned __int64>(b) << 32) | a;
+
+				std::unordered_map<unsigned __int64,UINT>::iterator it = midpoints.find(key);
+				if(it != midpoints.end())
+				{
+					m[e] = it->second;
+					continue;
+				}
+
+				XMVECTOR P = XMVector3Normalize(XMLoadFloat3(&dst.positions[a]) + XMLoadFloat3(&dst.positions[b]));
+				XMFLOAT3 pos;
+				XMStoreFloat3(&pos,P);
+				m[e] = dst.positions.size();
+				dst.positions.push_back(pos);
+				midpoints[key] = m[e];
+			}
+
+			UINT *out = &dst.indices[i*12];
+			out[0] = v[0];	out[1] = m[0];	out[2] = m[2];
+			out[3] = m[0];	out[4] = v[1];	out[5] = m[1];
+			out[6] = m[2];	out[7] = m[1];	out[8] = v[2];
+			out[9] = m[0];	out[10] = m[1];	out[11] = m[2];
+		}
+	}
+
+	//Texcoords, seam split and tangents for a unit level
+	static void BuildGeoSphereMesh(const GeoSphereLevel &level, MeshData &mesh)
+	{
+		UINT nVerts = level.positions.size();
+		mesh.vertices.resize(nVerts);
+		mesh.indices = level.indices;
+
+		//Spherical texcoords, same mapping as CreateSphere: u = theta / 2PI, v = phi / PI
+		for(UINT i=0; i<nVerts; ++i)
+		{
+			const XMFLOAT3 &p = level.positions[i];
+			float theta = atan2f(p.z,p.x);
+			if(theta < 0.f)
+				theta += XM_2PI;
+			float phi = acosf(max(-1.f,min(1.f,p.y)));
+
+			mesh.vertices[i].pos = p;
+			mesh.vertices[i].normal = p;
+			mesh.vertices[i].tex = XMFLOAT2(theta / XM_2PI,phi / XM_PI);
+		}
+
+		//Remove the uv seam: a triangle crossing u = 0 gets copies of its low-u vertices with u + 1.
+		//Pole vertices get one copy per triangle, with u in the middle of the triangle's other two vertices.
+		std::vector<UINT> seamCopy(nVerts,UINT(-1));
+		for(UINT i=0; i<mesh.indices.size(); i+=3)
+		{
+			UINT *tri = &mesh.indices[i];
+			bool pole[3];
+			float uMin = 2.f, uMax = -1.f;
+			for(UINT k=0; k<3; ++k)
+			{
+				const XMFLOAT3 &p = level.positions[tri[k]];
+				pole[k] = p.x == 0.f && p.z == 0.f;
+				if(!pole[k])
+				{
+					uMin = min(uMin,mesh.vertices[tri[k]].tex.x);
+					uMax = max(uMax,mesh.vertices[tri[k]].tex.x);
+				}
+			}
+
+			if(uMax - uMin > 0.5f)
+			{
+				for(UINT k=0; k<3; ++k)
+				{
+					if(pole[k] || mesh.vertices[tri[k]].tex.x >= 0.5f)
+						continue;
+					if(seamCopy[tri[k]] == UINT(-1))
+					{
+						seamCopy[tri[k]] = mesh.vertices.size();
+						Vertex copy = mesh.vertices[tri[k]];
+						copy.tex.x += 1.f;
+						mesh.vertices.push_back(copy);
+					}
+					tri[k] = seamCopy[tri[k]];
+				}
+			}
+
+			for(UINT k=0; k<3; ++k)
+			{
+				if(!pole[k])
+					continue;
+				Vertex copy = mesh.vertices[tri[k]];
+				copy.tex.x = 0.5f * (mesh.vertices[tri[(k+1)%3]].tex.x + mesh.vertices[tri[(k+2)%3]].tex.x);
+				tri[k] = mesh.vertices.size();
+				mesh.vertices.push_back(copy);
+			}
+		}
+
+		//Tangent along increasing u, as in CreateSphere
+		for(UINT i=0; i<mesh.vertices.size(); ++i)
+		{
+			float theta = XM_2PI * mesh.vertices[i].tex.x;
+			mesh.vertices[i].tangent = XMFLOAT3(-sinf(theta),0.f,cosf(theta));
+		}
+	}
+
+	void CreateGeoSphere(float radius, UINT subdivisions, MeshData &mesh)
+	{
+		subdivisions = min(subdivisions,8u);
+
+		//Held until the copy is done: a push_back of another call may move the levels
+		std::vector<GeoSphereLevel> &levels = g_geoSphereCache.levels;
+		EnterCriticalSection(&g_geoSphereCache.lock);
+		if(levels.empty())
+		{
+			levels.resize(1);
+			BuildIcosahedron(levels[0]);
+		}
+		while(levels.size() <= subdivisions)
+		{
+			levels.push_back(GeoSphereLevel());
+			SubdivideGeoSphere(levels[levels.size()-2],levels.back());
+		}
+		GeoSphereLevel &level = levels[subdivisions];
+		if(level.unitMesh.vertices.empty())
+			BuildGeoSphereMesh(level,level.unitMesh);
+
+		const MeshData &unit = level.unitMesh;
+		mesh.vertices.resize(unit.vertices.size());
+		mesh.indices = unit.indices;
+		memcpy(&mesh.vertices[0],&unit.vertices[0],sizeof(Vertex) * unit.vertices.size());
+		LeaveCriticalSection(&g_geoSphereCache.lock);
+
+		for(UINT i=0; i<mesh.vertices.size(); ++i)
+		{
+			mesh.vertices[i].pos.x *= radius;
+			mesh.vertices[i].pos.y *= radius;
+			mesh.vertices[i].pos.z *= radius;
+		}
+	}
 };
\ No newline at end of file
@@ -26,6 +26,31 @@ namespace GeoGen
 		std::vector<UINT>	indices;
 	};
 
+	//Plain vertex with the same layout as Vertex, so tables of it can be initialized at compile time
+	struct StaticVertex
+	{
+		float	pos[3];
+		float	normal[3];
+		float	tangent[3];
+		float	tex[2];
+	};
+
+	//Fixed primitive stored in read-only data(see GeometryTables.cpp)
+	struct StaticMesh
+	{
+		const StaticVertex	*vertices;
+		UINT				nVertices;
+		const UINT			*indices;
+		UINT				nIndices;
+	};
+
+	//Precomputed primitive, nothing is generated at runtime.
+	//The arrays can be used directly as the initial data of immutable buffers.
+	const StaticMesh& UnitBox();			//Same as CreateBox(1,1,1)
+
+	//Copy a precomputed primitive into 'mesh', positions scaled by (sx, sy, sz)
+	void CreateFromStatic(const StaticMesh &src, float sx, float sy, float sz, MeshData &mesh);
+
 	//Create a cube
 	void CreateBox(float width, float height, float depth, MeshData &mesh);
 	
@@ -41,6 +66,11 @@ namespace GeoGen
 	
 	//Sphere
 	void CreateSphere(float radius, int slice, int stack, MeshData &mesh);
+
+	//Geodesic sphere: an icosahedron subdivided 'subdivisions' times(at most 8), vertices are shared between triangles.
+	//The unit sphere of every level is cached, so later calls for a built level only scale and copy it.
+	//Thread safe: the cache is locked while a level is built or copied.
+	void CreateGeoSphere(float radius, UINT subdivisions, MeshData &mesh);
 };
 
 
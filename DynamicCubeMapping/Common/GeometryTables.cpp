@@ -0,0 +1,59 @@
+//Primitive meshes baked into the binary.
+//The unit box table is what CreateBox is built from: it is the box, not a copy of a generator's output, so there
+//is nothing to keep in sync. Meshes with a generator(spheres, cylinders) are generated instead.
+#include "GeometryGens.h"
+
+namespace GeoGen
+{
+	//StaticVertex must be a drop-in copy of Vertex
+	static_assert(sizeof(StaticVertex) == sizeof(Vertex), "StaticVertex and Vertex layouts differ");
+
+	//Unit box, 24 vertices, 36 indices
+	static const StaticVertex g_unitBoxVertices[24] = 
+	{
+		//front
+		{{-0.5f,-0.5f,-0.5f},{0.f,0.f,-1.f},{1.f,0.f,0.f},{0.f,1.f}},
+		{{-0.5f,0.5f,-0.5f},{0.f,0.f,-1.f},{1.f,0.f,0.f},{0.f,0.f}},
+		{{0.5f,0.5f,-0.5f},{0.f,0.f,-1.f},{1.f,0.f,0.f},{1.f,0.f}},
+		{{0.5f,-0.5f,-0.5f},{0.f,0.f,-1.f},{1.f,0.f,0.f},{1.f,1.f}},
+		//left
+		{{-0.5f,-0.5f,0.5f},{-1.f,0.f,0.f},{0.f,0.f,-1.f},{0.f,1.f}},
+		{{-0.5f,0.5f,0.5f},{-1.f,0.f,0.f},{0.f,0.f,-1.f},{0.f,0.f}},
+		{{-0.5f,0.5f,-0.5f},{-1.f,0.f,0.f},{0.f,0.f,-1.f},{1.f,0.f}},
+		{{-0.5f,-0.5f,-0.5f},{-1.f,0.f,0.f},{0.f,0.f,-1.f},{1.f,1.f}},
+		//back
+		{{0.5f,-0.5f,0.5f},{0.f,0.f,1.f},{-1.f,0.f,0.f},{0.f,1.f}},
+		{{0.5f,0.5f,0.5f},{0.f,0.f,1.f},{-1.f,0.f,0.f},{0.f,0.f}},
+		{{-0.5f,0.5f,0.5f},{0.f,0.f,1.f},{-1.f,0.f,0.f},{1.f,0.f}},
+		{{-0.5f,-0.5f,0.5f},{0.f,0.f,1.f},{-1.f,0.f,0.f},{1.f,1.f}},
+		//right
+		{{0.5f,-0.5f,-0.5f},{1.f,0.f,0.f},{0.f,0.f,1.f},{0.f,1.f}},
+		{{0.5f,0.5f,-0.5f},{1.f,0.f,0.f},{0.f,0.f,1.f},{0.f,0.f}},
+		{{0.5f,0.5f,0.5f},{1.f,0.f,0.f},{0.f,0.f,1.f},{1.f,0.f}},
+		{{0.5f,-0.5f,0.5f},{1.f,0.f,0.f},{0.f,0.f,1.f},{1.f,1.f}},
+		//top
+		{{-0.5f,0.5f,-0.5f},{0.f,1.f,0.f},{1.f,0.f,0.f},{0.f,1.f}},
+		{{-0.5f,0.5f,0.5f},{0.f,1.f,0.f},{1.f,0.f,0.f},{0.f,0.f}},
+		{{0.5f,0.5f,0.5f},{0.f,1.f,0.f},{1.f,0.f,0.f},{1.f,0.f}},
+		{{0.5f,0.5f,-0.5f},{0.f,1.f,0.f},{1.f,0.f,0.f},{1.f,1.f}},
+		//bottom
+		{{-0.5f,-0.5f,0.5f},{0.f,-1.f,0.f},{1.f,0.f,0.f},{0.f,1.f}},
+		{{-0.5f,-0.5f,-0.5f},{0.f,-1.f,0.f},{1.f,0.f,0.f},{0.f,0.f}},
+		{{0.5f,-0.5f,-0.5f},{0.f,-1.f,0.f},{1.f,0.f,0.f},{1.f,0.f}},
+		{{0.5f,-0.5f,0.5f},{0.f,-1.f,0.f},{1.f,0.f,0.f},{1.f,1.f}}
+	};
+
+	static const UINT g_unitBoxIndices[36] = 
+	{
+		0,1,2,0,2,3,
+		4,5,6,4,6,7,
+		8,9,10,8,10,11,
+		12,13,14,12,14,15,
+		16,17,18,16,18,19,
+		20,21,22,20,22,23
+	};
+
+	static const StaticMesh g_unitBox	= { g_unitBoxVertices, 24, g_unitBoxIndices, 36 };
+
+	const StaticMesh& UnitBox()	{ return g_unitBox; }
+};
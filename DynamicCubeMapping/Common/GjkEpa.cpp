@@ -0,0 +1,646 @@
+#include "GjkEpa.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace GjkEpa
+{
+	static const UINT	g_maxGjkIterations = 64;
+	static const float	g_gjkTolerance = 1e-6f;			//Relative progress below which GJK has converged
+	static const float	g_touchTolerance = 1e-10f;		//Squared distance, relative to the squared size of the simplex, taken as contact
+	static const UINT	g_maxEpaIterations = 64;
+	static const float	g_epaTolerance = 1e-3f;			//Relative progress below which EPA has converged
+	static const UINT	g_maxEpaVertices = g_maxEpaIterations + 4;
+	static const UINT	g_maxEpaFaces = 2 * g_maxEpaVertices;
+	static const UINT	g_maxEpaEdges = 3 * g_maxEpaFaces;
+
+	XMVECTOR SphereShape::Support(FXMVECTOR direction) const
+	{
+		XMVECTOR center = XMLoadFloat3(&m_center);
+		XMVECTOR lengthSq = XMVector3LengthSq(direction);
+		if(XMVectorGetX(lengthSq) <= FLT_MIN)
+			return center;
+		return XMVectorMultiplyAdd(direction,XMVectorReplicate(m_radius) * XMVectorReciprocalSqrt(lengthSq),center);
+	}
+
+	XMVECTOR AxisAlignedBoxShape::Support(FXMVECTOR direction) const
+	{
+		XMVECTOR extents = XMLoadFloat3(&m_extents);
+		XMVECTOR negative = XMVectorLess(direction,XMVectorZero());
+		return XMLoadFloat3(&m_center) + XMVectorSelect(extents,-extents,negative);
+	}
+
+	XMVECTOR OrientedBoxShape::Support(FXMVECTOR direction) const
+	{
+		XMVECTOR orientation = XMLoadFloat4(&m_orientation);
+		XMVECTOR local = XMVector3InverseRotate(direction,orientation);
+		XMVECTOR extents = XMLoadFloat3(&m_extents);
+		XMVECTOR corner = XMVectorSelect(extents,-extents,XMVectorLess(local,XMVectorZero()));
+		return XMLoadFloat3(&m_center) + XMVector3Rotate(corner,orientation);
+	}
+
+	XMVECTOR PointSetShape::Support(FXMVECTOR direction) const
+	{
+		const BYTE *p = (const BYTE*)m_points;
+		XMVECTOR best = XMLoadFloat3(m_points);
+		XMVECTOR bestDot = XMVector3Dot(best,direction);
+		for(UINT i=1; i<m_count; ++i)
+		{
+			XMVECTOR point = XMLoadFloat3((const XMFLOAT3*)(p + i * m_stride));
+			XMVECTOR dot = XMVector3Dot(point,direction);
+			XMVECTOR greater = XMVectorGreater(dot,bestDot);
+			best = XMVectorSelect(best,point,greater);
+			bestDot = XMVectorMax(bestDot,dot);
+		}
+		return best;
+	}
+
+	FrustumShape::FrustumShape(const XNA::Frustum &frustum):
+		m_corners(m_points,8,sizeof(XMFLOAT3))
+	{
+		//Corners in the order of the XNA frustum tests, near plane first
+		float slopeX[4] = { frustum.RightSlope, frustum.RightSlope, frustum.LeftSlope, frustum.LeftSlope };
+		float slopeY[4] = { frustum.TopSlope, frustum.BottomSlope, frustum.TopSlope, frustum.BottomSlope };
+		XMVECTOR origin = XMLoadFloat3(&frustum.Origin);
+		XMVECTOR orientation = XMLoadFloat4(&frustum.Orientation);
+		for(UINT i=0; i<8; ++i)
+		{
+			float z = i < 4 ? frustum.Near : frustum.Far;
+			XMVECTOR local = XMVectorSet(slopeX[i & 3] * z,slopeY[i & 3] * z,z,0.f);
+			XMStoreFloat3(&m_points[i],XMVector3Rotate(local,orientation) + origin);
+		}
+	}
+
+	XMVECTOR RoundedShape::Support(FXMVECTOR direction) const
+	{
+		XMVECTOR point = m_shape.Support(direction);
+		XMVECTOR lengthSq = XMVector3LengthSq(direction);
+		if(XMVectorGetX(lengthSq) <= FLT_MIN)
+			return point;
+		return XMVectorMultiplyAdd(direction,XMVectorReplicate(m_radius) * XMVectorReciprocalSqrt(lengthSq),point);
+	}
+
+	//Vertex of the Minkowski difference: w = a - b, with a the support of A along 'dir' and b the support of B along -dir
+	struct Vertex
+	{
+		XMVECTOR	a;
+		XMVECTOR	b;
+		XMVECTOR	w;
+		XMVECTOR	dir;
+	};
+
+	struct Simplex
+	{
+		Vertex	v[4];
+		float	lambda[4];					//Barycentric weights of the point closest to the origin
+		UINT	count;
+	};
+
+	static inline void GetSupport(const SupportShape &a, const SupportShape &b, FXMVECTOR dir, Vertex &out)
+	{
+		out.a = a.Support(dir);
+		out.b = b.Support(-dir);
+		out.w = out.a - out.b;
+		out.dir = dir;
+	}
+
+	static inline float Dot(FXMVECTOR v1, FXMVECTOR v2)
+	{
+		return XMVectorGetX(XMVector3Dot(v1,v2));
+	}
+
+	//Keep the vertices 'keep' of the simplex with their weights
+	static void Reduce(Simplex &s, const UINT *keep, const float *lambda, UINT count)
+	{
+		Vertex v[4];
+		for(UINT i=0; i<count; ++i)
+			v[i] = s.v[keep[i]];
+		for(UINT i=0; i<count; ++i)
+		{
+			s.v[i] = v[i];
+			s.lambda[i] = lambda[i];
+		}
+		s.count = count;
+	}
+
+	static void SolveSegment(Simplex &s, UINT i0, UINT i1)
+	{
+		XMVECTOR a = s.v[i0].w;
+		XMVECTOR ab = s.v[i1].w - a;
+		float abab = Dot(ab,ab);
+		float t = abab > 0.f ? -Dot(a,ab) / abab : 0.f;
+
+		UINT keep[2] = { i0, i1 };
+		if(t <= 0.f)
+		{
+			float lambda = 1.f;
+			Reduce(s,&keep[0],&lambda,1);
+		}
+		else if(t >= 1.f)
+		{
+			float lambda = 1.f;
+			Reduce(s,&keep[1],&lambda,1);
+		}
+		else
+		{
+			float lambda[2] = { 1.f - t, t };
+			Reduce(s,keep,lambda,2);
+		}
+	}
+
+	//Closest point of triangle(i0, i1, i2) to the origin. The origin is projected on the plane of the triangle and
+	//the weights are the areas of the sub-triangles around the projection, which stay accurate for thin triangles
+	//far from the origin, unlike the dot products of the Voronoi region tests. When the projection is outside,
+	//the answer is on one of the edges it is outside of.
+	static void SolveTriangle(Simplex &s, UINT i0, UINT i1, UINT i2)
+	{
+		XMVECTOR a = s.v[i0].w, b = s.v[i1].w, c = s.v[i2].w;
+		XMVECTOR ab = b - a, ac = c - a;
+		XMVECTOR n = XMVector3Cross(ab,ac);
+		float nn = Dot(n,n);
+		float ab2 = Dot(ab,ab), ac2 = Dot(ac,ac), bc2 = Dot(c - b,c - b);
+
+		//A sliver triangle, e.g. with a vertex added next to another, is solved as its longest edge
+		if(!(nn > 1e-10f * ab2 * ac2))
+		{
+			if(ab2 >= ac2 && ab2 >= bc2)
+				SolveSegment(s,i0,i1);
+			else if(ac2 >= bc2)
+				SolveSegment(s,i0,i2);
+			else
+				SolveSegment(s,i1,i2);
+			return;
+		}
+
+		XMVECTOR p = n * XMVectorReplicate(Dot(n,a) / nn);
+		float u = Dot(XMVector3Cross(b - p,c - p),n);
+		float v = Dot(XMVector3Cross(c - p,a - p),n);
+		float w = Dot(XMVector3Cross(a - p,b - p),n);
+		if(u >= 0.f && v >= 0.f && w >= 0.f)
+		{
+			float invSum = 1.f / (u + v + w);
+			UINT keep[3] = { i0, i1, i2 };
+			float lambda[3] = { u * invSum, v * invSum, w * invSum };
+			Reduce(s,keep,lambda,3);
+			return;
+		}
+
+		UINT edges[3][2] = { { i1, i2 }, { i2, i0 }, { i0, i1 } };
+		float weights[3] = { u, v, w };
+		Simplex best;
+		float bestDistSq = FLT_MAX;
+		for(UINT e=0; e<3; ++e)
+		{
+			if(weights[e] >= 0.f)
+				continue;
+
+			Simplex candidate = s;
+			SolveSegment(candidate,edges[e][0],edges[e][1]);
+			XMVECTOR closest = candidate.v[0].w * XMVectorReplicate(candidate.lambda[0]);
+			if(candidate.count == 2)
+				closest = XMVectorMultiplyAdd(candidate.v[1].w,XMVectorReplicate(candidate.lambda[1]),closest);
+			float distSq = Dot(closest,closest);
+			if(distSq < bestDistSq)
+			{
+				bestDistSq = distSq;
+				best = candidate;
+			}
+		}
+		s = best;
+	}
+
+	static XMVECTOR ClosestPoint(const Simplex &s)
+	{
+		XMVECTOR v = XMVectorZero();
+		for(UINT i=0; i<s.count; ++i)
+			v = XMVectorMultiplyAdd(s.v[i].w,XMVectorReplicate(s.lambda[i]),v);
+		return v;
+	}
+
+	//Closest point of the tetrahedron to the origin: the best of the faces the origin is outside of.
+	//Return true when the origin is inside, leaving the 4 vertices.
+	static bool SolveTetrahedron(Simplex &s)
+	{
+		static const UINT faces[4][4] = { {0,1,2,3}, {0,3,1,2}, {0,2,3,1}, {1,3,2,0} };
+
+		XMVECTOR w[4] = { s.v[0].w, s.v[1].w, s.v[2].w, s.v[3].w };
+		float scale = 0.f;
+		for(UINT i=1; i<4; ++i)
+			scale = max(scale,Dot(w[i] - w[0],w[i] - w[0]));
+		float volume = Dot(XMVector3Cross(w[1] - w[0],w[2] - w[0]),w[3] - w[0]);
+		bool degenerate = fabs(volume) <= 1e-6f * scale * sqrt(scale);
+
+		Simplex best;
+		float bestDistSq = FLT_MAX;
+		bool outside = false;
+		for(UINT f=0; f<4; ++f)
+		{
+			const UINT *face = faces[f];
+			XMVECTOR a = w[face[0]];
+			XMVECTOR n = XMVector3Cross(w[face[1]] - a,w[face[2]] - a);
+			float signOrigin = -Dot(n,a);
+			float signOpposite = Dot(n,w[face[3]] - a);
+			if(!degenerate && signOrigin * signOpposite >= 0.f)
+				continue;
+
+			outside = true;
+			Simplex candidate = s;
+			SolveTriangle(candidate,face[0],face[1],face[2]);
+			XMVECTOR v = ClosestPoint(candidate);
+			float distSq = Dot(v,v);
+			if(distSq < bestDistSq)
+			{
+				bestDistSq = distSq;
+				best = candidate;
+			}
+		}
+
+		if(!outside)
+			return true;
+
+		s = best;
+		return false;
+	}
+
+	//Run GJK from the cached simplex, or from the centers. On return 's' is the final simplex and 'v' its point
+	//closest to the origin. With 'stopWhenSeparated' the search ends at the first separating direction.
+	static bool RunGjk(const SupportShape &a, const SupportShape &b, SimplexCache *cache, bool stopWhenSeparated,
+		Simplex &s, XMVECTOR &v, UINT &iterations)
+	{
+		s.count = 0;
+		if(cache)
+		{
+			//Last frame's support directions, evaluated on the shapes as they are now. Duplicates are dropped.
+			for(UINT i=0; i<cache->count; ++i)
+			{
+				Vertex vertex;
+				GetSupport(a,b,XMLoadFloat3(&cache->directions[i]),vertex);
+				bool duplicate = false;
+				for(UINT j=0; j<s.count; ++j)
+					duplicate = duplicate || XMVector3Equal(vertex.w,s.v[j].w);
+				if(!duplicate)
+					s.v[s.count++] = vertex;
+			}
+		}
+		if(s.count == 0)
+		{
+			XMVECTOR dir = a.GetCenter() - b.GetCenter();
+			if(Dot(dir,dir) <= FLT_MIN)
+				dir = XMVectorSet(1.f,0.f,0.f,0.f);
+			GetSupport(a,b,-dir,s.v[0]);
+			s.count = 1;
+		}
+		for(UINT i=0; i<s.count; ++i)
+			s.lambda[i] = 1.f / s.count;
+
+		Simplex prev;
+		bool intersect = false;
+		iterations = 0;
+		float prevDistSq = FLT_MAX;
+		while(true)
+		{
+			switch(s.count)
+			{
+			case 2:	SolveSegment(s,0,1);				break;
+			case 3:	SolveTriangle(s,0,1,2);				break;
+			case 4:	intersect = SolveTetrahedron(s);	break;
+			default: s.lambda[0] = 1.f;					break;
+			}
+			if(intersect)
+			{
+				v = XMVectorZero();
+				break;
+			}
+
+			v = ClosestPoint(s);
+			float distSq = Dot(v,v);
+
+			//Touching: the origin is on the simplex, up to rounding
+			float size = 0.f;
+			for(UINT i=0; i<s.count; ++i)
+				size = max(size,Dot(s.v[i].w,s.v[i].w));
+			if(distSq <= g_touchTolerance * size)
+			{
+				intersect = true;
+				break;
+			}
+			//No more progress: the duplicate vertex case, or rounding. Keep the previous simplex.
+			if(distSq >= prevDistSq)
+			{
+				s = prev;
+				v = ClosestPoint(s);
+				break;
+			}
+			if(iterations >= g_maxGjkIterations)
+				break;
+			prevDistSq = distSq;
+			prev = s;
+
+			Vertex vertex;
+			GetSupport(a,b,-v,vertex);
+			++iterations;
+
+			float vw = Dot(v,vertex.w);
+			if(stopWhenSeparated && vw > 0.f)
+				break;
+			if(distSq - vw <= g_gjkTolerance * distSq)
+				break;
+
+			s.v[s.count] = vertex;
+			s.lambda[s.count] = 0.f;
+			++s.count;
+		}
+
+		if(cache)
+		{
+			cache->count = s.count;
+			for(UINT i=0; i<s.count; ++i)
+				XMStoreFloat3(&cache->directions[i],s.v[i].dir);
+		}
+		return intersect;
+	}
+
+	static void SetSeparated(const Simplex &s, FXMVECTOR v, Result &result)
+	{
+		XMVECTOR pointA = XMVectorZero(), pointB = XMVectorZero();
+		for(UINT i=0; i<s.count; ++i)
+		{
+			XMVECTOR lambda = XMVectorReplicate(s.lambda[i]);
+			pointA = XMVectorMultiplyAdd(s.v[i].a,lambda,pointA);
+			pointB = XMVectorMultiplyAdd(s.v[i].b,lambda,pointB);
+		}
+
+		result.intersect = false;
+		result.distance = XMVectorGetX(XMVector3Length(v));
+		result.depth = 0.f;
+		XMStoreFloat3(&result.normal,XMVector3Normalize(-v));
+		XMStoreFloat3(&result.pointA,pointA);
+		XMStoreFloat3(&result.pointB,pointB);
+	}
+
+	bool Intersect(const SupportShape &a, const SupportShape &b, SimplexCache *cache)
+	{
+		Simplex s;
+		XMVECTOR v;
+		UINT iterations;
+		return RunGjk(a,b,cache,true,s,v,iterations);
+	}
+
+	bool Distance(const SupportShape &a, const SupportShape &b, Result &result, SimplexCache *cache)
+	{
+		Simplex s;
+		XMVECTOR v;
+		memset(&result,0,sizeof(result));
+		result.intersect = RunGjk(a,b,cache,false,s,v,result.iterations);
+		if(!result.intersect)
+			SetSeparated(s,v,result);
+		return result.intersect;
+	}
+
+	struct Face
+	{
+		XMVECTOR	normal;					//Unit, pointing out of the polytope
+		float		dist;					//Distance of the plane to the origin
+		UINT		v[3];
+	};
+
+	struct Polytope
+	{
+		Vertex	vertices[g_maxEpaVertices];
+		UINT	nVertices;
+		Face	faces[g_maxEpaFaces];
+		UINT	nFaces;
+	};
+
+	//Add face(i0, i1, i2), counterclockwise seen from outside. Return false for a degenerate face.
+	static bool AddFace(Polytope &p, UINT i0, UINT i1, UINT i2)
+	{
+		if(p.nFaces >= g_maxEpaFaces)
+			return false;
+
+		XMVECTOR a = p.vertices[i0].w;
+		XMVECTOR n = XMVector3Cross(p.vertices[i1].w - a,p.vertices[i2].w - a);
+		float lengthSq = Dot(n,n);
+		if(lengthSq <= FLT_MIN)
+			return false;
+
+		Face &face = p.faces[p.nFaces++];
+		face.normal = n * XMVectorReciprocalSqrt(XMVectorReplicate(lengthSq));
+		face.dist = Dot(face.normal,a);
+		face.v[0] = i0;
+		face.v[1] = i1;
+		face.v[2] = i2;
+		return true;
+	}
+
+	static UINT ClosestFace(const Polytope &p)
+	{
+		UINT closest = 0;
+		for(UINT f=1; f<p.nFaces; ++f)
+		{
+			if(p.faces[f].dist < p.faces[closest].dist)
+				closest = f;
+		}
+		return closest;
+	}
+
+	//Grow a simplex that touches or contains the origin into a tetrahedron, with support points in new directions
+	static bool BuildTetrahedron(const SupportShape &a, const SupportShape &b, Simplex &s)
+	{
+		static const XMVECTORF32 axes[6] = { {1.f,0.f,0.f,0.f}, {-1.f,0.f,0.f,0.f}, {0.f,1.f,0.f,0.f},
+			{0.f,-1.f,0.f,0.f}, {0.f,0.f,1.f,0.f}, {0.f,0.f,-1.f,0.f} };
+
+		float scale = FLT_MIN;
+		for(UINT i=0; i<s.count; ++i)
+			scale = max(scale,Dot(s.v[i].w,s.v[i].w));
+
+		if(s.count == 1)
+		{
+			for(UINT i=0; i<6 && s.count == 1; ++i)
+			{
+				GetSupport(a,b,axes[i],s.v[1]);
+				XMVECTOR d = s.v[1].w - s.v[0].w;
+				if(Dot(d,d) > 1e-8f * max(scale,Dot(s.v[1].w,s.v[1].w)))
+					s.count = 2;
+			}
+		}
+		if(s.count == 2)
+		{
+			//Directions around the segment, 60 degrees apart
+			XMVECTOR e = XMVector3Normalize(s.v[1].w - s.v[0].w);
+			XMVECTOR absE = XMVectorAbs(e);
+			UINT axis = XMVectorGetX(absE) < XMVectorGetY(absE) ? (XMVectorGetX(absE) < XMVectorGetZ(absE) ? 0 : 4) :
+				(XMVectorGetY(absE) < XMVectorGetZ(absE) ? 2 : 4);
+			XMVECTOR dir = XMVector3Cross(e,axes[axis]);
+			XMVECTOR rotation = XMQuaternionRotationAxis(e,XM_PI / 3.f);
+			for(UINT i=0; i<6 && s.count == 2; ++i)
+			{
+				GetSupport(a,b,dir,s.v[2]);
+				XMVECTOR n = XMVector3Cross(s.v[1].w - s.v[0].w,s.v[2].w - s.v[0].w);
+				if(Dot(n,n) > 1e-12f * scale * scale)
+					s.count = 3;
+				dir = XMVector3Rotate(dir,rotation);
+			}
+		}
+		if(s.count == 3)
+		{
+			XMVECTOR n = XMVector3Cross(s.v[1].w - s.v[0].w,s.v[2].w - s.v[0].w);
+			for(UINT i=0; i<2 && s.count == 3; ++i)
+			{
+				GetSupport(a,b,i == 0 ? n : -n,s.v[3]);
+				float volume = Dot(n,s.v[3].w - s.v[0].w);
+				if(fabs(volume) > 1e-6f * scale * sqrt(scale))
+					s.count = 4;
+			}
+		}
+
+		return s.count == 4;
+	}
+
+	//Barycentric weights of the projection of the origin on face(a, b, c)
+	static void FaceWeights(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c, FXMVECTOR p, float *lambda)
+	{
+		XMVECTOR v0 = b - a, v1 = c - a, v2 = p - a;
+		float d00 = Dot(v0,v0), d01 = Dot(v0,v1), d11 = Dot(v1,v1);
+		float d20 = Dot(v2,v0), d21 = Dot(v2,v1);
+		float denom = d00 * d11 - d01 * d01;
+		if(!(denom > 0.f))
+		{
+			lambda[0] = 1.f;
+			lambda[1] = lambda[2] = 0.f;
+			return;
+		}
+		lambda[1] = (d11 * d20 - d01 * d21) / denom;
+		lambda[2] = (d00 * d21 - d01 * d20) / denom;
+		lambda[0] = 1.f - lambda[1] - lambda[2];
+	}
+
+	static void RunEpa(const SupportShape &a, const SupportShape &b, Simplex &s, Result &result)
+	{
+		result.distance = 0.f;
+		result.depth = 0.f;
+		if(!BuildTetrahedron(a,b,s))
+		{
+			//Flat contact with no volume: the shapes only touch
+			XMVECTOR point = s.v[0].a;
+			XMStoreFloat3(&result.pointA,point);
+			XMStoreFloat3(&result.pointB,s.v[0].b);
+			XMStoreFloat3(&result.normal,XMVector3Normalize(b.GetCenter() - a.GetCenter()));
+			return;
+		}
+
+		//About 11KB, on the stack: a heap allocation would not keep the XMVECTOR members aligned
+		Polytope polytope;
+		Polytope *p = &polytope;
+		p->nVertices = 4;
+		p->nFaces = 0;
+		for(UINT i=0; i<4; ++i)
+			p->vertices[i] = s.v[i];
+
+		//Faces counterclockwise from outside
+		if(Dot(XMVector3Cross(s.v[1].w - s.v[0].w,s.v[2].w - s.v[0].w),s.v[3].w - s.v[0].w) > 0.f)
+			std::swap(p->vertices[1],p->vertices[2]);
+		AddFace(*p,0,1,2);
+		AddFace(*p,0,3,1);
+		AddFace(*p,0,2,3);
+		AddFace(*p,1,3,2);
+		if(p->nFaces < 4)
+			return;
+
+		//The distance of the nearest face only grows as the polytope expands. Keep the best face, since a polytope
+		//grown past float precision may fold over and report a nearer face again.
+		float size = 0.f;
+		for(UINT i=0; i<4; ++i)
+			size = max(size,Dot(s.v[i].w,s.v[i].w));
+		float foldTolerance = g_epaTolerance * sqrt(size);
+
+		UINT edges[g_maxEpaEdges][2];
+		Face best = p->faces[ClosestFace(*p)];
+		Vertex bestVertices[3] = { p->vertices[best.v[0]], p->vertices[best.v[1]], p->vertices[best.v[2]] };
+		for(UINT iteration=0; iteration<g_maxEpaIterations && p->nFaces > 0; ++iteration)
+		{
+			const Face &face = p->faces[ClosestFace(*p)];
+			if(face.dist < best.dist - foldTolerance)
+				break;
+			if(face.dist >= best.dist || iteration == 0)
+			{
+				best = face;
+				for(UINT k=0; k<3; ++k)
+					bestVertices[k] = p->vertices[face.v[k]];
+			}
+
+			++result.iterations;
+			Vertex vertex;
+			GetSupport(a,b,face.normal,vertex);
+			float dist = Dot(face.normal,vertex.w);
+			if(dist - face.dist <= g_epaTolerance * max(dist,1e-6f) || p->nVertices >= g_maxEpaVertices)
+				break;
+
+			//Remove the faces seen from the new vertex, keeping the edges of their boundary(the horizon)
+			UINT nEdges = 0;
+			UINT index = p->nVertices;
+			p->vertices[p->nVertices++] = vertex;
+			for(UINT f=0; f<p->nFaces; )
+			{
+				Face &seen = p->faces[f];
+				if(Dot(seen.normal,vertex.w - p->vertices[seen.v[0]].w) <= 0.f)
+				{
+					++f;
+					continue;
+				}
+
+				for(UINT k=0; k<3; ++k)
+				{
+					UINT e0 = seen.v[k], e1 = seen.v[(k + 1) % 3];
+					//An edge shared with another removed face appears in the opposite direction
+					bool shared = false;
+					for(UINT e=0; e<nEdges; ++e)
+					{
+						if(edges[e][0] == e1 && edges[e][1] == e0)
+						{
+							edges[e][0] = edges[nEdges - 1][0];
+							edges[e][1] = edges[nEdges - 1][1];
+							--nEdges;
+							shared = true;
+							break;
+						}
+					}
+					if(!shared && nEdges < g_maxEpaEdges)
+					{
+						edges[nEdges][0] = e0;
+						edges[nEdges][1] = e1;
+						++nEdges;
+					}
+				}
+				p->faces[f] = p->faces[--p->nFaces];
+			}
+
+			for(UINT e=0; e<nEdges; ++e)
+				AddFace(*p,edges[e][0],edges[e][1],index);
+		}
+
+		const Vertex &v0 = bestVertices[0], &v1 = bestVertices[1], &v2 = bestVertices[2];
+		float lambda[3];
+		FaceWeights(v0.w,v1.w,v2.w,best.normal * XMVectorReplicate(best.dist),lambda);
+
+		XMVECTOR l0 = XMVectorReplicate(lambda[0]), l1 = XMVectorReplicate(lambda[1]), l2 = XMVectorReplicate(lambda[2]);
+		XMStoreFloat3(&result.pointA,v0.a * l0 + v1.a * l1 + v2.a * l2);
+		XMStoreFloat3(&result.pointB,v0.b * l0 + v1.b * l1 + v2.b * l2);
+		XMStoreFloat3(&result.normal,best.normal);
+		result.depth = max(best.dist,0.f);
+	}
+
+	bool Penetration(const SupportShape &a, const SupportShape &b, Result &result, SimplexCache *cache)
+	{
+		Simplex s;
+		XMVECTOR v;
+		memset(&result,0,sizeof(result));
+		result.intersect = RunGjk(a,b,cache,false,s,v,result.iterations);
+		if(result.intersect)
+			RunEpa(a,b,s,result);
+		else
+			SetSeparated(s,v,result);
+		return result.intersect;
+	}
+}
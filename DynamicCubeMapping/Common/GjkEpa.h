@@ -0,0 +1,143 @@
+#ifndef _GJK_EPA_H_
+#define _GJK_EPA_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include "xnacollision.h"
+
+//Distance, intersection and penetration of any two convex shapes described by their support function
+//(the farthest point of the shape in a direction), instead of one routine per pair of volumes:
+//	- GJK walks a simplex of the Minkowski difference A - B toward the origin: the closest points when the shapes
+//	  are apart, or an enclosing tetrahedron when they overlap;
+//	- EPA then grows that tetrahedron into a polytope until its face nearest to the origin gives the penetration.
+//A SimplexCache keeps the support directions of the final simplex, so the next query of the same pair starts
+//from last frame's simplex and usually ends in one or two iterations.
+namespace GjkEpa
+{
+	class SupportShape
+	{
+	public:
+		virtual ~SupportShape() {}
+
+		//Farthest point of the shape along 'direction'(not normalized, may be zero)
+		virtual XMVECTOR Support(FXMVECTOR direction) const = 0;
+		//Any point inside the shape, used for the first search direction
+		virtual XMVECTOR GetCenter() const = 0;
+	};
+
+	class SphereShape: public SupportShape
+	{
+	public:
+		SphereShape(const XNA::Sphere &sphere): m_center(sphere.Center), m_radius(sphere.Radius) {}
+
+		XMVECTOR Support(FXMVECTOR direction) const;
+		XMVECTOR GetCenter() const	{ return XMLoadFloat3(&m_center); }
+
+	private:
+		XMFLOAT3	m_center;
+		float		m_radius;
+	};
+
+	class AxisAlignedBoxShape: public SupportShape
+	{
+	public:
+		AxisAlignedBoxShape(const XNA::AxisAlignedBox &box): m_center(box.Center), m_extents(box.Extents) {}
+
+		XMVECTOR Support(FXMVECTOR direction) const;
+		XMVECTOR GetCenter() const	{ return XMLoadFloat3(&m_center); }
+
+	private:
+		XMFLOAT3	m_center;
+		XMFLOAT3	m_extents;
+	};
+
+	class OrientedBoxShape: public SupportShape
+	{
+	public:
+		OrientedBoxShape(const XNA::OrientedBox &box): m_center(box.Center), m_extents(box.Extents), m_orientation(box.Orientation) {}
+
+		XMVECTOR Support(FXMVECTOR direction) const;
+		XMVECTOR GetCenter() const	{ return XMLoadFloat3(&m_center); }
+
+	private:
+		XMFLOAT3	m_center;
+		XMFLOAT3	m_extents;
+		XMFLOAT4	m_orientation;
+	};
+
+	//Convex hull of a point set, e.g. the vertices of a mesh from GeoGen. The points are not copied.
+	class PointSetShape: public SupportShape
+	{
+	public:
+		PointSetShape(const XMFLOAT3 *points, UINT count, UINT stride): m_points(points), m_count(count), m_stride(stride) {}
+
+		XMVECTOR Support(FXMVECTOR direction) const;
+		XMVECTOR GetCenter() const	{ return XMLoadFloat3(m_points); }
+
+	private:
+		const XMFLOAT3	*m_points;
+		UINT			m_count;
+		UINT			m_stride;
+	};
+
+	//Hull of the 8 corners of the frustum, in world space
+	class FrustumShape: public SupportShape
+	{
+	public:
+		FrustumShape(const XNA::Frustum &frustum);
+
+		XMVECTOR Support(FXMVECTOR direction) const	{ return m_corners.Support(direction); }
+		XMVECTOR GetCenter() const					{ return m_corners.GetCenter(); }
+
+	private:
+		FrustumShape(const FrustumShape&);
+		FrustumShape& operator=(const FrustumShape&);
+
+		XMFLOAT3		m_points[8];
+		PointSetShape	m_corners;			//Over m_points
+	};
+
+	//Another shape grown by a radius in every direction: a segment(PointSetShape of 2 points) gives a capsule
+	class RoundedShape: public SupportShape
+	{
+	public:
+		RoundedShape(const SupportShape &shape, float radius): m_shape(shape), m_radius(radius) {}
+
+		XMVECTOR Support(FXMVECTOR direction) const;
+		XMVECTOR GetCenter() const	{ return m_shape.GetCenter(); }
+
+	private:
+		RoundedShape& operator=(const RoundedShape&);
+
+		const SupportShape	&m_shape;
+		float				m_radius;
+	};
+
+	//Simplex of the last query of a pair, to keep from one frame to the next. Zero-initialize it(count = 0) before the first query.
+	struct SimplexCache
+	{
+		XMFLOAT3	directions[4];		//Support directions of the simplex vertices
+		UINT		count;
+	};
+
+	struct Result
+	{
+		bool		intersect;
+		float		distance;			//Distance between the shapes when they are apart, 0 otherwise
+		float		depth;				//Penetration depth(Penetration only), 0 when the shapes are apart
+		XMFLOAT3	normal;				//Unit axis pointing from A toward B: B touches A after moving back along it by 'distance',
+										//or separates from A after moving along it by 'depth'
+		XMFLOAT3	pointA;				//Closest points when apart, deepest points of the overlap otherwise
+		XMFLOAT3	pointB;
+		UINT		iterations;			//GJK and EPA iterations
+	};
+
+	//Boolean test: stops as soon as a separating direction is found
+	bool Intersect(const SupportShape &a, const SupportShape &b, SimplexCache *cache = NULL);
+	//Distance and closest points. When the shapes overlap only 'intersect' is set. Return result.intersect.
+	bool Distance(const SupportShape &a, const SupportShape &b, Result &result, SimplexCache *cache = NULL);
+	//Same as Distance, with the penetration depth, normal and points computed by EPA when the shapes overlap
+	bool Penetration(const SupportShape &a, const SupportShape &b, Result &result, SimplexCache *cache = NULL);
+};
+
+#endif	//_GJK_EPA_H_
@@ -0,0 +1,126 @@
+#include "JobBenchmark.h"
+#include "JobSystem.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+
+namespace JobBenchmark
+{
+	static const UINT g_emptyJobs = 100000;
+	static const UINT g_treeDepth = 14;				//2^15 - 1 jobs
+	static const UINT g_forCount = 1 << 20;
+	static const UINT g_forGrain = 4096;
+	static const UINT g_runs = 3;					//Best of, for the ParallelFor timings
+
+	static double Now()
+	{
+		static double secsPerCount(0.0);
+		if(secsPerCount == 0.0)
+		{
+			__int64 countsPerSec(0);
+			QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+			secsPerCount = countsPerSec ? 1.0 / countsPerSec : 1.0;
+		}
+
+		__int64 count(0);
+		QueryPerformanceCounter((LARGE_INTEGER*)&count);
+		return count * secsPerCount;
+	}
+
+	static void EmptyJob(void*, UINT, UINT)
+	{
+	}
+
+	//Each node queues its two children and waits for them, so the waits run the jobs of other nodes
+	static void TreeJob(void *data, UINT depth, UINT)
+	{
+		if(depth == 0)
+			return;
+
+		JobSystem &jobs = *static_cast<JobSystem*>(data);
+		JobSystem::Counter counter;
+		jobs.Run(&TreeJob,data,depth - 1,0,&counter);
+		jobs.Run(&TreeJob,data,depth - 1,0,&counter);
+		jobs.Wait(&counter);
+	}
+
+	//Nanoseconds per empty job queued from worker 0, waited for in batches the queue holds
+	static double SpawnCost(JobSystem &jobs)
+	{
+		JobSystem::Counter counter;
+		double begin = Now();
+		for(UINT i=0; i<g_emptyJobs; ++i)
+		{
+			jobs.Run(&EmptyJob,NULL,0,0,&counter);
+			if((i & 1023) == 1023)
+				jobs.Wait(&counter);
+		}
+		jobs.Wait(&counter);
+		return (Now() - begin) * 1e9 / g_emptyJobs;
+	}
+
+	static double TreeCost(JobSystem &jobs)
+	{
+		JobSystem::Counter counter;
+		double begin = Now();
+		jobs.Run(&TreeJob,&jobs,g_treeDepth,0,&counter);
+		jobs.Wait(&counter);
+		return (Now() - begin) * 1e9 / ((2 << g_treeDepth) - 1);
+	}
+
+	//Milliseconds of a ParallelFor over 'values', best of g_runs
+	static double ForCost(JobSystem &jobs, std::vector<float> &values)
+	{
+		double best(0.0);
+		for(UINT run=0; run<g_runs; ++run)
+		{
+			double begin = Now();
+			jobs.ParallelFor(0,(UINT)values.size(),g_forGrain,[&](UINT i)
+			{
+				float v = values[i];
+				for(UINT k=0; k<8; ++k)
+					v = sqrtf(v * 0.5f + (float)(i + k));
+				values[i] = v;
+			});
+			double ms = (Now() - begin) * 1e3;
+			if(run == 0 || ms < best)
+				best = ms;
+		}
+		return best;
+	}
+
+	void Print()
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		std::cout<<"Job system benchmark, "<<info.dwNumberOfProcessors<<" cores"<<std::endl;
+		std::cout<<std::fixed<<std::setprecision(1);
+
+		std::vector<float> values(g_forCount,1.f);
+		double single(0.0);
+		for(UINT nWorkers=1; nWorkers<=JobSystem::MaxWorkers; nWorkers*=2)
+		{
+			JobSystem jobs;
+			if(!jobs.Init(nWorkers - 1))
+				return;
+			//The speedups are against the single worker run: no pass may get more or fewer threads than asked
+			if(jobs.GetWorkerCount() != nWorkers)
+			{
+				std::cout<<nWorkers<<" workers: got "<<jobs.GetWorkerCount()<<", stopped"<<std::endl;
+				return;
+			}
+
+			double spawn = SpawnCost(jobs);
+			double tree = TreeCost(jobs);
+			jobs.ResetStats();
+			double ms = ForCost(jobs,values);
+			if(nWorkers == 1)
+				single = ms;
+
+			std::cout<<std::setw(2)<<jobs.GetWorkerCount()<<" workers: spawn "<<spawn<<" ns/job, tree "<<tree
+				<<" ns/job, ParallelFor "<<std::setprecision(2)<<ms<<" ms (x"<<(ms > 0.0 ? single / ms : 0.0)
+				<<"), stolen "<<jobs.GetStolen()<<std::setprecision(1)<<std::endl;
+		}
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef _JOB_BENCHMARK_H_
+#define _JOB_BENCHMARK_H_
+
+#include <Windows.h>
+
+//Micro-benchmark of the job system, printed on the console(debug builds open one):
+//	- spawn overhead: empty jobs queued and waited for from worker 0, and a binary tree of jobs each waiting on
+//	  its two children;
+//	- scaling: the same ParallelFor with 1 to JobSystem::MaxWorkers workers, against the single worker run.
+//Each line uses a JobSystem of its own, so nothing else should run jobs meanwhile.
+namespace JobBenchmark
+{
+	void Print();
+}
+
+#endif	//_JOB_BENCHMARK_H_
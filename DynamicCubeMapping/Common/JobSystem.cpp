@@ -0,0 +1,332 @@
+#include "JobSystem.h"
+
+JobSystem::JobSystem():m_tlsIndex(TLS_OUT_OF_INDEXES),
+	m_wake(NULL),
+	m_sleeping(0),
+	m_searching(0),
+	m_quit(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+bool JobSystem::Init(UINT nThreads, UINT nAttached)
+{
+	Shutdown();
+
+	if(nThreads == AutoThreads)
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		nThreads = info.dwNumberOfProcessors > 1 ? info.dwNumberOfProcessors - 1 : 0;
+	}
+	nThreads = min(nThreads,(UINT)MaxWorkers - 1);
+	nAttached = min(nAttached,(UINT)MaxWorkers - 1 - nThreads);
+
+	m_tlsIndex = TlsAlloc();
+	m_wake = CreateSemaphore(NULL,0,MaxWorkers,NULL);
+	if(m_tlsIndex == TLS_OUT_OF_INDEXES || !m_wake)
+	{
+		Shutdown();
+		MessageBox(NULL,L"Create job system failed!",L"Error",MB_OK);
+		return false;
+	}
+	m_quit = 0;
+	m_sleeping = 0;
+	m_searching = 0;
+
+	//Worker 0, the threads, then the attachable workers
+	for(UINT i=0; i<=nThreads+nAttached; ++i)
+	{
+		Worker *worker = new Worker;
+		worker->top = 0;
+		worker->bottom = 0;
+		worker->system = this;
+		worker->index = i;
+		worker->thread = NULL;
+		worker->owned = i <= nThreads;
+		worker->seed = i * 2654435761U + 1;
+		worker->executed = 0;
+		worker->stolen = 0;
+		m_workers.push_back(worker);
+	}
+	//The calling thread is worker 0
+	TlsSetValue(m_tlsIndex,(LPVOID)1);
+
+	//Every worker exists before the threads start stealing from them
+	for(UINT i=1; i<=nThreads; ++i)
+	{
+		m_workers[i]->thread = CreateThread(NULL,0,ThreadMain,m_workers[i],0,NULL);
+		if(!m_workers[i]->thread)
+		{
+			Shutdown();
+			MessageBox(NULL,L"Create worker thread failed!",L"Error",MB_OK);
+			return false;
+		}
+	}
+	return true;
+}
+
+void JobSystem::Shutdown()
+{
+	InterlockedExchange(&m_quit,1);
+	//One release per thread: a release beyond the maximum count fails, but then enough are pending already
+	for(UINT i=1; i<m_workers.size(); ++i)
+		ReleaseSemaphore(m_wake,1,NULL);
+	for(UINT i=1; i<m_workers.size(); ++i)
+	{
+		if(m_workers[i]->thread)
+		{
+			WaitForSingleObject(m_workers[i]->thread,INFINITE);
+			CloseHandle(m_workers[i]->thread);
+		}
+	}
+	for(UINT i=0; i<m_workers.size(); ++i)
+		delete m_workers[i];
+	m_workers.clear();
+
+	if(m_tlsIndex != TLS_OUT_OF_INDEXES)
+	{
+		TlsSetValue(m_tlsIndex,NULL);
+		TlsFree(m_tlsIndex);
+		m_tlsIndex = TLS_OUT_OF_INDEXES;
+	}
+	if(m_wake)
+	{
+		CloseHandle(m_wake);
+		m_wake = NULL;
+	}
+}
+
+bool JobSystem::AttachThread()
+{
+	if(CurrentWorker())
+		return true;
+	for(UINT i=1; i<m_workers.size(); ++i)
+	{
+		if(!m_workers[i]->thread && InterlockedCompareExchange(&m_workers[i]->owned,1,0) == 0)
+		{
+			TlsSetValue(m_tlsIndex,(LPVOID)(UINT_PTR)(i + 1));
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::DetachThread()
+{
+	//Worker 0 stays with the Init thread
+	Worker *worker = CurrentWorker();
+	if(!worker || worker->index == 0 || worker->thread)
+		return;
+	TlsSetValue(m_tlsIndex,NULL);
+	InterlockedExchange(&worker->owned,0);
+}
+
+DWORD WINAPI JobSystem::ThreadMain(LPVOID param)
+{
+	Worker &worker = *static_cast<Worker*>(param);
+	JobSystem &system = *worker.system;
+	TlsSetValue(system.m_tlsIndex,(LPVOID)(UINT_PTR)(worker.index + 1));
+
+	//failed > 0 while the worker is counted in m_searching
+	UINT failed = 0;
+	while(!system.m_quit)
+	{
+		Job job;
+		if(system.FindJob(worker,job))
+		{
+			//The last searching worker wakes another one, in case more jobs are queued
+			if(failed && InterlockedDecrement(&system.m_searching) == 0 && system.m_sleeping > 0)
+				ReleaseSemaphore(system.m_wake,1,NULL);
+			failed = 0;
+			system.Execute(&worker,job);
+		}
+		else if(failed == 0)
+		{
+			InterlockedIncrement(&system.m_searching);
+			failed = 1;
+		}
+		else if(++failed < SpinRounds)
+			Pause(failed);
+		else
+		{
+			InterlockedDecrement(&system.m_searching);
+			system.WaitForJobs();
+			failed = 0;
+		}
+	}
+	return 0;
+}
+
+JobSystem::Worker* JobSystem::CurrentWorker() const
+{
+	if(m_workers.empty())
+		return NULL;
+	UINT index = (UINT)(UINT_PTR)TlsGetValue(m_tlsIndex);
+	return index ? m_workers[index - 1] : NULL;
+}
+
+void JobSystem::Run(JobFunc func, void *data, UINT begin, UINT end, Counter *counter)
+{
+	Job job = { func, data, begin, end, counter };
+	if(counter)
+		InterlockedIncrement(&counter->pending);
+
+	//A full queue runs the job now, which only loses parallelism
+	Worker *worker = CurrentWorker();
+	if(!worker || !Push(*worker,job))
+	{
+		Execute(worker,job);
+		return;
+	}
+	//Push publishes with a full barrier, and a worker stops searching before it counts itself asleep and looks at
+	//the queues a last time: either it sees the job, or it is counted here. A searching worker finds the job.
+	if(m_searching == 0 && m_sleeping > 0)
+		ReleaseSemaphore(m_wake,1,NULL);
+}
+
+void JobSystem::Wait(Counter *counter)
+{
+	Worker *worker = CurrentWorker();
+	UINT failed = 0;
+	while(counter->pending > 0)
+	{
+		Job job;
+		if(worker && FindJob(*worker,job))
+		{
+			Execute(worker,job);
+			failed = 0;
+		}
+		else
+			Pause(++failed);
+	}
+}
+
+//The deque: only the owner moves bottom, and only to push or pop. top only grows, moved by a compare exchange,
+//so the owner and the thieves race for the last job through it.
+bool JobSystem::Push(Worker &worker, const Job &job)
+{
+	LONG bottom = worker.bottom;
+	//The slot of bottom is the slot of top once the queue is full. top may be stale here, but only too low.
+	if(bottom - worker.top >= QueueSize)
+		return false;
+	worker.jobs[bottom & (QueueSize - 1)] = job;
+	InterlockedExchange(&worker.bottom,bottom + 1);
+	return true;
+}
+
+bool JobSystem::Pop(Worker &worker, Job &job)
+{
+	//Take the slot before reading top, so a thief reading bottom after that does not take it too
+	LONG bottom = worker.bottom - 1;
+	InterlockedExchange(&worker.bottom,bottom);
+	LONG top = worker.top;
+	if(top > bottom)
+	{
+		worker.bottom = top;
+		return false;
+	}
+
+	job = worker.jobs[bottom & (QueueSize - 1)];
+	if(top < bottom)
+		return true;
+
+	//Last job: whoever moves top first has it
+	bool taken = InterlockedCompareExchange(&worker.top,top + 1,top) == top;
+	worker.bottom = top + 1;
+	return taken;
+}
+
+bool JobSystem::Steal(Worker &victim, Job &job)
+{
+	LONG top = victim.top;
+	MemoryBarrier();
+	LONG bottom = victim.bottom;
+	if(top >= bottom)
+		return false;
+
+	//Copied before taking it: once top moves, the owner may reuse the slot
+	job = victim.jobs[top & (QueueSize - 1)];
+	MemoryBarrier();
+	return InterlockedCompareExchange(&victim.top,top + 1,top) == top;
+}
+
+bool JobSystem::FindJob(Worker &worker, Job &job)
+{
+	if(Pop(worker,job))
+		return true;
+
+	UINT nWorkers = m_workers.size();
+	if(nWorkers < 2)
+		return false;
+	worker.seed = worker.seed * 1664525U + 1013904223U;
+	UINT start = (worker.seed >> 16) % nWorkers;
+	for(UINT i=0; i<nWorkers; ++i)
+	{
+		Worker &victim = *m_workers[(start + i) % nWorkers];
+		if(&victim != &worker && Steal(victim,job))
+		{
+			++worker.stolen;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::Execute(Worker *worker, const Job &job)
+{
+	job.func(job.data,job.begin,job.end);
+	if(job.counter)
+		InterlockedDecrement(&job.counter->pending);
+	if(worker)
+		++worker->executed;
+}
+
+void JobSystem::Pause(UINT failed)
+{
+	//Give the core away now and then: with more threads than cores, the thread holding the jobs may be waiting for it
+	if(failed % 8)
+		YieldProcessor();
+	else
+		SwitchToThread();
+}
+
+void JobSystem::WaitForJobs()
+{
+	InterlockedIncrement(&m_sleeping);
+	bool queued = m_quit != 0;
+	for(UINT i=0; i<m_workers.size() && !queued; ++i)
+		queued = m_workers[i]->top < m_workers[i]->bottom;
+	if(!queued)
+		WaitForSingleObject(m_wake,INFINITE);
+	InterlockedDecrement(&m_sleeping);
+}
+
+UINT JobSystem::GetExecuted() const
+{
+	UINT executed(0);
+	for(UINT i=0; i<m_workers.size(); ++i)
+		executed += m_workers[i]->executed;
+	return executed;
+}
+
+UINT JobSystem::GetStolen() const
+{
+	UINT stolen(0);
+	for(UINT i=0; i<m_workers.size(); ++i)
+		stolen += m_workers[i]->stolen;
+	return stolen;
+}
+
+void JobSystem::ResetStats()
+{
+	for(UINT i=0; i<m_workers.size(); ++i)
+	{
+		m_workers[i]->executed = 0;
+		m_workers[i]->stolen = 0;
+	}
+}
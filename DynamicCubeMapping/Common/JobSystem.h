@@ -0,0 +1,153 @@
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <Windows.h>
+#include <vector>
+
+//Work-stealing job scheduler. Each worker thread, and the thread that called Init(worker 0), owns a Chase-Lev deque:
+//it pushes and pops jobs at the bottom, the idle workers steal the oldest jobs at the top. A job is a function with
+//a range of indices and a counter; Wait runs other jobs until the counter drops to 0, so jobs may wait on the jobs
+//they spawn. Idle workers search a little, then sleep; a push wakes one only when no worker is searching.
+//
+//Run, Wait and ParallelFor are called from worker 0, from threads attached with AttachThread or from jobs. From any
+//other thread a job runs inline.
+class JobSystem
+{
+public:
+	enum { MaxWorkers = 64, AutoThreads = 0xffffffff };
+
+	typedef void (*JobFunc)(void *data, UINT begin, UINT end);
+
+	//Jobs waited for together
+	struct Counter
+	{
+		volatile LONG	pending;
+
+		Counter():pending(0)	{ }
+	};
+
+	JobSystem();
+	~JobSystem();
+
+	//Start 'nThreads' worker threads besides the calling one, AutoThreads for one per other core; with 0 the jobs run
+	//on the calling thread. 'nAttached' more workers are left for threads of their own to take(e.g. a render thread).
+	bool Init(UINT nThreads = AutoThreads, UINT nAttached = 0);
+	void Shutdown();
+	//Make the calling thread a worker until DetachThread, once its jobs are done. False when none is left.
+	bool AttachThread();
+	void DetachThread();
+	//Threads running jobs, the calling thread of Init included
+	UINT GetWorkerCount()	const	{ return m_workers.size(); }
+
+	//Queue func(data, begin, end)
+	void Run(JobFunc func, void *data, UINT begin, UINT end, Counter *counter);
+	//Run jobs until the jobs of 'counter' are done
+	void Wait(Counter *counter);
+
+	//body(i) for i in [begin, end). The range is split in halves down to 'grain' indices, the halves left for the
+	//thieves, so the idle workers take large ranges first.
+	template<typename F>
+	void ParallelFor(UINT begin, UINT end, UINT grain, const F &body);
+
+	//Jobs executed and stolen since ResetStats
+	UINT GetExecuted() const;
+	UINT GetStolen() const;
+	void ResetStats();
+
+private:
+	enum { QueueSize = 4096, SpinRounds = 64 };			//Failed searches before a worker sleeps
+
+	struct Job
+	{
+		JobFunc		func;
+		void		*data;
+		UINT		begin;
+		UINT		end;
+		Counter		*counter;
+	};
+
+	//top and bottom on their own cache lines: the thieves write one, the owner the other
+	struct Worker
+	{
+		volatile LONG	top;
+		char			pad0[60];
+		volatile LONG	bottom;
+		char			pad1[60];
+		Job				jobs[QueueSize];
+
+		JobSystem		*system;
+		UINT			index;
+		HANDLE			thread;
+		volatile LONG	owned;			//Has a thread: its own, the Init one or an attached one
+		UINT			seed;			//Victim choice
+		UINT			executed;
+		UINT			stolen;
+	};
+
+	template<typename F>
+	struct ForData
+	{
+		const F		*body;
+		UINT		grain;
+		JobSystem	*system;
+		Counter		*counter;
+	};
+
+	template<typename F>
+	static void ForJob(void *data, UINT begin, UINT end);
+
+	static DWORD WINAPI ThreadMain(LPVOID param);
+
+	//Worker of the calling thread, NULL when it is not one
+	Worker* CurrentWorker() const;
+	bool	Push(Worker &worker, const Job &job);
+	bool	Pop(Worker &worker, Job &job);
+	bool	Steal(Worker &victim, Job &job);
+	//Pop, or steal from the other workers starting at a random one
+	bool	FindJob(Worker &worker, Job &job);
+	//Run a job and count it down. 'worker' is NULL for a job run inline.
+	void	Execute(Worker *worker, const Job &job);
+	//Between failed searches
+	static void	Pause(UINT failed);
+	//Sleep until jobs are pushed, unless some are queued already
+	void	WaitForJobs();
+
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+private:
+	std::vector<Worker*>	m_workers;
+	DWORD					m_tlsIndex;			//Worker index + 1 of each thread
+	HANDLE					m_wake;				//Semaphore for sleeping workers
+	volatile LONG			m_sleeping;
+	volatile LONG			m_searching;		//Workers out of jobs, not asleep yet
+	volatile LONG			m_quit;
+};
+
+template<typename F>
+void JobSystem::ForJob(void *data, UINT begin, UINT end)
+{
+	ForData<F> &d = *static_cast<ForData<F>*>(data);
+	while(end - begin > d.grain)
+	{
+		UINT middle = begin + (end - begin) / 2;
+		d.system->Run(&ForJob<F>,data,middle,end,d.counter);
+		end = middle;
+	}
+	for(UINT i=begin; i<end; ++i)
+		(*d.body)(i);
+}
+
+template<typename F>
+void JobSystem::ParallelFor(UINT begin, UINT end, UINT grain, const F &body)
+{
+	if(begin >= end)
+		return;
+
+	Counter counter;
+	ForData<F> data = { &body, max(grain,1U), this, &counter };
+	ForJob<F>(&data,begin,end);
+	Wait(&counter);
+}
+
+#endif	//_JOB_SYSTEM_H_
@@ -0,0 +1,203 @@
+#include "LooseOctree.h"
+#include <cmath>
+
+LooseOctree::LooseOctree(const XNA::AxisAlignedBox &worldBounds, UINT maxDepth):
+	m_freeObject(NullObject),
+	m_objectCount(0),
+	m_maxDepth(min(maxDepth,(UINT)MaxDepth))
+{
+	Node root;
+	root.center = worldBounds.Center;
+	root.halfSize = max(worldBounds.Extents.x,max(worldBounds.Extents.y,worldBounds.Extents.z));
+	root.parent = -1;
+	for(UINT k=0; k<8; ++k)
+		root.children[k] = -1;
+	root.subtreeCount = 0;
+	m_nodes.push_back(root);
+}
+
+int LooseOctree::CreateObject(const XNA::AxisAlignedBox &box, void *userData)
+{
+	int object;
+	if(m_freeObject != NullObject)
+	{
+		object = m_freeObject;
+		m_freeObject = (int)m_objects[object].slot;
+	}
+	else
+	{
+		object = m_objects.size();
+		m_objects.push_back(Object());
+	}
+
+	m_objects[object].userData = userData;
+	AddEntry(FindNode(box),object,box);
+	++m_objectCount;
+
+	return object;
+}
+
+void LooseOctree::DestroyObject(int object)
+{
+	XMASSERT(m_objects[object].node >= 0);
+
+	RemoveEntry(object);
+	m_objects[object].node = -1;
+	m_objects[object].slot = (UINT)m_freeObject;
+	m_objects[object].userData = NULL;
+	m_freeObject = object;
+	--m_objectCount;
+}
+
+bool LooseOctree::MoveObject(int object, const XNA::AxisAlignedBox &box)
+{
+	Object &o = m_objects[object];
+	XMASSERT(o.node >= 0);
+
+	//Stay in the node while the box fits in its loose bounds: no larger than the cell, center inside the cell.
+	//The root also holds the objects outside the world, whatever their size: look for a cell again. Only the root
+	//path looks before removing the entry, the root is never recycled.
+	int target = -1;
+	if(o.node == 0)
+		target = FindNode(box);
+	else
+	{
+		const Node &node = m_nodes[o.node];
+		float half = node.halfSize;
+		if(max(box.Extents.x,max(box.Extents.y,box.Extents.z)) <= half &&
+		   fabs(box.Center.x - node.center.x) <= half &&
+		   fabs(box.Center.y - node.center.y) <= half &&
+		   fabs(box.Center.z - node.center.z) <= half)
+			target = o.node;
+	}
+
+	if(target == o.node)
+	{
+		Entry &entry = m_nodes[o.node].entries[o.slot];
+		entry.center = box.Center;
+		entry.extents = box.Extents;
+		return false;
+	}
+
+	RemoveEntry(object);
+	AddEntry(target >= 0 ? target : FindNode(box),object,box);
+	return true;
+}
+
+void LooseOctree::GetBox(int object, XNA::AxisAlignedBox &box) const
+{
+	const Object &o = m_objects[object];
+	EntryBox(m_nodes[o.node].entries[o.slot],box);
+}
+
+//The deepest cell at least as large as the box, among the cells holding its center
+int LooseOctree::FindNode(const XNA::AxisAlignedBox &box)
+{
+	const Node &root = m_nodes[0];
+	float radius = max(box.Extents.x,max(box.Extents.y,box.Extents.z));
+
+	UINT depth = 0;
+	float half = root.halfSize;
+	while(depth < m_maxDepth && half * 0.5f >= radius)
+	{
+		half *= 0.5f;
+		++depth;
+	}
+	if(depth == 0)
+		return 0;
+
+	//Cell coordinates at that depth. Centers outside the world stay in the root.
+	float invCellSize = 0.5f / half;
+	int cells = 1 << depth;
+	int cx = (int)floor((box.Center.x - root.center.x + root.halfSize) * invCellSize);
+	int cy = (int)floor((box.Center.y - root.center.y + root.halfSize) * invCellSize);
+	int cz = (int)floor((box.Center.z - root.center.z + root.halfSize) * invCellSize);
+	if(cx < 0 || cy < 0 || cz < 0 || cx >= cells || cy >= cells || cz >= cells)
+		return 0;
+
+	int node = 0;
+	for(int bit=depth-1; bit>=0; --bit)
+	{
+		UINT octant = ((cx >> bit) & 1) | (((cy >> bit) & 1) << 1) | (((cz >> bit) & 1) << 2);
+		int child = m_nodes[node].children[octant];
+		if(child < 0)
+			child = AllocateNode(node,octant);
+		node = child;
+	}
+
+	return node;
+}
+
+int LooseOctree::AllocateNode(int parent, UINT octant)
+{
+	int node;
+	if(!m_freeNodes.empty())
+	{
+		node = m_freeNodes.back();
+		m_freeNodes.pop_back();
+	}
+	else
+	{
+		node = m_nodes.size();
+		m_nodes.push_back(Node());
+	}
+
+	//Indexed again after the push_back, which may have moved the nodes
+	Node &p = m_nodes[parent];
+	Node &n = m_nodes[node];
+	float half = 0.5f * p.halfSize;
+	n.center = XMFLOAT3(p.center.x + (octant & 1 ? half : -half),
+		p.center.y + (octant & 2 ? half : -half),
+		p.center.z + (octant & 4 ? half : -half));
+	n.halfSize = half;
+	n.parent = parent;
+	for(UINT k=0; k<8; ++k)
+		n.children[k] = -1;
+	n.subtreeCount = 0;
+	n.entries.clear();
+
+	p.children[octant] = node;
+	return node;
+}
+
+void LooseOctree::AddEntry(int node, int object, const XNA::AxisAlignedBox &box)
+{
+	Entry entry = { box.Center, box.Extents, object };
+	std::vector<Entry> &entries = m_nodes[node].entries;
+	m_objects[object].node = node;
+	m_objects[object].slot = entries.size();
+	entries.push_back(entry);
+
+	for(int n=node; n>=0; n=m_nodes[n].parent)
+		++m_nodes[n].subtreeCount;
+}
+
+void LooseOctree::RemoveEntry(int object)
+{
+	int node = m_objects[object].node;
+	UINT slot = m_objects[object].slot;
+
+	//Fill the hole with the last entry
+	std::vector<Entry> &entries = m_nodes[node].entries;
+	entries[slot] = entries.back();
+	m_objects[entries[slot].object].slot = slot;
+	entries.pop_back();
+
+	//Recycle the nodes left empty, children before their parents
+	for(int n=node; n>=0; )
+	{
+		Node &current = m_nodes[n];
+		int parent = current.parent;
+		if(--current.subtreeCount == 0 && n != 0)
+		{
+			Node &p = m_nodes[parent];
+			for(UINT k=0; k<8; ++k)
+			{
+				if(p.children[k] == n)
+					p.children[k] = -1;
+			}
+			m_freeNodes.push_back(n);
+		}
+		n = parent;
+	}
+}
@@ -0,0 +1,263 @@
+#ifndef _LOOSE_OCTREE_H_
+#define _LOOSE_OCTREE_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include <vector>
+#include "xnacollision.h"
+
+//Loose octree scene index.
+//Each node's bounds are its cell grown to twice the size, so an object only needs its center inside a cell
+//to fit: the depth of an object follows from its size alone, and its node from the position of its center.
+//A node keeps the bounds of its objects in one contiguous array. Moving an object whose center stays in its cell
+//rewrites its entry in place; otherwise it is moved to the node of the new cell, creating it when needed.
+//Empty nodes are recycled.
+class LooseOctree
+{
+public:
+	enum { NullObject = -1, MaxDepth = 10 };
+
+	//Cells cover the cube around 'worldBounds'. Objects outside it are kept in the root.
+	LooseOctree(const XNA::AxisAlignedBox &worldBounds, UINT maxDepth = 5);
+
+	//Add an object and return its id
+	int		CreateObject(const XNA::AxisAlignedBox &box, void *userData);
+	void	DestroyObject(int object);
+	//Update the box of a moving object. Return true when the object changed node.
+	bool	MoveObject(int object, const XNA::AxisAlignedBox &box);
+
+	void*	GetUserData(int object)	const	{ return m_objects[object].userData; }
+	void	GetBox(int object, XNA::AxisAlignedBox &box) const;
+	UINT	GetObjectCount()		const	{ return m_objectCount; }
+	UINT	GetNodeCount()			const	{ return m_nodes.size() - m_freeNodes.size(); }
+
+	//Call callback(object) for every object inside or intersecting the six planes(Dot(plane, point) > 0 is outside,
+	//as XNA::ComputePlanesFromFrustum). Same result as XNA::IntersectAxisAlignedBox6Planes on every object, but
+	//a node fully inside a plane is not tested against it again below, and nodes fully inside all of them(2 in the XNA test)
+	//are reported with all their subtree without further tests. The callback returns false to stop the query.
+	template<typename Callback>
+	void QueryFrustum(const XMVECTOR *planes, Callback &callback) const;
+	template<typename Callback>
+	void QueryFrustum(const XNA::Frustum &frustum, Callback &callback) const;
+
+	//Call callback(object) for every object whose box intersects the sphere or the box
+	template<typename Callback>
+	void QuerySphere(const XNA::Sphere &sphere, Callback &callback) const;
+	template<typename Callback>
+	void QueryAABB(const XNA::AxisAlignedBox &box, Callback &callback) const;
+
+private:
+	enum { StackSize = 8 * MaxDepth + 1 };
+
+	//Object bounds as stored in the nodes
+	struct Entry
+	{
+		XMFLOAT3	center;
+		XMFLOAT3	extents;
+		int			object;
+	};
+
+	struct Node
+	{
+		XMFLOAT3			center;			//Center of the cell
+		float				halfSize;		//Half size of the cell, the loose bounds are twice as large
+		int					parent;
+		int					children[8];	//-1 when absent; child k holds the octant with bit 0: +x, bit 1: +y, bit 2: +z
+		UINT				subtreeCount;	//Objects in this node and below. The node is recycled when it drops to 0.
+		std::vector<Entry>	entries;
+	};
+
+	struct Object
+	{
+		int		node;					//-1 while the object is unused
+		UINT	slot;					//Index in the node's entries, or the next free object while unused
+		void	*userData;
+	};
+
+	int		FindNode(const XNA::AxisAlignedBox &box);
+	int		AllocateNode(int parent, UINT octant);
+	void	AddEntry(int node, int object, const XNA::AxisAlignedBox &box);
+	void	RemoveEntry(int object);
+
+	static inline void LooseBox(const Node &node, XNA::AxisAlignedBox &box)
+	{
+		box.Center = node.center;
+		box.Extents = XMFLOAT3(2.f * node.halfSize,2.f * node.halfSize,2.f * node.halfSize);
+	}
+	static inline void EntryBox(const Entry &entry, XNA::AxisAlignedBox &box)
+	{
+		box.Center = entry.center;
+		box.Extents = entry.extents;
+	}
+
+	//Test a box against the planes in 'mask' and drop the planes it is fully inside from the mask. Return false when outside.
+	static inline bool ClipPlanes(FXMVECTOR center, FXMVECTOR extents, const XMVECTOR *planes, const XMVECTOR *absPlanes, UINT &mask)
+	{
+		for(UINT i=0; i<6; ++i)
+		{
+			if(!(mask & (1 << i)))
+				continue;
+
+			float dist = XMVectorGetX(XMPlaneDotCoord(planes[i],center));
+			float radius = XMVectorGetX(XMVector3Dot(absPlanes[i],extents));
+			if(dist > radius)
+				return false;
+			if(dist < -radius)
+				mask &= ~(1 << i);
+		}
+		return true;
+	}
+
+	//Visit the nodes whose loose bounds pass 'test'(0 outside, 1 intersecting, 2 inside) and the entries passing 'test'
+	//in the intersecting nodes. The root is never culled, since it also holds the objects outside the world.
+	template<typename Test, typename Callback>
+	void Query(const Test &test, Callback &callback) const;
+
+	LooseOctree(const LooseOctree&);
+	LooseOctree& operator=(const LooseOctree&);
+
+private:
+	std::vector<Node>	m_nodes;			//Node 0 is the root
+	std::vector<int>	m_freeNodes;
+	std::vector<Object>	m_objects;
+	int					m_freeObject;
+	UINT				m_objectCount;
+	UINT				m_maxDepth;
+};
+
+template<typename Test, typename Callback>
+void LooseOctree::Query(const Test &test, Callback &callback) const
+{
+	struct Item
+	{
+		int		node;
+		bool	inside;
+	};
+
+	Item stack[StackSize];
+	int top = 0;
+	Item root = { 0, false };
+	stack[top++] = root;
+	while(top > 0)
+	{
+		Item item = stack[--top];
+		const Node &node = m_nodes[item.node];
+		if(node.subtreeCount == 0)
+			continue;
+
+		bool inside = item.inside;
+		if(!inside && item.node != 0)
+		{
+			XNA::AxisAlignedBox loose;
+			LooseBox(node,loose);
+			INT result = test(loose);
+			if(result == 0)
+				continue;
+			inside = result == 2;
+		}
+
+		for(UINT i=0; i<node.entries.size(); ++i)
+		{
+			const Entry &entry = node.entries[i];
+			if(!inside)
+			{
+				XNA::AxisAlignedBox box;
+				EntryBox(entry,box);
+				if(test(box) == 0)
+					continue;
+			}
+			if(!callback(entry.object))
+				return;
+		}
+
+		for(UINT k=0; k<8; ++k)
+		{
+			if(node.children[k] < 0)
+				continue;
+			XMASSERT(top < StackSize);
+			Item child = { node.children[k], inside };
+			stack[top++] = child;
+		}
+	}
+}
+
+template<typename Callback>
+void LooseOctree::QueryFrustum(const XMVECTOR *planes, Callback &callback) const
+{
+	XMVECTOR absPlanes[6];
+	for(UINT i=0; i<6; ++i)
+		absPlanes[i] = XMVectorAbs(planes[i]);
+
+	struct Item
+	{
+		int		node;
+		UINT	mask;						//Planes the parent straddles, 0 when it is fully inside
+	};
+
+	Item stack[StackSize];
+	int top = 0;
+	Item root = { 0, 0x3f };
+	stack[top++] = root;
+	while(top > 0)
+	{
+		Item item = stack[--top];
+		const Node &node = m_nodes[item.node];
+		if(node.subtreeCount == 0)
+			continue;
+
+		UINT mask = item.mask;
+		if(mask && item.node != 0)
+		{
+			float loose = 2.f * node.halfSize;
+			if(!ClipPlanes(XMLoadFloat3(&node.center),XMVectorReplicate(loose),planes,absPlanes,mask))
+				continue;
+		}
+
+		for(UINT i=0; i<node.entries.size(); ++i)
+		{
+			const Entry &entry = node.entries[i];
+			UINT entryMask = mask;
+			if(mask && !ClipPlanes(XMLoadFloat3(&entry.center),XMLoadFloat3(&entry.extents),planes,absPlanes,entryMask))
+				continue;
+			if(!callback(entry.object))
+				return;
+		}
+
+		for(UINT k=0; k<8; ++k)
+		{
+			if(node.children[k] < 0)
+				continue;
+			XMASSERT(top < StackSize);
+			Item child = { node.children[k], mask };
+			stack[top++] = child;
+		}
+	}
+}
+
+template<typename Callback>
+void LooseOctree::QueryFrustum(const XNA::Frustum &frustum, Callback &callback) const
+{
+	XMVECTOR planes[6];
+	XNA::ComputePlanesFromFrustum(&frustum,&planes[0],&planes[1],&planes[2],&planes[3],&planes[4],&planes[5]);
+	QueryFrustum(planes,callback);
+}
+
+template<typename Callback>
+void LooseOctree::QuerySphere(const XNA::Sphere &sphere, Callback &callback) const
+{
+	Query([&](const XNA::AxisAlignedBox &box) -> INT
+	{
+		return XNA::IntersectSphereAxisAlignedBox(&sphere,&box) ? 1 : 0;
+	},callback);
+}
+
+template<typename Callback>
+void LooseOctree::QueryAABB(const XNA::AxisAlignedBox &box, Callback &callback) const
+{
+	Query([&](const XNA::AxisAlignedBox &other) -> INT
+	{
+		return XNA::IntersectAxisAlignedBoxAxisAlignedBox(&box,&other) ? 1 : 0;
+	},callback);
+}
+
+#endif	//_LOOSE_OCTREE_H_
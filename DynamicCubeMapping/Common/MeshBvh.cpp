@@ -0,0 +1,640 @@
+#include "MeshBvh.h"
+#include <ppl.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+//Build parameters
+static const UINT	g_nBins = 16;					//SAH candidates per axis
+static const UINT	g_maxLeafSize = 8;				//Larger nodes are always split
+static const float	g_traversalCost = 1.f;			//Cost of an inner node, relative to one triangle test
+static const UINT	g_parallelSubtree = 4096;		//Smaller subtrees are built on the calling thread
+static const UINT	g_chunkSize = 16384;			//Triangles per task when a single node is processed in parallel
+static const UINT	g_maxSahDepth = 30;				//Deeper nodes are split at the median
+//Traversal stack size. A median split halves a node, so no leaf is deeper than g_maxSahDepth + 32 and a stack holds
+//at most one entry per level, plus one.
+static const UINT	g_maxDepth = 64;
+
+struct BuildBox
+{
+	float	bmin[3];
+	float	bmax[3];
+
+	void Reset()
+	{
+		bmin[0] = bmin[1] = bmin[2] = FLT_MAX;
+		bmax[0] = bmax[1] = bmax[2] = -FLT_MAX;
+	}
+
+	void Grow(const float *p)
+	{
+		for(UINT a=0; a<3; ++a)
+		{
+			bmin[a] = min(bmin[a],p[a]);
+			bmax[a] = max(bmax[a],p[a]);
+		}
+	}
+
+	void Grow(const BuildBox &b)
+	{
+		for(UINT a=0; a<3; ++a)
+		{
+			bmin[a] = min(bmin[a],b.bmin[a]);
+			bmax[a] = max(bmax[a],b.bmax[a]);
+		}
+	}
+
+	float HalfArea() const
+	{
+		float dx = bmax[0] - bmin[0];
+		float dy = bmax[1] - bmin[1];
+		float dz = bmax[2] - bmin[2];
+		return dx < 0.f ? 0.f : dx * dy + dy * dz + dz * dx;
+	}
+};
+
+struct BuildBin
+{
+	BuildBox	bounds;
+	BuildBox	centroids;
+	UINT		count;
+};
+
+struct BuildBins
+{
+	BuildBin	bins[3][g_nBins];
+
+	UINT		nBins;				//Small nodes use fewer bins
+
+	void Reset(UINT n)
+	{
+		nBins = n;
+		for(UINT a=0; a<3; ++a)
+		{
+			for(UINT b=0; b<nBins; ++b)
+			{
+				bins[a][b].bounds.Reset();
+				bins[a][b].centroids.Reset();
+				bins[a][b].count = 0;
+			}
+		}
+	}
+};
+
+struct BuildContext
+{
+	std::vector<BuildBox>	boxes;			//Per source triangle
+	std::vector<XMFLOAT3>	centroids;		//Per source triangle, center of its box
+	std::vector<UINT>		order;			//Triangle order, partitioned in place while building
+
+	MeshBvh::Node			*nodes;
+	volatile LONG			nodeCount;
+};
+
+//Run f(begin, end) over chunks of [0, count) in parallel
+template<typename Func>
+static void ForEachChunk(UINT count, const Func &f)
+{
+	UINT nChunks = (count + g_chunkSize - 1) / g_chunkSize;
+	Concurrency::parallel_for(0u,nChunks,[&](UINT c)
+	{
+		UINT begin = c * g_chunkSize;
+		f(begin,min(begin + g_chunkSize,count));
+	});
+}
+
+static void SummarizeChunk(const BuildContext &ctx, UINT begin, UINT end, BuildBox &bounds, BuildBox &centroidBounds)
+{
+	bounds.Reset();
+	centroidBounds.Reset();
+	for(UINT i=begin; i<end; ++i)
+	{
+		UINT t = ctx.order[i];
+		bounds.Grow(ctx.boxes[t]);
+		centroidBounds.Grow(&ctx.centroids[t].x);
+	}
+}
+
+//Bounds of the triangles and of their centroids in order[begin, end)
+static void Summarize(const BuildContext &ctx, UINT begin, UINT end, BuildBox &bounds, BuildBox &centroidBounds)
+{
+	if(end - begin <= g_chunkSize)
+	{
+		SummarizeChunk(ctx,begin,end,bounds,centroidBounds);
+		return;
+	}
+
+	UINT nChunks = (end - begin + g_chunkSize - 1) / g_chunkSize;
+	std::vector<BuildBox> chunkBounds(nChunks), chunkCentroids(nChunks);
+	ForEachChunk(end - begin,[&](UINT first, UINT last)
+	{
+		SummarizeChunk(ctx,begin + first,begin + last,chunkBounds[first / g_chunkSize],chunkCentroids[first / g_chunkSize]);
+	});
+
+	bounds = chunkBounds[0];
+	centroidBounds = chunkCentroids[0];
+	for(UINT c=1; c<nChunks; ++c)
+	{
+		bounds.Grow(chunkBounds[c]);
+		centroidBounds.Grow(chunkCentroids[c]);
+	}
+}
+
+static inline UINT BinIndex(float c, float cmin, float scale, UINT nBins)
+{
+	UINT b = static_cast<UINT>((c - cmin) * scale);
+	return min(b,nBins - 1);
+}
+
+static void BinChunk(const BuildContext &ctx, UINT begin, UINT end, const BuildBox &centroidBounds, const float *scale, UINT nBins, BuildBins &out)
+{
+	out.Reset(nBins);
+	for(UINT i=begin; i<end; ++i)
+	{
+		UINT t = ctx.order[i];
+		const float *c = &ctx.centroids[t].x;
+		for(UINT a=0; a<3; ++a)
+		{
+			BuildBin &bin = out.bins[a][BinIndex(c[a],centroidBounds.bmin[a],scale[a],nBins)];
+			bin.bounds.Grow(ctx.boxes[t]);
+			bin.centroids.Grow(c);
+			++bin.count;
+		}
+	}
+}
+
+//Drop the triangles of order[begin, end) into bins along all three axes
+static void Bin(const BuildContext &ctx, UINT begin, UINT end, const BuildBox &centroidBounds, const float *scale, UINT nBins, BuildBins &out)
+{
+	if(end - begin <= g_chunkSize)
+	{
+		BinChunk(ctx,begin,end,centroidBounds,scale,nBins,out);
+		return;
+	}
+
+	UINT nChunks = (end - begin + g_chunkSize - 1) / g_chunkSize;
+	std::vector<BuildBins> chunkBins(nChunks);
+	ForEachChunk(end - begin,[&](UINT first, UINT last)
+	{
+		BinChunk(ctx,begin + first,begin + last,centroidBounds,scale,nBins,chunkBins[first / g_chunkSize]);
+	});
+
+	out = chunkBins[0];
+	for(UINT c=1; c<nChunks; ++c)
+	{
+		for(UINT a=0; a<3; ++a)
+		{
+			for(UINT b=0; b<nBins; ++b)
+			{
+				BuildBin &bin = out.bins[a][b];
+				bin.bounds.Grow(chunkBins[c].bins[a][b].bounds);
+				bin.centroids.Grow(chunkBins[c].bins[a][b].centroids);
+				bin.count += chunkBins[c].bins[a][b].count;
+			}
+		}
+	}
+}
+
+//Lowest SAH cost over all bin boundaries. Return false when the centroids do not spread along any axis.
+static bool FindSplit(const BuildContext &ctx, UINT begin, UINT end, const BuildBox &centroidBounds,
+					  BuildBins &bins, float *scale, UINT &bestAxis, UINT &bestBin, float &bestCost)
+{
+	UINT nBins = min(end - begin,g_nBins);
+	bool spread = false;
+	for(UINT a=0; a<3; ++a)
+	{
+		float extent = centroidBounds.bmax[a] - centroidBounds.bmin[a];
+		scale[a] = extent > 0.f ? nBins / extent : 0.f;
+		spread = spread || extent > 0.f;
+	}
+	if(!spread)
+		return false;
+
+	Bin(ctx,begin,end,centroidBounds,scale,nBins,bins);
+
+	bestCost = FLT_MAX;
+	for(UINT a=0; a<3; ++a)
+	{
+		if(scale[a] == 0.f)
+			continue;
+
+		//Sweep from the left, then from the right: the split before bin b has bins [0, b) on its left
+		float leftCost[g_nBins - 1];
+		BuildBox box;
+		box.Reset();
+		UINT count = 0;
+		for(UINT b=0; b<nBins - 1; ++b)
+		{
+			box.Grow(bins.bins[a][b].bounds);
+			count += bins.bins[a][b].count;
+			leftCost[b] = box.HalfArea() * count;
+		}
+
+		box.Reset();
+		count = 0;
+		for(UINT b=nBins - 1; b>0; --b)
+		{
+			box.Grow(bins.bins[a][b].bounds);
+			count += bins.bins[a][b].count;
+			float cost = leftCost[b - 1] + box.HalfArea() * count;
+			if(cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = a;
+				bestBin = b;
+			}
+		}
+	}
+
+	return true;
+}
+
+//Build the subtree of order[begin, end) into 'nodeIndex', 'depth' levels below the root. Return the depth of its deepest leaf.
+//The bounds are passed down from the parent's bins when known, otherwise computed here.
+static UINT BuildNode(BuildContext &ctx, UINT nodeIndex, UINT begin, UINT end, UINT depth, const BuildBox *knownBounds, const BuildBox *knownCentroids)
+{
+	BuildBox bounds, centroidBounds;
+	if(knownBounds)
+	{
+		bounds = *knownBounds;
+		centroidBounds = *knownCentroids;
+	}
+	else
+	{
+		Summarize(ctx,begin,end,bounds,centroidBounds);
+	}
+
+	MeshBvh::Node &node = ctx.nodes[nodeIndex];
+	node.boxMin = XMFLOAT3(bounds.bmin[0],bounds.bmin[1],bounds.bmin[2]);
+	node.boxMax = XMFLOAT3(bounds.bmax[0],bounds.bmax[1],bounds.bmax[2]);
+
+	UINT count = end - begin;
+	UINT mid = begin;
+	BuildBox childBounds[2], childCentroids[2];
+	bool childrenKnown = false;
+	if(depth >= g_maxSahDepth)
+	{
+		//Too deep for the traversal stacks if the SAH keeps cutting thin slices(fans, strips of long triangles):
+		//halve the node along the widest spread of its centroids instead
+		if(count > g_maxLeafSize)
+		{
+			UINT axis = 0;
+			for(UINT a=1; a<3; ++a)
+			{
+				if(centroidBounds.bmax[a] - centroidBounds.bmin[a] > centroidBounds.bmax[axis] - centroidBounds.bmin[axis])
+					axis = a;
+			}
+			mid = begin + count / 2;
+			const XMFLOAT3 *centroids = &ctx.centroids[0];
+			std::nth_element(&ctx.order[0] + begin,&ctx.order[0] + mid,&ctx.order[0] + end,[=](UINT a, UINT b)
+			{
+				return (&centroids[a].x)[axis] < (&centroids[b].x)[axis];
+			});
+		}
+	}
+	else if(count > 1)
+	{
+		BuildBins bins;
+		float scale[3];
+		UINT axis = 0, splitBin = 0;
+		float cost = FLT_MAX;
+		if(FindSplit(ctx,begin,end,centroidBounds,bins,scale,axis,splitBin,cost))
+		{
+			//SAH: traversal cost plus the expected triangle tests of both children, against testing all triangles here
+			float area = bounds.HalfArea();
+			float splitCost = g_traversalCost + (area > 0.f ? cost / area : 0.f);
+			if(count > g_maxLeafSize || splitCost < count)
+			{
+				float cmin = centroidBounds.bmin[axis];
+				float s = scale[axis];
+				UINT nBins = bins.nBins;
+				const XMFLOAT3 *centroids = &ctx.centroids[0];
+				UINT *split = std::partition(&ctx.order[0] + begin,&ctx.order[0] + end,[=](UINT t)
+				{
+					return BinIndex((&centroids[t].x)[axis],cmin,s,nBins) < splitBin;
+				});
+				mid = static_cast<UINT>(split - &ctx.order[0]);
+
+				if(mid == begin || mid == end)
+				{
+					//Every bin is on one side: fall back to a median split
+					mid = begin + count / 2;
+				}
+				else
+				{
+					for(UINT c=0; c<2; ++c)
+					{
+						childBounds[c].Reset();
+						childCentroids[c].Reset();
+					}
+					for(UINT b=0; b<nBins; ++b)
+					{
+						UINT c = b < splitBin ? 0 : 1;
+						childBounds[c].Grow(bins.bins[axis][b].bounds);
+						childCentroids[c].Grow(bins.bins[axis][b].centroids);
+					}
+					childrenKnown = true;
+				}
+			}
+		}
+		else if(count > g_maxLeafSize)
+		{
+			//All centroids at the same point
+			mid = begin + count / 2;
+		}
+	}
+
+	if(mid == begin)
+	{
+		node.first = begin;
+		node.count = count;
+		return depth;
+	}
+
+	UINT left = static_cast<UINT>(InterlockedExchangeAdd(&ctx.nodeCount,2));
+	node.first = left;
+	node.count = 0;
+
+	const BuildBox *bounds0 = childrenKnown ? &childBounds[0] : NULL;
+	const BuildBox *bounds1 = childrenKnown ? &childBounds[1] : NULL;
+	const BuildBox *centroids0 = childrenKnown ? &childCentroids[0] : NULL;
+	const BuildBox *centroids1 = childrenKnown ? &childCentroids[1] : NULL;
+	UINT depth0(0), depth1(0);
+	if(count > g_parallelSubtree)
+	{
+		Concurrency::parallel_invoke(
+			[&]() { depth0 = BuildNode(ctx,left,begin,mid,depth + 1,bounds0,centroids0); },
+			[&]() { depth1 = BuildNode(ctx,left + 1,mid,end,depth + 1,bounds1,centroids1); });
+	}
+	else
+	{
+		depth0 = BuildNode(ctx,left,begin,mid,depth + 1,bounds0,centroids0);
+		depth1 = BuildNode(ctx,left + 1,mid,end,depth + 1,bounds1,centroids1);
+	}
+	return max(depth0,depth1);
+}
+
+MeshBvh::MeshBvh():m_depth(0)
+{
+}
+
+void MeshBvh::Clear()
+{
+	m_nodes.clear();
+	m_triangles.clear();
+	m_sourceTriangles.clear();
+	m_depth = 0;
+}
+
+void MeshBvh::Build(const GeoGen::MeshData &mesh)
+{
+	if(mesh.indices.empty())
+	{
+		Clear();
+		return;
+	}
+
+	Build(&mesh.vertices[0].pos,sizeof(GeoGen::Vertex),&mesh.indices[0],mesh.indices.size() / 3);
+}
+
+void MeshBvh::Build(const XMFLOAT3 *positions, UINT stride, const UINT *indices, UINT nTriangles)
+{
+	Clear();
+	if(nTriangles == 0)
+		return;
+
+	const BYTE *base = reinterpret_cast<const BYTE*>(positions);
+
+	BuildContext ctx;
+	ctx.boxes.resize(nTriangles);
+	ctx.centroids.resize(nTriangles);
+	ctx.order.resize(nTriangles);
+	ForEachChunk(nTriangles,[&](UINT first, UINT last)
+	{
+		for(UINT t=first; t<last; ++t)
+		{
+			BuildBox &box = ctx.boxes[t];
+			box.Reset();
+			for(UINT k=0; k<3; ++k)
+			{
+				box.Grow(&reinterpret_cast<const XMFLOAT3*>(base + indices[3 * t + k] * stride)->x);
+			}
+			ctx.centroids[t] = XMFLOAT3((box.bmin[0] + box.bmax[0]) * 0.5f,(box.bmin[1] + box.bmax[1]) * 0.5f,(box.bmin[2] + box.bmax[2]) * 0.5f);
+			ctx.order[t] = t;
+		}
+	});
+
+	//A binary tree with one triangle per leaf at most has 2n - 1 nodes
+	m_nodes.resize(2 * nTriangles - 1);
+	ctx.nodes = &m_nodes[0];
+	ctx.nodeCount = 1;
+	m_depth = BuildNode(ctx,0,0,nTriangles,0,NULL,NULL);
+	XMASSERT(m_depth < g_maxDepth);
+	m_nodes.resize(ctx.nodeCount);
+
+	//Store the triangles in leaf order
+	m_triangles.resize(nTriangles);
+	ForEachChunk(nTriangles,[&](UINT first, UINT last)
+	{
+		for(UINT i=first; i<last; ++i)
+		{
+			UINT t = ctx.order[i];
+			XMVECTOR v0 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + indices[3 * t] * stride));
+			XMVECTOR v1 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + indices[3 * t + 1] * stride));
+			XMVECTOR v2 = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + indices[3 * t + 2] * stride));
+			XMStoreFloat3(&m_triangles[i].v0,v0);
+			XMStoreFloat3(&m_triangles[i].e1,XMVectorSubtract(v1,v0));
+			XMStoreFloat3(&m_triangles[i].e2,XMVectorSubtract(v2,v0));
+		}
+	});
+	m_sourceTriangles.swap(ctx.order);
+}
+
+//Ray with a precomputed inverse direction for the slab tests
+struct BvhRay
+{
+	float	o[3];
+	float	d[3];
+	float	inv[3];
+};
+
+static void SetupRay(FXMVECTOR origin, FXMVECTOR direction, BvhRay &ray)
+{
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(ray.o),origin);
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(ray.d),direction);
+	for(UINT a=0; a<3; ++a)
+	{
+		//Keep the slab distances finite for axis aligned rays
+		float d = fabs(ray.d[a]) < 1e-30f ? (ray.d[a] < 0.f ? -1e-30f : 1e-30f) : ray.d[a];
+		ray.inv[a] = 1.f / d;
+	}
+}
+
+//Entry distance of the ray into the node's box, or FLT_MAX when it misses the box within [0, tMax]
+static inline float RayBox(const MeshBvh::Node &node, const BvhRay &ray, float tMax)
+{
+	float t0 = (node.boxMin.x - ray.o[0]) * ray.inv[0];
+	float t1 = (node.boxMax.x - ray.o[0]) * ray.inv[0];
+	float tNear = min(t0,t1);
+	float tFar = max(t0,t1);
+
+	t0 = (node.boxMin.y - ray.o[1]) * ray.inv[1];
+	t1 = (node.boxMax.y - ray.o[1]) * ray.inv[1];
+	tNear = max(tNear,min(t0,t1));
+	tFar = min(tFar,max(t0,t1));
+
+	t0 = (node.boxMin.z - ray.o[2]) * ray.inv[2];
+	t1 = (node.boxMax.z - ray.o[2]) * ray.inv[2];
+	tNear = max(tNear,min(t0,t1));
+	tFar = min(tFar,max(t0,t1));
+
+	tNear = max(tNear,0.f);
+	tFar = min(tFar,tMax);
+	return tNear <= tFar ? tNear : FLT_MAX;
+}
+
+//Moller-Trumbore ray/triangle test, two sided
+static inline bool RayTriangle(const MeshBvh::Triangle &tri, const BvhRay &ray, float tMax, float &t, float &u, float &v)
+{
+	const float *d = ray.d;
+	float px = d[1] * tri.e2.z - d[2] * tri.e2.y;
+	float py = d[2] * tri.e2.x - d[0] * tri.e2.z;
+	float pz = d[0] * tri.e2.y - d[1] * tri.e2.x;
+
+	float det = tri.e1.x * px + tri.e1.y * py + tri.e1.z * pz;
+	if(det == 0.f)
+		return false;
+	float invDet = 1.f / det;
+
+	float sx = ray.o[0] - tri.v0.x;
+	float sy = ray.o[1] - tri.v0.y;
+	float sz = ray.o[2] - tri.v0.z;
+	u = (sx * px + sy * py + sz * pz) * invDet;
+	if(u < 0.f || u > 1.f)
+		return false;
+
+	float qx = sy * tri.e1.z - sz * tri.e1.y;
+	float qy = sz * tri.e1.x - sx * tri.e1.z;
+	float qz = sx * tri.e1.y - sy * tri.e1.x;
+	v = (d[0] * qx + d[1] * qy + d[2] * qz) * invDet;
+	if(v < 0.f || u + v > 1.f)
+		return false;
+
+	t = (tri.e2.x * qx + tri.e2.y * qy + tri.e2.z * qz) * invDet;
+	return t >= 0.f && t <= tMax;
+}
+
+bool MeshBvh::IntersectRay(FXMVECTOR origin, FXMVECTOR direction, float maxDist, RayHit &hit) const
+{
+	if(m_nodes.empty())
+		return false;
+
+	BvhRay ray;
+	SetupRay(origin,direction,ray);
+	if(RayBox(m_nodes[0],ray,maxDist) == FLT_MAX)
+		return false;
+
+	//Far children waiting to be visited, with their entry distances
+	UINT stack[g_maxDepth];
+	float stackDist[g_maxDepth];
+	UINT top = 0;
+
+	float best = maxDist;
+	bool found = false;
+	UINT nodeIndex = 0;
+	for(;;)
+	{
+		const Node &node = m_nodes[nodeIndex];
+		if(node.count)
+		{
+			for(UINT i=node.first; i<node.first + node.count; ++i)
+			{
+				float t, u, v;
+				if(RayTriangle(m_triangles[i],ray,best,t,u,v))
+				{
+					best = t;
+					hit.dist = t;
+					hit.u = u;
+					hit.v = v;
+					hit.triangle = m_sourceTriangles[i];
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			//Visit the closer child first
+			UINT child0 = node.first, child1 = node.first + 1;
+			float dist0 = RayBox(m_nodes[child0],ray,best);
+			float dist1 = RayBox(m_nodes[child1],ray,best);
+			if(dist1 < dist0)
+			{
+				std::swap(child0,child1);
+				std::swap(dist0,dist1);
+			}
+
+			if(dist0 != FLT_MAX)
+			{
+				if(dist1 != FLT_MAX)
+				{
+					XMASSERT(top < g_maxDepth);
+					stack[top] = child1;
+					stackDist[top] = dist1;
+					++top;
+				}
+				nodeIndex = child0;
+				continue;
+			}
+		}
+
+		//Next pending node that is not behind the closest hit so far
+		bool pending = false;
+		while(top > 0 && !pending)
+		{
+			--top;
+			pending = stackDist[top] <= best;
+			nodeIndex = stack[top];
+		}
+		if(!pending)
+			break;
+	}
+
+	return found;
+}
+
+bool MeshBvh::IntersectRayAny(FXMVECTOR origin, FXMVECTOR direction, float maxDist) const
+{
+	if(m_nodes.empty())
+		return false;
+
+	BvhRay ray;
+	SetupRay(origin,direction,ray);
+
+	UINT stack[g_maxDepth];
+	UINT top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		const Node &node = m_nodes[stack[--top]];
+		if(RayBox(node,ray,maxDist) == FLT_MAX)
+			continue;
+
+		if(node.count)
+		{
+			for(UINT i=node.first; i<node.first + node.count; ++i)
+			{
+				float t, u, v;
+				if(RayTriangle(m_triangles[i],ray,maxDist,t,u,v))
+					return true;
+			}
+		}
+		else
+		{
+			XMASSERT(top + 2 <= g_maxDepth);
+			stack[top++] = node.first + 1;
+			stack[top++] = node.first;
+		}
+	}
+
+	return false;
+}
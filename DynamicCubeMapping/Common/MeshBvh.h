@@ -0,0 +1,66 @@
+#ifndef _MESH_BVH_H_
+#define _MESH_BVH_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include <vector>
+#include "GeometryGens.h"
+
+//Bounding volume hierarchy over the triangles of a mesh, for ray queries.
+//Built top-down with the binned surface area heuristic(SAH), subtrees are built in parallel.
+class MeshBvh
+{
+public:
+	//32 bytes. The children of an inner node are stored next to each other, in no particular cache line.
+	struct Node
+	{
+		XMFLOAT3	boxMin;
+		UINT		first;			//Inner node: index of the left child(the right one is first + 1). Leaf: first triangle
+		XMFLOAT3	boxMax;
+		UINT		count;			//Number of triangles in a leaf, 0 for inner nodes
+	};
+
+	//Triangle in BVH order, stored as one vertex and two edges for the ray test
+	struct Triangle
+	{
+		XMFLOAT3	v0;
+		XMFLOAT3	e1;				//v1 - v0
+		XMFLOAT3	e2;				//v2 - v0
+	};
+
+	struct RayHit
+	{
+		float	dist;				//Hit point is origin + dist * direction
+		float	u, v;				//Barycentric coordinates of the hit point(weights of vertex 1 and 2)
+		UINT	triangle;			//Triangle index in the source mesh(its indices start at 3 * triangle)
+	};
+
+	MeshBvh();
+
+	//Build from a mesh, or from any position array with 'stride' bytes between positions
+	void Build(const GeoGen::MeshData &mesh);
+	void Build(const XMFLOAT3 *positions, UINT stride, const UINT *indices, UINT nTriangles);
+	void Clear();
+
+	//Closest hit with a distance in [0, maxDist]. Triangles are two sided.
+	bool IntersectRay(FXMVECTOR origin, FXMVECTOR direction, float maxDist, RayHit &hit) const;
+	//Any hit with a distance in [0, maxDist], e.g. for shadow or visibility rays
+	bool IntersectRayAny(FXMVECTOR origin, FXMVECTOR direction, float maxDist) const;
+
+	UINT			NodeCount()				const	{ return m_nodes.size(); }
+	//Levels from the root to the deepest leaf, below 64
+	UINT			Depth()					const	{ return m_depth; }
+	UINT			TriangleCount()			const	{ return m_triangles.size(); }
+	const Node&		GetNode(UINT i)			const	{ return m_nodes[i]; }
+	const Triangle&	GetTriangle(UINT i)		const	{ return m_triangles[i]; }
+	//Source mesh index of the i-th triangle in BVH order
+	UINT			SourceTriangle(UINT i)	const	{ return m_sourceTriangles[i]; }
+
+private:
+	std::vector<Node>		m_nodes;				//Root at index 0
+	std::vector<Triangle>	m_triangles;			//Leaves index into this array
+	std::vector<UINT>		m_sourceTriangles;
+	UINT					m_depth;
+};
+
+#endif	//_MESH_BVH_H_
@@ -0,0 +1,365 @@
+#include "MeshCollision.h"
+#include "AppUtil.h"
+#include "xnacollision.h"
+#include <ppl.h>
+#include <cmath>
+
+namespace MeshCollision
+{
+	static const UINT	g_maxStack = 512;				//Pending node pairs of one traversal on the stack, see Traverse
+	static const UINT	g_parallelPairs = 64;			//Subtree pairs gathered before the parallel traversal
+	static const float	g_parallelAxis = 1e-6f;			//Edge axes shorter than this, relative to the edges, are skipped
+	static const XMVECTORF32 g_margin = { 1.00001f, 1.00001f, 1.00001f, 1.00001f };	//Radius growth against rounding,
+																						//the boxes only need to be conservative
+
+	//Constants of the separating axis test between boxes of A(axis aligned in A) and boxes of B, oriented by bToA.
+	//B's half axes are extents[j] * row j of the matrix, which need not be orthonormal.
+	struct Relative
+	{
+		float	rows[4][3];			//Axes and origin of B in A
+		float	absRows[3][3];		//|rows|, to project B on A's axes
+		float	normals[3][3];		//Face normals of B: row j + 1 x row j + 2
+		float	absNormals[3][3];	//To project A on B's face normals
+		float	normalDots[3];		//|row j . normal j|, to project B on its own face normals
+		float	edges[9][3];		//A axis k x row j at 3 * k + j, zero when nearly parallel
+		float	absEdges[9][3];		//To project A on the edge axes
+		float	edgeDots[9][3];		//|row m . edge axis|, to project B on the edge axes
+	};
+
+	static void SetupRelative(CXMMATRIX bToA, Relative &rel)
+	{
+		for(UINT r=0; r<4; ++r)
+		{
+			XMFLOAT3 row;
+			XMStoreFloat3(&row,bToA.r[r]);
+			rel.rows[r][0] = row.x;
+			rel.rows[r][1] = row.y;
+			rel.rows[r][2] = row.z;
+		}
+
+		for(UINT j=0; j<3; ++j)
+		{
+			XMVECTOR row = XMLoadFloat3((const XMFLOAT3*)rel.rows[j]);
+			XMVECTOR normal = XMVector3Cross(XMLoadFloat3((const XMFLOAT3*)rel.rows[(j + 1) % 3]),XMLoadFloat3((const XMFLOAT3*)rel.rows[(j + 2) % 3]));
+			XMStoreFloat3((XMFLOAT3*)rel.normals[j],normal);
+			XMStoreFloat3((XMFLOAT3*)rel.absNormals[j],XMVectorAbs(normal));
+			XMStoreFloat3((XMFLOAT3*)rel.absRows[j],XMVectorAbs(row));
+			rel.normalDots[j] = fabs(XMVectorGetX(XMVector3Dot(row,normal)));
+		}
+
+		static const XMVECTORF32 axes[3] = { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f } };
+		for(UINT k=0; k<3; ++k)
+		{
+			for(UINT j=0; j<3; ++j)
+			{
+				XMVECTOR row = XMLoadFloat3((const XMFLOAT3*)rel.rows[j]);
+				XMVECTOR edge = XMVector3Cross(axes[k],row);
+				if(XMVectorGetX(XMVector3LengthSq(edge)) <= g_parallelAxis * g_parallelAxis * XMVectorGetX(XMVector3LengthSq(row)))
+					edge = XMVectorZero();
+
+				UINT e = 3 * k + j;
+				XMStoreFloat3((XMFLOAT3*)rel.edges[e],edge);
+				XMStoreFloat3((XMFLOAT3*)rel.absEdges[e],XMVectorAbs(edge));
+				for(UINT m=0; m<3; ++m)
+					rel.edgeDots[e][m] = fabs(XMVectorGetX(XMVector3Dot(XMLoadFloat3((const XMFLOAT3*)rel.rows[m]),edge)));
+			}
+		}
+	}
+
+	static inline XMVECTOR Dot3(const XMVECTOR *v, const float *w)
+	{
+		return XMVectorMultiplyAdd(v[0],XMVectorReplicate(w[0]),
+			XMVectorMultiplyAdd(v[1],XMVectorReplicate(w[1]),XMVectorMultiply(v[2],XMVectorReplicate(w[2]))));
+	}
+
+	static inline XMVECTOR Separated(FXMVECTOR d, FXMVECTOR rA, FXMVECTOR rB)
+	{
+		return XMVectorGreater(XMVectorAbs(d),(rA + rB) * g_margin);
+	}
+
+	//Overlap of up to 4 node pairs, one per lane: nodesA[i] against nodesB[i]. Return the bits of the overlapping pairs.
+	static UINT OverlapLanes(const Relative &rel, const MeshBvh::Node *const *nodesA, const MeshBvh::Node *const *nodesB, UINT count)
+	{
+		//Centers and extents as structure of arrays, padded with the last pair
+		float lanes[12][4];
+		for(UINT i=0; i<4; ++i)
+		{
+			const MeshBvh::Node &a = *nodesA[min(i,count - 1)];
+			const MeshBvh::Node &b = *nodesB[min(i,count - 1)];
+			const float *aMin = &a.boxMin.x, *aMax = &a.boxMax.x, *bMin = &b.boxMin.x, *bMax = &b.boxMax.x;
+			for(UINT k=0; k<3; ++k)
+			{
+				lanes[k][i] = 0.5f * (aMin[k] + aMax[k]);
+				lanes[3 + k][i] = 0.5f * (aMax[k] - aMin[k]);
+				lanes[6 + k][i] = 0.5f * (bMin[k] + bMax[k]);
+				lanes[9 + k][i] = 0.5f * (bMax[k] - bMin[k]);
+			}
+		}
+		XMVECTOR centerA[3], extentA[3], centerB[3], extentB[3];
+		for(UINT k=0; k<3; ++k)
+		{
+			centerA[k] = XMLoadFloat4((const XMFLOAT4*)lanes[k]);
+			extentA[k] = XMLoadFloat4((const XMFLOAT4*)lanes[3 + k]);
+			centerB[k] = XMLoadFloat4((const XMFLOAT4*)lanes[6 + k]);
+			extentB[k] = XMLoadFloat4((const XMFLOAT4*)lanes[9 + k]);
+		}
+
+		//Center of B in A, relative to the center of A
+		XMVECTOR t[3];
+		for(UINT k=0; k<3; ++k)
+		{
+			t[k] = XMVectorReplicate(rel.rows[3][k]) - centerA[k];
+			for(UINT j=0; j<3; ++j)
+				t[k] = XMVectorMultiplyAdd(centerB[j],XMVectorReplicate(rel.rows[j][k]),t[k]);
+		}
+
+		//Face axes of A, then of B
+		XMVECTOR separated = XMVectorFalseInt();
+		for(UINT k=0; k<3; ++k)
+		{
+			XMVECTOR rB = XMVectorMultiplyAdd(extentB[0],XMVectorReplicate(rel.absRows[0][k]),
+				XMVectorMultiplyAdd(extentB[1],XMVectorReplicate(rel.absRows[1][k]),XMVectorMultiply(extentB[2],XMVectorReplicate(rel.absRows[2][k]))));
+			separated = XMVectorOrInt(separated,Separated(t[k],extentA[k],rB));
+		}
+		for(UINT j=0; j<3; ++j)
+		{
+			XMVECTOR d = Dot3(t,rel.normals[j]);
+			XMVECTOR rA = Dot3(extentA,rel.absNormals[j]);
+			separated = XMVectorOrInt(separated,Separated(d,rA,extentB[j] * XMVectorReplicate(rel.normalDots[j])));
+		}
+
+		//Edge axes, unless the face axes already separate every pair
+		UINT valid = (1 << count) - 1;
+		if((MoveMask(separated) & valid) != valid)
+		{
+			for(UINT e=0; e<9; ++e)
+			{
+				XMVECTOR d = Dot3(t,rel.edges[e]);
+				XMVECTOR rA = Dot3(extentA,rel.absEdges[e]);
+				XMVECTOR rB = Dot3(extentB,rel.edgeDots[e]);
+				separated = XMVectorOrInt(separated,Separated(d,rA,rB));
+			}
+		}
+
+		return ~MoveMask(separated) & valid;
+	}
+
+	//A leaf stands for itself, an inner node for its two children
+	static inline UINT Children(const MeshBvh &tree, UINT node, UINT *children)
+	{
+		const MeshBvh::Node &n = tree.GetNode(node);
+		if(n.count)
+		{
+			children[0] = node;
+			return 1;
+		}
+		children[0] = n.first;
+		children[1] = n.first + 1;
+		return 2;
+	}
+
+	//Overlapping child pairs of an overlapping pair with at least one inner node, written to 'out' as(a, b).
+	//Both nodes are split when both are inner. Return the number of pairs.
+	static UINT Descend(const MeshBvh &a, const MeshBvh &b, const Relative &rel, UINT nodeA, UINT nodeB, UINT (*out)[2])
+	{
+		UINT childrenA[2], childrenB[2];
+		UINT nA = Children(a,nodeA,childrenA);
+		UINT nB = Children(b,nodeB,childrenB);
+
+		const MeshBvh::Node *nodesA[4], *nodesB[4];
+		UINT pairs[4][2];
+		UINT count = 0;
+		for(UINT i=0; i<nA; ++i)
+		{
+			for(UINT j=0; j<nB; ++j)
+			{
+				pairs[count][0] = childrenA[i];
+				pairs[count][1] = childrenB[j];
+				nodesA[count] = &a.GetNode(childrenA[i]);
+				nodesB[count] = &b.GetNode(childrenB[j]);
+				++count;
+			}
+		}
+
+		UINT mask = OverlapLanes(rel,nodesA,nodesB,count);
+		UINT nOut = 0;
+		for(UINT i=0; i<count; ++i)
+		{
+			if(mask & (1 << i))
+			{
+				out[nOut][0] = pairs[i][0];
+				out[nOut][1] = pairs[i][1];
+				++nOut;
+			}
+		}
+		return nOut;
+	}
+
+	static inline void TriangleBounds(FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2, XMVECTOR &vMin, XMVECTOR &vMax)
+	{
+		vMin = XMVectorMin(v0,XMVectorMin(v1,v2));
+		vMax = XMVectorMax(v0,XMVectorMax(v1,v2));
+	}
+
+	static inline bool BoxesOverlap(FXMVECTOR minA, FXMVECTOR maxA, FXMVECTOR minB, CXMVECTOR maxB)
+	{
+		return (MoveMask(XMVectorOrInt(XMVectorGreater(minA,maxB),XMVectorGreater(minB,maxA))) & 7) == 0;
+	}
+
+	//Test every triangle of leaf A against every triangle of leaf B. Return true when a pair intersects,
+	//after the first one when 'pairs' is NULL.
+	static bool LeafPair(const MeshBvh &a, const MeshBvh &b, CXMMATRIX bToA, UINT leafA, UINT leafB, std::vector<TrianglePair> *pairs)
+	{
+		const MeshBvh::Node &nodeA = a.GetNode(leafA);
+		const MeshBvh::Node &nodeB = b.GetNode(leafB);
+		XMVECTOR boxMinA = XMLoadFloat3(&nodeA.boxMin), boxMaxA = XMLoadFloat3(&nodeA.boxMax);
+
+		bool found = false;
+		for(UINT j=nodeB.first; j<nodeB.first + nodeB.count; ++j)
+		{
+			//Triangle of B in A, skipped when it misses the box of leaf A
+			const MeshBvh::Triangle &tb = b.GetTriangle(j);
+			XMVECTOR v0 = XMLoadFloat3(&tb.v0);
+			XMVECTOR b0 = XMVector3Transform(v0,bToA);
+			XMVECTOR b1 = XMVector3Transform(v0 + XMLoadFloat3(&tb.e1),bToA);
+			XMVECTOR b2 = XMVector3Transform(v0 + XMLoadFloat3(&tb.e2),bToA);
+			XMVECTOR minB, maxB;
+			TriangleBounds(b0,b1,b2,minB,maxB);
+			if(!BoxesOverlap(boxMinA,boxMaxA,minB,maxB))
+				continue;
+
+			for(UINT i=nodeA.first; i<nodeA.first + nodeA.count; ++i)
+			{
+				const MeshBvh::Triangle &ta = a.GetTriangle(i);
+				XMVECTOR a0 = XMLoadFloat3(&ta.v0);
+				XMVECTOR a1 = a0 + XMLoadFloat3(&ta.e1);
+				XMVECTOR a2 = a0 + XMLoadFloat3(&ta.e2);
+				XMVECTOR minA, maxA;
+				TriangleBounds(a0,a1,a2,minA,maxA);
+				if(!BoxesOverlap(minA,maxA,minB,maxB) || !XNA::IntersectTriangleTriangle(a0,a1,a2,b0,b1,b2))
+					continue;
+
+				found = true;
+				if(!pairs)
+					return true;
+				TrianglePair pair = { a.SourceTriangle(i), b.SourceTriangle(j) };
+				pairs->push_back(pair);
+			}
+		}
+		return found;
+	}
+
+	//Depth first traversal below an overlapping pair of nodes. With 'pairs' NULL, stop at the first intersecting pair.
+	static bool Traverse(const MeshBvh &a, const MeshBvh &b, CXMMATRIX bToA, const Relative &rel, UINT nodeA, UINT nodeB,
+		std::vector<TrianglePair> *pairs)
+	{
+		//Each pair popped leaves at most 3 of its children behind, one level deeper in either tree, so the pending pairs
+		//are at most 3 per level of both trees. MeshBvh keeps its depth below 64: the fixed stack is enough, unless
+		//that changes.
+		UINT fixedStack[g_maxStack][2];
+		std::vector<UINT> grownStack;
+		UINT (*stack)[2] = fixedStack;
+		UINT stackSize = 3 * (a.Depth() + b.Depth()) + 4;
+		if(stackSize > g_maxStack)
+		{
+			grownStack.resize(2 * stackSize);
+			stack = reinterpret_cast<UINT(*)[2]>(&grownStack[0]);
+		}
+		UINT top = 0;
+		stack[top][0] = nodeA;
+		stack[top][1] = nodeB;
+		++top;
+
+		bool found = false;
+		while(top > 0)
+		{
+			--top;
+			UINT na = stack[top][0], nb = stack[top][1];
+			if(a.GetNode(na).count && b.GetNode(nb).count)
+			{
+				if(LeafPair(a,b,bToA,na,nb,pairs))
+				{
+					found = true;
+					if(!pairs)
+						return true;
+				}
+				continue;
+			}
+
+			XMASSERT(top + 4 <= max(stackSize,g_maxStack));
+			top += Descend(a,b,rel,na,nb,stack + top);
+		}
+		return found;
+	}
+
+	//Whether the roots overlap
+	static bool OverlapRoots(const MeshBvh &a, const MeshBvh &b, const Relative &rel)
+	{
+		const MeshBvh::Node *rootA = &a.GetNode(0), *rootB = &b.GetNode(0);
+		return OverlapLanes(rel,&rootA,&rootB,1) != 0;
+	}
+
+	UINT Intersect(const MeshBvh &a, const MeshBvh &b, CXMMATRIX bToA, std::vector<TrianglePair> &pairs)
+	{
+		pairs.clear();
+		if(a.NodeCount() == 0 || b.NodeCount() == 0)
+			return 0;
+
+		Relative rel;
+		SetupRelative(bToA,rel);
+		if(!OverlapRoots(a,b,rel))
+			return 0;
+
+		//Split the overlapping pairs level by level until there are enough subtree pairs to share between threads.
+		//Leaf pairs met on the way are kept in the list.
+		std::vector<UINT> frontier(2,0), next;
+		bool split = true;
+		while(split && frontier.size() < 2 * g_parallelPairs)
+		{
+			split = false;
+			next.clear();
+			for(UINT p=0; p<frontier.size(); p+=2)
+			{
+				UINT na = frontier[p], nb = frontier[p + 1];
+				if(a.GetNode(na).count && b.GetNode(nb).count)
+				{
+					next.push_back(na);
+					next.push_back(nb);
+					continue;
+				}
+
+				UINT children[4][2];
+				UINT n = Descend(a,b,rel,na,nb,children);
+				for(UINT c=0; c<n; ++c)
+				{
+					next.push_back(children[c][0]);
+					next.push_back(children[c][1]);
+				}
+				split = true;
+			}
+			frontier.swap(next);
+		}
+
+		//Each subtree pair fills its own list, appended in frontier order so the outcome does not depend on the scheduling
+		UINT nPairs = frontier.size() / 2;
+		std::vector<std::vector<TrianglePair>> partials(nPairs);
+		Concurrency::parallel_for(0U,nPairs,[&](UINT p)
+		{
+			Traverse(a,b,bToA,rel,frontier[2 * p],frontier[2 * p + 1],&partials[p]);
+		});
+
+		for(UINT p=0; p<nPairs; ++p)
+			pairs.insert(pairs.end(),partials[p].begin(),partials[p].end());
+		return pairs.size();
+	}
+
+	bool IntersectAny(const MeshBvh &a, const MeshBvh &b, CXMMATRIX bToA)
+	{
+		if(a.NodeCount() == 0 || b.NodeCount() == 0)
+			return false;
+
+		Relative rel;
+		SetupRelative(bToA,rel);
+		return OverlapRoots(a,b,rel) && Traverse(a,b,bToA,rel,0,0,NULL);
+	}
+};
@@ -0,0 +1,30 @@
+#ifndef _MESH_COLLISION_H_
+#define _MESH_COLLISION_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include <vector>
+#include "MeshBvh.h"
+
+//Exact contact between two triangle meshes, each with its MeshBvh built in its own local space.
+//Both hierarchies are walked together: the boxes of B are taken into the space of A as oriented boxes and
+//the four child pairs of two inner nodes are tested at once, one pair per XMVECTOR lane, with the separating
+//axis test of XNA::IntersectOrientedBoxOrientedBox. Leaf pairs go through XNA::IntersectTriangleTriangle.
+//The pairs of subtrees left after the first levels are traversed in parallel.
+namespace MeshCollision
+{
+	//Source mesh triangles(MeshBvh::RayHit::triangle numbering) of an intersecting pair
+	struct TrianglePair
+	{
+		UINT	a;
+		UINT	b;
+	};
+
+	//'bToA' takes the local space of B into the local space of A, i.e. worldB times the inverse of worldA.
+	//It may scale and shear(any affine transform). Fill 'pairs' with every intersecting pair of triangles and return their number.
+	UINT Intersect(const MeshBvh &a, const MeshBvh &b, CXMMATRIX bToA, std::vector<TrianglePair> &pairs);
+	//Whether any triangle of A intersects a triangle of B, stopping at the first pair found
+	bool IntersectAny(const MeshBvh &a, const MeshBvh &b, CXMMATRIX bToA);
+};
+
+#endif	//_MESH_COLLISION_H_
@@ -0,0 +1,398 @@
+#include "OcclusionCuller.h"
+#include "AppUtil.h"
+#include <ppl.h>
+#include <malloc.h>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+static const int	g_tileSize = 8;					//Pixels per tile side, the unit of the farthest depth
+static const int	g_binTiles = 4;					//Tiles per bin side, the unit of parallel rasterization
+static const int	g_binSize = g_tileSize * g_binTiles;
+
+OcclusionCuller::OcclusionCuller():
+	m_width(0),
+	m_height(0),
+	m_tilesX(0),
+	m_tilesY(0),
+	m_binsX(0),
+	m_binsY(0),
+	m_depth(NULL)
+{
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	if(m_depth)
+		_aligned_free(m_depth);
+}
+
+bool OcclusionCuller::Resize(UINT width, UINT height)
+{
+	if(width == 0 || height == 0)
+		return false;
+
+	UINT tilesX = (width + g_tileSize - 1) / g_tileSize;
+	UINT tilesY = (height + g_tileSize - 1) / g_tileSize;
+	if(tilesX * g_tileSize == m_width && tilesY * g_tileSize == m_height)
+		return true;
+
+	float *depth = (float*)_aligned_malloc(tilesX * tilesY * g_tileSize * g_tileSize * sizeof(float),16);
+	if(!depth)
+		return false;
+
+	if(m_depth)
+		_aligned_free(m_depth);
+	m_depth = depth;
+
+	m_tilesX = tilesX;
+	m_tilesY = tilesY;
+	m_width = tilesX * g_tileSize;
+	m_height = tilesY * g_tileSize;
+	m_binsX = (tilesX + g_binTiles - 1) / g_binTiles;
+	m_binsY = (tilesY + g_binTiles - 1) / g_binTiles;
+
+	m_tileMaxDepth.resize(tilesX * tilesY);
+	m_binTriangles.resize(m_binsX * m_binsY);
+
+	Clear();
+	return true;
+}
+
+void OcclusionCuller::Clear()
+{
+	m_triangles.clear();
+	for(UINT i=0; i<m_binTriangles.size(); ++i)
+		m_binTriangles[i].clear();
+
+	for(UINT i=0, n=m_width*m_height; i<n; ++i)
+		m_depth[i] = 1.f;
+	for(UINT i=0; i<m_tileMaxDepth.size(); ++i)
+		m_tileMaxDepth[i] = 1.f;
+}
+
+//Clip space point on the segment a-b where z = 0(the D3D near plane)
+static inline XMFLOAT4 NearIntersection(const XMFLOAT4 &a, const XMFLOAT4 &b)
+{
+	float t = a.z / (a.z - b.z);
+	return XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, 0.f, a.w + (b.w - a.w) * t);
+}
+
+//Pixel coordinates(y down) and depth of a clip space point in front of the near plane
+static inline XMFLOAT3 ToScreen(const XMFLOAT4 &clip, float width, float height)
+{
+	float invW = 1.f / clip.w;
+	return XMFLOAT3((clip.x * invW * 0.5f + 0.5f) * width, (0.5f - clip.y * invW * 0.5f) * height, clip.z * invW);
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3 *positions, UINT nVertices, UINT stride, const UINT *indices, UINT nTriangles, CXMMATRIX worldViewProj)
+{
+	if(!m_depth)
+		return;
+
+	//Vertices are projected once, only the triangles crossing the near plane go back to clip space
+	m_clipVertices.resize(nVertices);
+	m_screenVertices.resize(nVertices);
+	XMVector3TransformStream(&m_clipVertices[0],sizeof(XMFLOAT4),positions,stride,nVertices,worldViewProj);
+	for(UINT i=0; i<nVertices; ++i)
+	{
+		if(m_clipVertices[i].z >= 0.f)
+			m_screenVertices[i] = ToScreen(m_clipVertices[i],(float)m_width,(float)m_height);
+	}
+
+	for(UINT t=0; t<nTriangles; ++t)
+	{
+		const UINT *tri = &indices[3 * t];
+		const XMFLOAT4 *v[3] = { &m_clipVertices[tri[0]], &m_clipVertices[tri[1]], &m_clipVertices[tri[2]] };
+
+		//Skip the triangles entirely outside one of the frustum planes
+		UINT outside = ~0U;
+		UINT nearCount = 0;
+		for(UINT k=0; k<3; ++k)
+		{
+			UINT code = (v[k]->x > v[k]->w ? 1 : 0) | (v[k]->x < -v[k]->w ? 2 : 0) |
+				(v[k]->y > v[k]->w ? 4 : 0) | (v[k]->y < -v[k]->w ? 8 : 0) |
+				(v[k]->z > v[k]->w ? 16 : 0) | (v[k]->z < 0.f ? 32 : 0);
+			outside &= code;
+			nearCount += v[k]->z < 0.f ? 1 : 0;
+		}
+		if(outside)
+			continue;
+
+		if(nearCount == 0)
+		{
+			XMFLOAT3 screen[3] = { m_screenVertices[tri[0]], m_screenVertices[tri[1]], m_screenVertices[tri[2]] };
+			SetupTriangle(screen);
+			continue;
+		}
+
+		//Clip against the near plane, keeping the winding: one vertex behind gives a quad, two give a triangle
+		XMFLOAT3 poly[4];
+		UINT n = 0;
+		for(UINT k=0; k<3; ++k)
+		{
+			const XMFLOAT4 &a = *v[k];
+			const XMFLOAT4 &b = *v[(k + 1) % 3];
+			if(a.z >= 0.f)
+				poly[n++] = m_screenVertices[tri[k]];
+			if((a.z >= 0.f) != (b.z >= 0.f))
+				poly[n++] = ToScreen(NearIntersection(a,b),(float)m_width,(float)m_height);
+		}
+
+		SetupTriangle(poly);
+		if(n == 4)
+		{
+			poly[1] = poly[0];
+			SetupTriangle(&poly[1]);
+		}
+	}
+}
+
+void OcclusionCuller::SetupTriangle(const XMFLOAT3 *screen)
+{
+	float x[3] = { screen[0].x, screen[1].x, screen[2].x };
+	float y[3] = { screen[0].y, screen[1].y, screen[2].y };
+	float z[3] = { screen[0].z, screen[1].z, screen[2].z };
+
+	//Clockwise on screen(y down) has a positive area. Back faces and degenerate triangles are dropped.
+	float d1x = x[1] - x[0], d1y = y[1] - y[0];
+	float d2x = x[2] - x[0], d2y = y[2] - y[0];
+	float area = d1x * d2y - d2x * d1y;
+	if(!(area > 0.f))
+		return;
+
+	//Pixel (px, py) is covered when its center (px + 0.5, py + 0.5) is inside
+	float fMinX = min(x[0],min(x[1],x[2])), fMaxX = max(x[0],max(x[1],x[2]));
+	float fMinY = min(y[0],min(y[1],y[2])), fMaxY = max(y[0],max(y[1],y[2]));
+	Triangle tri;
+	tri.minX = (int)ceil(Clamp(0.f,(float)m_width,fMinX) - 0.5f);
+	tri.minY = (int)ceil(Clamp(0.f,(float)m_height,fMinY) - 0.5f);
+	tri.maxX = (int)floor(Clamp(0.f,(float)m_width,fMaxX) - 0.5f);
+	tri.maxY = (int)floor(Clamp(0.f,(float)m_height,fMaxY) - 0.5f);
+	if(tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return;
+
+	float originX = tri.minX + 0.5f;
+	float originY = tri.minY + 0.5f;
+	for(UINT k=0; k<3; ++k)
+	{
+		UINT next = (k + 1) % 3;
+		tri.edgeA[k] = y[k] - y[next];
+		tri.edgeB[k] = x[next] - x[k];
+		tri.edgeC[k] = tri.edgeA[k] * (originX - x[k]) + tri.edgeB[k] * (originY - y[k]);
+	}
+
+	float dz1 = z[1] - z[0], dz2 = z[2] - z[0];
+	float invArea = 1.f / area;
+	tri.dzdx = (dz1 * d2y - dz2 * d1y) * invArea;
+	tri.dzdy = (dz2 * d1x - dz1 * d2x) * invArea;
+	tri.z = z[0] + tri.dzdx * (originX - x[0]) + tri.dzdy * (originY - y[0]);
+
+	UINT index = m_triangles.size();
+	m_triangles.push_back(tri);
+	for(int by=tri.minY/g_binSize; by<=tri.maxY/g_binSize; ++by)
+	{
+		for(int bx=tri.minX/g_binSize; bx<=tri.maxX/g_binSize; ++bx)
+			m_binTriangles[by * m_binsX + bx].push_back(index);
+	}
+}
+
+void OcclusionCuller::Rasterize()
+{
+	if(!m_depth)
+		return;
+
+	Concurrency::parallel_for(0U,m_binsX * m_binsY,[&](UINT bin)
+	{
+		RasterizeBin(bin);
+	});
+}
+
+//Bins start on a multiple of 32 pixels and the width is a multiple of 8, so the 4 pixel groups never leave the bin
+void OcclusionCuller::RasterizeBin(UINT bin)
+{
+	int binX = (bin % m_binsX) * g_binSize;
+	int binY = (bin / m_binsX) * g_binSize;
+	int binMaxX = min(binX + g_binSize,(int)m_width) - 1;
+	int binMaxY = min(binY + g_binSize,(int)m_height) - 1;
+
+	static const XMVECTORF32 laneOffsets = { 0.f, 1.f, 2.f, 3.f };
+	XMVECTOR zero = XMVectorZero();
+
+	const std::vector<UINT> &triangles = m_binTriangles[bin];
+	for(UINT t=0; t<triangles.size(); ++t)
+	{
+		const Triangle &tri = m_triangles[triangles[t]];
+		int x0 = max(tri.minX,binX) & ~3;
+		int x1 = min(tri.maxX,binMaxX);
+		int y0 = max(tri.minY,binY);
+		int y1 = min(tri.maxY,binMaxY);
+
+		//Values at pixel (x0, y0) and their steps
+		float dx = (float)(x0 - tri.minX);
+		float dy = (float)(y0 - tri.minY);
+		XMVECTOR edgeRow[3], edgeStepX[3], edgeStepY[3];
+		for(UINT k=0; k<3; ++k)
+		{
+			XMVECTOR a = XMVectorReplicate(tri.edgeA[k]);
+			edgeRow[k] = XMVectorMultiplyAdd(laneOffsets,a,XMVectorReplicate(tri.edgeA[k] * dx + tri.edgeB[k] * dy + tri.edgeC[k]));
+			edgeStepX[k] = XMVectorScale(a,4.f);
+			edgeStepY[k] = XMVectorReplicate(tri.edgeB[k]);
+		}
+		XMVECTOR dzdx = XMVectorReplicate(tri.dzdx);
+		XMVECTOR zRow = XMVectorMultiplyAdd(laneOffsets,dzdx,XMVectorReplicate(tri.z + tri.dzdx * dx + tri.dzdy * dy));
+		XMVECTOR zStepX = XMVectorScale(dzdx,4.f);
+		XMVECTOR zStepY = XMVectorReplicate(tri.dzdy);
+
+		for(int y=y0; y<=y1; ++y)
+		{
+			float *row = m_depth + y * m_width;
+			XMVECTOR e0 = edgeRow[0], e1 = edgeRow[1], e2 = edgeRow[2];
+			XMVECTOR z = zRow;
+			for(int x=x0; x<=x1; x+=4)
+			{
+				XMVECTOR inside = XMVectorAndInt(XMVectorAndInt(XMVectorGreaterOrEqual(e0,zero),XMVectorGreaterOrEqual(e1,zero)),
+					XMVectorGreaterOrEqual(e2,zero));
+				if(MoveMask(inside))
+				{
+					XMVECTOR depth = XMLoadFloat4A((const XMFLOAT4A*)(row + x));
+					depth = XMVectorSelect(depth,XMVectorMin(depth,z),inside);
+					XMStoreFloat4A((XMFLOAT4A*)(row + x),depth);
+				}
+				e0 += edgeStepX[0];
+				e1 += edgeStepX[1];
+				e2 += edgeStepX[2];
+				z += zStepX;
+			}
+
+			edgeRow[0] += edgeStepY[0];
+			edgeRow[1] += edgeStepY[1];
+			edgeRow[2] += edgeStepY[2];
+			zRow += zStepY;
+		}
+	}
+
+	//Farthest depth of the tiles of the bin
+	for(int ty=binY; ty<binMaxY; ty+=g_tileSize)
+	{
+		for(int tx=binX; tx<binMaxX; tx+=g_tileSize)
+		{
+			XMVECTOR farthest = zero;
+			for(int y=ty; y<ty+g_tileSize; ++y)
+			{
+				const float *row = m_depth + y * m_width + tx;
+				farthest = XMVectorMax(farthest,XMLoadFloat4A((const XMFLOAT4A*)row));
+				farthest = XMVectorMax(farthest,XMLoadFloat4A((const XMFLOAT4A*)(row + 4)));
+			}
+			XMFLOAT4 f;
+			XMStoreFloat4(&f,farthest);
+			m_tileMaxDepth[(ty / g_tileSize) * m_tilesX + tx / g_tileSize] = max(max(f.x,f.y),max(f.z,f.w));
+		}
+	}
+}
+
+//Whether a pixel of the rectangle(inclusive) is farther than z
+bool OcclusionCuller::TestRect(int minX, int minY, int maxX, int maxY, float z) const
+{
+	for(int ty=minY/g_tileSize; ty<=maxY/g_tileSize; ++ty)
+	{
+		for(int tx=minX/g_tileSize; tx<=maxX/g_tileSize; ++tx)
+		{
+			if(m_tileMaxDepth[ty * m_tilesX + tx] <= z)
+				continue;
+
+			//The farthest pixel of a tile inside the rectangle is farther than z
+			int x0 = tx * g_tileSize, y0 = ty * g_tileSize;
+			int x1 = x0 + g_tileSize - 1, y1 = y0 + g_tileSize - 1;
+			if(x0 >= minX && x1 <= maxX && y0 >= minY && y1 <= maxY)
+				return true;
+
+			x0 = max(x0,minX);
+			y0 = max(y0,minY);
+			x1 = min(x1,maxX);
+			y1 = min(y1,maxY);
+			for(int y=y0; y<=y1; ++y)
+			{
+				const float *row = m_depth + y * m_width;
+				for(int x=x0; x<=x1; ++x)
+				{
+					if(row[x] > z)
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+bool OcclusionCuller::TestAABB(const XNA::AxisAlignedBox &box, CXMMATRIX viewProj) const
+{
+	if(!m_depth)
+		return true;
+
+	//Clip space corners: the transformed center plus or minus the rows of the matrix scaled by the extents
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&box.Center),viewProj);
+	XMVECTOR axisX = XMVectorScale(viewProj.r[0],box.Extents.x);
+	XMVECTOR axisY = XMVectorScale(viewProj.r[1],box.Extents.y);
+	XMVECTOR axisZ = XMVectorScale(viewProj.r[2],box.Extents.z);
+	XMVECTOR xy[4] = { center - axisX - axisY, center + axisX - axisY, center - axisX + axisY, center + axisX + axisY };
+
+	//Project the corners 4 at a time, as x, y, z and w lanes
+	XMMATRIX nearCorners = XMMatrixTranspose(XMMATRIX(xy[0] - axisZ,xy[1] - axisZ,xy[2] - axisZ,xy[3] - axisZ));
+	XMMATRIX farCorners = XMMatrixTranspose(XMMATRIX(xy[0] + axisZ,xy[1] + axisZ,xy[2] + axisZ,xy[3] + axisZ));
+
+	//A corner behind the near plane: the box may contain the eye, call it visible
+	XMVECTOR zero = XMVectorZero();
+	if(MoveMask(XMVectorOrInt(XMVectorLess(nearCorners.r[2],zero),XMVectorLess(farCorners.r[2],zero))))
+		return true;
+
+	XMVECTOR halfWidth = XMVectorReplicate(0.5f * m_width);
+	XMVECTOR halfHeight = XMVectorReplicate(0.5f * m_height);
+	XMVECTOR invW0 = XMVectorReciprocal(nearCorners.r[3]);
+	XMVECTOR invW1 = XMVectorReciprocal(farCorners.r[3]);
+	XMVECTOR x0 = nearCorners.r[0] * invW0, x1 = farCorners.r[0] * invW1;
+	XMVECTOR y0 = nearCorners.r[1] * invW0, y1 = farCorners.r[1] * invW1;
+	XMVECTOR z = XMVectorMin(nearCorners.r[2] * invW0,farCorners.r[2] * invW1);
+
+	//Screen rectangle(y down) and nearest depth
+	XMFLOAT4 vMinX, vMaxX, vMinY, vMaxY, vMinZ;
+	XMStoreFloat4(&vMinX,XMVectorMultiplyAdd(XMVectorMin(x0,x1),halfWidth,halfWidth));
+	XMStoreFloat4(&vMaxX,XMVectorMultiplyAdd(XMVectorMax(x0,x1),halfWidth,halfWidth));
+	XMStoreFloat4(&vMinY,XMVectorNegativeMultiplySubtract(XMVectorMax(y0,y1),halfHeight,halfHeight));
+	XMStoreFloat4(&vMaxY,XMVectorNegativeMultiplySubtract(XMVectorMin(y0,y1),halfHeight,halfHeight));
+	XMStoreFloat4(&vMinZ,z);
+
+	float minSX = min(min(vMinX.x,vMinX.y),min(vMinX.z,vMinX.w));
+	float maxSX = max(max(vMaxX.x,vMaxX.y),max(vMaxX.z,vMaxX.w));
+	float minSY = min(min(vMinY.x,vMinY.y),min(vMinY.z,vMinY.w));
+	float maxSY = max(max(vMaxY.x,vMaxY.y),max(vMaxY.z,vMaxY.w));
+	float minZ = min(min(vMinZ.x,vMinZ.y),min(vMinZ.z,vMinZ.w));
+
+	//Pixels touched by the rectangle
+	if(maxSX < 0.f || maxSY < 0.f || minSX >= m_width || minSY >= m_height)
+		return false;
+	int minX = (int)floor(max(minSX,0.f));
+	int minY = (int)floor(max(minSY,0.f));
+	int maxX = (int)floor(min(maxSX,m_width - 0.5f));
+	int maxY = (int)floor(min(maxSY,m_height - 0.5f));
+
+	return TestRect(minX,minY,maxX,maxY,minZ);
+}
+
+UINT OcclusionCuller::TestAABBs(const XNA::AxisAlignedBox *boxes, UINT count, CXMMATRIX viewProj, UINT *visibleMask) const
+{
+	memset(visibleMask,0,(count + 31) / 32 * sizeof(UINT));
+
+	UINT visible = 0;
+	for(UINT i=0; i<count; ++i)
+	{
+		if(TestAABB(boxes[i],viewProj))
+		{
+			visibleMask[i >> 5] |= 1u << (i & 31);
+			++visible;
+		}
+	}
+
+	return visible;
+}
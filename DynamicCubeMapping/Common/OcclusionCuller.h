@@ -0,0 +1,73 @@
+#ifndef _OCCLUSION_CULLER_H_
+#define _OCCLUSION_CULLER_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include <vector>
+#include "xnacollision.h"
+
+//Software occlusion culling on the CPU. A few large occluders are rasterized into a small depth buffer,
+//then the bounding boxes of the other objects are tested against it before their draw calls are submitted.
+//
+//The buffer is split into 8x8 pixel tiles, each keeping the farthest depth of its pixels, and into bins of
+//4x4 tiles. Occluder triangles are set up and binned on the calling thread, then the bins are rasterized in
+//parallel, 4 pixels at a time. Depth is D3D depth(0 near, 1 far), so the matrices are the ones used for drawing.
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+	~OcclusionCuller();
+
+	//Buffer size in pixels, e.g. a quarter of the back buffer. The width is rounded up to whole tiles.
+	bool Resize(UINT width, UINT height);
+	UINT GetWidth() const		{ return m_width; }
+	UINT GetHeight() const		{ return m_height; }
+
+	//Start a new frame: drop the occluders and clear the depth to the far plane
+	void Clear();
+
+	//Set up the front facing triangles of an occluder(clockwise, as the default rasterizer state) for Rasterize.
+	//Triangles crossing the near plane are clipped against it.
+	void AddOccluder(const XMFLOAT3 *positions, UINT nVertices, UINT stride, const UINT *indices, UINT nTriangles, CXMMATRIX worldViewProj);
+	//Rasterize the occluders added since Clear, then update the tile depths
+	void Rasterize();
+
+	//Return false when the box is hidden behind the occluders(or off screen), true when it may be visible
+	bool TestAABB(const XNA::AxisAlignedBox &box, CXMMATRIX viewProj) const;
+	//Bit i of 'visibleMask'(Culling::MaskSize(count) UINTs) is set when boxes[i] may be visible.
+	//Return the number of visible boxes.
+	UINT TestAABBs(const XNA::AxisAlignedBox *boxes, UINT count, CXMMATRIX viewProj, UINT *visibleMask) const;
+
+	//Depth of the pixels, row by row, GetWidth() floats per row
+	const float* GetDepth() const	{ return m_depth; }
+
+private:
+	//Screen space triangle: edge functions and depth plane relative to the top left pixel center of its bounds
+	struct Triangle
+	{
+		float	edgeA[3], edgeB[3], edgeC[3];		//edge(x, y) = A * x + B * y + C, inside when all are >= 0
+		float	z, dzdx, dzdy;
+		int		minX, minY, maxX, maxY;				//Pixel bounds, inclusive
+	};
+
+	void SetupTriangle(const XMFLOAT3 *screen);
+	void RasterizeBin(UINT bin);
+	bool TestRect(int minX, int minY, int maxX, int maxY, float z) const;
+
+	OcclusionCuller(const OcclusionCuller&);
+	OcclusionCuller& operator=(const OcclusionCuller&);
+
+private:
+	UINT	m_width, m_height;
+	UINT	m_tilesX, m_tilesY;
+	UINT	m_binsX, m_binsY;
+	float	*m_depth;							//16 byte aligned, so rows can be loaded 4 pixels at a time
+
+	std::vector<float>				m_tileMaxDepth;
+	std::vector<Triangle>			m_triangles;
+	std::vector<std::vector<UINT>>	m_binTriangles;
+	std::vector<XMFLOAT4>			m_clipVertices;
+	std::vector<XMFLOAT3>			m_screenVertices;		//Pixel x, y and depth of the vertices in front of the near plane
+};
+
+#endif	//_OCCLUSION_CULLER_H_
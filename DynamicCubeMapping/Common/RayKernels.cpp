@@ -0,0 +1,346 @@
+#include "RayKernels.h"
+#include "AppUtil.h"
+#include <cfloat>
+
+namespace RayKernels
+{
+	static const XMVECTORF32 g_epsilon = { 1e-20f, 1e-20f, 1e-20f, 1e-20f };		//Same as the XNA tests
+	static const XMVECTORF32 g_fltMax = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+	static const XMVECTORF32 g_fltMin = { -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	static const XMVECTORI32 g_signBit = { 0x80000000, 0x80000000, 0x80000000, 0x80000000 };
+
+	static inline XMVECTOR Load4(const float *p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	static void FinishRay(RayLanes &ray)
+	{
+		ray.invDx = XMVectorReciprocal(ray.dx);
+		ray.invDy = XMVectorReciprocal(ray.dy);
+		ray.invDz = XMVectorReciprocal(ray.dz);
+		ray.parallelX = XMVectorLessOrEqual(XMVectorAbs(ray.dx),g_epsilon);
+		ray.parallelY = XMVectorLessOrEqual(XMVectorAbs(ray.dy),g_epsilon);
+		ray.parallelZ = XMVectorLessOrEqual(XMVectorAbs(ray.dz),g_epsilon);
+	}
+
+	void SetRay(FXMVECTOR origin, FXMVECTOR direction, Ray &ray)
+	{
+		ray.ox = XMVectorSplatX(origin);
+		ray.oy = XMVectorSplatY(origin);
+		ray.oz = XMVectorSplatZ(origin);
+		ray.dx = XMVectorSplatX(direction);
+		ray.dy = XMVectorSplatY(direction);
+		ray.dz = XMVectorSplatZ(direction);
+		FinishRay(ray);
+	}
+
+	void SetRayPacket(const XMVECTOR *origins, const XMVECTOR *directions, RayPacket4 &packet)
+	{
+		//Transpose: lane r holds ray r
+		XMMATRIX o(origins[0],origins[1],origins[2],origins[3]);
+		XMMATRIX d(directions[0],directions[1],directions[2],directions[3]);
+		o = XMMatrixTranspose(o);
+		d = XMMatrixTranspose(d);
+
+		packet.ox = o.r[0];
+		packet.oy = o.r[1];
+		packet.oz = o.r[2];
+		packet.dx = d.r[0];
+		packet.dy = d.r[1];
+		packet.dz = d.r[2];
+		FinishRay(packet);
+	}
+
+	void SetBox(UINT i, const XNA::AxisAlignedBox &box, Boxes8 &boxes)
+	{
+		boxes.centerX[i] = box.Center.x;
+		boxes.centerY[i] = box.Center.y;
+		boxes.centerZ[i] = box.Center.z;
+		boxes.extentX[i] = box.Extents.x;
+		boxes.extentY[i] = box.Extents.y;
+		boxes.extentZ[i] = box.Extents.z;
+	}
+
+	void SetSphere(UINT i, const XNA::Sphere &sphere, Spheres8 &spheres)
+	{
+		spheres.centerX[i] = sphere.Center.x;
+		spheres.centerY[i] = sphere.Center.y;
+		spheres.centerZ[i] = sphere.Center.z;
+		spheres.radius[i] = sphere.Radius;
+	}
+
+	void SetTriangle(UINT i, FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2, Triangles8 &triangles)
+	{
+		XMFLOAT3 p, e1, e2;
+		XMStoreFloat3(&p,v0);
+		XMStoreFloat3(&e1,XMVectorSubtract(v1,v0));
+		XMStoreFloat3(&e2,XMVectorSubtract(v2,v0));
+
+		triangles.v0X[i] = p.x;		triangles.v0Y[i] = p.y;		triangles.v0Z[i] = p.z;
+		triangles.e1X[i] = e1.x;	triangles.e1Y[i] = e1.y;	triangles.e1Z[i] = e1.z;
+		triangles.e2X[i] = e2.x;	triangles.e2Y[i] = e2.y;	triangles.e2Z[i] = e2.z;
+	}
+
+	//Primitive data in vector lanes, loaded from a pack(one primitive per lane) or splatted(one primitive for a packet)
+	struct BoxLanes
+	{
+		XMVECTOR	cx, cy, cz;
+		XMVECTOR	ex, ey, ez;
+	};
+
+	struct SphereLanes
+	{
+		XMVECTOR	cx, cy, cz;
+		XMVECTOR	r;
+	};
+
+	struct TriangleLanes
+	{
+		XMVECTOR	v0x, v0y, v0z;
+		XMVECTOR	e1x, e1y, e1z;
+		XMVECTOR	e2x, e2y, e2z;
+	};
+
+	//Slab test along one axis. Parallel lanes keep the full range, and miss when the origin is outside the slab.
+	static inline void Slab(FXMVECTOR toCenter, FXMVECTOR extent, FXMVECTOR inv, CXMVECTOR parallel,
+							XMVECTOR &tMin, XMVECTOR &tMax, XMVECTOR &noHit)
+	{
+		XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(toCenter,extent),inv);
+		XMVECTOR t2 = XMVectorMultiply(XMVectorAdd(toCenter,extent),inv);
+		tMin = XMVectorMax(tMin,XMVectorSelect(XMVectorMin(t1,t2),g_fltMin,parallel));
+		tMax = XMVectorMin(tMax,XMVectorSelect(XMVectorMax(t1,t2),g_fltMax,parallel));
+
+		XMVECTOR inside = XMVectorLessOrEqual(XMVectorAbs(toCenter),extent);
+		noHit = XMVectorOrInt(noHit,XMVectorAndCInt(parallel,inside));
+	}
+
+	static inline UINT TestBoxes(const RayLanes &ray, const BoxLanes &b, XMVECTOR &dist)
+	{
+		XMVECTOR tMin = g_fltMin;
+		XMVECTOR tMax = g_fltMax;
+		XMVECTOR noHit = XMVectorFalseInt();
+		Slab(XMVectorSubtract(b.cx,ray.ox),b.ex,ray.invDx,ray.parallelX,tMin,tMax,noHit);
+		Slab(XMVectorSubtract(b.cy,ray.oy),b.ey,ray.invDy,ray.parallelY,tMin,tMax,noHit);
+		Slab(XMVectorSubtract(b.cz,ray.oz),b.ez,ray.invDz,ray.parallelZ,tMin,tMax,noHit);
+
+		noHit = XMVectorOrInt(noHit,XMVectorGreater(tMin,tMax));
+		noHit = XMVectorOrInt(noHit,XMVectorLess(tMax,XMVectorZero()));
+
+		//Entry distance, negative when the origin is inside the box
+		dist = tMin;
+		return ~MoveMask(noHit) & 0xF;
+	}
+
+	static inline UINT TestSpheres(const RayLanes &ray, const SphereLanes &s, XMVECTOR &dist)
+	{
+		XMVECTOR lx = XMVectorSubtract(s.cx,ray.ox);
+		XMVECTOR ly = XMVectorSubtract(s.cy,ray.oy);
+		XMVECTOR lz = XMVectorSubtract(s.cz,ray.oz);
+
+		//Projection of the center on the ray, and squared distance from the center to that point
+		XMVECTOR proj = XMVectorMultiply(lx,ray.dx);
+		proj = XMVectorMultiplyAdd(ly,ray.dy,proj);
+		proj = XMVectorMultiplyAdd(lz,ray.dz,proj);
+		XMVECTOR l2 = XMVectorMultiply(lx,lx);
+		l2 = XMVectorMultiplyAdd(ly,ly,l2);
+		l2 = XMVectorMultiplyAdd(lz,lz,l2);
+		XMVECTOR r2 = XMVectorMultiply(s.r,s.r);
+		XMVECTOR m2 = XMVectorSubtract(l2,XMVectorMultiply(proj,proj));
+
+		//Miss when the origin is outside and the center behind it, or when the ray passes farther than the radius
+		XMVECTOR noHit = XMVectorAndInt(XMVectorLess(proj,XMVectorZero()),XMVectorGreater(l2,r2));
+		noHit = XMVectorOrInt(noHit,XMVectorGreater(m2,r2));
+
+		//Nearest intersection, or the exit point when the origin is inside
+		XMVECTOR q = XMVectorSqrt(XMVectorMax(XMVectorSubtract(r2,m2),XMVectorZero()));
+		XMVECTOR originInside = XMVectorLessOrEqual(l2,r2);
+		dist = XMVectorSelect(XMVectorSubtract(proj,q),XMVectorAdd(proj,q),originInside);
+
+		return ~MoveMask(noHit) & 0xF;
+	}
+
+	//Moller-Trumbore, two sided: the back side is handled by flipping the signs of det, u, v and t
+	static inline UINT TestTriangles(const RayLanes &ray, const TriangleLanes &t, XMVECTOR &dist)
+	{
+		//p = direction x e2
+		XMVECTOR px = XMVectorSubtract(XMVectorMultiply(ray.dy,t.e2z),XMVectorMultiply(ray.dz,t.e2y));
+		XMVECTOR py = XMVectorSubtract(XMVectorMultiply(ray.dz,t.e2x),XMVectorMultiply(ray.dx,t.e2z));
+		XMVECTOR pz = XMVectorSubtract(XMVectorMultiply(ray.dx,t.e2y),XMVectorMultiply(ray.dy,t.e2x));
+
+		XMVECTOR det = XMVectorMultiply(t.e1x,px);
+		det = XMVectorMultiplyAdd(t.e1y,py,det);
+		det = XMVectorMultiplyAdd(t.e1z,pz,det);
+		XMVECTOR sign = XMVectorAndInt(det,g_signBit);
+		XMVECTOR absDet = XMVectorXorInt(det,sign);
+
+		//s = origin - v0
+		XMVECTOR sx = XMVectorSubtract(ray.ox,t.v0x);
+		XMVECTOR sy = XMVectorSubtract(ray.oy,t.v0y);
+		XMVECTOR sz = XMVectorSubtract(ray.oz,t.v0z);
+
+		XMVECTOR u = XMVectorMultiply(sx,px);
+		u = XMVectorMultiplyAdd(sy,py,u);
+		u = XMVectorMultiplyAdd(sz,pz,u);
+		u = XMVectorXorInt(u,sign);
+
+		//q = s x e1
+		XMVECTOR qx = XMVectorSubtract(XMVectorMultiply(sy,t.e1z),XMVectorMultiply(sz,t.e1y));
+		XMVECTOR qy = XMVectorSubtract(XMVectorMultiply(sz,t.e1x),XMVectorMultiply(sx,t.e1z));
+		XMVECTOR qz = XMVectorSubtract(XMVectorMultiply(sx,t.e1y),XMVectorMultiply(sy,t.e1x));
+
+		XMVECTOR v = XMVectorMultiply(ray.dx,qx);
+		v = XMVectorMultiplyAdd(ray.dy,qy,v);
+		v = XMVectorMultiplyAdd(ray.dz,qz,v);
+		v = XMVectorXorInt(v,sign);
+
+		XMVECTOR tq = XMVectorMultiply(t.e2x,qx);
+		tq = XMVectorMultiplyAdd(t.e2y,qy,tq);
+		tq = XMVectorMultiplyAdd(t.e2z,qz,tq);
+
+		XMVECTOR noHit = XMVectorLess(absDet,g_epsilon);
+		noHit = XMVectorOrInt(noHit,XMVectorLess(u,XMVectorZero()));
+		noHit = XMVectorOrInt(noHit,XMVectorGreater(u,absDet));
+		noHit = XMVectorOrInt(noHit,XMVectorLess(v,XMVectorZero()));
+		noHit = XMVectorOrInt(noHit,XMVectorGreater(XMVectorAdd(u,v),absDet));
+		noHit = XMVectorOrInt(noHit,XMVectorLess(XMVectorXorInt(tq,sign),XMVectorZero()));
+
+		dist = XMVectorDivide(tq,det);
+		return ~MoveMask(noHit) & 0xF;
+	}
+
+	static inline void LoadBoxes(const Boxes8 &b, UINT i, BoxLanes &l)
+	{
+		l.cx = Load4(b.centerX + i);	l.cy = Load4(b.centerY + i);	l.cz = Load4(b.centerZ + i);
+		l.ex = Load4(b.extentX + i);	l.ey = Load4(b.extentY + i);	l.ez = Load4(b.extentZ + i);
+	}
+
+	static inline void SplatBox(const Boxes8 &b, UINT i, BoxLanes &l)
+	{
+		l.cx = XMVectorReplicate(b.centerX[i]);	l.cy = XMVectorReplicate(b.centerY[i]);	l.cz = XMVectorReplicate(b.centerZ[i]);
+		l.ex = XMVectorReplicate(b.extentX[i]);	l.ey = XMVectorReplicate(b.extentY[i]);	l.ez = XMVectorReplicate(b.extentZ[i]);
+	}
+
+	static inline void LoadSpheres(const Spheres8 &s, UINT i, SphereLanes &l)
+	{
+		l.cx = Load4(s.centerX + i);	l.cy = Load4(s.centerY + i);	l.cz = Load4(s.centerZ + i);
+		l.r = Load4(s.radius + i);
+	}
+
+	static inline void SplatSphere(const Spheres8 &s, UINT i, SphereLanes &l)
+	{
+		l.cx = XMVectorReplicate(s.centerX[i]);	l.cy = XMVectorReplicate(s.centerY[i]);	l.cz = XMVectorReplicate(s.centerZ[i]);
+		l.r = XMVectorReplicate(s.radius[i]);
+	}
+
+	static inline void LoadTriangles(const Triangles8 &t, UINT i, TriangleLanes &l)
+	{
+		l.v0x = Load4(t.v0X + i);	l.v0y = Load4(t.v0Y + i);	l.v0z = Load4(t.v0Z + i);
+		l.e1x = Load4(t.e1X + i);	l.e1y = Load4(t.e1Y + i);	l.e1z = Load4(t.e1Z + i);
+		l.e2x = Load4(t.e2X + i);	l.e2y = Load4(t.e2Y + i);	l.e2z = Load4(t.e2Z + i);
+	}
+
+	static inline void SplatTriangle(const Triangles8 &t, UINT i, TriangleLanes &l)
+	{
+		l.v0x = XMVectorReplicate(t.v0X[i]);	l.v0y = XMVectorReplicate(t.v0Y[i]);	l.v0z = XMVectorReplicate(t.v0Z[i]);
+		l.e1x = XMVectorReplicate(t.e1X[i]);	l.e1y = XMVectorReplicate(t.e1Y[i]);	l.e1z = XMVectorReplicate(t.e1Z[i]);
+		l.e2x = XMVectorReplicate(t.e2X[i]);	l.e2y = XMVectorReplicate(t.e2Y[i]);	l.e2z = XMVectorReplicate(t.e2Z[i]);
+	}
+
+	UINT IntersectRayBoxes8(const Ray &ray, const Boxes8 &boxes, float *dist)
+	{
+		//Two independent groups of 4
+		BoxLanes low, high;
+		LoadBoxes(boxes,0,low);
+		LoadBoxes(boxes,4,high);
+
+		XMVECTOR distLow, distHigh;
+		UINT hits = TestBoxes(ray,low,distLow) | (TestBoxes(ray,high,distHigh) << 4);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist),distLow);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist + 4),distHigh);
+
+		return hits;
+	}
+
+	UINT IntersectRaySpheres8(const Ray &ray, const Spheres8 &spheres, float *dist)
+	{
+		SphereLanes low, high;
+		LoadSpheres(spheres,0,low);
+		LoadSpheres(spheres,4,high);
+
+		XMVECTOR distLow, distHigh;
+		UINT hits = TestSpheres(ray,low,distLow) | (TestSpheres(ray,high,distHigh) << 4);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist),distLow);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist + 4),distHigh);
+
+		return hits;
+	}
+
+	UINT IntersectRayTriangles8(const Ray &ray, const Triangles8 &triangles, float *dist)
+	{
+		TriangleLanes low, high;
+		LoadTriangles(triangles,0,low);
+		LoadTriangles(triangles,4,high);
+
+		XMVECTOR distLow, distHigh;
+		UINT hits = TestTriangles(ray,low,distLow) | (TestTriangles(ray,high,distHigh) << 4);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist),distLow);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist + 4),distHigh);
+
+		return hits;
+	}
+
+	UINT IntersectPacketBoxes4x4(const RayPacket4 &packet, const Boxes8 &boxes, UINT first, float *dist)
+	{
+		XMASSERT(first + 4 <= 8);
+
+		UINT hits = 0;
+		for(UINT p=0; p<4; ++p)
+		{
+			BoxLanes box;
+			SplatBox(boxes,first + p,box);
+
+			XMVECTOR d;
+			hits |= TestBoxes(packet,box,d) << (4 * p);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist + 4 * p),d);
+		}
+
+		return hits;
+	}
+
+	UINT IntersectPacketSpheres4x4(const RayPacket4 &packet, const Spheres8 &spheres, UINT first, float *dist)
+	{
+		XMASSERT(first + 4 <= 8);
+
+		UINT hits = 0;
+		for(UINT p=0; p<4; ++p)
+		{
+			SphereLanes sphere;
+			SplatSphere(spheres,first + p,sphere);
+
+			XMVECTOR d;
+			hits |= TestSpheres(packet,sphere,d) << (4 * p);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist + 4 * p),d);
+		}
+
+		return hits;
+	}
+
+	UINT IntersectPacketTriangles4x4(const RayPacket4 &packet, const Triangles8 &triangles, UINT first, float *dist)
+	{
+		XMASSERT(first + 4 <= 8);
+
+		UINT hits = 0;
+		for(UINT p=0; p<4; ++p)
+		{
+			TriangleLanes triangle;
+			SplatTriangle(triangles,first + p,triangle);
+
+			XMVECTOR d;
+			hits |= TestTriangles(packet,triangle,d) << (4 * p);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dist + 4 * p),d);
+		}
+
+		return hits;
+	}
+};
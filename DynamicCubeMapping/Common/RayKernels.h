@@ -0,0 +1,68 @@
+#ifndef _RAY_KERNELS_H_
+#define _RAY_KERNELS_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include "xnacollision.h"
+
+//Ray tests against 8 primitives at once, and 4 rays against 4 primitives at once.
+//Primitives are packed as structure of arrays, so each XMVECTOR lane works on a different primitive(or ray).
+//Hits and distances follow XNA::IntersectRayAxisAlignedBox, IntersectRaySphere and IntersectRayTriangle.
+namespace RayKernels
+{
+	//Ray data in vector lanes: either one ray splatted across the lanes(SetRay), or four rays with one per lane(SetRayPacket)
+	_DECLSPEC_ALIGN_16_ struct RayLanes
+	{
+		XMVECTOR	ox, oy, oz;
+		XMVECTOR	dx, dy, dz;
+		XMVECTOR	invDx, invDy, invDz;
+		XMVECTOR	parallelX, parallelY, parallelZ;	//All bits set where the direction is parallel to the slab
+	};
+
+	_DECLSPEC_ALIGN_16_ struct Ray: public RayLanes {};
+	_DECLSPEC_ALIGN_16_ struct RayPacket4: public RayLanes {};
+
+	//8 axis aligned boxes(center and half size, same as XNA::AxisAlignedBox)
+	_DECLSPEC_ALIGN_16_ struct Boxes8
+	{
+		float	centerX[8], centerY[8], centerZ[8];
+		float	extentX[8], extentY[8], extentZ[8];
+	};
+
+	//8 spheres
+	_DECLSPEC_ALIGN_16_ struct Spheres8
+	{
+		float	centerX[8], centerY[8], centerZ[8];
+		float	radius[8];
+	};
+
+	//8 triangles, stored as one vertex and two edges
+	_DECLSPEC_ALIGN_16_ struct Triangles8
+	{
+		float	v0X[8], v0Y[8], v0Z[8];
+		float	e1X[8], e1Y[8], e1Z[8];		//v1 - v0
+		float	e2X[8], e2Y[8], e2Z[8];		//v2 - v0
+	};
+
+	//Directions must be normalized, as in the XNA tests
+	void SetRay(FXMVECTOR origin, FXMVECTOR direction, Ray &ray);
+	void SetRayPacket(const XMVECTOR *origins, const XMVECTOR *directions, RayPacket4 &packet);
+
+	void SetBox(UINT i, const XNA::AxisAlignedBox &box, Boxes8 &boxes);
+	void SetSphere(UINT i, const XNA::Sphere &sphere, Spheres8 &spheres);
+	void SetTriangle(UINT i, FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2, Triangles8 &triangles);
+
+	//One ray against 8 primitives: bit i of the result is set when primitive i is hit, and dist[i] receives the distance.
+	//Slots that are not filled must still hold valid numbers(e.g. zero sized primitives far away).
+	UINT IntersectRayBoxes8(const Ray &ray, const Boxes8 &boxes, float *dist);
+	UINT IntersectRaySpheres8(const Ray &ray, const Spheres8 &spheres, float *dist);
+	UINT IntersectRayTriangles8(const Ray &ray, const Triangles8 &triangles, float *dist);
+
+	//4 rays against primitives [first, first + 4) of a pack: bit 4 * p + r of the result is set when ray r hits
+	//primitive first + p, and dist[4 * p + r] receives the distance.
+	UINT IntersectPacketBoxes4x4(const RayPacket4 &packet, const Boxes8 &boxes, UINT first, float *dist);
+	UINT IntersectPacketSpheres4x4(const RayPacket4 &packet, const Spheres8 &spheres, UINT first, float *dist);
+	UINT IntersectPacketTriangles4x4(const RayPacket4 &packet, const Triangles8 &triangles, UINT first, float *dist);
+};
+
+#endif	//_RAY_KERNELS_H_
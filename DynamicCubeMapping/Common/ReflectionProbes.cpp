@@ -0,0 +1,529 @@
+#include "ReflectionProbes.h"
+#include "AppUtil.h"
+#include "Culling.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+static const UINT g_allFaces = 0x3F;
+
+static inline UINT CountFaces(UINT mask)
+{
+	UINT count = 0;
+	for(; mask; mask &= mask - 1)
+		++count;
+	return count;
+}
+
+ReflectionProbes::ReflectionProbes():m_nTiers(0),
+	m_freeProbe(-1),
+	m_frame(0),
+	m_lastFaces(0)
+{
+	for(UINT t=0; t<MaxTiers; ++t)
+	{
+		m_tiers[t].arraySRV = NULL;
+		m_tiers[t].dsv = NULL;
+	}
+}
+
+ReflectionProbes::~ReflectionProbes()
+{
+	Release();
+}
+
+void ReflectionProbes::Release()
+{
+	for(UINT t=0; t<MaxTiers; ++t)
+	{
+		Tier &tier = m_tiers[t];
+		for(UINT i=0; i<tier.rtvs.size(); ++i)
+			SafeRelease(tier.rtvs[i]);
+		for(UINT i=0; i<tier.slotSRVs.size(); ++i)
+			SafeRelease(tier.slotSRVs[i]);
+		SafeRelease(tier.arraySRV);
+		SafeRelease(tier.dsv);
+		tier.rtvs.clear();
+		tier.slotSRVs.clear();
+		tier.owners.clear();
+		tier.lastUsed.clear();
+	}
+	m_nTiers = 0;
+
+	//Probes keep their place, without slots
+	for(UINT p=0; p<m_probes.size(); ++p)
+	{
+		m_probes[p].tier = -1;
+		m_probes[p].target = -1;
+		m_probes[p].valid = 0;
+	}
+}
+
+bool ReflectionProbes::Init(ID3D11Device *device, const TierDesc *tiers, UINT nTiers, DXGI_FORMAT format)
+{
+	Release();
+
+	m_nTiers = min(nTiers,(UINT)MaxTiers);
+	for(UINT t=0; t<m_nTiers; ++t)
+	{
+		Tier &tier = m_tiers[t];
+		tier.desc = tiers[t];
+		tier.owners.assign(tier.desc.slots,-1);
+		tier.lastUsed.assign(tier.desc.slots,0);
+		if(device && tier.desc.slots && !CreateViews(device,tier,format))
+		{
+			Release();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ReflectionProbes::CreateViews(ID3D11Device *device, Tier &tier, DXGI_FORMAT format)
+{
+	UINT slots = tier.desc.slots;
+
+	D3D11_TEXTURE2D_DESC cubeDesc;
+	cubeDesc.Width = tier.desc.resolution;
+	cubeDesc.Height = tier.desc.resolution;
+	cubeDesc.Format = format;
+	cubeDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	cubeDesc.ArraySize = 6 * slots;
+	cubeDesc.Usage = D3D11_USAGE_DEFAULT;
+	cubeDesc.CPUAccessFlags = 0;
+	cubeDesc.MipLevels = 0;
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE | D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	cubeDesc.SampleDesc.Count = 1;
+	cubeDesc.SampleDesc.Quality = 0;
+
+	ID3D11Texture2D *cubes(NULL);
+	if(FAILED(device->CreateTexture2D(&cubeDesc,0,&cubes)))
+	{
+		MessageBox(NULL,L"Create reflection probe cube array failed!",L"Error",MB_OK);
+		return false;
+	}
+
+	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc;
+	rtvDesc.Format = format;
+	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
+	rtvDesc.Texture2DArray.ArraySize = 1;
+	rtvDesc.Texture2DArray.MipSlice = 0;
+	tier.rtvs.assign(6 * slots,(ID3D11RenderTargetView*)NULL);
+	for(UINT i=0; i<6 * slots; ++i)
+	{
+		rtvDesc.Texture2DArray.FirstArraySlice = i;
+		if(FAILED(device->CreateRenderTargetView(cubes,&rtvDesc,&tier.rtvs[i])))
+		{
+			SafeRelease(cubes);
+			MessageBox(NULL,L"Create reflection probe rtv failed!",L"Error",MB_OK);
+			return false;
+		}
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+	srvDesc.TextureCubeArray.MostDetailedMip = 0;
+	srvDesc.TextureCubeArray.MipLevels = -1;
+	srvDesc.TextureCubeArray.First2DArrayFace = 0;
+	srvDesc.TextureCubeArray.NumCubes = slots;
+	if(FAILED(device->CreateShaderResourceView(cubes,&srvDesc,&tier.arraySRV)))
+	{
+		SafeRelease(cubes);
+		MessageBox(NULL,L"Create reflection probe srv failed!",L"Error",MB_OK);
+		return false;
+	}
+
+	//One cube per view, so the mips of a single probe can be rebuilt
+	srvDesc.TextureCubeArray.NumCubes = 1;
+	tier.slotSRVs.assign(slots,(ID3D11ShaderResourceView*)NULL);
+	for(UINT s=0; s<slots; ++s)
+	{
+		srvDesc.TextureCubeArray.First2DArrayFace = 6 * s;
+		if(FAILED(device->CreateShaderResourceView(cubes,&srvDesc,&tier.slotSRVs[s])))
+		{
+			SafeRelease(cubes);
+			MessageBox(NULL,L"Create reflection probe srv failed!",L"Error",MB_OK);
+			return false;
+		}
+	}
+	SafeRelease(cubes);
+
+	D3D11_TEXTURE2D_DESC dsDesc;
+	dsDesc.Width = tier.desc.resolution;
+	dsDesc.Height = tier.desc.resolution;
+	dsDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	dsDesc.ArraySize = 1;
+	dsDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+	dsDesc.Usage = D3D11_USAGE_DEFAULT;
+	dsDesc.SampleDesc.Count = 1;
+	dsDesc.SampleDesc.Quality = 0;
+	dsDesc.CPUAccessFlags = 0;
+	dsDesc.MiscFlags = 0;
+	dsDesc.MipLevels = 1;
+
+	ID3D11Texture2D *depth(NULL);
+	if(FAILED(device->CreateTexture2D(&dsDesc,0,&depth)))
+	{
+		MessageBox(NULL,L"Create reflection probe depth buffer failed!",L"Error",MB_OK);
+		return false;
+	}
+	if(FAILED(device->CreateDepthStencilView(depth,0,&tier.dsv)))
+	{
+		SafeRelease(depth);
+		MessageBox(NULL,L"Create reflection probe dsv failed!",L"Error",MB_OK);
+		return false;
+	}
+	SafeRelease(depth);
+
+	return true;
+}
+
+int ReflectionProbes::CreateProbe(FXMVECTOR center, float radius)
+{
+	int probe;
+	if(m_freeProbe >= 0)
+	{
+		probe = m_freeProbe;
+		m_freeProbe = m_probes[probe].slot;
+	}
+	else
+	{
+		probe = m_probes.size();
+		m_probes.push_back(Probe());
+	}
+
+	Probe &p = m_probes[probe];
+	XMStoreFloat3(&p.center,center);
+	p.radius = radius;
+	p.tier = -1;
+	p.slot = -1;
+	p.target = -1;
+	p.valid = 0;
+	p.dirty = g_allFaces;
+	p.cursor = 0;
+	p.credit = 0.f;
+	p.coverage = 0.f;
+	p.distance = 0.f;
+	p.rank = m_probes.size();
+	p.filled = 0;
+	p.alive = true;
+
+	return probe;
+}
+
+void ReflectionProbes::DestroyProbe(int probe)
+{
+	FreeSlot(probe);
+	m_probes[probe].alive = false;
+	m_probes[probe].slot = m_freeProbe;
+	m_freeProbe = probe;
+}
+
+void ReflectionProbes::MoveProbe(int probe, FXMVECTOR center)
+{
+	XMStoreFloat3(&m_probes[probe].center,center);
+	m_probes[probe].dirty = g_allFaces;
+}
+
+void ReflectionProbes::MarkDirty(int probe, UINT faceMask)
+{
+	m_probes[probe].dirty |= faceMask & g_allFaces;
+}
+
+void ReflectionProbes::ObjectMoved(const XNA::AxisAlignedBox &before, const XNA::AxisAlignedBox &after)
+{
+	float centerX[2] = { before.Center.x, after.Center.x };
+	float centerY[2] = { before.Center.y, after.Center.y };
+	float centerZ[2] = { before.Center.z, after.Center.z };
+	float extentX[2] = { before.Extents.x, after.Extents.x };
+	float extentY[2] = { before.Extents.y, after.Extents.y };
+	float extentZ[2] = { before.Extents.z, after.Extents.z };
+	Culling::AABBSoA boxes = { centerX, centerY, centerZ, extentX, extentY, extentZ, 2 };
+
+	for(UINT p=0; p<m_probes.size(); ++p)
+	{
+		Probe &probe = m_probes[p];
+		if(!probe.alive)
+			continue;
+
+		Culling::CubeViews cube = { probe.center, m_rig.GetNearZ(), m_rig.GetFarZ() };
+		UINT masks[2];
+		Culling::CullAABBsCube(cube,NULL,0,boxes,masks);
+		probe.dirty |= (masks[0] | masks[1]) & g_allFaces;
+	}
+}
+
+void ReflectionProbes::FreeSlot(int probe)
+{
+	Probe &p = m_probes[probe];
+	if(p.tier >= 0)
+		m_tiers[p.tier].owners[p.slot] = -1;
+	p.tier = -1;
+	p.slot = -1;
+	p.valid = 0;
+}
+
+void ReflectionProbes::AssignSlot(int probe, UINT t)
+{
+	Tier &tier = m_tiers[t];
+	int best = -1;
+	for(UINT s=0; s<tier.owners.size(); ++s)
+	{
+		int owner = tier.owners[s];
+		if(owner < 0)
+		{
+			best = s;
+			break;
+		}
+		//A slot whose probe is ranked into this tier again stays with it
+		if(m_probes[owner].target == (int)t)
+			continue;
+		if(best < 0 || tier.lastUsed[s] < tier.lastUsed[best])
+			best = s;
+	}
+	if(best < 0)
+		return;
+
+	if(tier.owners[best] >= 0)
+		FreeSlot(tier.owners[best]);
+	FreeSlot(probe);
+
+	Probe &p = m_probes[probe];
+	p.tier = t;
+	p.slot = best;
+	p.valid = 0;
+	p.credit = 0.f;
+	tier.owners[best] = probe;
+}
+
+UINT ReflectionProbes::TakeFaces(Probe &probe, UINT candidates, UINT count)
+{
+	UINT faces = 0;
+	UINT start = probe.cursor;
+	for(UINT i=0; i<6 && count > 0; ++i)
+	{
+		UINT face = (start + i) % 6;
+		if(candidates & (1 << face))
+		{
+			faces |= 1 << face;
+			probe.cursor = (face + 1) % 6;
+			--count;
+		}
+	}
+	return faces;
+}
+
+void ReflectionProbes::Update(const Camera &camera, UINT faceBudget, std::vector<FaceUpdate> &updates)
+{
+	updates.clear();
+	++m_frame;
+
+	//Screen coverage: a sphere of radius r at distance d covers a disk of radius r / (d tan(fovY / 2)) in y,
+	//pi r'^2 / aspect of the 4 units of the screen. Probes outside the frustum cover nothing.
+	XMVECTOR eye = camera.GetPositionXM();
+	XMVECTOR planes[6];
+	camera.GetPlanes(planes);
+	float tanHalfFov = tan(camera.GetFovY() * 0.5f);
+	float aspect = camera.GetAspect();
+	m_order.clear();
+	for(UINT p=0; p<m_probes.size(); ++p)
+	{
+		Probe &probe = m_probes[p];
+		if(!probe.alive)
+			continue;
+
+		XMVECTOR center = XMLoadFloat3(&probe.center);
+		probe.distance = XMVectorGetX(XMVector3Length(center - eye));
+		bool inside = true;
+		for(UINT i=0; i<6 && inside; ++i)
+			inside = XMVectorGetX(XMPlaneDotCoord(planes[i],center)) <= probe.radius;
+
+		if(!inside)
+			probe.coverage = 0.f;
+		else if(probe.distance <= probe.radius)
+			probe.coverage = 1.f;
+		else
+		{
+			float r = probe.radius / (probe.distance * tanHalfFov);
+			probe.coverage = min(XM_PI * r * r / (4.f * aspect),1.f);
+		}
+		m_order.push_back(p);
+	}
+
+	const std::vector<Probe> &probes = m_probes;
+	std::sort(m_order.begin(),m_order.end(),[&](int a, int b) -> bool
+	{
+		if(probes[a].coverage != probes[b].coverage)
+			return probes[a].coverage > probes[b].coverage;
+		if(probes[a].distance != probes[b].distance)
+			return probes[a].distance < probes[b].distance;
+		return a < b;
+	});
+
+	//Tier of each rank: the slots of the first tier, then those of the next ones
+	UINT t = 0, used = 0;
+	for(UINT r=0; r<m_order.size(); ++r)
+	{
+		while(t < m_nTiers && used >= m_tiers[t].desc.slots)
+		{
+			++t;
+			used = 0;
+		}
+		Probe &probe = m_probes[m_order[r]];
+		probe.rank = r;
+		probe.target = t < m_nTiers ? (int)t : -1;
+		++used;
+	}
+
+	//Slots in rank order, so the best probes win the evictions
+	for(UINT r=0; r<m_order.size(); ++r)
+	{
+		int p = m_order[r];
+		Probe &probe = m_probes[p];
+		if(probe.target < 0)
+			continue;
+		if(probe.tier != probe.target)
+			AssignSlot(p,probe.target);
+		if(probe.tier >= 0)
+			m_tiers[probe.tier].lastUsed[probe.slot] = m_frame;
+	}
+
+	//A new cube is completed first, in rank order. The refreshes then share the rest of the budget: each probe earns
+	//faces at the rate of its tier, every rate scaled down by the same factor when they ask for more than the budget,
+	//so the lower tiers slow down instead of starving behind the first ranks.
+	UINT budget = faceBudget;
+	float demand = 0.f;
+	for(UINT r=0; r<m_order.size(); ++r)
+	{
+		Probe &probe = m_probes[m_order[r]];
+		if(probe.tier < 0 || probe.tier != probe.target)
+			continue;
+
+		UINT missing = ~probe.valid & g_allFaces;
+		if(missing)
+		{
+			probe.filled = m_frame;
+			UINT faces = TakeFaces(probe,missing,budget);
+			budget -= CountFaces(faces);
+			EmitFaces(m_order[r],faces,updates);
+		}
+		else
+			demand += m_tiers[probe.tier].desc.facesPerFrame;
+	}
+
+	float scale = demand > (float)budget ? budget / demand : 1.f;
+	for(UINT r=0; r<m_order.size() && budget > 0; ++r)
+	{
+		int p = m_order[r];
+		Probe &probe = m_probes[p];
+		if(probe.tier < 0 || probe.tier != probe.target)
+			continue;
+		//Probes filled above wait for the next frame
+		if(probe.filled == m_frame)
+			continue;
+
+		probe.credit = min(probe.credit + m_tiers[probe.tier].desc.facesPerFrame * scale,6.f);
+		UINT count = min((UINT)probe.credit,budget);
+		if(count == 0)
+			continue;
+		probe.credit -= count;
+
+		//Dirty faces first, then the others in turn
+		UINT faces = TakeFaces(probe,probe.dirty,count);
+		faces |= TakeFaces(probe,g_allFaces & ~faces,count - CountFaces(faces));
+		budget -= count;
+		EmitFaces(p,faces,updates);
+	}
+	m_lastFaces = updates.size();
+}
+
+void ReflectionProbes::EmitFaces(int probe, UINT faces, std::vector<FaceUpdate> &updates)
+{
+	Probe &p = m_probes[probe];
+	const Tier &tier = m_tiers[p.tier];
+	p.valid |= faces;
+	p.dirty &= ~faces;
+
+	m_rig.SetCenter(XMLoadFloat3(&p.center));
+	for(UINT f=0; f<6; ++f)
+	{
+		if(!(faces & (1 << f)))
+			continue;
+
+		FaceUpdate update;
+		update.probe = probe;
+		update.face = f;
+		update.tier = p.tier;
+		update.slot = p.slot;
+		XMStoreFloat4x4(&update.viewProj,m_rig.ViewProjection(f));
+		update.center = p.center;
+		update.rtv = tier.rtvs.empty() ? NULL : tier.rtvs[6 * p.slot + f];
+		update.dsv = tier.dsv;
+		update.viewport.TopLeftX = 0.f;
+		update.viewport.TopLeftY = 0.f;
+		update.viewport.Width = (float)tier.desc.resolution;
+		update.viewport.Height = (float)tier.desc.resolution;
+		update.viewport.MinDepth = 0.f;
+		update.viewport.MaxDepth = 1.f;
+		updates.push_back(update);
+	}
+}
+
+void ReflectionProbes::GenerateMips(ID3D11DeviceContext *context, const std::vector<FaceUpdate> &updates) const
+{
+	//Faces of a probe are consecutive in 'updates'
+	for(UINT i=0; i<updates.size(); ++i)
+	{
+		const FaceUpdate &update = updates[i];
+		if(i + 1 < updates.size() && updates[i + 1].probe == update.probe)
+			continue;
+		const Tier &tier = m_tiers[update.tier];
+		if(!tier.slotSRVs.empty())
+			context->GenerateMips(tier.slotSRVs[update.slot]);
+	}
+}
+
+bool ReflectionProbes::GetSlot(int probe, UINT &tier, UINT &slot) const
+{
+	const Probe &p = m_probes[probe];
+	if(!p.alive || p.tier < 0 || p.valid != g_allFaces)
+		return false;
+	tier = p.tier;
+	slot = p.slot;
+	return true;
+}
+
+bool ReflectionProbes::GetBlend(FXMVECTOR point, Blend &blend) const
+{
+	float dist[2] = { FLT_MAX, FLT_MAX };
+	blend.probes[0] = blend.probes[1] = -1;
+	blend.weight = 0.f;
+	for(UINT p=0; p<m_probes.size(); ++p)
+	{
+		const Probe &probe = m_probes[p];
+		if(!probe.alive || probe.tier < 0 || probe.valid != g_allFaces)
+			continue;
+
+		float d = XMVectorGetX(XMVector3Length(XMLoadFloat3(&probe.center) - point));
+		if(d < dist[0])
+		{
+			dist[1] = dist[0];
+			blend.probes[1] = blend.probes[0];
+			dist[0] = d;
+			blend.probes[0] = p;
+		}
+		else if(d < dist[1])
+		{
+			dist[1] = d;
+			blend.probes[1] = p;
+		}
+	}
+	if(blend.probes[0] < 0)
+		return false;
+
+	//Inverse distance weights: the nearer probe counts more, half each halfway between them
+	if(blend.probes[1] >= 0)
+		blend.weight = dist[0] + dist[1] > 0.f ? dist[0] / (dist[0] + dist[1]) : 0.5f;
+	return true;
+}
@@ -0,0 +1,143 @@
+#ifndef _REFLECTION_PROBES_H_
+#define _REFLECTION_PROBES_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include <D3D11.h>
+#include <vector>
+#include "xnacollision.h"
+#include "Camera.h"
+#include "CubeCameraRig.h"
+
+//Dynamic cube maps for many reflective objects. The cubes live in a few TextureCubeArray pools, one per resolution
+//(tier), each with a fixed number of slots. Every frame the probes are ranked by their coverage of the screen, then
+//their distance to the camera: the best ranked fill the slots of the first tier, the next ones those of the second tier,
+//and so on. A probe moved to another tier takes a free slot there or the least recently used one; probes ranked
+//out of every tier keep their slot as a cache until it is taken. All faces of a frame fit in one budget: new cubes
+//are completed first, then each tier refreshes its probes at its own rate, slowed down evenly when the rates exceed
+//the budget. The faces to render are returned with their views and targets; drawing them is up to the caller.
+class ReflectionProbes
+{
+public:
+	enum { MaxTiers = 4 };
+
+	struct TierDesc
+	{
+		UINT	resolution;			//Width and height of the cube faces
+		UINT	slots;				//Cubes in the array
+		float	facesPerFrame;		//Refresh rate of each probe of the tier, 6 for a full cube every frame
+	};
+
+	//A face to render this frame
+	struct FaceUpdate
+	{
+		int							probe;
+		UINT						face;			//D3D face order(+X, -X, +Y, -Y, +Z, -Z)
+		UINT						tier;
+		UINT						slot;			//Cube index in the array of the tier
+		XMFLOAT4X4					viewProj;
+		XMFLOAT3					center;
+		ID3D11RenderTargetView		*rtv;
+		ID3D11DepthStencilView		*dsv;			//Shared by the tier
+		D3D11_VIEWPORT				viewport;
+	};
+
+	//The two nearest probes with a complete cube: weight is the share of probes[1](-1 when there is only one probe)
+	struct Blend
+	{
+		int		probes[2];
+		float	weight;
+	};
+
+	ReflectionProbes();
+	~ReflectionProbes();
+
+	//Create the pools, in decreasing resolution. With a NULL device only the ranking and scheduling run(no views).
+	bool Init(ID3D11Device *device, const TierDesc *tiers, UINT nTiers, DXGI_FORMAT format = DXGI_FORMAT_R16G16B16A16_FLOAT);
+	void Release();
+	//Near and far distances of the cube cameras
+	void SetLens(float nearZ, float farZ)	{ m_rig.SetLens(nearZ,farZ); }
+
+	//'radius' is the size of the reflective object, used for its screen coverage
+	int		CreateProbe(FXMVECTOR center, float radius);
+	void	DestroyProbe(int probe);
+	//A moved probe sees everything from a new point: all its faces become dirty
+	void	MoveProbe(int probe, FXMVECTOR center);
+	void	MarkDirty(int probe, UINT faceMask);
+	//Mark the faces of every probe that saw the box before or sees it after it moved
+	void	ObjectMoved(const XNA::AxisAlignedBox &before, const XNA::AxisAlignedBox &after);
+
+	//Rank the probes for 'camera', assign the slots and fill 'updates' with at most 'faceBudget' faces,
+	//which count as rendered after the call
+	void Update(const Camera &camera, UINT faceBudget, std::vector<FaceUpdate> &updates);
+	//After the faces of 'updates' were drawn, rebuild the mips of the cubes they belong to
+	void GenerateMips(ID3D11DeviceContext *context, const std::vector<FaceUpdate> &updates) const;
+
+	//Nearest two probes for an object at 'point'. Return false when no probe has a complete cube.
+	bool GetBlend(FXMVECTOR point, Blend &blend) const;
+	//Tier and slot of a probe with a complete cube
+	bool GetSlot(int probe, UINT &tier, UINT &slot) const;
+	//Rank of the last Update, 0 is the best
+	UINT GetRank(int probe)	const	{ return m_probes[probe].rank; }
+
+	ID3D11ShaderResourceView*	GetArraySRV(UINT tier)	const	{ return m_tiers[tier].arraySRV; }
+	UINT						GetTierCount()			const	{ return m_nTiers; }
+
+	UINT GetLastFaces()		const	{ return m_lastFaces; }
+
+private:
+	struct Probe
+	{
+		XMFLOAT3	center;
+		float		radius;
+		int			tier;			//Slot held, -1 when none. Free probes link through 'slot'.
+		int			slot;
+		int			target;			//Tier of the rank in the last Update, -1 when ranked out
+		UINT		valid;			//Faces rendered since the slot was taken
+		UINT		dirty;
+		UINT		cursor;			//Next face in cyclic order
+		float		credit;			//Faces owed at the rate of the tier
+		float		coverage;
+		float		distance;
+		UINT		rank;
+		UINT		filled;			//Last Update that rendered faces of an incomplete cube
+		bool		alive;
+	};
+
+	struct Tier
+	{
+		TierDesc								desc;
+		std::vector<int>						owners;			//Probe per slot, -1 when free
+		std::vector<UINT>						lastUsed;		//Frame a probe of the tier's rank last held the slot
+		std::vector<ID3D11RenderTargetView*>	rtvs;			//6 per slot
+		std::vector<ID3D11ShaderResourceView*>	slotSRVs;		//One cube each, for GenerateMips
+		ID3D11ShaderResourceView				*arraySRV;
+		ID3D11DepthStencilView					*dsv;
+	};
+
+	bool	CreateViews(ID3D11Device *device, Tier &tier, DXGI_FORMAT format);
+	//Give 'probe' a slot in tier 't', evicting the least recently used slot whose owner does not belong there
+	void	AssignSlot(int probe, UINT t);
+	void	FreeSlot(int probe);
+	//'count' faces in cyclic order from the probe's cursor among 'candidates'
+	UINT	TakeFaces(Probe &probe, UINT candidates, UINT count);
+	//Mark 'faces' rendered and append them to 'updates'
+	void	EmitFaces(int probe, UINT faces, std::vector<FaceUpdate> &updates);
+
+	ReflectionProbes(const ReflectionProbes&);
+	ReflectionProbes& operator=(const ReflectionProbes&);
+
+private:
+	Tier				m_tiers[MaxTiers];
+	UINT				m_nTiers;
+
+	std::vector<Probe>	m_probes;
+	int					m_freeProbe;
+	std::vector<int>	m_order;			//Probes by rank
+
+	CubeCameraRig		m_rig;				//Face views of the probe being scheduled
+	UINT				m_frame;
+	UINT				m_lastFaces;
+};
+
+#endif	//_REFLECTION_PROBES_H_
@@ -0,0 +1,309 @@
+#include "RenderTargetPool.h"
+#include "AppUtil.h"
+
+bool RenderTargetPool::Desc::operator==(const Desc &desc) const
+{
+	return width == desc.width && height == desc.height && arraySize == desc.arraySize && mipLevels == desc.mipLevels &&
+		format == desc.format && bindFlags == desc.bindFlags && miscFlags == desc.miscFlags;
+}
+
+RenderTargetPool::Desc RenderTargetPool::Desc::Color(UINT width, UINT height, DXGI_FORMAT format)
+{
+	Desc desc = { width, height, 1, 1, format, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE, 0 };
+	return desc;
+}
+
+RenderTargetPool::Desc RenderTargetPool::Desc::Depth(UINT width, UINT height, DXGI_FORMAT format)
+{
+	Desc desc = { width, height, 1, 1, format, D3D11_BIND_DEPTH_STENCIL, 0 };
+	return desc;
+}
+
+RenderTargetPool::Desc RenderTargetPool::Desc::Cube(UINT size, DXGI_FORMAT format)
+{
+	Desc desc = { size, size, 6, 0, format, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE,
+		D3D11_RESOURCE_MISC_TEXTURECUBE | D3D11_RESOURCE_MISC_GENERATE_MIPS };
+	return desc;
+}
+
+RenderTargetPool::RenderTargetPool():m_device(NULL),
+	m_maxIdleFrames(60),
+	m_frame(0),
+	m_peakBytes(0)
+{
+	ResetStats();
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+	ReleaseAll();
+}
+
+void RenderTargetPool::Init(ID3D11Device *device, UINT maxIdleFrames)
+{
+	ReleaseAll();
+	m_device = device;
+	m_maxIdleFrames = maxIdleFrames;
+}
+
+void RenderTargetPool::ReleaseAll()
+{
+	for(UINT i=0; i<m_targets.size(); ++i)
+		Destroy(m_targets[i]);
+	m_targets.clear();
+}
+
+int RenderTargetPool::Acquire(const Desc &desc)
+{
+	++m_acquires;
+
+	//The same descriptor released earlier: alias it
+	int free = -1;
+	for(UINT i=0; i<m_targets.size(); ++i)
+	{
+		Target &target = m_targets[i];
+		if(!target.texture)
+		{
+			if(free < 0)
+				free = i;
+			continue;
+		}
+		if(!target.held && target.desc == desc)
+		{
+			target.held = true;
+			++m_reuses;
+			return i;
+		}
+	}
+
+	if(free < 0)
+	{
+		free = m_targets.size();
+		m_targets.push_back(Target());
+		m_targets[free].texture = NULL;
+		m_targets[free].srv = NULL;
+	}
+	if(!Create(desc,m_targets[free]))
+		return -1;
+
+	m_peakBytes = max(m_peakBytes,GetTotalBytes());
+	return free;
+}
+
+void RenderTargetPool::Release(int target)
+{
+	if(target < 0)
+		return;
+	m_targets[target].held = false;
+	m_targets[target].lastFrame = m_frame;
+}
+
+void RenderTargetPool::EndFrame()
+{
+	++m_frame;
+	for(UINT i=0; i<m_targets.size(); ++i)
+	{
+		Target &target = m_targets[i];
+		if(target.texture && !target.held && m_frame - target.lastFrame > m_maxIdleFrames)
+			Destroy(target);
+	}
+}
+
+void RenderTargetPool::Trim()
+{
+	for(UINT i=0; i<m_targets.size(); ++i)
+	{
+		if(m_targets[i].texture && !m_targets[i].held)
+			Destroy(m_targets[i]);
+	}
+}
+
+bool RenderTargetPool::Create(const Desc &desc, Target &target)
+{
+	D3D11_TEXTURE2D_DESC texDesc;
+	texDesc.Width = desc.width;
+	texDesc.Height = desc.height;
+	texDesc.MipLevels = desc.mipLevels;
+	texDesc.ArraySize = desc.arraySize;
+	texDesc.Format = desc.format;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	texDesc.BindFlags = desc.bindFlags;
+	texDesc.CPUAccessFlags = 0;
+	texDesc.MiscFlags = desc.miscFlags;
+
+	target.desc = desc;
+	target.held = true;
+	target.lastFrame = m_frame;
+	target.bytes = TextureBytes(desc);
+	if(FAILED(m_device->CreateTexture2D(&texDesc,0,&target.texture)))
+	{
+		target.texture = NULL;
+		target.bytes = 0;
+		MessageBox(NULL,L"Create pooled render target failed!",L"Error",MB_OK);
+		return false;
+	}
+
+	//One render target / depth stencil view per slice, as cube faces are rendered one by one
+	if(desc.bindFlags & D3D11_BIND_RENDER_TARGET)
+	{
+		D3D11_RENDER_TARGET_VIEW_DESC rtvDesc;
+		rtvDesc.Format = desc.format;
+		rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
+		rtvDesc.Texture2DArray.ArraySize = 1;
+		rtvDesc.Texture2DArray.MipSlice = 0;
+		target.rtvs.assign(desc.arraySize,(ID3D11RenderTargetView*)NULL);
+		for(UINT i=0; i<desc.arraySize; ++i)
+		{
+			rtvDesc.Texture2DArray.FirstArraySlice = i;
+			if(FAILED(m_device->CreateRenderTargetView(target.texture,&rtvDesc,&target.rtvs[i])))
+			{
+				Destroy(target);
+				MessageBox(NULL,L"Create pooled rtv failed!",L"Error",MB_OK);
+				return false;
+			}
+		}
+	}
+	if(desc.bindFlags & D3D11_BIND_DEPTH_STENCIL)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+		dsvDesc.Format = desc.format;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		dsvDesc.Flags = 0;
+		dsvDesc.Texture2DArray.ArraySize = 1;
+		dsvDesc.Texture2DArray.MipSlice = 0;
+		target.dsvs.assign(desc.arraySize,(ID3D11DepthStencilView*)NULL);
+		for(UINT i=0; i<desc.arraySize; ++i)
+		{
+			dsvDesc.Texture2DArray.FirstArraySlice = i;
+			if(FAILED(m_device->CreateDepthStencilView(target.texture,&dsvDesc,&target.dsvs[i])))
+			{
+				Destroy(target);
+				MessageBox(NULL,L"Create pooled dsv failed!",L"Error",MB_OK);
+				return false;
+			}
+		}
+	}
+	if(desc.bindFlags & D3D11_BIND_SHADER_RESOURCE)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		srvDesc.Format = desc.format;
+		if(desc.miscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE)
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+			srvDesc.TextureCube.MostDetailedMip = 0;
+			srvDesc.TextureCube.MipLevels = -1;
+		}
+		else
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			srvDesc.Texture2DArray.MostDetailedMip = 0;
+			srvDesc.Texture2DArray.MipLevels = -1;
+			srvDesc.Texture2DArray.FirstArraySlice = 0;
+			srvDesc.Texture2DArray.ArraySize = desc.arraySize;
+		}
+		if(FAILED(m_device->CreateShaderResourceView(target.texture,&srvDesc,&target.srv)))
+		{
+			Destroy(target);
+			MessageBox(NULL,L"Create pooled srv failed!",L"Error",MB_OK);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void RenderTargetPool::Destroy(Target &target)
+{
+	for(UINT i=0; i<target.rtvs.size(); ++i)
+		SafeRelease(target.rtvs[i]);
+	for(UINT i=0; i<target.dsvs.size(); ++i)
+		SafeRelease(target.dsvs[i]);
+	target.rtvs.clear();
+	target.dsvs.clear();
+	SafeRelease(target.srv);
+	SafeRelease(target.texture);
+	target.held = false;
+	target.bytes = 0;
+}
+
+UINT64 RenderTargetPool::GetBytes(DXGI_FORMAT format) const
+{
+	UINT64 bytes = 0;
+	for(UINT i=0; i<m_targets.size(); ++i)
+	{
+		if(m_targets[i].texture && m_targets[i].desc.format == format)
+			bytes += m_targets[i].bytes;
+	}
+	return bytes;
+}
+
+UINT64 RenderTargetPool::GetTotalBytes() const
+{
+	UINT64 bytes = 0;
+	for(UINT i=0; i<m_targets.size(); ++i)
+		bytes += m_targets[i].bytes;
+	return bytes;
+}
+
+UINT RenderTargetPool::GetTargetCount() const
+{
+	UINT count = 0;
+	for(UINT i=0; i<m_targets.size(); ++i)
+	{
+		if(m_targets[i].texture)
+			++count;
+	}
+	return count;
+}
+
+void RenderTargetPool::ResetStats()
+{
+	m_acquires = 0;
+	m_reuses = 0;
+}
+
+UINT RenderTargetPool::FormatBytes(DXGI_FORMAT format)
+{
+	switch(format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 16;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 8;
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_D32_FLOAT:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+		return 4;
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_D16_UNORM:
+		return 2;
+	case DXGI_FORMAT_R8_UNORM:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+UINT64 RenderTargetPool::TextureBytes(const Desc &desc)
+{
+	//Sum of the mip levels, down to 1x1 for a full chain
+	UINT64 texels = 0;
+	UINT width = desc.width, height = desc.height;
+	for(UINT level=0; desc.mipLevels == 0 || level < desc.mipLevels; ++level)
+	{
+		texels += (UINT64)width * height;
+		if(width == 1 && height == 1)
+			break;
+		width = max(width / 2,1U);
+		height = max(height / 2,1U);
+	}
+	return texels * desc.arraySize * FormatBytes(desc.format);
+}
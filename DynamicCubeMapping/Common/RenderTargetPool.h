@@ -0,0 +1,103 @@
+#ifndef _RENDER_TARGET_POOL_H_
+#define _RENDER_TARGET_POOL_H_
+
+#include <Windows.h>
+#include <D3D11.h>
+#include <vector>
+
+//Render targets and depth buffers shared by the passes of a frame. A pass borrows a target for a descriptor with
+//Acquire and gives it back with Release; the next Acquire of the same descriptor gets the same texture, so passes
+//whose lifetimes do not overlap alias one allocation instead of holding their own. Targets that stay unused for a
+//while are destroyed by EndFrame. A target held across frames(e.g. a cube map whose faces are refreshed in turn)
+//is simply never released.
+class RenderTargetPool
+{
+public:
+	struct Desc
+	{
+		UINT			width;
+		UINT			height;
+		UINT			arraySize;			//6 for a cube
+		UINT			mipLevels;			//0 for the full chain
+		DXGI_FORMAT		format;
+		UINT			bindFlags;			//Render target, depth stencil and/or shader resource
+		UINT			miscFlags;			//E.g. TEXTURECUBE, GENERATE_MIPS
+
+		bool operator==(const Desc &desc) const;
+
+		//Common descriptors
+		static Desc Color(UINT width, UINT height, DXGI_FORMAT format);
+		static Desc Depth(UINT width, UINT height, DXGI_FORMAT format = DXGI_FORMAT_D32_FLOAT);
+		//Six faces with render target views, a cube view and generated mips
+		static Desc Cube(UINT size, DXGI_FORMAT format);
+	};
+
+	RenderTargetPool();
+	~RenderTargetPool();
+
+	void Init(ID3D11Device *device, UINT maxIdleFrames = 60);
+	//Destroy every target, held or not
+	void ReleaseAll();
+
+	//Borrow a target, -1 when it cannot be created
+	int		Acquire(const Desc &desc);
+	void	Release(int target);
+	//Destroy the targets unused for more than 'maxIdleFrames' frames
+	void	EndFrame();
+	//Destroy every target not held now, e.g. after a format change
+	void	Trim();
+
+	//Views of a held target. Render target and depth stencil views are per array slice.
+	ID3D11Texture2D*			GetTexture(int target)				const	{ return m_targets[target].texture; }
+	ID3D11RenderTargetView*		GetRTV(int target, UINT slice = 0)	const	{ return m_targets[target].rtvs[slice]; }
+	ID3D11DepthStencilView*		GetDSV(int target, UINT slice = 0)	const	{ return m_targets[target].dsvs[slice]; }
+	ID3D11ShaderResourceView*	GetSRV(int target)					const	{ return m_targets[target].srv; }
+	const Desc&					GetDesc(int target)					const	{ return m_targets[target].desc; }
+
+	//Video memory of the pool(estimated from the formats, mips included), per format and in total
+	UINT64	GetBytes(DXGI_FORMAT format)	const;
+	UINT64	GetTotalBytes()					const;
+	UINT64	GetPeakBytes()					const	{ return m_peakBytes; }
+	UINT	GetTargetCount()				const;
+
+	//Acquires since ResetStats, and how many of them got an existing texture
+	UINT	GetAcquires()	const	{ return m_acquires; }
+	UINT	GetReuses()		const	{ return m_reuses; }
+	void	ResetStats();
+
+	//Bytes per texel of the formats the pool knows, 0 for the others
+	static UINT FormatBytes(DXGI_FORMAT format);
+	static UINT64 TextureBytes(const Desc &desc);
+
+private:
+	struct Target
+	{
+		Desc										desc;
+		ID3D11Texture2D								*texture;		//NULL when the entry is free
+		std::vector<ID3D11RenderTargetView*>		rtvs;
+		std::vector<ID3D11DepthStencilView*>		dsvs;
+		ID3D11ShaderResourceView					*srv;
+		UINT64										bytes;
+		bool										held;
+		UINT										lastFrame;		//Frame of the last Release
+	};
+
+	bool	Create(const Desc &desc, Target &target);
+	void	Destroy(Target &target);
+
+	RenderTargetPool(const RenderTargetPool&);
+	RenderTargetPool& operator=(const RenderTargetPool&);
+
+private:
+	ID3D11Device			*m_device;
+	UINT					m_maxIdleFrames;
+	UINT					m_frame;
+
+	std::vector<Target>		m_targets;
+
+	UINT64					m_peakBytes;
+	UINT					m_acquires;
+	UINT					m_reuses;
+};
+
+#endif	//_RENDER_TARGET_POOL_H_
@@ -0,0 +1,219 @@
+#include "SatKernels.h"
+#include "AppUtil.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace SatKernels
+{
+	//Added to |R|, so axes built from nearly parallel edges do not report a separation from rounding noise
+	static const XMVECTORF32 g_parallelEpsilon = { 1e-6f, 1e-6f, 1e-6f, 1e-6f };
+	//Edge axes shorter than this(nearly parallel edges) are ignored for the penetration depth
+	static const XMVECTORF32 g_minAxisLength = { 1e-3f, 1e-3f, 1e-3f, 1e-3f };
+	static const XMVECTORF32 g_fltMax = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+
+	//Lane vectors of 4 boxes, in the order of PreparedBox
+	enum { CX, CY, CZ, EX, EY, EZ, AXES, LaneCount = 16 };
+
+	void PrepareBox(const XNA::OrientedBox &box, PreparedBox &out)
+	{
+		XMMATRIX r = XMMatrixRotationQuaternion(XMLoadFloat4(&box.Orientation));
+		XMFLOAT3 a0, a1, a2;
+		XMStoreFloat3(&a0,r.r[0]);
+		XMStoreFloat3(&a1,r.r[1]);
+		XMStoreFloat3(&a2,r.r[2]);
+
+		out.data[0] = XMFLOAT4(box.Center.x,box.Center.y,box.Center.z,box.Extents.x);
+		out.data[1] = XMFLOAT4(box.Extents.y,box.Extents.z,a0.x,a0.y);
+		out.data[2] = XMFLOAT4(a0.z,a1.x,a1.y,a1.z);
+		out.data[3] = XMFLOAT4(a2.x,a2.y,a2.z,0.f);
+	}
+
+	void PrepareBoxes(const XNA::OrientedBox *boxes, UINT count, PreparedBox *out)
+	{
+		for(UINT i=0; i<count; ++i)
+			PrepareBox(boxes[i],out[i]);
+	}
+
+	static inline void LoadLanes(const PreparedBox *const *boxes, XMVECTOR *lanes)
+	{
+		for(UINT r=0; r<4; ++r)
+		{
+			XMMATRIX m(XMLoadFloat4(&boxes[0]->data[r]),XMLoadFloat4(&boxes[1]->data[r]),
+				XMLoadFloat4(&boxes[2]->data[r]),XMLoadFloat4(&boxes[3]->data[r]));
+			m = XMMatrixTranspose(m);
+			lanes[4 * r] = m.r[0];
+			lanes[4 * r + 1] = m.r[1];
+			lanes[4 * r + 2] = m.r[2];
+			lanes[4 * r + 3] = m.r[3];
+		}
+	}
+
+	static inline XMVECTOR GetAxis(const PreparedBox &box, UINT i)
+	{
+		const float *a = &box.data[0].x + AXES + 3 * i;
+		return XMVectorSet(a[0],a[1],a[2],0.f);
+	}
+
+	//Track the axis with the least penetration: (r - |d|) / |axis|
+	static inline void UpdateDepth(FXMVECTOR d, FXMVECTOR r, FXMVECTOR invLength, UINT axis, XMVECTOR &minDepth, XMVECTOR &minAxis)
+	{
+		XMVECTOR depth = (r - XMVectorAbs(d)) * invLength;
+		XMVECTOR less = XMVectorLess(depth,minDepth);
+		minDepth = XMVectorSelect(minDepth,depth,less);
+		minAxis = XMVectorSelect(minAxis,XMVectorReplicateInt(axis),less);
+	}
+
+	//SAT for 4 pairs in the frame of box A, where B's axes are the columns of R = A^T B.
+	//Return the hit bits of the lanes in 'validLanes'.
+	static UINT TestLanes(const PreparedBox *const *boxesA, const PreparedBox *const *boxesB, UINT validLanes, Contact *const *contacts)
+	{
+		XMVECTOR a[LaneCount], b[LaneCount];
+		LoadLanes(boxesA,a);
+		LoadLanes(boxesB,b);
+
+		XMVECTOR tw[3] = {b[CX] - a[CX], b[CY] - a[CY], b[CZ] - a[CZ]};
+		XMVECTOR t[3];
+		XMVECTOR R[3][3], absR[3][3];
+		for(UINT i=0; i<3; ++i)
+		{
+			const XMVECTOR *ai = &a[AXES + 3 * i];
+			t[i] = tw[0] * ai[0] + tw[1] * ai[1] + tw[2] * ai[2];
+			for(UINT j=0; j<3; ++j)
+			{
+				const XMVECTOR *bj = &b[AXES + 3 * j];
+				R[i][j] = ai[0] * bj[0] + ai[1] * bj[1] + ai[2] * bj[2];
+				absR[i][j] = XMVectorAbs(R[i][j]) + g_parallelEpsilon;
+			}
+		}
+
+		const XMVECTOR *ea = &a[EX];
+		const XMVECTOR *eb = &b[EX];
+		XMVECTOR separated = XMVectorZero();
+		XMVECTOR minDepth = g_fltMax;
+		XMVECTOR minAxis = XMVectorZero();
+		XMVECTOR one = XMVectorReplicate(1.f);
+
+		//Face axes of A, then of B
+		for(UINT i=0; i<3; ++i)
+		{
+			XMVECTOR r = ea[i] + eb[0] * absR[i][0] + eb[1] * absR[i][1] + eb[2] * absR[i][2];
+			separated = XMVectorOrInt(separated,XMVectorGreater(XMVectorAbs(t[i]),r));
+			if(contacts)
+				UpdateDepth(t[i],r,one,i,minDepth,minAxis);
+		}
+		for(UINT j=0; j<3; ++j)
+		{
+			XMVECTOR d = t[0] * R[0][j] + t[1] * R[1][j] + t[2] * R[2][j];
+			XMVECTOR r = ea[0] * absR[0][j] + ea[1] * absR[1][j] + ea[2] * absR[2][j] + eb[j];
+			separated = XMVectorOrInt(separated,XMVectorGreater(XMVectorAbs(d),r));
+			if(contacts)
+				UpdateDepth(d,r,one,3 + j,minDepth,minAxis);
+		}
+
+		if((MoveMask(separated) & validLanes) == validLanes)
+			return 0;
+
+		//Edge axes A_i x B_j
+		for(UINT i=0; i<3; ++i)
+		{
+			UINT i1 = (i + 1) % 3;
+			UINT i2 = (i + 2) % 3;
+			for(UINT j=0; j<3; ++j)
+			{
+				UINT j1 = (j + 1) % 3;
+				UINT j2 = (j + 2) % 3;
+				XMVECTOR d = t[i2] * R[i1][j] - t[i1] * R[i2][j];
+				XMVECTOR r = ea[i1] * absR[i2][j] + ea[i2] * absR[i1][j] + eb[j1] * absR[i][j2] + eb[j2] * absR[i][j1];
+				separated = XMVectorOrInt(separated,XMVectorGreater(XMVectorAbs(d),r));
+				if(contacts)
+				{
+					//In A's frame A_i x B_j = e_i x (column j of R), whose length has no cancellation for nearly parallel edges
+					XMVECTOR length = XMVectorSqrt(R[i1][j] * R[i1][j] + R[i2][j] * R[i2][j]);
+					XMVECTOR valid = XMVectorGreater(length,g_minAxisLength);
+					XMVECTOR invLength = XMVectorSelect(one,XMVectorReciprocal(length),valid);
+					XMVECTOR rValid = XMVectorSelect(g_fltMax,r,valid);
+					UpdateDepth(d,rValid,invLength,6 + 3 * i + j,minDepth,minAxis);
+				}
+			}
+		}
+
+		UINT hits = ~MoveMask(separated) & validLanes;
+		if(contacts && hits)
+		{
+			float depths[4];
+			UINT axes[4];
+			XMStoreFloat4((XMFLOAT4*)depths,minDepth);
+			XMStoreInt4(axes,minAxis);
+			for(UINT k=0; k<4; ++k)
+			{
+				if(!(hits & (1 << k)))
+					continue;
+
+				XMVECTOR axis;
+				if(axes[k] < 3)
+					axis = GetAxis(*boxesA[k],axes[k]);
+				else if(axes[k] < 6)
+					axis = GetAxis(*boxesB[k],axes[k] - 3);
+				else
+					axis = XMVector3Normalize(XMVector3Cross(GetAxis(*boxesA[k],(axes[k] - 6) / 3),GetAxis(*boxesB[k],(axes[k] - 6) % 3)));
+
+				//Point from A toward B
+				XMVECTOR centerA = XMLoadFloat4(&boxesA[k]->data[0]);
+				XMVECTOR centerB = XMLoadFloat4(&boxesB[k]->data[0]);
+				if(XMVectorGetX(XMVector3Dot(axis,centerB - centerA)) < 0.f)
+					axis = -axis;
+
+				XMStoreFloat3(&contacts[k]->axis,axis);
+				contacts[k]->depth = depths[k];
+			}
+		}
+
+		return hits;
+	}
+
+	//Run the lanes over groups of 4 pairs. The last group repeats its last pair in the unused lanes.
+	template<typename GetPair>
+	static UINT IntersectGroups(UINT nPairs, UINT *hitMask, Contact *contacts, const GetPair &getPair)
+	{
+		memset(hitMask,0,(nPairs + 31) / 32 * sizeof(UINT));
+
+		UINT count = 0;
+		for(UINT first=0; first<nPairs; first+=4)
+		{
+			UINT n = min(4U,nPairs - first);
+			const PreparedBox *boxesA[4], *boxesB[4];
+			Contact *pairContacts[4];
+			for(UINT k=0; k<4; ++k)
+			{
+				UINT pair = first + min(k,n - 1);
+				getPair(pair,boxesA[k],boxesB[k]);
+				pairContacts[k] = contacts ? &contacts[pair] : NULL;
+			}
+
+			UINT hits = TestLanes(boxesA,boxesB,(1 << n) - 1,contacts ? pairContacts : NULL);
+			hitMask[first >> 5] |= hits << (first & 31);
+			count += (hits & 1) + ((hits >> 1) & 1) + ((hits >> 2) & 1) + ((hits >> 3) & 1);
+		}
+
+		return count;
+	}
+
+	UINT IntersectPairs(const PreparedBox *boxes, const UINT *pairs, UINT nPairs, UINT *hitMask, Contact *contacts)
+	{
+		return IntersectGroups(nPairs,hitMask,contacts,[&](UINT i, const PreparedBox *&a, const PreparedBox *&b)
+		{
+			a = &boxes[pairs[2 * i]];
+			b = &boxes[pairs[2 * i + 1]];
+		});
+	}
+
+	UINT IntersectPairs(const PreparedBox *boxesA, const PreparedBox *boxesB, UINT nPairs, UINT *hitMask, Contact *contacts)
+	{
+		return IntersectGroups(nPairs,hitMask,contacts,[&](UINT i, const PreparedBox *&a, const PreparedBox *&b)
+		{
+			a = &boxesA[i];
+			b = &boxesB[i];
+		});
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef _SAT_KERNELS_H_
+#define _SAT_KERNELS_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include "xnacollision.h"
+
+//Oriented box overlap tests for many pairs at once, with the 15 axis separating axis test(SAT) of
+//XNA::IntersectOrientedBoxOrientedBox. Each XMVECTOR lane works on a different pair, and the 9 edge axes
+//are skipped when the 6 face axes already separate all 4 pairs.
+namespace SatKernels
+{
+	//Box with its quaternion turned into axes, in one 64 byte block:
+	//(cx cy cz ex) (ey ez a0x a0y) (a0z a1x a1y a1z) (a2x a2y a2z 0), where a0-a2 are the box axes in world space.
+	//Four boxes transpose into lanes with four matrix transposes.
+	struct PreparedBox
+	{
+		XMFLOAT4	data[4];
+	};
+
+	//Penetration of an intersecting pair
+	struct Contact
+	{
+		XMFLOAT3	axis;			//Unit axis of least penetration, pointing from box A toward box B
+		float		depth;			//Distance B must move along 'axis' to separate the boxes
+	};
+
+	void PrepareBox(const XNA::OrientedBox &box, PreparedBox &out);
+	void PrepareBoxes(const XNA::OrientedBox *boxes, UINT count, PreparedBox *out);
+
+	//Test pair i: boxes[pairs[2 * i]] against boxes[pairs[2 * i + 1]], e.g. the pairs of a broadphase.
+	//Bit i of 'hitMask'(Culling::MaskSize(nPairs) UINTs) is set when the boxes intersect. When 'contacts' is not NULL,
+	//contacts[i] receives the penetration of intersecting pairs. Return the number of intersecting pairs.
+	UINT IntersectPairs(const PreparedBox *boxes, const UINT *pairs, UINT nPairs, UINT *hitMask, Contact *contacts = NULL);
+	//Same with pair i made of boxesA[i] and boxesB[i]
+	UINT IntersectPairs(const PreparedBox *boxesA, const PreparedBox *boxesB, UINT nPairs, UINT *hitMask, Contact *contacts = NULL);
+};
+
+#endif	//_SAT_KERNELS_H_
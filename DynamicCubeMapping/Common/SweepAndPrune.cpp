@@ -0,0 +1,359 @@
+#include "SweepAndPrune.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iterator>
+
+static const float	g_axisSwitchRatio = 1.5f;		//The sort axis changes when another axis has this much more spread
+static const UINT	g_maxShiftsPerEntry = 8;		//Beyond this the insertion sort gives up for a full sort
+static const float	g_cellObjects = 128.f;			//Target number of objects in a grid cell
+static const float	g_cellSizeRatio = 4.f;			//Minimum grid cell size, relative to the average object size
+static const UINT	g_maxGridSize = 64;				//Cells along each grid axis
+
+static bool PairLess(const SweepAndPrune::Pair &a, const SweepAndPrune::Pair &b)
+{
+	return a.proxyA < b.proxyA || (a.proxyA == b.proxyA && a.proxyB < b.proxyB);
+}
+
+//Sort that is linear for nearly sorted input. Return false when too many entries moved, the order is then incomplete.
+template<typename Entry>
+static bool InsertionSort(Entry *entries, UINT n, UINT maxShifts)
+{
+	UINT shifts = 0;
+	for(UINT i=1; i<n; ++i)
+	{
+		Entry e = entries[i];
+		UINT j = i;
+		while(j > 0 && entries[j - 1].key > e.key)
+		{
+			entries[j] = entries[j - 1];
+			--j;
+		}
+		entries[j] = e;
+
+		shifts += i - j;
+		if(shifts > maxShifts)
+			return false;
+	}
+
+	return true;
+}
+
+template<typename Entry>
+static bool KeyLess(const Entry &a, const Entry &b)
+{
+	return a.key < b.key;
+}
+
+SweepAndPrune::SweepAndPrune()
+	: m_proxyCount(0), m_axis(0)
+{
+	m_gridSize[0] = m_gridSize[1] = 1;
+	m_gridOrigin[0] = m_gridOrigin[1] = 0.f;
+	m_gridInvCell[0] = m_gridInvCell[1] = 0.f;
+}
+
+UINT SweepAndPrune::CreateProxy(ShapeType type, const void *shape, void *userData)
+{
+	XMASSERT(shape != NULL);
+
+	UINT proxy;
+	if(!m_freeProxies.empty())
+	{
+		proxy = m_freeProxies.back();
+		m_freeProxies.pop_back();
+	}
+	else
+	{
+		proxy = m_proxies.size();
+		m_proxies.push_back(Proxy());
+		m_bounds.push_back(Bounds());
+	}
+
+	Proxy &p = m_proxies[proxy];
+	p.type = type;
+	p.shape = shape;
+	p.userData = userData;
+
+	//Sorted into place at the next update
+	Entry entry = {FLT_MAX, proxy};
+	m_entries.push_back(entry);
+	++m_proxyCount;
+	return proxy;
+}
+
+void SweepAndPrune::DestroyProxy(UINT proxy)
+{
+	XMASSERT(proxy < m_proxies.size() && m_proxies[proxy].shape != NULL);
+
+	//The entry is dropped at the next update. The id is not reused before that update,
+	//otherwise a new proxy could take over the pairs of the destroyed one.
+	m_proxies[proxy].shape = NULL;
+	m_destroyedProxies.push_back(proxy);
+	--m_proxyCount;
+}
+
+void SweepAndPrune::ComputeBounds(const Proxy &proxy, Bounds &bounds) const
+{
+	XMVECTOR center, half;
+	switch(proxy.type)
+	{
+	case ShapeSphere:
+		{
+			const XNA::Sphere *sphere = (const XNA::Sphere*)proxy.shape;
+			center = XMLoadFloat3(&sphere->Center);
+			half = XMVectorReplicate(sphere->Radius);
+		}
+		break;
+
+	case ShapeAxisAlignedBox:
+		{
+			const XNA::AxisAlignedBox *box = (const XNA::AxisAlignedBox*)proxy.shape;
+			center = XMLoadFloat3(&box->Center);
+			half = XMLoadFloat3(&box->Extents);
+		}
+		break;
+
+	default:
+		{
+			//Project the rotated axes onto the world axes
+			const XNA::OrientedBox *box = (const XNA::OrientedBox*)proxy.shape;
+			XMMATRIX r = XMMatrixRotationQuaternion(XMLoadFloat4(&box->Orientation));
+			XMVECTOR e = XMLoadFloat3(&box->Extents);
+			center = XMLoadFloat3(&box->Center);
+			half = XMVectorAbs(r.r[0]) * XMVectorSplatX(e) + XMVectorAbs(r.r[1]) * XMVectorSplatY(e) + XMVectorAbs(r.r[2]) * XMVectorSplatZ(e);
+		}
+		break;
+	}
+
+	XMStoreFloat3((XMFLOAT3*)bounds.bmin,center - half);
+	XMStoreFloat3((XMFLOAT3*)bounds.bmax,center + half);
+}
+
+//Sort along the axis where the objects are most spread, so the sweep meets few false overlaps.
+//Return true when the axis changed.
+bool SweepAndPrune::ChooseAxis(const double *sum, const double *sumSq, UINT count)
+{
+	if(count < 2)
+		return false;
+
+	double variance[3];
+	for(UINT a=0; a<3; ++a)
+		variance[a] = sumSq[a] / count - (sum[a] / count) * (sum[a] / count);
+
+	UINT best = m_axis;
+	for(UINT a=0; a<3; ++a)
+	{
+		if(variance[a] > variance[best])
+			best = a;
+	}
+
+	if(best == m_axis || variance[best] < g_axisSwitchRatio * variance[m_axis])
+		return false;
+
+	m_axis = best;
+	return true;
+}
+
+void SweepAndPrune::Update()
+{
+	//Bounds of the live proxies, their extent and the spread of their centers.
+	//Done in proxy order, which usually follows the order of the shapes in memory.
+	double sum[3] = {0, 0, 0};
+	double sumSq[3] = {0, 0, 0};
+	float worldMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+	float worldMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+	double sizeSum = 0;
+	for(UINT proxy=0; proxy<m_proxies.size(); ++proxy)
+	{
+		if(m_proxies[proxy].shape == NULL)
+			continue;
+
+		Bounds &bounds = m_bounds[proxy];
+		ComputeBounds(m_proxies[proxy],bounds);
+		for(UINT a=0; a<3; ++a)
+		{
+			double c = 0.5 * (bounds.bmin[a] + bounds.bmax[a]);
+			sum[a] += c;
+			sumSq[a] += c * c;
+			sizeSum += bounds.bmax[a] - bounds.bmin[a];
+			worldMin[a] = min(worldMin[a],bounds.bmin[a]);
+			worldMax[a] = max(worldMax[a],bounds.bmax[a]);
+		}
+	}
+
+	//Drop the entries of destroyed proxies
+	UINT n = 0;
+	for(UINT i=0; i<m_entries.size(); ++i)
+	{
+		if(m_proxies[m_entries[i].proxy].shape != NULL)
+			m_entries[n++] = m_entries[i];
+	}
+	m_entries.resize(n);
+
+	bool axisChanged = ChooseAxis(sum,sumSq,n);
+	for(UINT i=0; i<n; ++i)
+		m_entries[i].key = m_bounds[m_entries[i].proxy].bmin[m_axis];
+
+	//Coherent motion keeps the entries nearly sorted
+	if(n > 0 && (axisChanged || !InsertionSort(&m_entries[0],n,g_maxShiftsPerEntry * n)))
+		std::sort(m_entries.begin(),m_entries.end(),KeyLess<Entry>);
+
+	BuildGrid(worldMin,worldMax,n > 0 ? (float)(sizeSum / (3 * n)) : 0.f);
+
+	m_previousPairs.swap(m_pairs);
+	m_pairs.clear();
+	for(UINT cellC=0; cellC<m_gridSize[1]; ++cellC)
+	{
+		for(UINT cellB=0; cellB<m_gridSize[0]; ++cellB)
+			Sweep(cellB,cellC);
+	}
+	std::sort(m_pairs.begin(),m_pairs.end(),PairLess);
+
+	m_addedPairs.clear();
+	m_removedPairs.clear();
+	std::set_difference(m_pairs.begin(),m_pairs.end(),m_previousPairs.begin(),m_previousPairs.end(),std::back_inserter(m_addedPairs),PairLess);
+	std::set_difference(m_previousPairs.begin(),m_previousPairs.end(),m_pairs.begin(),m_pairs.end(),std::back_inserter(m_removedPairs),PairLess);
+
+	//Destroyed proxies have had their pairs removed, their ids can be reused
+	m_freeProxies.insert(m_freeProxies.end(),m_destroyedProxies.begin(),m_destroyedProxies.end());
+	m_destroyedProxies.clear();
+}
+
+void SweepAndPrune::GetCellRange(const Bounds &bounds, UINT *cellMin, UINT *cellMax) const
+{
+	for(UINT g=0; g<2; ++g)
+	{
+		UINT a = (m_axis + 1 + g) % 3;
+		int last = m_gridSize[g] - 1;
+		cellMin[g] = max(0,min(last,(int)((bounds.bmin[a] - m_gridOrigin[g]) * m_gridInvCell[g])));
+		cellMax[g] = max(0,min(last,(int)((bounds.bmax[a] - m_gridOrigin[g]) * m_gridInvCell[g])));
+	}
+}
+
+//Bucket the sorted entries into grid cells, keeping the order inside each cell.
+//A box is copied into every cell it touches.
+void SweepAndPrune::BuildGrid(const float *worldMin, const float *worldMax, float averageSize)
+{
+	UINT n = m_entries.size();
+
+	//Cells hold about g_cellObjects objects, and are several times larger than the objects so few of them are copied
+	float range[2];
+	for(UINT g=0; g<2; ++g)
+	{
+		UINT a = (m_axis + 1 + g) % 3;
+		range[g] = n > 0 ? worldMax[a] - worldMin[a] : 0.f;
+		m_gridOrigin[g] = n > 0 ? worldMin[a] : 0.f;
+	}
+	float cellSize = max(g_cellSizeRatio * averageSize,sqrtf(range[0] * range[1] * g_cellObjects / max(n,1U)));
+	for(UINT g=0; g<2; ++g)
+	{
+		m_gridSize[g] = cellSize > 0.f ? (UINT)min(range[g] / cellSize + 1.f,(float)g_maxGridSize) : 1;
+		m_gridInvCell[g] = range[g] > 0.f ? m_gridSize[g] / range[g] : 0.f;
+	}
+
+	UINT nCells = m_gridSize[0] * m_gridSize[1];
+	m_cellStart.assign(nCells + 1,0);
+	UINT cellMin[2], cellMax[2];
+	for(UINT i=0; i<n; ++i)
+	{
+		GetCellRange(m_bounds[m_entries[i].proxy],cellMin,cellMax);
+		for(UINT c=cellMin[1]; c<=cellMax[1]; ++c)
+		{
+			for(UINT b=cellMin[0]; b<=cellMax[0]; ++b)
+				++m_cellStart[c * m_gridSize[0] + b + 1];
+		}
+	}
+	for(UINT cell=0; cell<nCells; ++cell)
+		m_cellStart[cell + 1] += m_cellStart[cell];
+
+	//Scatter, using the start of each cell as its write position
+	m_sorted.resize(m_cellStart[nCells]);
+	for(UINT i=0; i<n; ++i)
+	{
+		UINT proxy = m_entries[i].proxy;
+		const Bounds &bounds = m_bounds[proxy];
+		GetCellRange(bounds,cellMin,cellMax);
+		for(UINT c=cellMin[1]; c<=cellMax[1]; ++c)
+		{
+			for(UINT b=cellMin[0]; b<=cellMax[0]; ++b)
+			{
+				SortedBounds &sorted = m_sorted[m_cellStart[c * m_gridSize[0] + b]++];
+				sorted.bounds = bounds;
+				sorted.proxy = proxy;
+			}
+		}
+	}
+
+	//The write positions ended at the start of the next cell
+	for(UINT cell=nCells; cell>0; --cell)
+		m_cellStart[cell] = m_cellStart[cell - 1];
+	m_cellStart[0] = 0;
+}
+
+void SweepAndPrune::Sweep(UINT cellB, UINT cellC)
+{
+	UINT a = m_axis;
+	UINT b = (a + 1) % 3;
+	UINT c = (a + 2) % 3;
+
+	UINT cell = cellC * m_gridSize[0] + cellB;
+	UINT begin = m_cellStart[cell];
+	UINT end = m_cellStart[cell + 1];
+	bool shared = m_gridSize[0] * m_gridSize[1] > 1;
+	for(UINT i=begin; i<end; ++i)
+	{
+		const Bounds &bi = m_sorted[i].bounds;
+		UINT proxyI = m_sorted[i].proxy;
+
+		//Everything starting before the end of 'i' overlaps it along the sort axis
+		for(UINT j=i+1; j<end && m_sorted[j].bounds.bmin[a] <= bi.bmax[a]; ++j)
+		{
+			const Bounds &bj = m_sorted[j].bounds;
+			if(bj.bmin[b] > bi.bmax[b] || bi.bmin[b] > bj.bmax[b] ||
+				bj.bmin[c] > bi.bmax[c] || bi.bmin[c] > bj.bmax[c])
+				continue;
+
+			//Boxes in several cells meet more than once: keep the pair only in the cell holding the corner of the overlap
+			if(shared)
+			{
+				Bounds overlap;
+				overlap.bmin[b] = overlap.bmax[b] = max(bi.bmin[b],bj.bmin[b]);
+				overlap.bmin[c] = overlap.bmax[c] = max(bi.bmin[c],bj.bmin[c]);
+				overlap.bmin[a] = overlap.bmax[a] = 0.f;
+				UINT cellMin[2], cellMax[2];
+				GetCellRange(overlap,cellMin,cellMax);
+				if(cellMin[0] != cellB || cellMin[1] != cellC)
+					continue;
+			}
+
+			UINT proxyJ = m_sorted[j].proxy;
+			Pair pair = {min(proxyI,proxyJ), max(proxyI,proxyJ)};
+			m_pairs.push_back(pair);
+		}
+	}
+}
+
+bool SweepAndPrune::TestPair(const Pair &pair) const
+{
+	const Proxy *a = &m_proxies[pair.proxyA];
+	const Proxy *b = &m_proxies[pair.proxyB];
+	if(a->type > b->type)
+		std::swap(a,b);
+
+	switch(a->type * 3 + b->type)
+	{
+	case ShapeSphere * 3 + ShapeSphere:
+		return XNA::IntersectSphereSphere((const XNA::Sphere*)a->shape,(const XNA::Sphere*)b->shape) != FALSE;
+	case ShapeSphere * 3 + ShapeAxisAlignedBox:
+		return XNA::IntersectSphereAxisAlignedBox((const XNA::Sphere*)a->shape,(const XNA::AxisAlignedBox*)b->shape) != FALSE;
+	case ShapeSphere * 3 + ShapeOrientedBox:
+		return XNA::IntersectSphereOrientedBox((const XNA::Sphere*)a->shape,(const XNA::OrientedBox*)b->shape) != FALSE;
+	case ShapeAxisAlignedBox * 3 + ShapeAxisAlignedBox:
+		return XNA::IntersectAxisAlignedBoxAxisAlignedBox((const XNA::AxisAlignedBox*)a->shape,(const XNA::AxisAlignedBox*)b->shape) != FALSE;
+	case ShapeAxisAlignedBox * 3 + ShapeOrientedBox:
+		return XNA::IntersectAxisAlignedBoxOrientedBox((const XNA::AxisAlignedBox*)a->shape,(const XNA::OrientedBox*)b->shape) != FALSE;
+	default:
+		return XNA::IntersectOrientedBoxOrientedBox((const XNA::OrientedBox*)a->shape,(const XNA::OrientedBox*)b->shape) != FALSE;
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef _SWEEP_AND_PRUNE_H_
+#define _SWEEP_AND_PRUNE_H_
+
+#include <Windows.h>
+#include <xnamath.h>
+#include <vector>
+#include "xnacollision.h"
+
+//Broadphase finding the pairs of objects whose bounding boxes overlap.
+//Every update the box minimums along one axis are sorted with an insertion sort, which is close to linear
+//since objects move little between frames, then a sweep finds the overlaps. With many objects a coarse grid
+//over the two other axes splits the sweep, so objects far apart on those axes are never compared.
+//The pairs are compared with the previous update to report the pairs that started and stopped overlapping.
+class SweepAndPrune
+{
+public:
+	//Shapes are owned by the caller and read at every update, so moving an object only means changing its shape
+	enum ShapeType
+	{
+		ShapeSphere,				//XNA::Sphere
+		ShapeAxisAlignedBox,		//XNA::AxisAlignedBox
+		ShapeOrientedBox			//XNA::OrientedBox
+	};
+
+	struct Pair
+	{
+		UINT	proxyA;				//proxyA < proxyB
+		UINT	proxyB;
+	};
+
+	SweepAndPrune();
+
+	UINT	CreateProxy(ShapeType type, const void *shape, void *userData);
+	//The pairs of the proxy are reported as removed at the next update
+	void	DestroyProxy(UINT proxy);
+
+	//Read the shapes and find the overlapping pairs
+	void	Update();
+
+	//Pairs with overlapping bounding boxes, sorted
+	const std::vector<Pair>&	GetPairs()			const	{ return m_pairs; }
+	//Pairs that started or stopped overlapping at the last update
+	const std::vector<Pair>&	GetAddedPairs()		const	{ return m_addedPairs; }
+	const std::vector<Pair>&	GetRemovedPairs()	const	{ return m_removedPairs; }
+
+	//Narrowphase: exact test between the shapes of a pair, with the XNA intersection routines
+	bool	TestPair(const Pair &pair) const;
+
+	void*	GetUserData(UINT proxy)		const	{ return m_proxies[proxy].userData; }
+	UINT	GetProxyCount()				const	{ return m_proxyCount; }
+	UINT	GetSortAxis()				const	{ return m_axis; }
+
+private:
+	struct Proxy
+	{
+		ShapeType	type;
+		const void	*shape;			//NULL when the proxy is unused
+		void		*userData;
+	};
+
+	//Sort key of a proxy: its minimum along the sort axis
+	struct Entry
+	{
+		float	key;
+		UINT	proxy;
+	};
+
+	struct Bounds
+	{
+		float	bmin[3];
+		float	bmax[3];
+	};
+
+	//Bounds in sorted order, so the sweep reads memory sequentially
+	struct SortedBounds
+	{
+		Bounds	bounds;
+		UINT	proxy;
+	};
+
+	void ComputeBounds(const Proxy &proxy, Bounds &bounds) const;
+	bool ChooseAxis(const double *sum, const double *sumSq, UINT count);
+	void BuildGrid(const float *worldMin, const float *worldMax, float averageSize);
+	void GetCellRange(const Bounds &bounds, UINT *cellMin, UINT *cellMax) const;
+	void Sweep(UINT cellB, UINT cellC);
+
+private:
+	std::vector<Proxy>			m_proxies;
+	std::vector<Bounds>			m_bounds;			//Per proxy
+	std::vector<UINT>			m_freeProxies;		//Reusable after the next update
+	std::vector<UINT>			m_destroyedProxies;
+	UINT						m_proxyCount;
+
+	std::vector<Entry>			m_entries;			//Proxies sorted along the sort axis
+	std::vector<SortedBounds>	m_sorted;			//Grid cells one after the other, each sorted along the sort axis
+	UINT						m_axis;
+
+	//Grid over the two other axes: axis (m_axis + 1) % 3 first
+	UINT						m_gridSize[2];
+	float						m_gridOrigin[2];
+	float						m_gridInvCell[2];
+	std::vector<UINT>			m_cellStart;		//First entry of each cell in m_sorted, plus the end
+
+	std::vector<Pair>			m_pairs;
+	std::vector<Pair>			m_previousPairs;
+	std::vector<Pair>			m_addedPairs;
+	std::vector<Pair>			m_removedPairs;
+};
+
+#endif	//_SWEEP_AND_PRUNE_H_
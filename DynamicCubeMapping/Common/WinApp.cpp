@@ -32,7 +32,10 @@ WinApp::WinApp(HINSTANCE hInst, std::wstring title, int width, int height):m_hIn
 																		m_swapChain(NULL),
 																		m_renderTargetView(NULL),
 																		m_depthStencilBuffer(NULL),
-																		m_depthStencilView(NULL)
+																		m_depthStencilView(NULL),
+																		m_pipelined(false),
+																		m_renderPacket(0),
+																		m_latencyMs(0.f)
 {
 	//Initialize global application
 	g_winApp = this;
@@ -74,6 +77,10 @@ int WinApp::Run()
 {
 	MSG msg = {0};
 
+	__int64 countsPerSec(0);
+	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
+	float msPerCount = 1000.f / countsPerSec;
+
 	m_timer.Reset();
 	while(msg.message != WM_QUIT)
 	{
@@ -87,13 +94,44 @@ int WinApp::Run()
 			//Running
 			if(!m_isPaused)
 			{
+				//Switch between the pipelined and the sequential frames
+				if(m_pipelined != m_pipeline.IsRunning())
+				{
+					if(m_pipelined)
+					{
+						m_pipelined = m_pipeline.Start([this](UINT packet)
+						{
+							m_renderPacket = packet;
+							Render();
+						},[this](){ OnRenderThreadBegin(); },[this](){ OnRenderThreadEnd(); });
+					}
+					else
+						m_pipeline.Stop();
+				}
+
 				//Timer update
 				m_timer.Tick();
 				//Frame rate update
 				CalculateFPS();
 				//Scene update and rendering
-				Update(m_timer.DeltaTime());
-				Render();
+				if(m_pipeline.IsRunning())
+				{
+					UINT packet = m_pipeline.BeginPacket();
+					Update(m_timer.DeltaTime());
+					WritePacket(packet);
+					m_pipeline.SubmitPacket(packet);
+				}
+				else
+				{
+					__int64 begin(0), end(0);
+					QueryPerformanceCounter((LARGE_INTEGER*)&begin);
+					Update(m_timer.DeltaTime());
+					WritePacket(0);
+					m_renderPacket = 0;
+					Render();
+					QueryPerformanceCounter((LARGE_INTEGER*)&end);
+					m_latencyMs += (end - begin) * msPerCount;
+				}
 			}
 			//Paused
 			else
@@ -103,6 +141,8 @@ int WinApp::Run()
 			}
 		}
 	}
+	//The render thread draws the frames in flight and stops before the application is destroyed
+	m_pipeline.Stop();
 
 	//Eixt
 	return msg.wParam;
@@ -270,6 +310,9 @@ bool WinApp::OnResize()
 {
 	HRESULT hr;
 
+	//The render thread is done with the views before they are released
+	WaitForFrames();
+
 	SafeRelease(m_depthStencilView);
 	SafeRelease(m_renderTargetView);
 	SafeRelease(m_depthStencilBuffer);
@@ -328,12 +371,16 @@ void WinApp::CalculateFPS()
 	static int frameCounter = 0;
 	if(m_timer.TotalTime() - begin >= 1.f)
 	{
+		//Latency: from the start of Update to the end of Render
+		float latency = m_pipeline.IsRunning() ? m_pipeline.GetAverageLatencyMs() : m_latencyMs / frameCounter;
 		std::wostringstream text;
-		text<<L"      FPS: "<<frameCounter<<L"    FrameTime: "<<1000.f/frameCounter<<L"ms";
+		text<<L"      FPS: "<<frameCounter<<L"    FrameTime: "<<1000.f/frameCounter<<L"ms"<<L"    Latency: "<<latency<<L"ms";
 		SetWindowTitle(m_winTitle+text.str());
 
 		begin = m_timer.TotalTime();
 		frameCounter = 0;
+		m_latencyMs = 0.f;
+		m_pipeline.ResetStats();
 	}
 	++frameCounter;
 }
@@ -6,6 +6,7 @@
 #include <D3D11.h>
 
 #include "Timer.h"
+#include "FramePipeline.h"
 
 class WinApp
 {
@@ -29,6 +30,19 @@ public:
 	virtual bool	Update(float timeDelt) = 0;		//Update for each frame
 	virtual bool	Render() = 0;					//Scene rendering for each frame
 
+	/*
+	  Pipelined frames: Update of frame N+1 runs on this thread while a render thread draws frame N.
+	  After Update, WritePacket copies what Render reads into a frame packet; Render then draws packet m_renderPacket
+	  and reads nothing Update writes. Render owns the device context: anything else using it waits for the frames
+	  in flight with WaitForFrames(OnResize does).
+	*/
+	void			SetPipelined(bool pipelined)	{ m_pipelined = pipelined; }		//From the next frame
+	bool			IsPipelined()			const	{ return m_pipelined; }
+	virtual void	WritePacket(UINT packet)		{ }
+	//On the render thread, when it starts and before it stops
+	virtual void	OnRenderThreadBegin()			{ }
+	virtual void	OnRenderThreadEnd()				{ }
+
 	virtual LRESULT CALLBACK WinProc(HWND,UINT,WPARAM,LPARAM);		//Main messaeg processing function
 	
 	int		Run();		//Main game loop
@@ -44,6 +58,7 @@ protected:
 	bool	InitD3D();			//D3D11 initialization
 	
 	void	CalculateFPS();		//Frame rate update
+	void	WaitForFrames()		{ m_pipeline.Flush(); }
 
 protected:
 	HINSTANCE	m_hInstance;		//Application instance
@@ -68,6 +83,11 @@ protected:
 	std::wstring	m_winTitle;			//Title of the application
 	Timer			m_timer;			//Timer
 
+	bool			m_pipelined;		//Frame pipeline
+	FramePipeline	m_pipeline;
+	UINT			m_renderPacket;		//Packet drawn by Render
+	float			m_latencyMs;		//From Update to the end of Render, summed over the frames of the last second
+
 private:
 	//Forbid copying
 	WinApp(const WinApp&);
@@ -118,6 +118,8 @@ bool SkyBoxEffect::Init(ID3D11Device *device, std::wstring fileName)
 BasicEffect* Effects::fxBasic(NULL);
 ShadowMappingEffect* Effects::fxShadowMapping(NULL);
 SkyBoxEffect* Effects::fxSkyBox(NULL);
+std::vector<BasicEffect*> Effects::fxBasicCopies;
+std::vector<SkyBoxEffect*> Effects::fxSkyBoxCopies;
 bool Effects::InitAll(ID3D11Device *device)
 {
 	if(!fxBasic)
@@ -142,9 +144,33 @@ bool Effects::InitAll(ID3D11Device *device)
 	return true;
 }
 
+bool Effects::InitCopies(ID3D11Device *device, UINT nCopies)
+{
+	while(fxBasicCopies.size() < nCopies)
+	{
+		fxBasicCopies.push_back(new BasicEffect);
+		if(!fxBasicCopies.back()->Init(device,L"FX/Basic.fxo"))
+			return false;
+	}
+	while(fxSkyBoxCopies.size() < nCopies)
+	{
+		fxSkyBoxCopies.push_back(new SkyBoxEffect);
+		if(!fxSkyBoxCopies.back()->Init(device,L"FX/SkyBox.fxo"))
+			return false;
+	}
+
+	return true;
+}
+
 void Effects::ReleaseAll()
 {
 	SafeDelete(fxBasic);
 	SafeDelete(fxShadowMapping);
 	SafeDelete(fxSkyBox);
+	for(UINT i=0; i<fxBasicCopies.size(); ++i)
+		SafeDelete(fxBasicCopies[i]);
+	for(UINT i=0; i<fxSkyBoxCopies.size(); ++i)
+		SafeDelete(fxSkyBoxCopies[i]);
+	fxBasicCopies.clear();
+	fxSkyBoxCopies.clear();
 }
\ No newline at end of file
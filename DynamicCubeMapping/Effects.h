@@ -9,6 +9,7 @@
 #include <AppUtil.h>
 #include <Lights.h>
 #include <string>
+#include <vector>
 
 //Effect base class
 class Effect
@@ -209,5 +210,15 @@ public:
 	static BasicEffect			*fxBasic;
 	static ShadowMappingEffect	*fxShadowMapping;
 	static SkyBoxEffect			*fxSkyBox;
+
+	//Copies of fxBasic and fxSkyBox for recording on other threads. The setters write into the effect object,
+	//so two threads must never share one. Copy 0 is fxBasic/fxSkyBox.
+	static bool InitCopies(ID3D11Device *device, UINT nCopies);
+	static UINT GetCopyCount()				{ return fxBasicCopies.size() + 1; }
+	static BasicEffect* Basic(UINT copy)	{ return copy ? fxBasicCopies[copy - 1] : fxBasic; }
+	static SkyBoxEffect* SkyBox(UINT copy)	{ return copy ? fxSkyBoxCopies[copy - 1] : fxSkyBox; }
+
+	static std::vector<BasicEffect*>	fxBasicCopies;
+	static std::vector<SkyBoxEffect*>	fxSkyBoxCopies;
 };
 #endif	//_EFFECTS_H_
\ No newline at end of file
@@ -4,6 +4,16 @@
 #include <RenderStates.h>
 #include <Lights.h>
 #include <Camera.h>
+#include <CubeCameraRig.h>
+#include <CubeFaceScheduler.h>
+#include <RenderTargetPool.h>
+#include <FrameGraph.h>
+#include <JobSystem.h>
+#include <JobBenchmark.h>
+#include <CommandRecorder.h>
+#include <Culling.h>
+#include <OcclusionCuller.h>
+#include <LooseOctree.h>
 #include "Effects.h"
 #include "Inputs.h"
 
@@ -24,17 +34,50 @@ public:
 	bool	OnResize();						//Window size changed
 	bool	Update(float timeDelt);			//Update for each frame
 	bool	Render();						//Scene rendering for each frame
+	void	WritePacket(UINT packet);		//Copy the frame for Render
+	void	OnRenderThreadBegin();
+	void	OnRenderThreadEnd();
 
 	void OnMouseDown(WPARAM btnState, int x, int y);
 	void OnMouseUp(WPARAM btnState, int x, int y);
 	void OnMouseMove(WPARAM btnState, int x, int y);
 
 private:
+	//Objects culled against all views at once
+	enum { ObjSphere, ObjBox, ObjCount };
+	//Views: the six cube faces, then the main camera
+	enum { MainView = 6 };
+	//How the passes are recorded: on the immediate context, or on deferred contexts one after another or in parallel
+	enum RecordMode { RecordImmediate, RecordSerial, RecordParallel };
+
+	//What Render reads of a frame, written by Update's thread only while Render does not draw it
+	struct FramePacket
+	{
+		XMFLOAT4X4			viewProj;
+		XMFLOAT3			eyePos;
+		XMFLOAT3			cubeCenter;
+		XMFLOAT4X4			faceViewProj[6];
+		XMFLOAT4X4			world[ObjCount];
+		XMFLOAT4X4			invWorldTranspose[ObjCount];
+		UINT				viewMasks[ObjCount];
+		Lights::DirLight	dirLights[3];
+		UINT				faces;						//Cube faces to draw
+		RecordMode			recordMode;
+	};
+
 	bool BuildDynamicCubeMappingViews();
+	//Swap the dynamic cube map for one in 'format', all its faces are rendered again. False when it failed.
+	bool SetCubeFormat(DXGI_FORMAT format);
 	void BuildDynamicCameras();
 	bool BuildBuffers();
 	bool BuildCubeMap();
 
+	void UpdateBounds();
+	void UpdateSceneIndex();
+	void CullScene();
+	void DrawCubeFace(ID3D11DeviceContext *context, const FramePacket &frame, UINT face, ID3D11DepthStencilView *dsv);
+	void DrawScene(ID3D11DeviceContext *context, const FramePacket &frame);
+
 private:
 	ID3D11Buffer	*m_VBSky;
 	ID3D11Buffer	*m_IBSky;
@@ -47,12 +90,23 @@ private:
 
 	UINT	m_cubeMapWidth;
 	UINT	m_cubeMapHeight;
-	ID3D11RenderTargetView		*m_dynamicRTV[6];
-	ID3D11DepthStencilView		*m_dynamicDSV;
-	ID3D11ShaderResourceView	*m_dynamicSRV;
+	DXGI_FORMAT					m_cubeFormat;
+	RenderTargetPool			m_targets;					//Dynamic cube map, and the depth buffer borrowed by its faces
+	int							m_dynamicCube;				//Held for good: the faces are refreshed in turn
+	FrameGraph					m_frameGraph;				//Passes of the frame, rebuilt by Render
+
+	RecordMode					m_recordMode;
+	JobSystem					m_jobs;						//Worker threads, this thread being worker 0, one left for the render thread
+	CommandRecorder				m_recorder;
 	D3D11_VIEWPORT				m_dynamicViewport;
 
-	Camera						m_dynamicCameras[6];
+	CubeCameraRig				m_cubeRig;					//Follows the sphere
+	CubeFaceScheduler			m_cubeScheduler;			//Faces of the cube map rendered each frame
+	UINT						m_boxFaces;					//Cube faces the box was visible in last frame
+	UINT						m_faces;					//Cube faces scheduled this frame
+	bool						m_benchmarkKey;				//'J' held last frame
+
+	FramePacket					m_packets[FramePipeline::PacketCount];
 
 	GeoGen::MeshData	m_skySphere;
 	GeoGen::MeshData	m_sphere;
@@ -74,8 +128,26 @@ private:
 	Camera		m_camera;
 	
 	POINT		m_lastPos;
+
+	XNA::AxisAlignedBox	m_localBounds[ObjCount];
+	XNA::AxisAlignedBox	m_worldBounds[ObjCount];
+	UINT				m_viewMasks[ObjCount];			//Bit v set when the object is visible in view v
+
+	LooseOctree			m_sceneIndex;					//World bounds of the objects, user data is the object enum
+	int					m_sceneObjects[ObjCount];
+
+	OcclusionCuller		m_occlusion;					//Main view only: the sphere hides the box behind it
 };
 
+//Cube of 256 units around the origin, 5 levels: the smallest cells are 8 units wide
+static XNA::AxisAlignedBox SceneBounds()
+{
+	XNA::AxisAlignedBox bounds;
+	bounds.Center = XMFLOAT3(0.f,0.f,0.f);
+	bounds.Extents = XMFLOAT3(128.f,128.f,128.f);
+	return bounds;
+}
+
 DynamicCubeMapping::DynamicCubeMapping(HINSTANCE hInst, std::wstring title, int width, int height):WinApp(hInst,title,width,height),
 	m_VBSky(NULL),
 	m_IBSky(NULL),
@@ -85,15 +157,16 @@ DynamicCubeMapping::DynamicCubeMapping(HINSTANCE hInst, std::wstring title, int
 	m_boxSRV(NULL),
 	m_cubeMapWidth(256),
 	m_cubeMapHeight(256),
-	m_dynamicDSV(NULL),
-	m_dynamicSRV(NULL)
+	m_cubeFormat(DXGI_FORMAT_R16G16B16A16_FLOAT),
+	m_dynamicCube(-1),
+	m_recordMode(RecordParallel),
+	m_boxFaces(0),
+	m_faces(0),
+	m_benchmarkKey(false),
+	m_sceneIndex(SceneBounds(),5)
 {
 	m_camera.SetPosition(0.f,0.f,-3.f);
-
-	for(UINT i=0; i<6; ++i)
-	{
-		m_dynamicRTV[i] = NULL;
-	}
+	m_cubeScheduler.SetPolicy(CubeFaceScheduler::DirtyFaces);
 
 	//3 directional lights
 	//Main Light
@@ -119,6 +192,8 @@ DynamicCubeMapping::DynamicCubeMapping(HINSTANCE hInst, std::wstring title, int
 
 	XMStoreFloat4x4(&m_worldSphere,XMMatrixIdentity());
 	XMStoreFloat4x4(&m_invWorldTranspose,XMMatrixIdentity());
+	XMStoreFloat4x4(&m_worldBox,XMMatrixIdentity());
+	XMStoreFloat4x4(&m_invWorldTransposeBox,XMMatrixIdentity());
 }
 
 DynamicCubeMapping::~DynamicCubeMapping()
@@ -129,12 +204,8 @@ DynamicCubeMapping::~DynamicCubeMapping()
 	SafeRelease(m_IBObjects);
 	SafeRelease(m_cubeMapSRV);
 	SafeRelease(m_boxSRV);
-	SafeRelease(m_dynamicDSV);
-	SafeRelease(m_dynamicSRV);
-	for(UINT i=0; i<6; ++i)
-	{
-		SafeRelease(m_dynamicRTV[i]);
-	}
+	m_targets.ReleaseAll();
+	m_recorder.Release();
 
 	Effects::ReleaseAll();
 	InputLayouts::ReleaseAll();
@@ -152,6 +223,13 @@ bool DynamicCubeMapping::Init()
 		return false;
 	if(!RenderStates::InitAll(m_d3dDevice))
 		return false;
+	if(!m_jobs.Init(JobSystem::AutoThreads,1))
+		return false;
+	//Up to 8 passes a frame(six faces, the mips and the scene), each with its context and its effects
+	if(!m_recorder.Init(m_d3dDevice,8,&m_jobs))
+		return false;
+	if(!Effects::InitCopies(m_d3dDevice,m_recorder.GetContextCount()))
+		return false;
 	if(!BuildBuffers())
 		return false;
 	if(!BuildDynamicCubeMappingViews())
@@ -161,18 +239,22 @@ bool DynamicCubeMapping::Init()
 
 	BuildDynamicCameras();
 
+	UpdateBounds();
+	for(UINT i=0; i<ObjCount; ++i)
+		m_sceneObjects[i] = m_sceneIndex.CreateObject(m_worldBounds[i],(void*)(UINT_PTR)i);
+
 	return true;
 }
 
 bool DynamicCubeMapping::BuildBuffers()
 {
-	//For sky
-	GeoGen::CreateSphere(100.f,30,30,m_skySphere);
+	//For sky. The cube map is sampled by direction, so a coarse geodesic sphere is enough
+	GeoGen::CreateGeoSphere(100.f,2,m_skySphere);
 
 	D3D11_BUFFER_DESC descSky = {0};
 	descSky.ByteWidth = sizeof(PosVertex) * m_skySphere.vertices.size();
 	descSky.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	descSky.Usage = D3D11_USAGE_DEFAULT;
+	descSky.Usage = D3D11_USAGE_IMMUTABLE;
 
 	std::vector<PosVertex> verticesSky(m_skySphere.vertices.size());
 	for(UINT i=0; i<m_skySphere.vertices.size(); ++i)
@@ -193,14 +275,9 @@ bool DynamicCubeMapping::BuildBuffers()
 	D3D11_BUFFER_DESC iDescSky = {0};
 	iDescSky.ByteWidth = sizeof(UINT) * m_skySphere.indices.size();
 	iDescSky.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	iDescSky.Usage = D3D11_USAGE_DEFAULT;
-	std::vector<UINT> indicesSky(m_skySphere.indices.size());
-	for(UINT i=0; i<m_skySphere.indices.size(); ++i)
-	{
-		indicesSky[i] = m_skySphere.indices[i];
-	}
+	iDescSky.Usage = D3D11_USAGE_IMMUTABLE;
 	D3D11_SUBRESOURCE_DATA iDataSky;
-	iDataSky.pSysMem = &indicesSky[0];
+	iDataSky.pSysMem = &m_skySphere.indices[0];
 	iDataSky.SysMemPitch = 0;
 	iDataSky.SysMemSlicePitch = 0;
 	if(FAILED(m_d3dDevice->CreateBuffer(&iDescSky,&iDataSky,&m_IBSky)))
@@ -210,16 +287,20 @@ bool DynamicCubeMapping::BuildBuffers()
 	}
 
 	//For sphere and box
-	GeoGen::CreateSphere(1.0f,30,30,m_sphere);
+	//Level 3 geodesic sphere: 1280 triangles, less silhouette error than a 30x30 uv sphere(1740 triangles)
+	GeoGen::CreateGeoSphere(1.f,3,m_sphere);
 	m_sphereVStart = m_sphereIStart = 0;
-	GeoGen::CreateBox(1.f,1.f,1.f,m_box);
+	GeoGen::CreateFromStatic(GeoGen::UnitBox(),1.f,1.f,1.f,m_box);
 	m_boxVStart = m_sphere.vertices.size();
 	m_boxIStart = m_sphere.indices.size();
 
+	XNA::ComputeBoundingAxisAlignedBoxFromPoints(&m_localBounds[ObjSphere],m_sphere.vertices.size(),&m_sphere.vertices[0].pos,sizeof(GeoGen::Vertex));
+	XNA::ComputeBoundingAxisAlignedBoxFromPoints(&m_localBounds[ObjBox],m_box.vertices.size(),&m_box.vertices[0].pos,sizeof(GeoGen::Vertex));
+
 	D3D11_BUFFER_DESC descObjects = {0};
 	descObjects.ByteWidth = sizeof(Vertex::Basic32) * (m_sphere.vertices.size() + m_box.vertices.size());
 	descObjects.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	descObjects.Usage = D3D11_USAGE_DEFAULT;
+	descObjects.Usage = D3D11_USAGE_IMMUTABLE;
 
 	std::vector<Vertex::Basic32> verticesObjects(m_sphere.vertices.size() + m_box.vertices.size());
 	for(UINT i=0; i<m_sphere.vertices.size(); ++i)
@@ -248,7 +329,7 @@ bool DynamicCubeMapping::BuildBuffers()
 	D3D11_BUFFER_DESC iDescObjects = {0};
 	iDescObjects.ByteWidth = sizeof(UINT) * (m_sphere.indices.size() + m_box.indices.size());
 	iDescObjects.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	iDescObjects.Usage = D3D11_USAGE_DEFAULT;
+	iDescObjects.Usage = D3D11_USAGE_IMMUTABLE;
 	std::vector<UINT> indicesObjects(m_sphere.indices.size() + m_box.indices.size());
 	for(UINT i=0; i<m_sphere.indices.size(); ++i)
 	{
@@ -287,86 +368,11 @@ bool DynamicCubeMapping::BuildCubeMap()
 
 bool DynamicCubeMapping::BuildDynamicCubeMappingViews()
 {
-	//Create the dynamic cube map
-	D3D11_TEXTURE2D_DESC cubeMapDesc;
-	cubeMapDesc.Width = m_cubeMapWidth;
-	cubeMapDesc.Height = m_cubeMapHeight;
-	cubeMapDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	cubeMapDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-	cubeMapDesc.ArraySize = 6;
-	cubeMapDesc.Usage = D3D11_USAGE_DEFAULT;
-	cubeMapDesc.CPUAccessFlags = 0;
-	cubeMapDesc.MipLevels = 0;
-	cubeMapDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE | D3D11_RESOURCE_MISC_GENERATE_MIPS;
-	cubeMapDesc.SampleDesc.Count = 1;
-	cubeMapDesc.SampleDesc.Quality = 0;
-	
-	ID3D11Texture2D *cubeMap(NULL);
-	if(FAILED(m_d3dDevice->CreateTexture2D(&cubeMapDesc,0,&cubeMap)))
-	{
-		MessageBox(NULL,L"Create dynamic Cube Map failed!",L"Error",MB_OK);
-		return false;
-	}
-
-	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc;
-	rtvDesc.Format = cubeMapDesc.Format;
-	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2DARRAY;
-	rtvDesc.Texture2DArray.ArraySize = 1;
-	rtvDesc.Texture2DArray.MipSlice = 0;
-	
-	for(UINT i=0; i<6; ++i)
-	{
-		rtvDesc.Texture2DArray.FirstArraySlice = i;
-		if(FAILED(m_d3dDevice->CreateRenderTargetView(cubeMap,&rtvDesc,&m_dynamicRTV[i])))
-		{
-			SafeRelease(cubeMap);
-			MessageBox(NULL,L"Create dynamic Cube Map  rtv failed!",L"Error",MB_OK);
-			return false;
-		}
-	}
-
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-	srvDesc.Format = cubeMapDesc.Format;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
-	srvDesc.TextureCube.MipLevels = -1;
-	srvDesc.TextureCube.MostDetailedMip = 0;
-	if(FAILED(m_d3dDevice->CreateShaderResourceView(cubeMap,&srvDesc,&m_dynamicSRV)))
-	{
-		SafeRelease(cubeMap);
-		MessageBox(NULL,L"Create dynamic Cube Map srv failed!",L"Error",MB_OK);
+	//The cube map and its depth buffer come from the pool, the depth buffer only while the faces are drawn
+	m_targets.Init(m_d3dDevice);
+	m_dynamicCube = m_targets.Acquire(RenderTargetPool::Desc::Cube(m_cubeMapWidth,m_cubeFormat));
+	if(m_dynamicCube < 0)
 		return false;
-	}
-
-	SafeRelease(cubeMap);
-	
-	D3D11_TEXTURE2D_DESC dsDesc;
-	dsDesc.Width = m_cubeMapWidth;
-	dsDesc.Height = m_cubeMapHeight;
-	dsDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	dsDesc.ArraySize = 1;
-	dsDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-	dsDesc.Usage = D3D11_USAGE_DEFAULT;
-	dsDesc.SampleDesc.Count = 1;
-	dsDesc.SampleDesc.Quality = 0;
-	dsDesc.CPUAccessFlags = 0;
-	dsDesc.MiscFlags = 0;
-	dsDesc.MipLevels = 1;
-	
-	ID3D11Texture2D *depthStencilBuffer(NULL);
-	if(FAILED(m_d3dDevice->CreateTexture2D(&dsDesc,0,&depthStencilBuffer)))
-	{
-		SafeRelease(depthStencilBuffer);
-		MessageBox(NULL,L"Create dynamic depth stencil buffer failed!",L"Error",MB_OK);
-		return false;
-	}
-	if(FAILED(m_d3dDevice->CreateDepthStencilView(depthStencilBuffer,0,&m_dynamicDSV)))
-	{
-		SafeRelease(depthStencilBuffer);
-		MessageBox(NULL,L"Create dynamic DSV failed!",L"Error",MB_OK);
-		return false;
-	}
-
-	SafeRelease(depthStencilBuffer);
 
 	m_dynamicViewport.Width = static_cast<float>(m_cubeMapWidth);
 	m_dynamicViewport.Height = static_cast<float>(m_cubeMapHeight);
@@ -378,34 +384,32 @@ bool DynamicCubeMapping::BuildDynamicCubeMappingViews()
 	return true;
 }
 
-void DynamicCubeMapping::BuildDynamicCameras()
+bool DynamicCubeMapping::SetCubeFormat(DXGI_FORMAT format)
 {
-	XMFLOAT3 ups[6] = 
-	{
-		XMFLOAT3( 0.f, 1.f, 0.f),
-		XMFLOAT3( 0.f, 1.f, 0.f),
-		XMFLOAT3( 0.f, 0.f,-1.f),
-		XMFLOAT3( 0.f, 0.f, 1.f),
-		XMFLOAT3( 0.f, 1.f, 0.f),
-		XMFLOAT3( 0.f, 1.f, 0.f)
-	};
-
-	XMFLOAT3 targets[6] = 
-	{
-		XMFLOAT3( 1.f, 0.f, 0.f),
-		XMFLOAT3(-1.f, 0.f, 0.f),
-		XMFLOAT3( 0.f, 1.f, 0.f),
-		XMFLOAT3( 0.f,-1.f, 0.f),
-		XMFLOAT3( 0.f, 0.f, 1.f),
-		XMFLOAT3( 0.f, 0.f,-1.f)
-	};
+	if(format == m_cubeFormat)
+		return true;
+	//The cube is in use until the frames in flight are drawn
+	WaitForFrames();
+
+	//Free the old cube before creating the new one, so both are never alive together.
+	//Keep the old format when the new one cannot be created.
+	m_targets.Release(m_dynamicCube);
+	m_targets.Trim();
+	m_dynamicCube = m_targets.Acquire(RenderTargetPool::Desc::Cube(m_cubeMapWidth,format));
+	bool created = m_dynamicCube >= 0;
+	if(created)
+		m_cubeFormat = format;
+	else
+		m_dynamicCube = m_targets.Acquire(RenderTargetPool::Desc::Cube(m_cubeMapWidth,m_cubeFormat));
+	m_cubeScheduler.Reset();
+
+	return created;
+}
 
-	for(UINT i=0; i<6; ++i)
-	{
-		m_dynamicCameras[i].LookAt(XMFLOAT3(0.f,0.f,0.f),targets[i],ups[i]);
-		m_dynamicCameras[i].SetLens(XM_PI*0.5f,1.f,1.f,1000.f);
-		m_dynamicCameras[i].UpdateView();
-	}
+void DynamicCubeMapping::BuildDynamicCameras()
+{
+	m_cubeRig.SetLens(1.f,1000.f);
+	m_cubeRig.SetCenter(XMLoadFloat4x4(&m_worldSphere).r[3]);
 }
 
 bool DynamicCubeMapping::OnResize()
@@ -415,6 +419,9 @@ bool DynamicCubeMapping::OnResize()
 
 	m_camera.SetLens(XM_PI*0.25f,1.f*m_clientWidth/m_clientHeight,1.f,1000.f);
 
+	//A quarter of the back buffer in each direction is enough for occlusion
+	m_occlusion.Resize(max(1,m_clientWidth/4),max(1,m_clientHeight/4));
+
 	return true;
 }
 
@@ -437,6 +444,25 @@ bool DynamicCubeMapping::Update(float delta)
 		m_camera.Walk(-6.f*delta);
 	}
 
+	//1-4: cube map update policy
+	if(KeyDown('1'))
+		m_cubeScheduler.SetPolicy(CubeFaceScheduler::UpdateAll);
+	else if(KeyDown('2'))
+		m_cubeScheduler.SetPolicy(CubeFaceScheduler::RoundRobin,2);
+	else if(KeyDown('3'))
+		m_cubeScheduler.SetPolicy(CubeFaceScheduler::DirtyFaces);
+	else if(KeyDown('4'))
+		m_cubeScheduler.SetPolicy(CubeFaceScheduler::TimeSliced,CubeFaceScheduler::FaceCount,0.5f);
+	m_cubeScheduler.Advance(delta);
+
+	//5-7: cube map format
+	if(KeyDown('5'))
+		SetCubeFormat(DXGI_FORMAT_R32G32B32A32_FLOAT);
+	else if(KeyDown('6'))
+		SetCubeFormat(DXGI_FORMAT_R16G16B16A16_FLOAT);
+	else if(KeyDown('7'))
+		SetCubeFormat(DXGI_FORMAT_R11G11B10_FLOAT);
+
 	static float angle1(0.f), angle2(0.f);
 	angle1 += XM_PI*0.5f*delta;
 	angle2 += XM_PI*0.5f*delta;
@@ -449,97 +475,331 @@ bool DynamicCubeMapping::Update(float delta)
 	XMStoreFloat4x4(&m_worldBox,worldBox);
 	XMStoreFloat4x4(&m_invWorldTransposeBox,InverseTranspose(worldBox));
 
-	//Update per frame shader variables
-	Effects::fxBasic->SetLights(m_dirLights);
-	Effects::fxBasic->SetEyePos(m_camera.GetPosition());
+	//The cube cameras follow the sphere, only their translation is updated when it moves.
+	//Everything seen from the new center changed.
+	if(m_cubeRig.SetCenter(XMLoadFloat4x4(&m_worldSphere).r[3]))
+		m_cubeScheduler.MarkDirty(CubeFaceScheduler::AllFaces);
+
+	UpdateBounds();
+	UpdateSceneIndex();
+
+	//8-0: pass recording
+	if(KeyDown('8'))
+		m_recordMode = RecordImmediate;
+	else if(KeyDown('9'))
+		m_recordMode = RecordSerial;
+	else if(KeyDown('0'))
+		m_recordMode = RecordParallel;
+
+	//P/O: frames pipelined on a render thread, or updated and rendered in turn
+	if(KeyDown('P'))
+		SetPipelined(true);
+	else if(KeyDown('O'))
+		SetPipelined(false);
+
+	//J: job system benchmark on the console, once per press. The render thread idles meanwhile.
+	bool benchmarkKey = KeyDown('J');
+	if(benchmarkKey && !m_benchmarkKey)
+	{
+		WaitForFrames();
+		JobBenchmark::Print();
+	}
+	m_benchmarkKey = benchmarkKey;
 
 	m_camera.UpdateView();
 
+	CullScene();
+
+	//The box moves every frame: the faces it left and the faces it entered are stale
+	UINT boxFaces = m_viewMasks[ObjBox] & CubeFaceScheduler::AllFaces;
+	m_cubeScheduler.MarkDirty(boxFaces | m_boxFaces);
+	m_boxFaces = boxFaces;
+	m_faces = m_cubeScheduler.Schedule();
+	//Nothing reads the cube when the sphere is not visible: Render's graph culls the faces, they stay due
+	if(!(m_viewMasks[ObjSphere] & (1u << MainView)))
+		m_cubeScheduler.Restore(m_faces);
+
 	return true;
 }
 
+void DynamicCubeMapping::WritePacket(UINT packet)
+{
+	FramePacket &frame = m_packets[packet];
+	XMStoreFloat4x4(&frame.viewProj,m_camera.ViewProjection());
+	frame.eyePos = m_camera.GetPosition();
+	frame.cubeCenter = m_cubeRig.GetCenter();
+	for(UINT i=0; i<6; ++i)
+		XMStoreFloat4x4(&frame.faceViewProj[i],m_cubeRig.ViewProjection(i));
+	frame.world[ObjSphere] = m_worldSphere;
+	frame.world[ObjBox] = m_worldBox;
+	frame.invWorldTranspose[ObjSphere] = m_invWorldTranspose;
+	frame.invWorldTranspose[ObjBox] = m_invWorldTransposeBox;
+	for(UINT i=0; i<ObjCount; ++i)
+		frame.viewMasks[i] = m_viewMasks[i];
+	for(UINT i=0; i<3; ++i)
+		frame.dirLights[i] = m_dirLights[i];
+	frame.faces = m_faces;
+	frame.recordMode = m_recordMode;
+}
+
+//The render thread records the passes with the workers too
+void DynamicCubeMapping::OnRenderThreadBegin()
+{
+	m_jobs.AttachThread();
+}
+
+void DynamicCubeMapping::OnRenderThreadEnd()
+{
+	m_jobs.DetachThread();
+}
+
+//World space box enclosing a transformed local box: the center is transformed as a point,
+//the extents by the absolute value of the rotation/scale part
+static void TransformBounds(const XNA::AxisAlignedBox &local, CXMMATRIX world, XNA::AxisAlignedBox &out)
+{
+	XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&local.Center),world);
+	XMVECTOR extents = XMLoadFloat3(&local.Extents);
+
+	XMVECTOR worldExtents = XMVectorMultiply(XMVectorSplatX(extents),XMVectorAbs(world.r[0]));
+	worldExtents = XMVectorMultiplyAdd(XMVectorSplatY(extents),XMVectorAbs(world.r[1]),worldExtents);
+	worldExtents = XMVectorMultiplyAdd(XMVectorSplatZ(extents),XMVectorAbs(world.r[2]),worldExtents);
+
+	XMStoreFloat3(&out.Center,center);
+	XMStoreFloat3(&out.Extents,worldExtents);
+}
+
+void DynamicCubeMapping::UpdateBounds()
+{
+	TransformBounds(m_localBounds[ObjSphere],XMLoadFloat4x4(&m_worldSphere),m_worldBounds[ObjSphere]);
+	TransformBounds(m_localBounds[ObjBox],XMLoadFloat4x4(&m_worldBox),m_worldBounds[ObjBox]);
+}
+
+void DynamicCubeMapping::UpdateSceneIndex()
+{
+	//The sphere may move too, its cube cameras follow it
+	m_sceneIndex.MoveObject(m_sceneObjects[ObjSphere],m_worldBounds[ObjSphere]);
+	m_sceneIndex.MoveObject(m_sceneObjects[ObjBox],m_worldBounds[ObjBox]);
+}
+
+//Test every object against the six cube faces in one pass, then query the scene index for the main camera
+void DynamicCubeMapping::CullScene()
+{
+	Culling::CubeViews cube = m_cubeRig.GetCubeViews();
+
+	float centerX[ObjCount], centerY[ObjCount], centerZ[ObjCount];
+	float extentX[ObjCount], extentY[ObjCount], extentZ[ObjCount];
+	for(UINT i=0; i<ObjCount; ++i)
+	{
+		centerX[i] = m_worldBounds[i].Center.x;
+		centerY[i] = m_worldBounds[i].Center.y;
+		centerZ[i] = m_worldBounds[i].Center.z;
+		extentX[i] = m_worldBounds[i].Extents.x;
+		extentY[i] = m_worldBounds[i].Extents.y;
+		extentZ[i] = m_worldBounds[i].Extents.z;
+	}
+
+	Culling::AABBSoA bounds = { centerX, centerY, centerZ, extentX, extentY, extentZ, ObjCount };
+	Culling::CullAABBsCube(cube,NULL,0,bounds,m_viewMasks);
+
+	XMVECTOR mainPlanes[6];
+	m_camera.GetPlanes(mainPlanes);
+	auto markVisible = [&](int object) -> bool
+	{
+		m_viewMasks[(UINT)(UINT_PTR)m_sceneIndex.GetUserData(object)] |= 1u << MainView;
+		return true;
+	};
+	m_sceneIndex.QueryFrustum(mainPlanes,markVisible);
+
+	//Then drop the box from the main view when it is behind the sphere
+	UINT mainBit = 1u << MainView;
+	if((m_viewMasks[ObjSphere] & mainBit) && (m_viewMasks[ObjBox] & mainBit))
+	{
+		XMMATRIX viewProj = m_camera.ViewProjection();
+		m_occlusion.Clear();
+		m_occlusion.AddOccluder(&m_sphere.vertices[0].pos,m_sphere.vertices.size(),sizeof(GeoGen::Vertex),
+			&m_sphere.indices[0],m_sphere.indices.size()/3,XMLoadFloat4x4(&m_worldSphere)*viewProj);
+		m_occlusion.Rasterize();
+
+		if(!m_occlusion.TestAABB(m_worldBounds[ObjBox],viewProj))
+			m_viewMasks[ObjBox] &= ~mainBit;
+	}
+}
+
 bool DynamicCubeMapping::Render()
 {
-	//First, render the scene(except the sphere) into texture to generate cube 
-	m_deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	FramePacket &frame = m_packets[m_renderPacket];
+	UINT faces = frame.faces;
 
-	ID3D11RenderTargetView *rtv[1] = {0};
-	Camera *tmpCamera(NULL);
-	m_deviceContext->RSSetViewports(1,&m_dynamicViewport);
-	for(UINT i=0; i<6; ++i)
+	//Per frame shader variables, in every copy of the effect
+	for(UINT i=0; i<Effects::GetCopyCount(); ++i)
 	{
-		rtv[0] = m_dynamicRTV[i];
-		m_deviceContext->OMSetRenderTargets(1,&rtv[0],m_dynamicDSV);
-		m_deviceContext->ClearRenderTargetView(rtv[0],reinterpret_cast<const float*>(&Colors::Silver));
-		m_deviceContext->ClearDepthStencilView(m_dynamicDSV,D3D11_CLEAR_DEPTH,1.0f,0); 
-		tmpCamera = &m_dynamicCameras[i];
+		Effects::Basic(i)->SetLights(frame.dirLights);
+		Effects::Basic(i)->SetEyePos(frame.eyePos);
+	}
+	m_recorder.SetParallel(frame.recordMode == RecordParallel);
 
-		m_deviceContext->IASetInputLayout(InputLayouts::pos);
-		UINT stride1 = sizeof(PosVertex);
-		UINT offset1 = 0;
-		m_deviceContext->IASetVertexBuffers(0,1,&m_VBSky,&stride1,&offset1);
-		m_deviceContext->IASetIndexBuffer(m_IBSky,DXGI_FORMAT_R32_UINT,0);
+	//The passes of the frame: the scheduled cube faces, the mips of the cube, then the scene. Each face has its own
+	//depth buffer so the faces do not depend on each other. When the sphere is not visible nothing reads the cube,
+	//and the graph culls the passes drawing it.
+	m_frameGraph.Reset();
+	int cubeMap = m_frameGraph.ImportResource("CubeMap",m_dynamicCube);
+	int backBuffer = m_frameGraph.ImportResource("BackBuffer",-1,true);
 
-		ID3DX11EffectTechnique *tech = Effects::fxSkyBox->fxSkyBoxTech;
-		D3DX11_TECHNIQUE_DESC techDesc;
-		tech->GetDesc(&techDesc);
+	int faceImages[6];
+	for(UINT i=0; i<6; ++i)
+	{
+		faceImages[i] = -1;
+		if(!(faces & (1u << i)))
+			continue;
 
-		for(UINT p=0; p<techDesc.Passes; ++p)
+		int faceImage = faceImages[i] = m_frameGraph.ImportResource("CubeFace",m_dynamicCube);
+		int depth = m_frameGraph.AddResource("CubeFaceDepth",RenderTargetPool::Desc::Depth(m_cubeMapWidth,m_cubeMapHeight));
+		int facePass = m_frameGraph.AddPass("CubeFace",[this,&frame,i,depth](ID3D11DeviceContext *context)
 		{
-			XMFLOAT3 pos = tmpCamera->GetPosition();
-			XMMATRIX worldTrans = XMMatrixTranslation(pos.x, pos.y, pos.z);
-			XMMATRIX wvp = worldTrans * tmpCamera->ViewProjection();
-			Effects::fxSkyBox->SetWorldViewProjMatrix(wvp);
-			Effects::fxSkyBox->SetCubeMap(m_cubeMapSRV);
-
-			tech->GetPassByIndex(p)->Apply(0,m_deviceContext);
-			m_deviceContext->DrawIndexed(m_skySphere.indices.size(),0,0);
-			//Restore render states for other renderings
-			m_deviceContext->RSSetState(0);
+			DrawCubeFace(context,frame,i,m_targets.GetDSV(m_frameGraph.GetTarget(depth)));
+		});
+		m_frameGraph.Write(facePass,faceImage);
+		m_frameGraph.Write(facePass,depth);
+	}
+
+	int mipsPass = -1;
+	if(faces)
+	{
+		mipsPass = m_frameGraph.AddPass("GenerateMips",[this](ID3D11DeviceContext *context)
+		{
+			context->GenerateMips(m_targets.GetSRV(m_dynamicCube));
+		});
+		for(UINT i=0; i<6; ++i)
+		{
+			if(faceImages[i] >= 0)
+				m_frameGraph.Read(mipsPass,faceImages[i]);
 		}
+		m_frameGraph.Write(mipsPass,cubeMap);
+	}
 
-		m_deviceContext->IASetInputLayout(InputLayouts::basic32);
-		UINT stride2 = sizeof(Vertex::Basic32);
-		UINT offset2 = 0;
-		m_deviceContext->IASetVertexBuffers(0,1,&m_VBObjects,&stride2,&offset2);
-		m_deviceContext->IASetIndexBuffer(m_IBObjects,DXGI_FORMAT_R32_UINT,0);
+	int scenePass = m_frameGraph.AddPass("Scene",[this,&frame](ID3D11DeviceContext *context)
+	{
+		DrawScene(context,frame);
+	});
+	if(frame.viewMasks[ObjSphere] & (1u << MainView))
+		m_frameGraph.Read(scenePass,cubeMap);
+	m_frameGraph.Write(scenePass,backBuffer);
+
+	m_frameGraph.Compile();
+	if(frame.recordMode == RecordImmediate)
+	{
+		if(!m_frameGraph.Execute(m_targets,m_deviceContext))
+			return false;
+	}
+	else
+	{
+		//Every live pass is recorded at once, then the command lists run in the order of the graph
+		if(!m_frameGraph.AcquireTargets(m_targets))
+			return false;
+		m_recorder.Record(m_frameGraph.GetLivePassCount(),[this](UINT i, ID3D11DeviceContext *context)
+		{
+			m_frameGraph.ExecutePass(m_frameGraph.GetOrderedPass(i),context);
+		});
+		m_recorder.Execute(m_deviceContext);
+		m_frameGraph.ReleaseTargets(m_targets);
+	}
 
-		ID3DX11EffectTechnique *mainTech1 = Effects::fxBasic->fxLight3TexTech;
-		D3DX11_TECHNIQUE_DESC mainTechDesc1;
-		mainTech1->GetDesc(&mainTechDesc1);
+	m_swapChain->Present(0,0);
+	m_targets.EndFrame();
 
-		for(UINT p=0; p<mainTechDesc1.Passes; ++p)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&m_worldBox);
-			XMMATRIX wvp = world * tmpCamera->ViewProjection();
-			XMMATRIX invWorldTrans = XMLoadFloat4x4(&m_invWorldTransposeBox);
-			Effects::fxBasic->SetWorldMatrix(world);
-			Effects::fxBasic->SetWorldViewProjMatrix(wvp);
-			Effects::fxBasic->SetWorldInvTransposeMatrix(invWorldTrans);
-			Effects::fxBasic->SetTextureTransform(XMMatrixIdentity());
-			Effects::fxBasic->SetMaterial(m_material);
-			Effects::fxBasic->SetShaderResource(m_boxSRV);
-
-			mainTech1->GetPassByIndex(p)->Apply(0,m_deviceContext);
-			m_deviceContext->DrawIndexed(m_box.indices.size(),m_boxIStart,m_boxVStart);
-			//Restore render states for other renderings
-			m_deviceContext->RSSetState(0);
-		}
+	return true;
+}
 
+//Render the scene(except the sphere) into one face of the cube map
+void DynamicCubeMapping::DrawCubeFace(ID3D11DeviceContext *context, const FramePacket &frame, UINT face, ID3D11DepthStencilView *dsv)
+{
+	//Effects of the context: 0 for the immediate context, 1 + i for deferred context i
+	UINT copy = m_recorder.GetContextIndex(context) + 1;
+	BasicEffect *fxBasic = Effects::Basic(copy);
+	SkyBoxEffect *fxSkyBox = Effects::SkyBox(copy);
+
+	ID3D11RenderTargetView *rtv[1] = { m_targets.GetRTV(m_dynamicCube,face) };
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->RSSetViewports(1,&m_dynamicViewport);
+	context->OMSetRenderTargets(1,&rtv[0],dsv);
+	context->ClearRenderTargetView(rtv[0],reinterpret_cast<const float*>(&Colors::Silver));
+	context->ClearDepthStencilView(dsv,D3D11_CLEAR_DEPTH,1.0f,0); 
+	XMMATRIX faceViewProj = XMLoadFloat4x4(&frame.faceViewProj[face]);
+
+	context->IASetInputLayout(InputLayouts::pos);
+	UINT stride1 = sizeof(PosVertex);
+	UINT offset1 = 0;
+	context->IASetVertexBuffers(0,1,&m_VBSky,&stride1,&offset1);
+	context->IASetIndexBuffer(m_IBSky,DXGI_FORMAT_R32_UINT,0);
+
+	ID3DX11EffectTechnique *tech = fxSkyBox->fxSkyBoxTech;
+	D3DX11_TECHNIQUE_DESC techDesc;
+	tech->GetDesc(&techDesc);
+
+	for(UINT p=0; p<techDesc.Passes; ++p)
+	{
+		XMFLOAT3 pos = frame.cubeCenter;
+		XMMATRIX worldTrans = XMMatrixTranslation(pos.x, pos.y, pos.z);
+		XMMATRIX wvp = worldTrans * faceViewProj;
+		fxSkyBox->SetWorldViewProjMatrix(wvp);
+		fxSkyBox->SetCubeMap(m_cubeMapSRV);
+
+		tech->GetPassByIndex(p)->Apply(0,context);
+		context->DrawIndexed(m_skySphere.indices.size(),0,0);
+		//Restore render states for other renderings
+		context->RSSetState(0);
+	}
+
+	//The sky is always visible, the box only in the faces it overlaps
+	if(!(frame.viewMasks[ObjBox] & (1u << face)))
+		return;
+
+	context->IASetInputLayout(InputLayouts::basic32);
+	UINT stride2 = sizeof(Vertex::Basic32);
+	UINT offset2 = 0;
+	context->IASetVertexBuffers(0,1,&m_VBObjects,&stride2,&offset2);
+	context->IASetIndexBuffer(m_IBObjects,DXGI_FORMAT_R32_UINT,0);
+
+	ID3DX11EffectTechnique *mainTech1 = fxBasic->fxLight3TexTech;
+	D3DX11_TECHNIQUE_DESC mainTechDesc1;
+	mainTech1->GetDesc(&mainTechDesc1);
+
+	for(UINT p=0; p<mainTechDesc1.Passes; ++p)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&frame.world[ObjBox]);
+		XMMATRIX wvp = world * faceViewProj;
+		XMMATRIX invWorldTrans = XMLoadFloat4x4(&frame.invWorldTranspose[ObjBox]);
+		fxBasic->SetWorldMatrix(world);
+		fxBasic->SetWorldViewProjMatrix(wvp);
+		fxBasic->SetWorldInvTransposeMatrix(invWorldTrans);
+		fxBasic->SetTextureTransform(XMMatrixIdentity());
+		fxBasic->SetMaterial(m_material);
+		fxBasic->SetShaderResource(m_boxSRV);
+
+		mainTech1->GetPassByIndex(p)->Apply(0,context);
+		context->DrawIndexed(m_box.indices.size(),m_boxIStart,m_boxVStart);
+		//Restore render states for other renderings
+		context->RSSetState(0);
 	}
-	//Generate mip maps for the dynamic cube map
-	m_deviceContext->GenerateMips(m_dynamicSRV);
-
-	//Now begin rendering the scenen to the back buffer, including the central sphere rendered using the newly generated cube map
-	m_deviceContext->OMSetRenderTargets(1,&m_renderTargetView,m_depthStencilView);
-	m_deviceContext->RSSetViewports(1,&m_viewport);
-	m_deviceContext->ClearRenderTargetView(m_renderTargetView,reinterpret_cast<const float*>(&Colors::Silver));
-	m_deviceContext->ClearDepthStencilView(m_depthStencilView,D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL,1.f,0);
+}
+
+//Render the scene to the back buffer, including the central sphere rendered using the dynamic cube map
+void DynamicCubeMapping::DrawScene(ID3D11DeviceContext *context, const FramePacket &frame)
+{
+	UINT copy = m_recorder.GetContextIndex(context) + 1;
+	BasicEffect *fxBasic = Effects::Basic(copy);
+	SkyBoxEffect *fxSkyBox = Effects::SkyBox(copy);
+
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->OMSetRenderTargets(1,&m_renderTargetView,m_depthStencilView);
+	context->RSSetViewports(1,&m_viewport);
+	context->ClearRenderTargetView(m_renderTargetView,reinterpret_cast<const float*>(&Colors::Silver));
+	context->ClearDepthStencilView(m_depthStencilView,D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL,1.f,0);
 	
 	//Three techniques: one for sphere, one for box, one for sky box
-	ID3DX11EffectTechnique *mainTech = Effects::fxBasic->fxLight3ReflectionTech;
-	ID3DX11EffectTechnique *mainTech2 = Effects::fxBasic->fxLight3TexTech;
-	ID3DX11EffectTechnique *tech = Effects::fxSkyBox->fxSkyBoxTech;
+	ID3DX11EffectTechnique *mainTech = fxBasic->fxLight3ReflectionTech;
+	ID3DX11EffectTechnique *mainTech2 = fxBasic->fxLight3TexTech;
+	ID3DX11EffectTechnique *tech = fxSkyBox->fxSkyBoxTech;
 	
 	D3DX11_TECHNIQUE_DESC mainTechDesc,mainTechDesc2,techDesc;
 	
@@ -548,73 +808,73 @@ bool DynamicCubeMapping::Render()
 	tech->GetDesc(&techDesc);
 	
 	//Begin rendering sphere
-	m_deviceContext->IASetInputLayout(InputLayouts::basic32);
+	context->IASetInputLayout(InputLayouts::basic32);
 	UINT stride1 = sizeof(Vertex::Basic32);
 	UINT offset1 = 0;
-	m_deviceContext->IASetVertexBuffers(0,1,&m_VBObjects,&stride1,&offset1);
-	m_deviceContext->IASetIndexBuffer(m_IBObjects,DXGI_FORMAT_R32_UINT,0);
+	context->IASetVertexBuffers(0,1,&m_VBObjects,&stride1,&offset1);
+	context->IASetIndexBuffer(m_IBObjects,DXGI_FORMAT_R32_UINT,0);
 	
-	for(UINT i=0; i<mainTechDesc.Passes; ++i)
+	bool sphereVisible = (frame.viewMasks[ObjSphere] & (1u << MainView)) != 0;
+	bool boxVisible = (frame.viewMasks[ObjBox] & (1u << MainView)) != 0;
+	XMMATRIX viewProj = XMLoadFloat4x4(&frame.viewProj);
+
+	for(UINT i=0; sphereVisible && i<mainTechDesc.Passes; ++i)
 	{
 		//Update per object shader variables
-		XMMATRIX world = XMLoadFloat4x4(&m_worldSphere);
-		XMMATRIX wvp = world * m_camera.ViewProjection();
-		XMMATRIX invWorldTrans = XMLoadFloat4x4(&m_invWorldTranspose);
-		Effects::fxBasic->SetWorldMatrix(world);
-		Effects::fxBasic->SetWorldViewProjMatrix(wvp);
-		Effects::fxBasic->SetWorldInvTransposeMatrix(invWorldTrans);
-		Effects::fxBasic->SetCubeMap(m_dynamicSRV);
-		Effects::fxBasic->SetMaterial(m_material);
-
-		mainTech->GetPassByIndex(i)->Apply(0,m_deviceContext);
-		m_deviceContext->DrawIndexed(m_sphere.indices.size(),m_sphereIStart,m_sphereVStart);
+		XMMATRIX world = XMLoadFloat4x4(&frame.world[ObjSphere]);
+		XMMATRIX wvp = world * viewProj;
+		XMMATRIX invWorldTrans = XMLoadFloat4x4(&frame.invWorldTranspose[ObjSphere]);
+		fxBasic->SetWorldMatrix(world);
+		fxBasic->SetWorldViewProjMatrix(wvp);
+		fxBasic->SetWorldInvTransposeMatrix(invWorldTrans);
+		fxBasic->SetCubeMap(m_targets.GetSRV(m_dynamicCube));
+		fxBasic->SetMaterial(m_material);
+
+		mainTech->GetPassByIndex(i)->Apply(0,context);
+		context->DrawIndexed(m_sphere.indices.size(),m_sphereIStart,m_sphereVStart);
 		//Restore render states for other renderings
-		m_deviceContext->RSSetState(0);
+		context->RSSetState(0);
 
 
 	}
-	for(UINT i=0; i<mainTechDesc2.Passes; ++i)
-	{
-		XMMATRIX world = XMLoadFloat4x4(&m_worldBox);
-		XMMATRIX wvp = world * m_camera.ViewProjection();
-		XMMATRIX invWorldTrans = XMLoadFloat4x4(&m_invWorldTransposeBox);
-		Effects::fxBasic->SetWorldMatrix(world);
-		Effects::fxBasic->SetWorldViewProjMatrix(wvp);
-		Effects::fxBasic->SetWorldInvTransposeMatrix(invWorldTrans);
-		Effects::fxBasic->SetTextureTransform(XMMatrixIdentity());
-		Effects::fxBasic->SetMaterial(m_material);
-		Effects::fxBasic->SetShaderResource(m_boxSRV);
-
-		mainTech2->GetPassByIndex(i)->Apply(0,m_deviceContext);
-		m_deviceContext->DrawIndexed(m_box.indices.size(),m_boxIStart,m_boxVStart);
+	for(UINT i=0; boxVisible && i<mainTechDesc2.Passes; ++i)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&frame.world[ObjBox]);
+		XMMATRIX wvp = world * viewProj;
+		XMMATRIX invWorldTrans = XMLoadFloat4x4(&frame.invWorldTranspose[ObjBox]);
+		fxBasic->SetWorldMatrix(world);
+		fxBasic->SetWorldViewProjMatrix(wvp);
+		fxBasic->SetWorldInvTransposeMatrix(invWorldTrans);
+		fxBasic->SetTextureTransform(XMMatrixIdentity());
+		fxBasic->SetMaterial(m_material);
+		fxBasic->SetShaderResource(m_boxSRV);
+
+		mainTech2->GetPassByIndex(i)->Apply(0,context);
+		context->DrawIndexed(m_box.indices.size(),m_boxIStart,m_boxVStart);
 		//Restore render states for other renderings
-		m_deviceContext->RSSetState(0);
+		context->RSSetState(0);
 	}
 	
 	//Begin rendering sky box
-	m_deviceContext->IASetInputLayout(InputLayouts::pos);
+	context->IASetInputLayout(InputLayouts::pos);
 	UINT stride2 = sizeof(PosVertex);
 	UINT offset2 = 0;
-	m_deviceContext->IASetVertexBuffers(0,1,&m_VBSky,&stride2,&offset2);
-	m_deviceContext->IASetIndexBuffer(m_IBSky,DXGI_FORMAT_R32_UINT,0);
+	context->IASetVertexBuffers(0,1,&m_VBSky,&stride2,&offset2);
+	context->IASetIndexBuffer(m_IBSky,DXGI_FORMAT_R32_UINT,0);
 	for(UINT i=0; i<techDesc.Passes; ++i)
 	{
 		//Update per obejct shader variables
-		XMFLOAT3 eyePos = m_camera.GetPosition();
+		XMFLOAT3 eyePos = frame.eyePos;
 		XMMATRIX T = XMMatrixTranslation(eyePos.x, eyePos.y, eyePos.z);
-		XMMATRIX WVP = XMMatrixMultiply(T, m_camera.ViewProjection());
-		Effects::fxSkyBox->SetWorldViewProjMatrix(WVP);
-		Effects::fxSkyBox->SetCubeMap(m_cubeMapSRV);
+		XMMATRIX WVP = XMMatrixMultiply(T, viewProj);
+		fxSkyBox->SetWorldViewProjMatrix(WVP);
+		fxSkyBox->SetCubeMap(m_cubeMapSRV);
 
-		tech->GetPassByIndex(i)->Apply(0,m_deviceContext);
-		m_deviceContext->DrawIndexed(m_skySphere.indices.size(),0,0);
+		tech->GetPassByIndex(i)->Apply(0,context);
+		context->DrawIndexed(m_skySphere.indices.size(),0,0);
 		//Restore render states for other renderings
-		m_deviceContext->RSSetState(0);
+		context->RSSetState(0);
 	}
-	
-	m_swapChain->Present(0,0);
-
-	return true;
 }
 
 void DynamicCubeMapping::OnMouseDown(WPARAM btnState, int x, int y)